@@ -201,16 +201,7 @@ void BinaryContent::readBinaryContent(QFile *file, QList<OperationBlob> *operati
             throw Error(QCoreApplication::translate("BinaryContent",
                 "Cannot seek to %1 to read the operation data.").arg(posOfOperationsBlock));
         }
-        // read the operations count
-        qint64 operationsCount = QInstaller::retrieveInt64(file);
-        // read the operations
-        for (int i = 0; i < operationsCount; ++i) {
-            const QString name = QInstaller::retrieveString(file);
-            const QString xml = QInstaller::retrieveString(file);
-            operations->append(OperationBlob(name, xml));
-        }
-        // operations count
-        Q_UNUSED(QInstaller::retrieveInt64(file)) // read it, but deliberately not used
+        operations->append(readOperations(file));
     }
 
     if (manager) {    // read the collection index and data
@@ -268,11 +259,12 @@ void BinaryContent::writeBinaryContent(QFile *out, const QList<OperationBlob> &o
     }
     localManager.removeCollection("QResources");
 
-    // operations
+    // operations, installers do not carry any, so keep the format readable by older versions
     QInstaller::appendInt64(out, operations.count());
     foreach (const OperationBlob &operation, operations) {
         QInstaller::appendString(out, operation.name);
-        QInstaller::appendString(out, operation.xml);
+        QInstaller::appendString(out, operation.data.isNull() ? operation.xml
+            : QString::fromUtf8(operation.data));
     }
     QInstaller::appendInt64(out, operations.count());
     const Range<qint64> operationsSegment = Range<qint64>::fromStartAndEnd(pos, out->pos());
@@ -297,4 +289,95 @@ void BinaryContent::writeBinaryContent(QFile *out, const QList<OperationBlob> &o
     QInstaller::appendInt64(out, magicCookie);
 }
 
+/*!
+    Reads the operations written by writeOperations() from the current position of \a in. Throws
+    Error on failure.
+
+    Besides the indexed operation log, the format of older installations is supported, which
+    stores the name and the XML representation of each operation as strings. Operations read
+    from the indexed log carry their XML representation as undecoded data.
+*/
+QList<OperationBlob> BinaryContent::readOperations(QFileDevice *in)
+{
+    QList<OperationBlob> operations;
+    const qint64 countOrVersion = QInstaller::retrieveInt64(in);
+    if (countOrVersion >= 0) {
+        for (qint64 i = 0; i < countOrVersion; ++i) {
+            const QString name = QInstaller::retrieveString(in);
+            const QString xml = QInstaller::retrieveString(in);
+            operations.append(OperationBlob(name, xml));
+        }
+        // operations count
+        Q_UNUSED(QInstaller::retrieveInt64(in)) // read it, but deliberately not used
+        return operations;
+    }
+
+    if (-countOrVersion > OperationLogVersion) {
+        throw Error(QCoreApplication::translate("BinaryContent",
+            "Unsupported operation log version %1.").arg(-countOrVersion));
+    }
+
+    struct IndexEntry {
+        QString name;
+        QString component;
+        Range<qint64> range;
+    };
+
+    const qint64 count = QInstaller::retrieveInt64(in);
+    QVector<IndexEntry> index;
+    index.reserve(int(count));
+    for (qint64 i = 0; i < count; ++i) {
+        IndexEntry entry;
+        entry.name = QInstaller::retrieveString(in);
+        entry.component = QInstaller::retrieveString(in);
+        entry.range = QInstaller::retrieveInt64Range(in);
+        index.append(entry);
+    }
+
+    const QByteArray data = QInstaller::retrieveByteArray(in);
+    operations.reserve(index.count());
+    foreach (const IndexEntry &entry, index) {
+        if (entry.range.start() < 0 || entry.range.end() > data.size()) {
+            throw Error(QCoreApplication::translate("BinaryContent",
+                "Invalid data range for operation %1.").arg(entry.name));
+        }
+        operations.append(OperationBlob(entry.name, entry.component,
+            data.mid(int(entry.range.start()), int(entry.range.length()))));
+    }
+    // operations count
+    Q_UNUSED(QInstaller::retrieveInt64(in)) // read it, but deliberately not used
+    return operations;
+}
+
+/*!
+    Writes \a operations to \a out as indexed operation log. The log starts with the negated
+    version and the count of the operations, followed by an index holding the name, the component
+    and the data range of each operation. The XML representations of all operations follow as one
+    block, so that reading the log does not require parsing any XML. The log ends with the
+    operations count.
+
+    Operations that are read but never used are written back without decoding their data.
+*/
+void BinaryContent::writeOperations(QFileDevice *out, const QList<OperationBlob> &operations)
+{
+    QByteArray data;
+    QVector<Range<qint64> > ranges;
+    ranges.reserve(operations.count());
+    foreach (const OperationBlob &operation, operations) {
+        const qint64 start = data.size();
+        data.append(operation.data.isNull() ? operation.xml.toUtf8() : operation.data);
+        ranges.append(Range<qint64>::fromStartAndEnd(start, data.size()));
+    }
+
+    QInstaller::appendInt64(out, -OperationLogVersion);
+    QInstaller::appendInt64(out, operations.count());
+    for (int i = 0; i < operations.count(); ++i) {
+        QInstaller::appendString(out, operations.at(i).name);
+        QInstaller::appendString(out, operations.at(i).component);
+        QInstaller::appendInt64Range(out, ranges.at(i));
+    }
+    QInstaller::appendByteArray(out, data);
+    QInstaller::appendInt64(out, operations.count());
+}
+
 } // namespace QInstaller
@@ -34,6 +34,7 @@
 
 QT_BEGIN_NAMESPACE
 class QFile;
+class QFileDevice;
 QT_END_NAMESPACE
 
 namespace QInstaller {
@@ -52,6 +53,9 @@ public:
     static const quint64 MagicCookie = 0xc2630a1c99d668f8LL;  // binary
     static const quint64 MagicCookieDat = 0xc2630a1c99d668f9LL; // data
 
+    // the version of the indexed operation log, stored negated in place of the operations count
+    static const qint64 OperationLogVersion = 1;
+
     static qint64 findMagicCookie(QFile *file, quint64 magicCookie);
     static BinaryLayout binaryLayout(QFile *file, quint64 magicCookie);
 
@@ -66,6 +70,9 @@ public:
                                 const ResourceCollectionManager &manager,
                                 qint64 magicMarker,
                                 quint64 magicCookie);
+
+    static QList<OperationBlob> readOperations(QFileDevice *in);
+    static void writeOperations(QFileDevice *out, const QList<OperationBlob> &operations);
 };
 
 } // namespace QInstaller
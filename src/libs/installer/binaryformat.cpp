@@ -35,6 +35,8 @@
 #include <QFlags>
 #include <QUuid>
 
+#include <cstring>
+
 namespace QInstaller {
 
 /*!
@@ -56,11 +58,31 @@ namespace QInstaller {
     \brief The name of the operation.
 */
 
+/*!
+    \fn OperationBlob::OperationBlob(const QString &n, const QString &c, const QByteArray &d)
+
+    Constructs the operation blob of an operation read from the indexed operation log, while \a n
+    stands for the name part, \a c for the component the operation belongs to and \a d for the
+    UTF-8 encoded XML representation of the operation.
+*/
+
 /*!
     \variable QInstaller::OperationBlob::xml
     \brief The XML representation of the operation.
 */
 
+/*!
+    \variable QInstaller::OperationBlob::component
+    \brief The name of the component the operation belongs to, if read from the indexed
+        operation log.
+*/
+
+/*!
+    \variable QInstaller::OperationBlob::data
+    \brief The UTF-8 encoded XML representation of the operation, if read from the indexed
+        operation log. The data is decoded only when the operation is used.
+*/
+
 /*!
     \class QInstaller::Resource
     \inmodule QtInstallerFramework
@@ -72,6 +94,10 @@ namespace QInstaller {
 
     The resource name can be set at any time using setName() or during construction. The segment
     supplied during construction represents the offset and size of the resource inside the file.
+
+    While open, the segment is mapped into memory if possible. Reads are then served from the
+    mapping without touching the file position, so several resources can read from the same file
+    at the same time, and the data can be used in place through mappedData().
 */
 
 /*!
@@ -86,6 +112,13 @@ namespace QInstaller {
     Sets the range to the \a segment of the file that this resource represents.
 */
 
+/*!
+    \fn const uchar *Resource::mappedData() const
+
+    Returns the data of the resource if it is open and its segment could be mapped into memory,
+    otherwise returns \c 0. The data stays valid until the resource is closed.
+*/
+
 /*!
     Creates a resource providing the data in \a path.
  */
@@ -93,6 +126,7 @@ Resource::Resource(const QString &path)
     : m_file(path)
     , m_name(QFileInfo(path).fileName().toUtf8())
     , m_segment(Range<qint64>::fromStartAndLength(0, m_file.size()))
+    , m_mapped(0)
 {
 }
 
@@ -103,6 +137,7 @@ Resource::Resource(const QString &path, const QByteArray &name)
     : m_file(path)
     , m_name(name)
     , m_segment(Range<qint64>::fromStartAndLength(0, m_file.size()))
+    , m_mapped(0)
 {
 }
 
@@ -113,6 +148,7 @@ Resource::Resource(const QString &path, const Range<qint64> &segment)
     : m_file(path)
     , m_name(QFileInfo(path).fileName().toUtf8())
     , m_segment(segment)
+    , m_mapped(0)
 {
 }
 
@@ -149,6 +185,14 @@ void Resource::setName(const QByteArray &name)
     m_name = name;
 }
 
+/*!
+    Returns the path of the file that contains the resource.
+*/
+QString Resource::path() const
+{
+    return m_file.fileName(QAbstractFileEngine::DefaultName);
+}
+
 /*!
     Opens a resource in QIODevice::ReadOnly mode. The function returns \c true
     if successful.
@@ -163,7 +207,15 @@ bool Resource::open()
         return false;
     }
 
-    if (!QIODevice::open(QIODevice::ReadOnly)) {
+    // reads from a mapping do not need another buffer in between
+    OpenMode mode = QIODevice::ReadOnly;
+    if (m_segment.length() > 0) {
+        m_mapped = m_file.map(m_segment.start(), m_segment.length(), QFileDevice::NoOptions);
+        if (m_mapped)
+            mode |= QIODevice::Unbuffered;
+    }
+
+    if (!QIODevice::open(mode)) {
         setErrorString(tr("Cannot open resource %1 for reading.").arg(QString::fromUtf8(m_name)));
         return false;
     }
@@ -174,6 +226,10 @@ bool Resource::open()
  */
 void Resource::close()
 {
+    if (m_mapped) {
+        m_file.unmap(m_mapped);
+        m_mapped = 0;
+    }
     m_file.close();
     QIODevice::close();
 }
@@ -196,11 +252,15 @@ qint64 Resource::readData(char* data, qint64 maxSize)
     if (maxSize <= 0)
         return 0;
 
-    const qint64 p = m_file.pos();
-    m_file.seek(m_segment.start() + pos());
-    const qint64 amountRead = m_file.read(data, maxSize);
-    m_file.seek(p);
-    return amountRead;
+    if (m_mapped) {
+        memcpy(data, m_mapped + pos(), size_t(maxSize));
+        return maxSize;
+    }
+
+    // the file engine is not shared, so there is no position to restore
+    if (!m_file.seek(m_segment.start() + pos()))
+        return -1;
+    return m_file.read(data, maxSize);
 }
 
 /*!
@@ -227,14 +287,30 @@ qint64 Resource::writeData(const char* data, qint64 maxSize)
 */
 void Resource::copyData(Resource *resource, QFileDevice *out)
 {
+    static const qint64 scBufferSize = 1024 * 1024;
+
     qint64 left = resource->size();
-    char data[4096];
+    QByteArray buffer;
     while (left > 0) {
-        const qint64 len = qMin<qint64>(left, 4096);
-        const qint64 bytesRead = resource->read(data, len);
-        if (bytesRead != len) {
-            throw QInstaller::Error(tr("Read failed after %1 bytes: %2")
-                .arg(QString::number(resource->size() - left), resource->errorString()));
+        const qint64 len = qMin<qint64>(left, scBufferSize);
+        const char *data = 0;
+        if (const uchar *mapped = resource->mappedData()) {
+            if (resource->pos() + len > resource->size()) {
+                throw QInstaller::Error(tr("Read failed after %1 bytes: %2")
+                    .arg(QString::number(resource->size() - left), tr("Unexpected end of data.")));
+            }
+            // write straight from the mapping
+            data = reinterpret_cast<const char *>(mapped) + resource->pos();
+            resource->seek(resource->pos() + len);
+        } else {
+            if (buffer.isEmpty())
+                buffer.resize(int(scBufferSize));
+            const qint64 bytesRead = resource->read(buffer.data(), len);
+            if (bytesRead != len) {
+                throw QInstaller::Error(tr("Read failed after %1 bytes: %2")
+                    .arg(QString::number(resource->size() - left), resource->errorString()));
+            }
+            data = buffer.constData();
         }
         const qint64 bytesWritten = out->write(data, len);
         if (bytesWritten != len) {
@@ -295,6 +371,8 @@ void ResourceCollection::appendResource(const QSharedPointer<Resource>& resource
     Q_ASSERT(resource);
     resource->setParent(0);
     m_resources.append(resource);
+    if (!m_resourcesByName.contains(resource->name()))
+        m_resourcesByName.insert(resource->name(), resource);
 }
 
 /*!
@@ -316,15 +394,13 @@ QList<QSharedPointer<Resource> > ResourceCollection::resources() const
 }
 
 /*!
-    Returns the resource associated with the name \a name.
+    Returns the resource associated with the name \a name. If several resources share the name,
+    the first one appended is returned. The lookup uses the name a resource had when it was
+    appended to the collection.
 */
 QSharedPointer<Resource> ResourceCollection::resourceByName(const QByteArray &name) const
 {
-    foreach (const QSharedPointer<Resource>& i, m_resources) {
-        if (i->name() == name)
-            return i;
-    }
-    return QSharedPointer<Resource>();
+    return m_resourcesByName.value(name);
 }
 
 
@@ -42,8 +42,12 @@ namespace QInstaller {
 struct OperationBlob {
     OperationBlob(const QString &n, const QString &x)
         : name(n), xml(x) {}
+    OperationBlob(const QString &n, const QString &c, const QByteArray &d)
+        : name(n), component(c), data(d) {}
     QString name;
     QString xml;
+    QString component;
+    QByteArray data;
 };
 
 
@@ -67,9 +71,13 @@ public:
     QByteArray name() const;
     void setName(const QByteArray &name);
 
+    QString path() const;
+
     Range<qint64> segment() const { return m_segment; }
     void setSegment(const Range<qint64> &segment) { m_segment = segment; }
 
+    const uchar *mappedData() const { return m_mapped; }
+
     void copyData(QFileDevice *out) { copyData(this, out); }
     static void copyData(Resource *archive, QFileDevice *out);
 
@@ -84,6 +92,7 @@ private:
     QFSFileEngine m_file;
     QByteArray m_name;
     Range<qint64> m_segment;
+    uchar *m_mapped;
 };
 
 
@@ -107,6 +116,7 @@ public:
 private:
     QByteArray m_name;
     QList<QSharedPointer<Resource> > m_resources;
+    QHash<QByteArray, QSharedPointer<Resource> > m_resourcesByName;
 };
 
 
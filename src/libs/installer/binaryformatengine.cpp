@@ -77,9 +77,11 @@ namespace QInstaller {
 */
 
 /*!
-    Constructs a new binary format engine with \a collections and \a fileName.
+    Constructs a new binary format engine with \a collections and \a fileName. The engine shares
+    \a collections, which must not be modified anymore.
 */
-BinaryFormatEngine::BinaryFormatEngine(const QHash<QByteArray, ResourceCollection> &collections,
+BinaryFormatEngine::BinaryFormatEngine(
+        const std::shared_ptr<const QHash<QByteArray, ResourceCollection> > &collections,
         const QString &fileName)
     : m_resource(0)
     , m_collections(collections)
@@ -106,7 +108,7 @@ void BinaryFormatEngine::setFileName(const QString &file)
     while (path.endsWith(sep))
         path.chop(1);
 
-    m_collection = m_collections.value(path.section(sep, 0, 0).toUtf8());
+    m_collection = m_collections->value(path.section(sep, 0, 0).toUtf8());
     m_collection.setName(path.section(sep, 0, 0).toUtf8());
     m_resource = m_collection.resourceByName(path.section(sep, 1, 1).toUtf8());
 }
@@ -116,11 +118,11 @@ void BinaryFormatEngine::setFileName(const QString &file)
 */
 bool BinaryFormatEngine::close()
 {
-    if (m_resource.isNull())
+    if (m_device.isNull())
         return false;
 
-    const bool result = m_resource->isOpen();
-    m_resource->close();
+    const bool result = m_device->isOpen();
+    m_device.reset();
     return result;
 }
 
@@ -130,7 +132,16 @@ bool BinaryFormatEngine::close()
 bool BinaryFormatEngine::open(QIODevice::OpenMode mode)
 {
     Q_UNUSED(mode)
-    return m_resource.isNull() ? false : m_resource->open();
+    if (m_resource.isNull() || !m_device.isNull())
+        return false;
+
+    m_device.reset(new Resource(m_resource->path(), m_resource->segment()));
+    m_device->setName(m_resource->name());
+    if (!m_device->open()) {
+        m_device.reset();
+        return false;
+    }
+    return true;
 }
 
 /*!
@@ -138,7 +149,7 @@ bool BinaryFormatEngine::open(QIODevice::OpenMode mode)
 */
 qint64 BinaryFormatEngine::pos() const
 {
-    return m_resource.isNull() ? 0 : m_resource->pos();
+    return m_device.isNull() ? 0 : m_device->pos();
 }
 
 /*!
@@ -146,7 +157,7 @@ qint64 BinaryFormatEngine::pos() const
 */
 qint64 BinaryFormatEngine::read(char *data, qint64 maxlen)
 {
-    return m_resource.isNull() ? -1 : m_resource->read(data, maxlen);
+    return m_device.isNull() ? -1 : m_device->read(data, maxlen);
 }
 
 /*!
@@ -154,7 +165,7 @@ qint64 BinaryFormatEngine::read(char *data, qint64 maxlen)
 */
 bool BinaryFormatEngine::seek(qint64 offset)
 {
-    return m_resource.isNull() ? false : m_resource->seek(offset);
+    return m_device.isNull() ? false : m_device->seek(offset);
 }
 
 /*!
@@ -255,7 +266,7 @@ QStringList BinaryFormatEngine::entryList(QDir::Filters filters, const QStringLi
         foreach (const QSharedPointer<Resource> &resource, m_collection.resources())
             result.append(QString::fromUtf8(resource->name()));
     } else if (m_collection.name().isEmpty() && (filters & QDir::Dirs)) {
-        foreach (const ResourceCollection &collection, m_collections)
+        foreach (const ResourceCollection &collection, *m_collections)
             result.append(QString::fromUtf8(collection.name()));
     }
     result.removeAll(QString()); // Remove empty names, will crash while using directory iterator.
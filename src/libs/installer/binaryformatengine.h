@@ -33,6 +33,8 @@
 
 #include <QtCore/private/qfsfileengine_p.h>
 
+#include <memory>
+
 namespace QInstaller {
 
 class BinaryFormatEngine : public QAbstractFileEngine
@@ -40,7 +42,7 @@ class BinaryFormatEngine : public QAbstractFileEngine
     Q_DISABLE_COPY(BinaryFormatEngine)
 
 public:
-    BinaryFormatEngine(const QHash<QByteArray, ResourceCollection> &collections,
+    BinaryFormatEngine(const std::shared_ptr<const QHash<QByteArray, ResourceCollection> > &collections,
         const QString &fileName);
 
     void setFileName(const QString &file);
@@ -64,8 +66,10 @@ private:
 
     ResourceCollection m_collection;
     QSharedPointer<Resource> m_resource;
+    // private device for reading, so the same resource can be opened by several engines
+    QScopedPointer<Resource> m_device;
 
-    QHash<QByteArray, ResourceCollection> m_collections;
+    std::shared_ptr<const QHash<QByteArray, ResourceCollection> > m_collections;
 };
 
 } // namespace QInstaller
@@ -37,8 +37,23 @@ namespace QInstaller {
     \inmodule QtInstallerFramework
     \brief The BinaryFormatEngineHandler class provides a way to register resource collections and
         resource files.
+
+    The registered resources are kept in an immutable table. Registering resources creates a
+    modified copy of the table and swaps it in atomically, so engines can be created from any
+    thread without locking and share the table they were created with.
 */
 
+/*!
+    \typedef BinaryFormatEngineHandler::ResourceTable
+
+    Synonym for QHash<QByteArray, ResourceCollection>, the registered resource collections by name.
+*/
+
+BinaryFormatEngineHandler::BinaryFormatEngineHandler()
+    : m_resources(std::make_shared<const ResourceTable>())
+{
+}
+
 /*!
     Creates a file engine for the file specified by \a fileName. To be able to create a file
     engine, the file name needs to be prefixed with \c {installer://}.
@@ -48,7 +63,7 @@ namespace QInstaller {
 QAbstractFileEngine *BinaryFormatEngineHandler::create(const QString &fileName) const
 {
     return fileName.startsWith(QLatin1String("installer://"), Qt::CaseInsensitive )
-        ? new BinaryFormatEngine(m_resources, fileName) : 0;
+        ? new BinaryFormatEngine(resources(), fileName) : 0;
 }
 
 /*!
@@ -56,7 +71,8 @@ QAbstractFileEngine *BinaryFormatEngineHandler::create(const QString &fileName)
 */
 void BinaryFormatEngineHandler::clear()
 {
-    m_resources.clear();
+    QMutexLocker _(&m_mutex);
+    setResources(std::make_shared<const ResourceTable>());
 }
 
 /*!
@@ -73,10 +89,13 @@ BinaryFormatEngineHandler *BinaryFormatEngineHandler::instance()
 */
 void BinaryFormatEngineHandler::registerResources(const QList<ResourceCollection> &collections)
 {
+    QMutexLocker _(&m_mutex);
+    std::shared_ptr<ResourceTable> table = std::make_shared<ResourceTable>(*resources());
     foreach (const ResourceCollection &collection, collections) {
         if (ProductKeyCheck::instance()->isValidPackage(QString::fromUtf8(collection.name())))
-            m_resources.insert(collection.name(), collection);
+            table->insert(collection.name(), collection);
     }
+    setResources(table);
 }
 
 /*!
@@ -104,9 +123,23 @@ BinaryFormatEngineHandler::registerResource(const QString &fileName, const QStri
     if (!ProductKeyCheck::instance()->isValidPackage(QString::fromUtf8(collectionName)))
         return;
 
-    m_resources[collectionName].setName(collectionName);
-    m_resources[collectionName].appendResource(QSharedPointer<Resource>(new Resource(resourcePath,
+    QMutexLocker _(&m_mutex);
+    std::shared_ptr<ResourceTable> table = std::make_shared<ResourceTable>(*resources());
+    (*table)[collectionName].setName(collectionName);
+    (*table)[collectionName].appendResource(QSharedPointer<Resource>(new Resource(resourcePath,
         resourceName)));
+    setResources(table);
+}
+
+std::shared_ptr<const BinaryFormatEngineHandler::ResourceTable>
+BinaryFormatEngineHandler::resources() const
+{
+    return std::atomic_load(&m_resources);
+}
+
+void BinaryFormatEngineHandler::setResources(const std::shared_ptr<const ResourceTable> &resources)
+{
+    std::atomic_store(&m_resources, resources);
 }
 
 } // namespace QInstaller
@@ -33,6 +33,10 @@
 
 #include <QtCore/private/qabstractfileengine_p.h>
 
+#include <QMutex>
+
+#include <memory>
+
 namespace QInstaller {
 
 class INSTALLER_EXPORT BinaryFormatEngineHandler : public QAbstractFileEngineHandler
@@ -48,12 +52,18 @@ public:
     void registerResources(const QList<ResourceCollection> &collections);
     void registerResource(const QString &fileName, const QString &resourcePath);
 
+    typedef QHash<QByteArray, ResourceCollection> ResourceTable;
+
 private:
-    BinaryFormatEngineHandler() {}
+    BinaryFormatEngineHandler();
     ~BinaryFormatEngineHandler() {}
 
+    std::shared_ptr<const ResourceTable> resources() const;
+    void setResources(const std::shared_ptr<const ResourceTable> &resources);
+
 private:
-    QHash<QByteArray, ResourceCollection> m_resources;
+    QMutex m_mutex; // serializes changes to the table
+    std::shared_ptr<const ResourceTable> m_resources;
 };
 
 } // namespace QInstaller
@@ -390,6 +390,8 @@ void Component::setValue(const QString &key, const QString &value)
         this->setCheckable(normalizedValue.toLower() == scTrue);
 
     d->m_vars[key] = normalizedValue;
+    if (key == scName || key == scDependencies || key == scAutoDependOn)
+        d->m_core->invalidateComponentRegistry();
     emit valueChanged(key, normalizedValue);
 }
 
@@ -433,6 +435,7 @@ void Component::appendComponent(Component *component)
     if (Component *parent = component->parentComponent())
         parent->removeComponent(component);
     component->d->m_parentComponent = this;
+    d->m_core->invalidateComponentRegistry();
     setTristate(d->m_childComponents.count() > 0);
 }
 
@@ -446,6 +449,7 @@ void Component::removeComponent(Component *component)
         component->d->m_parentComponent = 0;
         d->m_childComponents.removeAll(component);
         d->m_allChildComponents.removeAll(component);
+        d->m_core->invalidateComponentRegistry();
     }
 }
 
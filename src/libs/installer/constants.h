@@ -89,6 +89,9 @@ static const QLatin1String scUrlQueryString("UrlQueryString");
 static const QLatin1String scProductUUID("ProductUUID");
 static const QLatin1String scAllUsers("AllUsers");
 static const QLatin1String scSupportsModify("SupportsModify");
+static const QLatin1String scMaxConcurrentDownloads("MaxConcurrentDownloads");
+static const QLatin1String scExtractWhileDownloading("ExtractWhileDownloading");
+static const QLatin1String scServerSideExtraction("ServerSideExtraction");
 
 const char scRelocatable[] = "@RELOCATABLE_PATH@";
 
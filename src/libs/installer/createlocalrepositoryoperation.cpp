@@ -40,6 +40,7 @@
 #include "productkeycheck.h"
 
 #include "updateoperations.h"
+#include "updatesinfo_p.h"
 
 #include <QtCore/QDir>
 #include <QtCore/QDirIterator>
@@ -203,41 +204,20 @@ bool CreateLocalRepositoryOperation::performOperation()
         // systems sets all permissions to a completely bogus value...
         Static::fixPermissions(repoPath);
 
-        // open the updates xml file we previously copied
-        QFile updatesXml(repoPath + QLatin1String("Updates.xml"));
-        if (!updatesXml.exists() || !updatesXml.open(QIODevice::ReadOnly))
-            throw QInstaller::Error(tr("Cannot open file \"%1\" for reading.").arg(
-                                        QDir::toNativeSeparators(updatesXml.fileName())));
-
-        // read the content of the updates xml
-        QString error;
-        QDomDocument doc;
-        if (!doc.setContent(&updatesXml, &error))
+        // read the updates xml file we previously copied
+        KDUpdater::UpdatesInfo updatesInfo;
+        updatesInfo.setFileName(repoPath + QLatin1String("Updates.xml"));
+        if (!updatesInfo.isValid()) {
             throw QInstaller::Error(tr("Cannot read file \"%1\": %2").arg(
-                                        QDir::toNativeSeparators(updatesXml.fileName()), error));
+                QDir::toNativeSeparators(updatesInfo.fileName()), updatesInfo.errorString()));
+        }
 
         // build for each available package a name - version mapping
         QHash<QString, QString> nameVersionHash;
-        const QDomElement root = doc.documentElement();
-        const QDomNodeList rootChildNodes = root.childNodes();
-        for (int i = 0; i < rootChildNodes.count(); ++i) {
-            const QDomElement element = rootChildNodes.at(i).toElement();
-            if (element.isNull())
-                continue;
-
-            QString name, version;
-            if (element.tagName() == QLatin1String("PackageUpdate")) {
-                const QDomNodeList elementChildNodes = element.childNodes();
-                for (int j = 0; j < elementChildNodes.count(); ++j) {
-                    const QDomElement e = elementChildNodes.at(j).toElement();
-                    if (e.tagName() == QLatin1String("Name"))
-                        name = e.text();
-                    else if (e.tagName() == QLatin1String("Version"))
-                        version = e.text();
-                }
-                if (ProductKeyCheck::instance()->isValidPackage(name))
-                    nameVersionHash.insert(name, version);
-            }
+        foreach (const KDUpdater::UpdateInfo &info, updatesInfo.updatesInfo()) {
+            const QString name = info.data.value(QLatin1String("Name")).toString();
+            if (ProductKeyCheck::instance()->isValidPackage(name))
+                nameVersionHash.insert(name, info.data.value(QLatin1String("Version")).toString());
         }
 
         emit progressChanged(0.50);
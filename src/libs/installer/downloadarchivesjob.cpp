@@ -29,34 +29,48 @@
 
 #include "binaryformatenginehandler.h"
 #include "component.h"
+#include "downloadcache.h"
 #include "messageboxhandler.h"
 #include "packagemanagercore.h"
+#include "settings.h"
 #include "utils.h"
 
 #include "filedownloader.h"
 #include "filedownloaderfactory.h"
 
+#include <QtCore/QDir>
 #include <QtCore/QFile>
 #include <QtCore/QTimerEvent>
 
+#include <QtNetwork/QNetworkAccessManager>
+
 using namespace QInstaller;
 using namespace KDUpdater;
 
+static QString componentName(const QPair<QString, QString> &archive)
+{
+    return QFileInfo(QFileInfo(archive.first).path()).fileName();
+}
 
 /*!
     Creates a new DownloadArchivesJob with \a parent.
+
+    The number of archives downloaded at the same time is initialized from the
+    \c MaxConcurrentDownloads setting of \a core.
 */
 DownloadArchivesJob::DownloadArchivesJob(PackageManagerCore *core)
     : Job(core)
     , m_core(core)
-    , m_downloader(0)
+    , m_networkManager(new QNetworkAccessManager(this))
     , m_archivesDownloaded(0)
     , m_archivesToDownloadCount(0)
+    , m_maxConcurrentDownloads(core->settings().maxConcurrentDownloads())
     , m_canceled(false)
-    , m_lastFileProgress(0)
+    , m_finished(false)
     , m_progressChangedTimerId(0)
 {
     setCapabilities(Cancelable);
+    connect(this, &Job::finished, [this]() { m_finished = true; });
 }
 
 /*!
@@ -64,8 +78,8 @@ DownloadArchivesJob::DownloadArchivesJob(PackageManagerCore *core)
 */
 DownloadArchivesJob::~DownloadArchivesJob()
 {
-    if (m_downloader)
-        m_downloader->deleteLater();
+    foreach (FileDownloader *downloader, m_transfers.keys())
+        downloader->deleteLater();
 }
 
 /*!
@@ -76,6 +90,29 @@ void DownloadArchivesJob::setArchivesToDownload(const QList<QPair<QString, QStri
 {
     m_archivesToDownload = archives;
     m_archivesToDownloadCount = archives.count();
+
+    m_pendingArchives.clear();
+    foreach (const QPair<QString, QString> &archive, archives)
+        ++m_pendingArchives[componentName(archive)];
+}
+
+/*!
+    Returns \c true if archives of \a component are still waiting to be downloaded or verified.
+    The signal archivesDownloaded() is emitted once the last of them got registered.
+*/
+bool DownloadArchivesJob::hasPendingArchives(const QString &component) const
+{
+    return m_pendingArchives.contains(component);
+}
+
+/*!
+    Sets the maximum number of archives that are downloaded at the same time to \a count. All
+    transfers share one network access manager, so connections to the same repository host are
+    kept alive and reused.
+*/
+void DownloadArchivesJob::setMaxConcurrentDownloads(int count)
+{
+    m_maxConcurrentDownloads = qMax(1, count);
 }
 
 /*!
@@ -83,95 +120,126 @@ void DownloadArchivesJob::setArchivesToDownload(const QList<QPair<QString, QStri
 */
 void DownloadArchivesJob::doStart()
 {
+    if (m_canceled)
+        return; // canceled before the queued start, the job has finished already
+
     m_archivesDownloaded = 0;
     fetchNextArchiveHash();
 }
 
 /*!
     \reimp
+
+    Stops the running transfers right away, so that none of them reports back afterwards. The
+    job then finishes with the \c Canceled error even if no transfer was running.
 */
 void DownloadArchivesJob::doCancel()
 {
     m_canceled = true;
-    if (m_downloader != 0)
-        m_downloader->cancelDownload();
+    abortTransfers();
 }
 
+/*!
+    Starts transfers for the pending archives until the maximum number of concurrent downloads
+    is reached. Finishes the job once no archive is left.
+*/
 void DownloadArchivesJob::fetchNextArchiveHash()
 {
-    if (m_core->testChecksum()) {
-        if (m_canceled) {
-            finishWithError(tr("Canceled"));
-            return;
-        }
+    if (m_canceled) {
+        finishWithError(tr("Canceled"));
+        return;
+    }
 
-        if (m_archivesToDownload.isEmpty()) {
-            emitFinished();
-            return;
-        }
+    while (m_transfers.count() < m_maxConcurrentDownloads && !m_archivesToDownload.isEmpty()) {
+        Transfer transfer;
+        transfer.archive = m_archivesToDownload.takeFirst();
+        startTransfer(transfer);
+    }
 
-        if (m_downloader)
-            m_downloader->deleteLater();
+    if (m_transfers.isEmpty() && m_archivesToDownload.isEmpty())
+        emitFinished();
+}
 
-        m_downloader = setupDownloader(QLatin1String(".sha1"));
-        if (!m_downloader) {
-            m_archivesToDownload.removeFirst();
-            QMetaObject::invokeMethod(this, "fetchNextArchiveHash", Qt::QueuedConnection);
-            return;
-        }
+void DownloadArchivesJob::startTransfer(const Transfer &transfer)
+{
+    if (!m_core->testChecksum()) {
+        fetchArchive(transfer);
+        return;
+    }
 
-        connect(m_downloader, &FileDownloader::downloadCompleted,
-                this, &DownloadArchivesJob::finishedHashDownload, Qt::QueuedConnection);
-        m_downloader->download();
-    } else {
-        QMetaObject::invokeMethod(this, "fetchNextArchive", Qt::QueuedConnection);
+    FileDownloader *const downloader = setupDownloader(transfer.archive, QLatin1String(".sha1"));
+    if (!downloader) {
+        archiveDone(transfer.archive);
+        return;
     }
+
+    m_transfers.insert(downloader, transfer);
+    connect(downloader, &FileDownloader::downloadCompleted,
+            this, &DownloadArchivesJob::finishedHashDownload, Qt::QueuedConnection);
+    downloader->download();
 }
 
 void DownloadArchivesJob::finishedHashDownload()
 {
-    Q_ASSERT(m_downloader != 0);
+    FileDownloader *const downloader = qobject_cast<FileDownloader *>(sender());
+    if (!downloader || !m_transfers.contains(downloader))
+        return; // the transfer has been aborted meanwhile
 
-    QFile sha1HashFile(m_downloader->downloadedFileName());
+    QFile sha1HashFile(downloader->downloadedFileName());
     if (sha1HashFile.open(QFile::ReadOnly)) {
-        m_currentHash = sha1HashFile.readAll();
-        fetchNextArchive();
+        Transfer transfer = takeTransfer(downloader);
+        transfer.hash = sha1HashFile.readAll();
+        if (!registerCachedArchive(transfer))
+            fetchArchive(transfer);
+        fetchNextArchiveHash();
     } else {
         finishWithError(tr("Downloading hash signature failed."));
     }
 }
 
 /*!
-    Fetches the next archive and registers it in the installer.
+    Registers the archive of \a transfer from the download cache if it contains a file with the
+    expected hash. Returns \c false if the archive needs to be downloaded.
 */
-void DownloadArchivesJob::fetchNextArchive()
+bool DownloadArchivesJob::registerCachedArchive(const Transfer &transfer)
 {
-    if (m_canceled) {
-        finishWithError(tr("Canceled"));
-        return;
-    }
-
-    if (m_archivesToDownload.isEmpty()) {
-        emitFinished();
-        return;
-    }
-
-    if (m_downloader != 0)
-        m_downloader->deleteLater();
+    if (transfer.hash.isEmpty() || !DownloadCache::instance()->isEnabled())
+        return false;
+
+    const QString target = localArchivePath(transfer.archive);
+    if (target.isEmpty() || !QDir().mkpath(QFileInfo(target).absolutePath()))
+        return false;
+    if (!DownloadCache::instance()->retrieve(transfer.hash, target))
+        return false;
+
+    emit outputTextChanged(tr("Using cached archive \"%1\".").arg(QFileInfo(target).fileName()));
+    ++m_archivesDownloaded;
+    emit progressChanged(overallProgress());
+    BinaryFormatEngineHandler::instance()->registerResource(transfer.archive.first, target);
+    archiveDone(transfer.archive);
+    return true;
+}
 
-    m_downloader = setupDownloader(QString(), m_core->value(scUrlQueryString));
-    if (!m_downloader) {
-        m_archivesToDownload.removeFirst();
-        QMetaObject::invokeMethod(this, "fetchNextArchiveHash", Qt::QueuedConnection);
+/*!
+    Fetches the archive of \a transfer. It gets registered in the installer once the download
+    completed.
+*/
+void DownloadArchivesJob::fetchArchive(const Transfer &transfer)
+{
+    FileDownloader *const downloader = setupDownloader(transfer.archive, QString(),
+        m_core->value(scUrlQueryString));
+    if (!downloader) {
+        archiveDone(transfer.archive);
         return;
     }
 
-    emit progressChanged(double(m_archivesDownloaded) / m_archivesToDownloadCount);
-    connect(m_downloader, SIGNAL(downloadProgress(double)), this, SLOT(emitDownloadProgress(double)));
-    connect(m_downloader, &FileDownloader::downloadCompleted,
+    m_transfers.insert(downloader, transfer);
+    emit progressChanged(overallProgress());
+    connect(downloader, SIGNAL(downloadProgress(double)), this, SLOT(emitDownloadProgress(double)));
+    connect(downloader, &FileDownloader::downloadCompleted,
             this, &DownloadArchivesJob::registerFile, Qt::QueuedConnection);
 
-    m_downloader->download();
+    downloader->download();
 }
 
 /*!
@@ -180,7 +248,9 @@ void DownloadArchivesJob::fetchNextArchive()
 */
 void DownloadArchivesJob::emitDownloadProgress(double progress)
 {
-    m_lastFileProgress = progress;
+    FileDownloader *const downloader = qobject_cast<FileDownloader *>(sender());
+    if (downloader && m_transfers.contains(downloader))
+        m_transfers[downloader].progress = progress;
     if (!m_progressChangedTimerId)
         m_progressChangedTimerId = startTimer(5);
 }
@@ -193,7 +263,7 @@ void DownloadArchivesJob::timerEvent(QTimerEvent *event)
     if (event->timerId() == m_progressChangedTimerId) {
         killTimer(m_progressChangedTimerId);
         m_progressChangedTimerId = 0;
-        emit progressChanged((double(m_archivesDownloaded) + m_lastFileProgress) / m_archivesToDownloadCount);
+        emit progressChanged(overallProgress());
     }
 }
 
@@ -202,12 +272,15 @@ void DownloadArchivesJob::timerEvent(QTimerEvent *event)
 */
 void DownloadArchivesJob::registerFile()
 {
-    Q_ASSERT(m_downloader != 0);
+    FileDownloader *const downloader = qobject_cast<FileDownloader *>(sender());
+    if (!downloader || !m_transfers.contains(downloader))
+        return; // the transfer has been aborted meanwhile
 
     if (m_canceled)
         return;
 
-    if (m_core->testChecksum() && m_currentHash != m_downloader->sha1Sum().toHex()) {
+    Transfer transfer = takeTransfer(downloader);
+    if (m_core->testChecksum() && transfer.hash != downloader->sha1Sum().toHex()) {
         //TODO: Maybe we should try to download the file again automatically
         const QMessageBox::Button res =
             MessageBoxHandler::critical(MessageBoxHandler::currentBestSuitParent(),
@@ -219,24 +292,32 @@ void DownloadArchivesJob::registerFile()
             finishWithError(tr("Cannot verify Hash"));
             return;
         }
+        transfer.hash.clear();
+        transfer.progress = 0;
+        startTransfer(transfer);
     } else {
         ++m_archivesDownloaded;
         if (m_progressChangedTimerId) {
             killTimer(m_progressChangedTimerId);
             m_progressChangedTimerId = 0;
-            emit progressChanged(double(m_archivesDownloaded) / m_archivesToDownloadCount);
+            emit progressChanged(overallProgress());
         }
 
-        const QPair<QString, QString> pair = m_archivesToDownload.takeFirst();
-        BinaryFormatEngineHandler::instance()->registerResource(pair.first,
-            m_downloader->downloadedFileName());
+        BinaryFormatEngineHandler::instance()->registerResource(transfer.archive.first,
+            downloader->downloadedFileName());
+        if (m_core->testChecksum())
+            DownloadCache::instance()->store(transfer.hash, downloader->downloadedFileName());
+        archiveDone(transfer.archive);
     }
     fetchNextArchiveHash();
 }
 
 void DownloadArchivesJob::downloadCanceled()
 {
-    emitFinishedWithError(Job::Canceled, m_downloader->errorString());
+    const FileDownloader *const downloader = qobject_cast<const FileDownloader *>(sender());
+    const QString error = downloader ? downloader->errorString() : tr("Canceled");
+    abortTransfers();
+    emitFinishedWithError(Job::Canceled, error);
 }
 
 void DownloadArchivesJob::downloadFailed(const QString &error)
@@ -244,43 +325,124 @@ void DownloadArchivesJob::downloadFailed(const QString &error)
     if (m_canceled)
         return;
 
+    FileDownloader *const downloader = qobject_cast<FileDownloader *>(sender());
+    if (!downloader || !m_transfers.contains(downloader))
+        return; // the transfer has been aborted meanwhile
+
+    Transfer transfer = m_transfers.value(downloader);
     const QMessageBox::StandardButton b =
         MessageBoxHandler::critical(MessageBoxHandler::currentBestSuitParent(),
         QLatin1String("archiveDownloadError"), tr("Download Error"), tr("Cannot download archive %1: %2")
-        .arg(m_archivesToDownload.first().second, error), QMessageBox::Retry | QMessageBox::Cancel);
-
-    if (b == QMessageBox::Retry)
-        QMetaObject::invokeMethod(this, "fetchNextArchiveHash", Qt::QueuedConnection);
-    else
+        .arg(transfer.archive.second, error), QMessageBox::Retry | QMessageBox::Cancel);
+
+    if (b == QMessageBox::Retry) {
+        takeTransfer(downloader);
+        transfer.hash.clear();
+        transfer.progress = 0;
+        startTransfer(transfer);
+        fetchNextArchiveHash();
+    } else {
         downloadCanceled();
+    }
 }
 
 void DownloadArchivesJob::finishWithError(const QString &error)
 {
     const FileDownloader *const dl = qobject_cast<const FileDownloader*> (sender());
     const QString msg = tr("Cannot fetch archives: %1\nError while loading %2");
+    QString url;
     if (dl != 0)
-        emitFinishedWithError(QInstaller::DownloadError, msg.arg(error, dl->url().toString()));
-    else
-        emitFinishedWithError(QInstaller::DownloadError, msg.arg(error, m_downloader->url().toString()));
+        url = dl->url().toString();
+    else if (!m_transfers.isEmpty())
+        url = m_transfers.constBegin().key()->url().toString();
+
+    abortTransfers();
+    emitFinishedWithError(QInstaller::DownloadError, msg.arg(error, url));
+}
+
+/*!
+    Removes the transfer that is handled by \a downloader from the list of running transfers
+    and returns it. The downloader gets deleted later.
+*/
+DownloadArchivesJob::Transfer DownloadArchivesJob::takeTransfer(FileDownloader *downloader)
+{
+    downloader->deleteLater();
+    return m_transfers.take(downloader);
+}
+
+/*!
+    Stops all running transfers without reporting their cancellation, so the error the job
+    finishes with is kept.
+*/
+void DownloadArchivesJob::abortTransfers()
+{
+    foreach (FileDownloader *downloader, m_transfers.keys()) {
+        disconnect(downloader, 0, this, 0);
+        downloader->cancelDownload();
+        downloader->deleteLater();
+    }
+    m_transfers.clear();
+}
+
+/*!
+    Marks \a archive as handled and emits archivesDownloaded() if it was the last pending archive
+    of its component.
+*/
+void DownloadArchivesJob::archiveDone(const QPair<QString, QString> &archive)
+{
+    const QString component = componentName(archive);
+    QHash<QString, int>::iterator it = m_pendingArchives.find(component);
+    if (it == m_pendingArchives.end())
+        return;
+
+    if (--it.value() == 0) {
+        m_pendingArchives.erase(it);
+        emit archivesDownloaded(component);
+    }
+}
+
+/*!
+    Returns the path \a archive is stored at locally, or an empty string if its component
+    is unknown.
+*/
+QString DownloadArchivesJob::localArchivePath(const QPair<QString, QString> &archive) const
+{
+    const Component *const component = m_core->componentByName(componentName(archive));
+    if (!component)
+        return QString();
+    return component->localTempPath() + QLatin1Char('/') + component->name() + QLatin1Char('/')
+        + QFileInfo(archive.first).fileName();
+}
+
+double DownloadArchivesJob::overallProgress() const
+{
+    if (m_archivesToDownloadCount == 0)
+        return 1;
+
+    double progress = m_archivesDownloaded;
+    foreach (const Transfer &transfer, m_transfers)
+        progress += transfer.progress;
+    return progress / m_archivesToDownloadCount;
 }
 
-KDUpdater::FileDownloader *DownloadArchivesJob::setupDownloader(const QString &suffix, const QString &queryString)
+KDUpdater::FileDownloader *DownloadArchivesJob::setupDownloader(const QPair<QString, QString> &archive,
+    const QString &suffix, const QString &queryString)
 {
     KDUpdater::FileDownloader *downloader = 0;
-    const QFileInfo fi = QFileInfo(m_archivesToDownload.first().first);
-    const Component *const component = m_core->componentByName(QFileInfo(fi.path()).fileName());
+    const QFileInfo fi = QFileInfo(archive.first);
+    const Component *const component = m_core->componentByName(componentName(archive));
     if (component) {
         QString fullQueryString;
         if (!queryString.isEmpty())
             fullQueryString = QLatin1String("?") + queryString;
-        const QUrl url(m_archivesToDownload.first().second + suffix + fullQueryString);
+        const QUrl url(archive.second + suffix + fullQueryString);
         const QString &scheme = url.scheme();
         downloader = FileDownloaderFactory::instance().create(scheme, this);
 
         if (downloader) {
             downloader->setUrl(url);
             downloader->setAutoRemoveDownloadedFile(false);
+            downloader->setNetworkAccessManager(m_networkManager);
 
             QAuthenticator auth;
             auth.setUser(component->value(QLatin1String("username")));
@@ -292,10 +454,8 @@ KDUpdater::FileDownloader *DownloadArchivesJob::setupDownloader(const QString &s
                 Qt::QueuedConnection);
             connect(downloader, &FileDownloader::downloadStatus, this, &DownloadArchivesJob::downloadStatusChanged);
 
-            if (FileDownloaderFactory::isSupportedScheme(scheme)) {
-                downloader->setDownloadedFileName(component->localTempPath() + QLatin1Char('/')
-                    + component->name() + QLatin1Char('/') + fi.fileName() + suffix);
-            }
+            if (FileDownloaderFactory::isSupportedScheme(scheme))
+                downloader->setDownloadedFileName(localArchivePath(archive) + suffix);
 
             emit outputTextChanged(tr("Downloading archive \"%1\" for component %2.")
                 .arg(fi.fileName() + suffix, component->displayName()));
@@ -29,11 +29,14 @@
 #ifndef DOWNLOADARCHIVESJOB_H
 #define DOWNLOADARCHIVESJOB_H
 
+#include "installer_global.h"
 #include "job.h"
 
+#include <QtCore/QHash>
 #include <QtCore/QPair>
 
 QT_BEGIN_NAMESPACE
+class QNetworkAccessManager;
 class QTimerEvent;
 QT_END_NAMESPACE
 
@@ -46,7 +49,7 @@ namespace QInstaller {
 class MessageBoxHandler;
 class PackageManagerCore;
 
-class DownloadArchivesJob : public Job
+class INSTALLER_EXPORT DownloadArchivesJob : public Job
 {
     Q_OBJECT
 
@@ -57,10 +60,17 @@ public:
     int numberOfDownloads() const { return m_archivesDownloaded; }
     void setArchivesToDownload(const QList<QPair<QString, QString> > &archives);
 
+    int maxConcurrentDownloads() const { return m_maxConcurrentDownloads; }
+    void setMaxConcurrentDownloads(int count);
+
+    bool hasPendingArchives(const QString &component) const;
+    bool isFinished() const { return m_finished; }
+
 Q_SIGNALS:
     void progressChanged(double progress);
     void outputTextChanged(const QString &progress);
     void downloadStatusChanged(const QString &status);
+    void archivesDownloaded(const QString &component);
 
 protected:
     void doStart();
@@ -72,25 +82,44 @@ protected Q_SLOTS:
     void downloadCanceled();
     void downloadFailed(const QString &error);
     void finishWithError(const QString &error);
-    void fetchNextArchive();
     void fetchNextArchiveHash();
     void finishedHashDownload();
     void emitDownloadProgress(double progress);
 
 private:
-    KDUpdater::FileDownloader *setupDownloader(const QString &suffix = QString(), const QString &queryString = QString());
+    struct Transfer
+    {
+        Transfer() : progress(0) {}
+
+        QPair<QString, QString> archive;
+        QByteArray hash;
+        double progress;
+    };
+
+    KDUpdater::FileDownloader *setupDownloader(const QPair<QString, QString> &archive,
+        const QString &suffix = QString(), const QString &queryString = QString());
+    void startTransfer(const Transfer &transfer);
+    bool registerCachedArchive(const Transfer &transfer);
+    void fetchArchive(const Transfer &transfer);
+    Transfer takeTransfer(KDUpdater::FileDownloader *downloader);
+    void abortTransfers();
+    void archiveDone(const QPair<QString, QString> &archive);
+    QString localArchivePath(const QPair<QString, QString> &archive) const;
+    double overallProgress() const;
 
 private:
     PackageManagerCore *m_core;
-    KDUpdater::FileDownloader *m_downloader;
+    QNetworkAccessManager *m_networkManager;
 
     int m_archivesDownloaded;
     int m_archivesToDownloadCount;
+    int m_maxConcurrentDownloads;
     QList<QPair<QString, QString> > m_archivesToDownload;
+    QHash<KDUpdater::FileDownloader *, Transfer> m_transfers;
+    QHash<QString, int> m_pendingArchives;
 
     bool m_canceled;
-    QByteArray m_currentHash;
-    double m_lastFileProgress;
+    bool m_finished;
     int m_progressChangedTimerId;
 };
 
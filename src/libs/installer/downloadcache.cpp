@@ -0,0 +1,369 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include "downloadcache.h"
+
+#include "globals.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QDirIterator>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QSaveFile>
+#include <QtCore/QTemporaryFile>
+
+namespace QInstaller {
+
+static const quint32 scIndexMagic = 0x49465743; // "IFWC"
+static const qint32 scIndexVersion = 1;
+static const qint64 scDefaultMaxSize = Q_INT64_C(2) * 1024 * 1024 * 1024;
+
+static QByteArray normalizedKey(const QByteArray &sha1)
+{
+    return sha1.trimmed().toLower();
+}
+
+static bool copyFile(QFile *source, QFile *target, QByteArray *sha1)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QByteArray buffer(32768, Qt::Uninitialized);
+    while (!source->atEnd()) {
+        const qint64 read = source->read(buffer.data(), buffer.size());
+        if (read < 0 || target->write(buffer.constData(), read) != read)
+            return false;
+        hash.addData(buffer.constData(), read);
+    }
+    *sha1 = hash.result().toHex();
+    return true;
+}
+
+/*!
+    \class QInstaller::DownloadCache
+    \inmodule QtInstallerFramework
+    \brief The DownloadCache class provides a persistent, size-bounded store for downloaded files
+        that is shared between installer runs.
+
+    Files are stored by the SHA-1 checksum of their content, as published in the repository,
+    so a file is only fetched from the network if the cache does not hold the same content
+    already. When the cache grows beyond maxSize(), the least recently used files are removed.
+
+    The cache is disabled until setPath() is called with a non-empty directory.
+*/
+
+DownloadCache::DownloadCache()
+    : m_maxSize(scDefaultMaxSize)
+    , m_size(0)
+    , m_indexLoaded(false)
+    , m_indexDirty(false)
+{
+}
+
+DownloadCache::~DownloadCache()
+{
+    QMutexLocker _(&m_mutex);
+    if (m_indexDirty)
+        writeIndex();
+}
+
+/*!
+    Returns the download cache used by the installer.
+*/
+DownloadCache *DownloadCache::instance()
+{
+    static DownloadCache instance;
+    return &instance;
+}
+
+/*!
+    Returns \c true if a cache directory is set and the maximum size is larger than zero.
+*/
+bool DownloadCache::isEnabled() const
+{
+    QMutexLocker _(&m_mutex);
+    return !m_path.isEmpty() && m_maxSize > 0;
+}
+
+/*!
+    Returns the directory the cached files are stored in.
+*/
+QString DownloadCache::path() const
+{
+    QMutexLocker _(&m_mutex);
+    return m_path;
+}
+
+/*!
+    Sets the directory the cached files are stored in to \a path. An empty \a path disables the
+    cache.
+*/
+void DownloadCache::setPath(const QString &path)
+{
+    QMutexLocker _(&m_mutex);
+    if (m_indexDirty)
+        writeIndex();
+    m_path = path.isEmpty() ? QString() : QDir(path).absolutePath();
+    m_entries.clear();
+    m_entriesByLastUse.clear();
+    m_size = 0;
+    m_indexLoaded = false;
+}
+
+/*!
+    Returns the maximum size of all cached files in bytes. Defaults to 2 GiB.
+*/
+qint64 DownloadCache::maxSize() const
+{
+    QMutexLocker _(&m_mutex);
+    return m_maxSize;
+}
+
+/*!
+    Sets the maximum size of all cached files to \a maxSize bytes.
+*/
+void DownloadCache::setMaxSize(qint64 maxSize)
+{
+    QMutexLocker _(&m_mutex);
+    m_maxSize = maxSize;
+}
+
+/*!
+    Copies the cached file with the hex encoded SHA-1 checksum \a sha1 to \a target. Returns
+    \c true on success, or \c false if the cache does not contain the file or the copy failed.
+    A cached file whose content does not match \a sha1 anymore gets removed.
+
+    The new use time is only recorded in memory; the index is written with the next change of
+    the cache content, when the path changes, or when the cache is destroyed.
+*/
+bool DownloadCache::retrieve(const QByteArray &sha1, const QString &target)
+{
+    const QByteArray key = normalizedKey(sha1);
+    QString path;
+    {
+        QMutexLocker _(&m_mutex);
+        if (m_path.isEmpty() || m_maxSize <= 0 || key.isEmpty())
+            return false;
+        loadIndex();
+        if (!m_entries.contains(key))
+            return false;
+        path = entryPath(key);
+    }
+
+    QFile source(path);
+    QFile output(target);
+    if (!source.open(QIODevice::ReadOnly) || !output.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QByteArray actual;
+    const bool copied = copyFile(&source, &output, &actual);
+    output.close();
+    if (!copied || actual != key) {
+        qCWarning(lcNetwork) << "Dropping damaged download cache entry" << path;
+        output.remove();
+
+        QMutexLocker _(&m_mutex);
+        removeEntry(key);
+        writeIndex();
+        return false;
+    }
+
+    QMutexLocker _(&m_mutex);
+    touchEntry(key);
+    qCDebug(lcNetwork) << "Using cached file for" << target;
+    return true;
+}
+
+/*!
+    Adds a copy of \a source to the cache if its content matches the hex encoded SHA-1 checksum
+    \a sha1. Least recently used files get removed afterwards to keep the cache within maxSize().
+    Files larger than maxSize() are not added, and leave the cache untouched. Returns \c true if
+    the cache contains the file afterwards.
+*/
+bool DownloadCache::store(const QByteArray &sha1, const QString &source)
+{
+    const QByteArray key = normalizedKey(sha1);
+    const qint64 sourceSize = QFileInfo(source).size();
+    QString path;
+    {
+        QMutexLocker _(&m_mutex);
+        if (m_path.isEmpty() || m_maxSize <= 0 || key.isEmpty() || sourceSize > m_maxSize)
+            return false;
+        loadIndex();
+        if (m_entries.contains(key)) {
+            touchEntry(key);
+            return true;
+        }
+        path = entryPath(key);
+    }
+
+    const QFileInfo fi(path);
+    if (!QDir().mkpath(fi.absolutePath()))
+        return false;
+
+    QFile input(source);
+    QTemporaryFile output(fi.absolutePath() + QLatin1String("/XXXXXX.tmp"));
+    if (!input.open(QIODevice::ReadOnly) || !output.open())
+        return false;
+
+    QByteArray actual;
+    if (!copyFile(&input, &output, &actual) || actual != key)
+        return false;
+    const qint64 size = output.size();
+    output.close();
+
+    output.setAutoRemove(false);
+    const QString temporaryPath = output.fileName();
+    if (!QFile::rename(temporaryPath, path)) {
+        QFile::remove(temporaryPath);
+        // another installer might have added the same file meanwhile
+        if (!QFileInfo::exists(path))
+            return false;
+    }
+
+    QMutexLocker _(&m_mutex);
+    if (m_entries.contains(key))
+        touchEntry(key);
+    else
+        insertEntry(key, Entry(size, QDateTime::currentMSecsSinceEpoch()));
+    evict();
+    writeIndex();
+    return m_entries.contains(key);
+}
+
+QString DownloadCache::entryPath(const QByteArray &sha1) const
+{
+    return m_path + QLatin1Char('/') + QString::fromLatin1(sha1.left(2)) + QLatin1Char('/')
+        + QString::fromLatin1(sha1);
+}
+
+/*!
+    \internal
+
+    Reads the index that records when each cached file was used last. Files found in the cache
+    directory without an index entry, for example because another installer process added them,
+    are taken over with their modification time.
+*/
+void DownloadCache::loadIndex()
+{
+    if (m_indexLoaded)
+        return;
+    m_indexLoaded = true;
+
+    QHash<QByteArray, qint64> lastUsed;
+    QFile index(m_path + QLatin1String("/index"));
+    if (index.open(QIODevice::ReadOnly)) {
+        QDataStream stream(&index);
+        quint32 magic = 0;
+        qint32 version = 0;
+        stream >> magic >> version;
+        if (magic == scIndexMagic && version == scIndexVersion) {
+            quint32 count = 0;
+            stream >> count;
+            for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+                QByteArray sha1;
+                qint64 used = 0;
+                stream >> sha1 >> used;
+                lastUsed.insert(sha1, used);
+            }
+        }
+    }
+
+    m_entries.clear();
+    m_entriesByLastUse.clear();
+    m_size = 0;
+    QDirIterator it(m_path, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo fi = it.fileInfo();
+        const QByteArray sha1 = fi.fileName().toLatin1();
+        if (sha1.size() != 40 || fi.dir().dirName() != QString::fromLatin1(sha1.left(2)))
+            continue;   // the index itself and temporary files
+
+        const qint64 used = lastUsed.value(sha1, fi.lastModified().toMSecsSinceEpoch());
+        insertEntry(sha1, Entry(fi.size(), used));
+    }
+}
+
+void DownloadCache::writeIndex()
+{
+    QSaveFile index(m_path + QLatin1String("/index"));
+    if (!index.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream stream(&index);
+    stream << scIndexMagic << scIndexVersion << quint32(m_entries.count());
+    for (QHash<QByteArray, Entry>::const_iterator it = m_entries.constBegin();
+        it != m_entries.constEnd(); ++it) {
+            stream << it.key() << it.value().lastUsed;
+    }
+    if (index.commit())
+        m_indexDirty = false;
+    else
+        qCWarning(lcNetwork) << "Cannot write download cache index:" << index.errorString();
+}
+
+void DownloadCache::insertEntry(const QByteArray &sha1, const Entry &entry)
+{
+    m_entries.insert(sha1, entry);
+    m_entriesByLastUse.insert(entry.lastUsed, sha1);
+    m_size += entry.size;
+}
+
+void DownloadCache::touchEntry(const QByteArray &sha1)
+{
+    QHash<QByteArray, Entry>::iterator it = m_entries.find(sha1);
+    if (it == m_entries.end())
+        return;
+
+    m_entriesByLastUse.remove(it->lastUsed, sha1);
+    it->lastUsed = QDateTime::currentMSecsSinceEpoch();
+    m_entriesByLastUse.insert(it->lastUsed, sha1);
+    m_indexDirty = true;
+}
+
+void DownloadCache::evict()
+{
+    while (m_size > m_maxSize && !m_entriesByLastUse.isEmpty())
+        removeEntry(m_entriesByLastUse.first());
+}
+
+void DownloadCache::removeEntry(const QByteArray &sha1)
+{
+    if (!m_entries.contains(sha1))
+        return;
+
+    const Entry entry = m_entries.take(sha1);
+    m_entriesByLastUse.remove(entry.lastUsed, sha1);
+    m_size -= entry.size;
+    QFile::remove(entryPath(sha1));
+}
+
+} // namespace QInstaller
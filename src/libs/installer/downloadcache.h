@@ -0,0 +1,92 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+#ifndef DOWNLOADCACHE_H
+#define DOWNLOADCACHE_H
+
+#include "installer_global.h"
+
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+namespace QInstaller {
+
+class INSTALLER_EXPORT DownloadCache
+{
+    Q_DISABLE_COPY(DownloadCache)
+
+public:
+    static DownloadCache *instance();
+
+    bool isEnabled() const;
+
+    QString path() const;
+    void setPath(const QString &path);
+
+    qint64 maxSize() const;
+    void setMaxSize(qint64 maxSize);
+
+    bool retrieve(const QByteArray &sha1, const QString &target);
+    bool store(const QByteArray &sha1, const QString &source);
+
+private:
+    DownloadCache();
+    ~DownloadCache();
+
+    struct Entry
+    {
+        Entry() : size(0), lastUsed(0) {}
+        Entry(qint64 s, qint64 used) : size(s), lastUsed(used) {}
+
+        qint64 size;
+        qint64 lastUsed;
+    };
+
+    QString entryPath(const QByteArray &sha1) const;
+    void loadIndex();
+    void writeIndex();
+    void insertEntry(const QByteArray &sha1, const Entry &entry);
+    void touchEntry(const QByteArray &sha1);
+    void evict();
+    void removeEntry(const QByteArray &sha1);
+
+private:
+    mutable QMutex m_mutex;
+    QString m_path;
+    qint64 m_maxSize;
+    qint64 m_size;
+    bool m_indexLoaded;
+    bool m_indexDirty;
+    QHash<QByteArray, Entry> m_entries;
+    QMultiMap<qint64, QByteArray> m_entriesByLastUse;
+};
+
+} // namespace QInstaller
+
+#endif // DOWNLOADCACHE_H
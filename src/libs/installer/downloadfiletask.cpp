@@ -30,6 +30,8 @@
 
 #include "downloadfiletask_p.h"
 
+#include "downloadcache.h"
+
 #include <QCoreApplication>
 #include <QDir>
 #include <QEventLoop>
@@ -85,11 +87,13 @@ void Downloader::doDownload()
     m_timer.start(1000); // Use a timer to check for canceled downloads.
 
     foreach (const FileTaskItem &item, m_items) {
+        if (retrieveFromCache(item))
+            continue;
         if (!startDownload(item))
             break;
     }
 
-    if (m_items.isEmpty() || m_futureInterface->isCanceled()) {
+    if (m_downloads.empty() || m_futureInterface->isCanceled()) {
         m_futureInterface->reportFinished();
         emit finished();    // emit finished, so the event loop can shutdown
     }
@@ -187,6 +191,9 @@ void Downloader::onReadyRead()
 void Downloader::onFinished(QNetworkReply *reply)
 {
     Data &data = *m_downloads[reply];
+    if (data.traceStart >= 0)
+        Tracer::instance()->addEvent("download", "Download", data.traceStart, reply->url().toString());
+
     const QString filename = data.file ? data.file->fileName() : QString();
     if (!m_futureInterface->isCanceled()) {
         if (reply->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid()) {
@@ -217,6 +224,26 @@ void Downloader::onFinished(QNetworkReply *reply)
         }
     }
 
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304) {
+        // The conditional request matched, the caller already holds the current copy.
+        if (data.file)
+            data.file->remove();
+        FileTaskResult result(QString(), QByteArray(), data.taskItem);
+        result.insert(TaskRole::NotModified, true);
+        m_futureInterface->reportResult(result);
+
+        m_downloads.erase(reply);
+        m_redirects.remove(reply);
+        reply->deleteLater();
+
+        m_finished++;
+        if (m_downloads.empty() || m_futureInterface->isCanceled()) {
+            m_futureInterface->reportFinished();
+            emit finished();    // emit finished, so the event loop can shutdown
+        }
+        return;
+    }
+
     const QByteArray ba = reply->readAll();
     if (!ba.isEmpty()) {
         data.observer->addSample(ba.size());
@@ -229,9 +256,17 @@ void Downloader::onFinished(QNetworkReply *reply)
         if (expectedCheckSum != data.observer->checkSum().toHex()) {
             m_futureInterface->reportException(TaskException(tr("Checksum mismatch detected for \"%1\".")
                 .arg(reply->url().toString())));
+        } else if (data.file) {
+            data.file->close();
+            DownloadCache::instance()->store(expectedCheckSum, filename);
         }
     }
-    m_futureInterface->reportResult(FileTaskResult(filename, data.observer->checkSum(), data.taskItem));
+    FileTaskResult result(filename, data.observer->checkSum(), data.taskItem);
+    if (reply->hasRawHeader("ETag"))
+        result.insert(TaskRole::ETag, reply->rawHeader("ETag"));
+    if (reply->hasRawHeader("Last-Modified"))
+        result.insert(TaskRole::LastModified, reply->rawHeader("Last-Modified"));
+    m_futureInterface->reportResult(result);
 
     m_downloads.erase(reply);
     m_redirects.remove(reply);
@@ -361,6 +396,42 @@ bool Downloader::testCanceled()
     return m_futureInterface->isCanceled();
 }
 
+/*!
+    \internal
+
+    Copies the file described by \a item from the download cache if it is known by checksum and
+    reports it as downloaded. Returns \c false if the file needs to be fetched from the network.
+*/
+bool Downloader::retrieveFromCache(const FileTaskItem &item)
+{
+    const QByteArray checksum = item.value(TaskRole::Checksum).toByteArray();
+    if (checksum.isEmpty() || !DownloadCache::instance()->isEnabled())
+        return false;
+
+    TraceSpan span("download", "Retrieve from download cache");
+    if (span.isActive())
+        span.setDetail(item.source());
+
+    QString target = item.target();
+    if (target.isEmpty()) {
+        QTemporaryFile file;
+        if (!file.open())
+            return false;
+        file.setAutoRemove(false);
+        target = file.fileName();
+    }
+
+    if (!DownloadCache::instance()->retrieve(checksum, target)) {
+        if (item.target().isEmpty())
+            QFile::remove(target);
+        return false;
+    }
+
+    m_futureInterface->reportResult(FileTaskResult(target, QByteArray::fromHex(checksum), item));
+    m_finished++;
+    return true;
+}
+
 QNetworkReply *Downloader::startDownload(const FileTaskItem &item)
 {
     QUrl const source = item.source();
@@ -371,7 +442,19 @@ QNetworkReply *Downloader::startDownload(const FileTaskItem &item)
         return 0;
     }
 
-    QNetworkReply *reply = m_nam.get(QNetworkRequest(source));
+    QNetworkRequest request(source);
+    const QByteArray etag = item.value(TaskRole::ETag).toByteArray();
+    const QByteArray lastModified = item.value(TaskRole::LastModified).toByteArray();
+    if (!etag.isEmpty() || !lastModified.isEmpty()) {
+        if (!etag.isEmpty())
+            request.setRawHeader("If-None-Match", etag);
+        if (!lastModified.isEmpty())
+            request.setRawHeader("If-Modified-Since", lastModified);
+        // make sure intermediate proxies revalidate with the origin server
+        request.setRawHeader("Cache-Control", "no-cache");
+    }
+
+    QNetworkReply *reply = m_nam.get(request);
     std::unique_ptr<Data> data(new Data(item));
     m_downloads[reply] = std::move(data);
 
@@ -40,7 +40,10 @@ namespace QInstaller {
 namespace TaskRole {
 enum
 {
-    Authenticator = TaskRole::TargetFile + 10
+    Authenticator = TaskRole::TargetFile + 10,
+    ETag,           // entity tag sent as If-None-Match, reported back from the response
+    LastModified,   // date sent as If-Modified-Since, reported back from the response
+    NotModified     // set on the result if the server answered 304 Not Modified
 };
 }
 
@@ -30,6 +30,7 @@
 #define DOWNLOADFILETASK_P_H
 
 #include "downloadfiletask.h"
+#include "tracer.h"
 #include <observer.h>
 
 #include <QFile>
@@ -54,17 +55,20 @@ struct Data
     Data()
         : file(Q_NULLPTR)
         , observer(Q_NULLPTR)
+        , traceStart(-1)
     {}
 
     Data(const FileTaskItem &fti)
         : taskItem(fti)
         , file(Q_NULLPTR)
         , observer(new FileTaskObserver(QCryptographicHash::Sha1))
+        , traceStart(Tracer::now())
     {}
 
     FileTaskItem taskItem;
     std::unique_ptr<QFile> file;
     std::unique_ptr<FileTaskObserver> observer;
+    qint64 traceStart;
 };
 
 class Downloader : public QObject
@@ -95,6 +99,7 @@ private slots:
 
 private:
     bool testCanceled();
+    bool retrieveFromCache(const FileTaskItem &item);
     QNetworkReply *startDownload(const FileTaskItem &item);
 
 private:
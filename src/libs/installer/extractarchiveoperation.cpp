@@ -28,11 +28,68 @@
 
 #include "extractarchiveoperation_p.h"
 
+#include "constants.h"
+#include "remoteclient.h"
+#include "settings.h"
+
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
 #include <QEventLoop>
 #include <QThreadPool>
 
+#include <algorithm>
+#include <iterator>
+
 namespace QInstaller {
 
+static const int scManifestVersion = 1;
+
+/*!
+    Encodes \a files as compressed path table. Each path is stored as the length of the prefix
+    it shares with the previous path, followed by the remaining UTF-8 encoded bytes.
+*/
+static QByteArray encodeManifest(const QStringList &files)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint32(files.count());
+
+    QByteArray previous;
+    foreach (const QString &file, files) {
+        const QByteArray current = file.toUtf8();
+        const int maxPrefix = qMin(qMin(current.size(), previous.size()), 0xffff);
+        int prefix = 0;
+        while (prefix < maxPrefix && current.at(prefix) == previous.at(prefix))
+            ++prefix;
+        stream << quint16(prefix) << current.mid(prefix);
+        previous = current;
+    }
+    return qCompress(data);
+}
+
+static bool decodeManifest(const QByteArray &manifest, QStringList *files)
+{
+    const QByteArray data = qUncompress(manifest);
+    QDataStream stream(data);
+
+    quint32 count = 0;
+    stream >> count;
+    files->reserve(int(count));
+
+    QByteArray previous;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint16 prefix = 0;
+        QByteArray suffix;
+        stream >> prefix >> suffix;
+        if (prefix > previous.size())
+            return false;
+        previous = previous.left(prefix) + suffix;
+        files->append(QString::fromUtf8(previous));
+    }
+    return stream.status() == QDataStream::Ok && quint32(files->count()) == count;
+}
+
 ExtractArchiveOperation::ExtractArchiveOperation(PackageManagerCore *core)
     : UpdateOperation(core)
 {
@@ -59,11 +116,14 @@ bool ExtractArchiveOperation::performOperation()
     connect(&callback, &Callback::currentFileChanged, this, &ExtractArchiveOperation::fileFinished);
     connect(&callback, &Callback::progressChanged, this, &ExtractArchiveOperation::progressChanged);
 
+    bool extractOnServer = false;
     if (PackageManagerCore *core = packageManager()) {
         connect(core, &PackageManagerCore::statusChanged, &callback, &Callback::statusChanged);
+        extractOnServer = core->settings().serverSideExtraction()
+            && RemoteClient::instance().isActive();
     }
 
-    Runnable *runnable = new Runnable(archivePath, targetDir, &callback);
+    Runnable *runnable = new Runnable(archivePath, targetDir, &callback, extractOnServer);
     connect(runnable, &Runnable::finished, &receiver, &Receiver::runnableFinished,
         Qt::QueuedConnection);
 
@@ -77,6 +137,13 @@ bool ExtractArchiveOperation::performOperation()
         receiver.runnableFinished(true, QString());
     }
 
+    // Store the extracted files once, newest first, so undo removes files before their directory.
+    const QStringList extractedFiles = callback.extractedFiles();
+    QStringList files;
+    files.reserve(extractedFiles.count());
+    std::copy(extractedFiles.crbegin(), extractedFiles.crend(), std::back_inserter(files));
+    setValue(QLatin1String("files"), files + value(QLatin1String("files")).toStringList());
+
     // TODO: Use backups for rollback, too? Doesn't work for uninstallation though.
 
     // delete all backups we can delete right now, remember the rest
@@ -116,14 +183,59 @@ bool ExtractArchiveOperation::testOperation()
 }
 
 /*!
-    This slot is direct connected to the caller so please don't call it from another thread in the
-    same time.
+    Stores the list of extracted files as compact manifest instead of a string list value.
+*/
+QDomDocument ExtractArchiveOperation::toXml() const
+{
+    if (!hasValue(QLatin1String("files")))
+        return UpdateOperation::toXml();
+
+    // the manifest below replaces the plain string list value
+    QDomDocument xml = xmlWithoutValues(QStringList(QLatin1String("files")));
+    const QStringList relocatable = relocatablePaths(value(QLatin1String("files"))
+        .toStringList());
+    QDomElement manifest = xml.createElement(QLatin1String("manifest"));
+    manifest.setAttribute(QLatin1String("version"), scManifestVersion);
+    manifest.appendChild(xml.createTextNode(QLatin1String(encodeManifest(relocatable)
+        .toBase64())));
+    xml.documentElement().appendChild(manifest);
+    return xml;
+}
+
+/*!
+    Restores the operation from \a doc. Reads the list of extracted files either from the manifest
+    or, for older installations, from the string list value.
+*/
+bool ExtractArchiveOperation::fromXml(const QDomDocument &doc)
+{
+    if (!UpdateOperation::fromXml(doc))
+        return false;
+
+    const QDomElement manifest = doc.documentElement().firstChildElement(QLatin1String("manifest"));
+    if (manifest.isNull())
+        return true;
+
+    if (manifest.attribute(QLatin1String("version")).toInt() != scManifestVersion) {
+        qWarning() << "Unsupported file manifest version in operation" << name();
+        return false;
+    }
+
+    QStringList files;
+    if (!decodeManifest(QByteArray::fromBase64(manifest.text().toLatin1()), &files)) {
+        qWarning() << "Cannot read file manifest of operation" << name();
+        return false;
+    }
+
+    setValue(QLatin1String("files"), resolvedPaths(files));
+    return true;
+}
+
+/*!
+    Forwards the name of the extracted file \a filename for display. The file list itself is
+    collected by the extraction callback and stored once the extraction finished.
 */
 void ExtractArchiveOperation::fileFinished(const QString &filename)
 {
-    QStringList files = value(QLatin1String("files")).toStringList();
-    files.prepend(filename);
-    setValue(QLatin1String("files"), files);
     emit outputTextChanged(QDir::toNativeSeparators(filename));
 }
 
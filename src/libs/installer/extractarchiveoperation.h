@@ -48,6 +48,10 @@ public:
     bool undoOperation();
     bool testOperation();
 
+    QDomDocument toXml() const;
+    bool fromXml(const QDomDocument &doc);
+    using UpdateOperation::fromXml;
+
 Q_SIGNALS:
     void outputTextChanged(const QString &progress);
     void progressChanged(double);
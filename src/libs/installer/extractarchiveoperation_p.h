@@ -30,10 +30,12 @@
 
 #include "extractarchiveoperation.h"
 
+#include "fileremover.h"
 #include "fileutils.h"
 #include "lib7z_extract.h"
 #include "lib7z_facade.h"
 #include "packagemanagercore.h"
+#include "remotefileengine.h"
 
 #include <QRunnable>
 #include <QThread>
@@ -57,20 +59,15 @@ public:
     {
         Q_ASSERT(m_op != 0);
 
-        int removedCounter = 0;
-        foreach (const QString &file, m_files) {
-            removedCounter++;
-
-            const QFileInfo fi(file);
-            emit currentFileChanged(QDir::toNativeSeparators(file));
-            emit progressChanged(double(removedCounter) / m_files.count());
-            if (fi.isFile() || fi.isSymLink()) {
-                m_op->deleteFileNowOrLater(fi.absoluteFilePath());
-            } else if (fi.isDir()) {
-                removeSystemGeneratedFiles(file);
-                fi.dir().rmdir(file); // directory may not exist
-            }
-        }
+        FileRemover remover;
+        connect(&remover, &FileRemover::currentFileChanged, this, &WorkerThread::currentFileChanged,
+            Qt::DirectConnection);
+        connect(&remover, &FileRemover::progressChanged, this, &WorkerThread::progressChanged,
+            Qt::DirectConnection);
+
+        // files still in use get renamed and deleted later, that has to happen on this thread
+        foreach (const QString &file, remover.removeEntries(m_files))
+            m_op->deleteFileNowOrLater(file);
     }
 
 signals:
@@ -97,6 +94,10 @@ public:
         return m_backupFiles;
     }
 
+    QStringList extractedFiles() const {
+        return m_extractedFiles;
+    }
+
 public slots:
     void statusChanged(QInstaller::PackageManagerCore::Status status)
     {
@@ -119,6 +120,7 @@ signals:
 private:
     void setCurrentFile(const QString &filename) Q_DECL_OVERRIDE
     {
+        m_extractedFiles.append(filename);
         emit currentFileChanged(QDir::toNativeSeparators(filename));
     }
 
@@ -157,6 +159,7 @@ private:
 private:
     HRESULT m_state = S_OK;
     BackupFiles m_backupFiles;
+    QStringList m_extractedFiles;
 };
 
 class ExtractArchiveOperation::Runnable : public QObject, public QRunnable
@@ -166,14 +169,35 @@ class ExtractArchiveOperation::Runnable : public QObject, public QRunnable
 
 public:
     Runnable(const QString &archivePath, const QString &targetDir,
-            ExtractArchiveOperation::Callback *callback)
+            ExtractArchiveOperation::Callback *callback, bool extractOnServer)
         : m_archivePath(archivePath)
         , m_targetDir(targetDir)
         , m_callback(callback)
+        , m_extractOnServer(extractOnServer)
     {}
 
     void run()
     {
+        if (m_extractOnServer) {
+            RemoteFileEngine engine;
+            engine.setFileName(m_archivePath);
+            if (engine.isConnectedToServer() && engine.supportsDeferredCalls()) {
+                try {
+                    QString errorString;
+                    if (engine.extractArchive(m_targetDir, m_callback, &errorString)) {
+                        emit finished(true, QString());
+                    } else {
+                        emit finished(false, tr("Error while extracting archive \"%1\": %2")
+                            .arg(m_archivePath, errorString));
+                    }
+                } catch (const Error &e) {
+                    emit finished(false, tr("Error while extracting archive \"%1\": %2")
+                        .arg(m_archivePath, e.message()));
+                }
+                return;
+            }
+        }
+
         QFile archive(m_archivePath);
         if (!archive.open(QIODevice::ReadOnly)) {
             emit finished(false, tr("Cannot open archive \"%1\" for reading: %2").arg(m_archivePath,
@@ -182,7 +206,7 @@ public:
         }
 
         try {
-            Lib7z::extractArchive(&archive, m_targetDir, m_callback);
+            Lib7z::extractArchive(&archive, m_targetDir, m_callback, QThread::idealThreadCount());
             emit finished(true, QString());
         } catch (const Lib7z::SevenZipException& e) {
             emit finished(false, tr("Error while extracting archive \"%1\": %2").arg(m_archivePath,
@@ -200,6 +224,7 @@ private:
     QString m_archivePath;
     QString m_targetDir;
     ExtractArchiveOperation::Callback *m_callback;
+    bool m_extractOnServer;
 };
 
 class ExtractArchiveOperation::Receiver : public QObject
@@ -30,6 +30,7 @@
 
 #include "errors.h"
 #include "range.h"
+#include "remoteclient.h"
 
 #include <QCoreApplication>
 #include <QByteArray>
@@ -37,6 +38,14 @@
 #include <QFileDevice>
 #include <QString>
 
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#endif
+
 qint64 QInstaller::retrieveInt64(QFileDevice *in)
 {
     qint64 n = 0;
@@ -92,9 +101,68 @@ QByteArray QInstaller::retrieveData(QFileDevice *in, qint64 size)
     return ba;
 }
 
+#ifdef Q_OS_LINUX
+/*!
+    Lets the kernel copy \a size bytes from the current position of \a in to the current
+    position of \a out, without passing the data through user space. If both files are on a file
+    system that supports it, the data gets shared (reflinked) instead of copied. Returns the
+    number of bytes copied, which is less than \a size if the kernel cannot copy between the
+    files; the positions of both devices are advanced accordingly.
+
+    While the remote client is active, files can be opened through RemoteFileEngine. Their
+    handle() is the descriptor of the server process and means nothing in this process, so
+    nothing is copied then.
+*/
+static qint64 kernelCopy(QFileDevice *out, QFileDevice *in, qint64 size)
+{
+    if (RemoteClient::instance().isActive())
+        return 0;
+
+    const int inFd = in->handle();
+    const int outFd = out->handle();
+    if (inFd == -1 || outFd == -1 || size <= 0 || (out->openMode() & QIODevice::Append))
+        return 0;
+    if (!out->flush())
+        return 0;
+
+    const qint64 inStart = in->pos();
+    const qint64 outStart = out->pos();
+    qint64 copied = 0;
+#ifdef FICLONE
+    // a whole file into an empty one, share all of its extents at once
+    if (inStart == 0 && outStart == 0 && size == in->size() && out->size() == 0
+        && ::ioctl(outFd, FICLONE, inFd) == 0) {
+        copied = size;
+    }
+#endif
+#ifdef SYS_copy_file_range
+    loff_t inOffset = inStart + copied;
+    loff_t outOffset = outStart + copied;
+    while (copied < size) {
+        const long n = ::syscall(SYS_copy_file_range, inFd, &inOffset, outFd, &outOffset,
+            size_t(size - copied), 0u);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            break; // not supported between these files or end of input, copy the rest by hand
+        }
+        copied += n;
+    }
+#endif
+    if (copied > 0) {
+        in->seek(inStart + copied);
+        out->seek(outStart + copied);
+    }
+    return copied;
+}
+#endif
+
 void QInstaller::appendData(QFileDevice *out, QFileDevice *in, qint64 size)
 {
     Q_ASSERT(!in->isSequential());
+#ifdef Q_OS_LINUX
+    size -= kernelCopy(out, in, size);
+#endif
     QInstaller::blockingCopy(in, out, size);
 }
 
@@ -0,0 +1,448 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include "fileremover.h"
+
+#include "errors.h"
+#include "fileutils.h"
+#include "remoteclient.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+
+#include <errno.h>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace QInstaller {
+
+/*!
+    \inmodule QtInstallerFramework
+    \class QInstaller::FileRemover
+    \internal
+    \brief The FileRemover class removes files and directory trees using several threads.
+
+    The work is split into batches of entries that share a parent directory. Batches are kept in
+    a queue that all threads take work from, and scanning a directory queues one batch per
+    subdirectory found, so a deep tree keeps every thread busy. On Unix, entries are unlinked
+    relative to a descriptor of their directory, which resolves the directory path once per
+    batch instead of once per file.
+
+    While the elevated remote client is active, removal goes through the file engines on a
+    single thread, so that the server performs it.
+*/
+
+/*!
+    \fn void QInstaller::FileRemover::currentFileChanged(const QString &filename)
+
+    This signal is emitted whenever a batch of entries in the directory \a filename was
+    processed. It can be emitted from any of the threads taking part in the removal.
+*/
+
+/*!
+    \fn void QInstaller::FileRemover::progressChanged(double progress)
+
+    This signal is emitted by removeEntries() with the \a progress as a value between \c 0
+    and \c 1. It can be emitted from any of the threads taking part in the removal.
+*/
+
+static const int MaxBatchSize = 512;
+
+enum struct EntryResult {
+    Removed,
+    Directory,
+    Failed
+};
+
+struct RemovalBatch
+{
+    RemovalBatch()
+        : depth(0)
+    {}
+    RemovalBatch(const QString &dir, int level)
+        : directory(dir)
+        , depth(level)
+    {}
+
+    QString directory;
+    QStringList names;      // if empty, the directory is scanned for its entries
+    QVector<int> indexes;   // position of each name in the list passed to removeEntries()
+    int depth;
+};
+
+class FileRemoverPrivate
+{
+public:
+    explicit FileRemoverPrivate(FileRemover *qq)
+        : q(qq)
+        , m_maxThreadCount(QThread::idealThreadCount())
+    {}
+
+    void run(const QList<RemovalBatch> &batches, bool tree, bool ignoreErrors);
+    void work();
+    void processBatch(RemovalBatch *batch, QList<RemovalBatch> *subdirectories);
+    EntryResult removeEntry(int directoryFd, const QString &directory, const QString &name,
+        QString *errorString) const;
+    void recordError(const QString &errorString);
+
+    FileRemover *const q;
+    int m_maxThreadCount;
+
+    // only valid during run()
+    bool m_direct;
+    bool m_tree;
+    bool m_ignoreErrors;
+    qint64 m_total;
+    EntryResult *m_results;
+
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    QList<RemovalBatch> m_queue;
+    int m_busy;
+    QAtomicInt m_canceled;
+    qint64 m_processed;
+    QString m_error;
+    QList<QPair<int, QString> > m_directories;
+};
+
+void FileRemoverPrivate::run(const QList<RemovalBatch> &batches, bool tree, bool ignoreErrors)
+{
+    m_direct = !RemoteClient::instance().isActive();
+    m_tree = tree;
+    m_ignoreErrors = ignoreErrors;
+    m_queue = batches;
+    m_busy = 0;
+    m_canceled.store(0);
+    m_processed = 0;
+    m_error.clear();
+    m_directories.clear();
+
+    const int threadCount = m_direct ? qMax(1, m_maxThreadCount) : 1;
+    QList<QFuture<void> > helpers;
+    for (int i = 1; i < threadCount && (tree || i < batches.count()); ++i)
+        helpers.append(QtConcurrent::run(this, &FileRemoverPrivate::work));
+
+    work(); // the calling thread takes part as well
+    foreach (QFuture<void> helper, helpers)
+        helper.waitForFinished();
+}
+
+void FileRemoverPrivate::work()
+{
+    forever {
+        RemovalBatch batch;
+        {
+            QMutexLocker _(&m_mutex);
+            while (m_queue.isEmpty() && m_busy > 0 && !m_canceled.load())
+                m_condition.wait(&m_mutex);
+            if (m_queue.isEmpty() || m_canceled.load()) {
+                m_condition.wakeAll();
+                return;
+            }
+            // take the most recently found directory, this walks the tree depth first
+            batch = m_queue.takeLast();
+            ++m_busy;
+        }
+
+        QList<RemovalBatch> subdirectories;
+        processBatch(&batch, &subdirectories);
+
+        qint64 processed = 0;
+        {
+            QMutexLocker _(&m_mutex);
+            m_queue.append(subdirectories);
+            m_processed += batch.names.count();
+            processed = m_processed;
+            --m_busy;
+            m_condition.wakeAll();
+        }
+
+        emit q->currentFileChanged(QDir::toNativeSeparators(batch.directory));
+        if (!m_tree && m_total > 0)
+            emit q->progressChanged(double(processed) / m_total);
+    }
+}
+
+void FileRemoverPrivate::processBatch(RemovalBatch *batch, QList<RemovalBatch> *subdirectories)
+{
+    int directoryFd = -1;
+#ifdef Q_OS_UNIX
+    if (m_direct) {
+        directoryFd = ::open(QFile::encodeName(batch->directory).constData(),
+            O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directoryFd < 0 && errno == ENOENT && !m_tree)
+            return; // nothing left to remove in there
+    }
+#endif
+
+    if (batch->names.isEmpty()) {
+        // scan the directory, queueing large directories in several batches
+        QStringList names;
+#ifdef Q_OS_UNIX
+        if (directoryFd >= 0) {
+            const int scanFd = ::dup(directoryFd);
+            if (DIR *dir = (scanFd < 0 ? 0 : ::fdopendir(scanFd))) {
+                while (struct dirent *entry = ::readdir(dir)) {
+                    if (qstrcmp(entry->d_name, ".") != 0 && qstrcmp(entry->d_name, "..") != 0)
+                        names.append(QFile::decodeName(entry->d_name));
+                }
+                ::closedir(dir);
+            } else if (scanFd >= 0) {
+                ::close(scanFd);
+            }
+        } else
+#endif
+        {
+            names = QDir(batch->directory).entryList(QDir::AllEntries | QDir::NoDotAndDotDot
+                | QDir::Hidden | QDir::System);
+        }
+
+        while (names.count() > MaxBatchSize) {
+            RemovalBatch rest(batch->directory, batch->depth);
+            rest.names = names.mid(names.count() - MaxBatchSize);
+            names.erase(names.end() - MaxBatchSize, names.end());
+            subdirectories->append(rest);
+        }
+        batch->names = names;
+    }
+
+    for (int i = 0; i < batch->names.count(); ++i) {
+        if (m_canceled.load())
+            break;
+
+        const QString &name = batch->names.at(i);
+        QString errorString;
+        const EntryResult result = removeEntry(directoryFd, batch->directory, name, &errorString);
+        if (!m_tree) {
+            m_results[batch->indexes.at(i)] = result;
+            continue;
+        }
+
+        const QString path = batch->directory + QLatin1Char('/') + name;
+        if (result == EntryResult::Directory) {
+            subdirectories->append(RemovalBatch(path, batch->depth + 1));
+            QMutexLocker _(&m_mutex);
+            m_directories.append(qMakePair(batch->depth + 1, path));
+        } else if (result == EntryResult::Failed) {
+            recordError(QCoreApplication::translate("QInstaller", "Cannot remove file \"%1\": %2")
+                .arg(QDir::toNativeSeparators(path), errorString));
+        }
+    }
+
+#ifdef Q_OS_UNIX
+    if (directoryFd >= 0)
+        ::close(directoryFd);
+#endif
+}
+
+EntryResult FileRemoverPrivate::removeEntry(int directoryFd, const QString &directory,
+    const QString &name, QString *errorString) const
+{
+#ifdef Q_OS_UNIX
+    if (directoryFd >= 0) {
+        const QByteArray encodedName = QFile::encodeName(name);
+        if (::unlinkat(directoryFd, encodedName.constData(), 0) == 0 || errno == ENOENT)
+            return EntryResult::Removed;
+
+        const int error = errno;
+        struct stat st;
+        if (::fstatat(directoryFd, encodedName.constData(), &st, AT_SYMLINK_NOFOLLOW) == 0
+            && S_ISDIR(st.st_mode)) {
+                return EntryResult::Directory;
+        }
+        *errorString = qt_error_string(error);
+        return EntryResult::Failed;
+    }
+#else
+    Q_UNUSED(directoryFd)
+#endif
+
+    const QString path = directory + QLatin1Char('/') + name;
+    QFile file(path);
+    if (file.remove())
+        return EntryResult::Removed;
+
+    const QFileInfo fi(path);
+    if (fi.isDir() && !fi.isSymLink())
+        return EntryResult::Directory;
+    if (!fi.exists() && !fi.isSymLink())
+        return EntryResult::Removed;
+    *errorString = file.errorString();
+    return EntryResult::Failed;
+}
+
+void FileRemoverPrivate::recordError(const QString &errorString)
+{
+    QMutexLocker _(&m_mutex);
+    if (m_ignoreErrors) {
+        qWarning().noquote() << errorString;
+        return;
+    }
+    if (m_error.isEmpty())
+        m_error = errorString;
+    m_canceled.store(1);
+    m_condition.wakeAll();
+}
+
+
+// -- FileRemover
+
+/*!
+    Constructs a file remover with the given \a parent. By default, as many threads as
+    QThread::idealThreadCount() returns take part in a removal.
+*/
+FileRemover::FileRemover(QObject *parent)
+    : QObject(parent)
+    , d(new FileRemoverPrivate(this))
+{
+}
+
+/*!
+    Destroys the file remover.
+*/
+FileRemover::~FileRemover()
+{
+    delete d;
+}
+
+/*!
+    Returns the maximum number of threads taking part in a removal, including the calling one.
+*/
+int FileRemover::maxThreadCount() const
+{
+    return d->m_maxThreadCount;
+}
+
+/*!
+    Sets the maximum number of threads taking part in a removal to \a count.
+*/
+void FileRemover::setMaxThreadCount(int count)
+{
+    d->m_maxThreadCount = qMax(1, count);
+}
+
+/*!
+    Removes the files and symbolic links in \a entries. Directories in \a entries are removed
+    once all files are gone, in the order given, and only if they are empty by then. Returns the
+    files that could not be removed, so the caller can decide how to handle them.
+*/
+QStringList FileRemover::removeEntries(const QStringList &entries)
+{
+    QVector<EntryResult> results(entries.count(), EntryResult::Removed);
+
+    QList<RemovalBatch> batches;
+    QHash<QString, int> openBatches;
+    for (int i = 0; i < entries.count(); ++i) {
+        const QFileInfo fi(entries.at(i));  // does not touch the file system yet
+        const QString directory = fi.absolutePath();
+
+        int batch = openBatches.value(directory, -1);
+        if (batch < 0 || batches.at(batch).names.count() >= MaxBatchSize) {
+            batch = batches.count();
+            batches.append(RemovalBatch(directory, 0));
+            openBatches.insert(directory, batch);
+        }
+        batches[batch].names.append(fi.fileName());
+        batches[batch].indexes.append(i);
+    }
+
+    d->m_total = entries.count();
+    d->m_results = results.data();
+    d->run(batches, false, true);
+    d->m_results = 0;
+
+    QDir dir;
+    QStringList failed;
+    for (int i = 0; i < entries.count(); ++i) {
+        if (results.at(i) == EntryResult::Directory) {
+            removeSystemGeneratedFiles(entries.at(i));
+            dir.rmdir(entries.at(i)); // might still contain files not installed by us
+        } else if (results.at(i) == EntryResult::Failed) {
+            failed.append(entries.at(i));
+        }
+    }
+    emit progressChanged(1.0);
+    return failed;
+}
+
+/*!
+    Removes the directory at \a path recursively. If \a ignoreErrors is \c true, errors are
+    logged as warnings and the removal continues. Otherwise the removal stops at the first error.
+
+    \throws QInstaller::Error if the directory cannot be removed and \a ignoreErrors is \c false
+*/
+void FileRemover::removeDirectory(const QString &path, bool ignoreErrors)
+{
+    if (path.isEmpty()) // QDir("") points to the working directory! We never want to remove that one.
+        return;
+
+    d->m_total = 0;
+    d->run(QList<RemovalBatch>() << RemovalBatch(path, 0), true, ignoreErrors);
+    if (!d->m_error.isEmpty())
+        throw Error(d->m_error);
+
+    // remove the deepest directories first, they are empty now
+    QList<QPair<int, QString> > directories = d->m_directories;
+    std::stable_sort(directories.begin(), directories.end(),
+        [](const QPair<int, QString> &lhs, const QPair<int, QString> &rhs) {
+            return lhs.first > rhs.first;
+        });
+    directories.append(qMakePair(0, path));
+
+    QDir dir;
+    for (int i = 0; i < directories.count(); ++i) {
+        const QString &directory = directories.at(i).second;
+        errno = 0;
+        if (!dir.rmdir(directory) && dir.exists(directory)) {
+            const QString errorMessage = QCoreApplication::translate("QInstaller",
+                "Cannot remove directory \"%1\": %2").arg(QDir::toNativeSeparators(directory),
+                                                          qt_error_string(errno));
+            if (!ignoreErrors)
+                throw Error(errorMessage);
+            qWarning().noquote() << errorMessage;
+        }
+    }
+}
+
+} // namespace QInstaller
@@ -27,6 +27,8 @@
 **************************************************************************/
 #include "fileutils.h"
 
+#include "fileremover.h"
+
 #include <errors.h>
 
 #include <QtCore/QDateTime>
@@ -200,31 +202,8 @@ static QString errnoToQString(int error)
 
 void QInstaller::removeDirectory(const QString &path, bool ignoreErrors)
 {
-    if (path.isEmpty()) // QDir("") points to the working directory! We never want to remove that one.
-        return;
-
-    QStringList dirs;
-    QDirIterator it(path, QDir::NoDotAndDotDot | QDir::Dirs | QDir::NoSymLinks | QDir::Hidden,
-        QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        dirs.prepend(it.next());
-        removeFiles(dirs.at(0), ignoreErrors);
-    }
-
-    QDir d;
-    dirs.append(path);
-    removeFiles(path, ignoreErrors);
-    foreach (const QString &dir, dirs) {
-        errno = 0;
-        if (d.exists(path) && !d.rmdir(dir)) {
-            const QString errorMessage = QCoreApplication::translate("QInstaller",
-                "Cannot remove directory \"%1\": %2").arg(QDir::toNativeSeparators(dir),
-                                                          errnoToQString(errno));
-            if (!ignoreErrors)
-                throw Error(errorMessage);
-            qWarning().noquote() << errorMessage;
-        }
-    }
+    FileRemover remover;
+    remover.removeDirectory(path, ignoreErrors);
 }
 
 class RemoveDirectoryThread : public QThread
@@ -33,26 +33,30 @@
 #include <QList>
 #include <QPair>
 #include <QSet>
+#include <QVector>
+
+#include <algorithm>
 
 namespace QInstaller {
 
 template <class T> class Graph
 {
 public:
-    inline Graph() {}
+    inline Graph() : m_hasCycle(false) {}
     explicit Graph(const QList<T> &nodes)
+        : m_hasCycle(false)
     {
         addNodes(nodes);
     }
 
     const QList<T> nodes() const
     {
-        return m_graph.keys();
+        return m_nodes;
     }
 
     void addNode(const T &node)
     {
-        m_graph.insert(node, QSet<T>());
+        indexOf(node);
     }
 
     void addNodes(const QList<T> &nodes)
@@ -63,12 +67,23 @@ public:
 
     QList<T> edges(const T &node) const
     {
-        return m_graph.value(node).toList();
+        QList<T> result;
+        const int index = m_index.value(node, -1);
+        if (index < 0)
+            return result;
+        foreach (int edge, m_edges.at(index))
+            result.append(m_nodes.at(edge));
+        return result;
     }
 
     void addEdge(const T &node, const T &edge)
     {
-        m_graph[node].insert(edge);
+        const int from = indexOf(node);
+        const int to = indexOf(edge);
+        if (!m_edgeSet.contains(qMakePair(from, to))) {
+            m_edgeSet.insert(qMakePair(from, to));
+            m_edges[from].append(to);
+        }
     }
 
     void addEdges(const T &node, const QList<T> &edges)
@@ -87,15 +102,59 @@ public:
         return m_cycle;
     }
 
+    // Returns all nodes of the detected cycle in edge order, starting and ending with
+    // cycle().second, or an empty list if sort() did not find a cycle.
+    QList<T> cycleNodes() const
+    {
+        return m_cycleNodes;
+    }
+
     QList<T> sort() const
     {
-        QSet<T> visitedNodes;
+        enum State { Unvisited, InProgress, Resolved };
+        QVector<char> states(m_nodes.count(), Unvisited);
+        // < node, index of the next edge to follow >
+        QVector<QPair<int, int> > stack;
         QList<T> resolvedNodes;
 
         m_hasCycle = false;
         m_cycle = qMakePair(T(), T());
-        foreach (const T &node, nodes())
-            visit(node, &resolvedNodes, &visitedNodes);
+        m_cycleNodes.clear();
+        for (int root = 0; root < m_nodes.count(); ++root) {
+            if (states.at(root) != Unvisited)
+                continue;
+
+            states[root] = InProgress;
+            stack.append(qMakePair(root, 0));
+            while (!stack.isEmpty()) {
+                QPair<int, int> &top = stack.last();
+                const QVector<int> &edges = m_edges.at(top.first);
+                if (top.second == edges.count()) {
+                    // all adjacencies are resolved, append this node to the ordered list
+                    states[top.first] = Resolved;
+                    resolvedNodes.append(m_nodes.at(top.first));
+                    stack.removeLast();
+                    continue;
+                }
+
+                const int adjacency = edges.at(top.second++);
+                if (states.at(adjacency) == Unvisited) {
+                    states[adjacency] = InProgress;
+                    stack.append(qMakePair(adjacency, 0));
+                } else if (states.at(adjacency) == InProgress) {
+                    // the adjacency is still on the stack, so we detected a cycle
+                    m_hasCycle = true;
+                    m_cycle = qMakePair(m_nodes.at(top.first), m_nodes.at(adjacency));
+                    int i = stack.count() - 1;
+                    while (stack.at(i).first != adjacency)
+                        --i;
+                    for (; i < stack.count(); ++i)
+                        m_cycleNodes.append(m_nodes.at(stack.at(i).first));
+                    m_cycleNodes.append(m_nodes.at(adjacency));
+                    return resolvedNodes;
+                }
+            }
+        }
         return resolvedNodes;
     }
 
@@ -107,38 +166,27 @@ public:
     }
 
 private:
-    void visit(const T &node, QList<T> *const resolvedNodes, QSet<T> *const visitedNodes) const
+    int indexOf(const T &node)
     {
-        if (m_hasCycle)
-            return;
-
-        // if we visited this node already
-        if (visitedNodes->contains(node)) {
-            // and if the node is already in the ordered list
-            if (resolvedNodes->contains(node))
-                return;
-
-            m_hasCycle = true;
-            m_cycle.second = node;
-            return; // if not yet in the ordered list, we detected a cycle
-        }
-
-        // mark this node as visited
-        visitedNodes->insert(node);
-
-        m_cycle.first = node;
-        // recursively visit all adjacency
-        foreach (const T &adjacency, edges(node))
-            visit(adjacency, resolvedNodes, visitedNodes);
-
-        // append this node to the ordered list
-        resolvedNodes->append(node);
+        typename QHash<T, int>::const_iterator it = m_index.constFind(node);
+        if (it != m_index.constEnd())
+            return it.value();
+
+        const int index = m_nodes.count();
+        m_index.insert(node, index);
+        m_nodes.append(node);
+        m_edges.append(QVector<int>());
+        return index;
     }
 
 private:
     mutable bool m_hasCycle;
-    QHash<T, QSet<T> > m_graph;
+    QList<T> m_nodes;
+    QHash<T, int> m_index;
+    QVector<QVector<int> > m_edges;
+    QSet<QPair<int, int> > m_edgeSet;
     mutable QPair<T,T> m_cycle;
+    mutable QList<T> m_cycleNodes;
 };
 
 }
@@ -46,6 +46,7 @@ HEADERS += packagemanagercore.h \
     binaryformatenginehandler.h \
     repository.h \
     utils.h \
+    fileremover.h \
     errors.h \
     component.h \
     scriptengine.h \
@@ -99,6 +100,8 @@ HEADERS += packagemanagercore.h \
     copyfiletask.h \
     downloadfiletask.h \
     downloadfiletask_p.h \
+    downloadcache.h \
+    tracer.h \
     unziptask.h \
     observer.h \
     runextensions.h \
@@ -139,6 +142,7 @@ SOURCES += packagemanagercore.cpp \
     binaryformatenginehandler.cpp \
     repository.cpp \
     fileutils.cpp \
+    fileremover.cpp \
     utils.cpp \
     component.cpp \
     scriptengine.cpp \
@@ -185,6 +189,8 @@ SOURCES += packagemanagercore.cpp \
     abstractfiletask.cpp \
     copyfiletask.cpp \
     downloadfiletask.cpp \
+    downloadcache.cpp \
+    tracer.cpp \
     unziptask.cpp \
     observer.cpp \
     metadatajob.cpp \
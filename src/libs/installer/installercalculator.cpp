@@ -30,6 +30,7 @@
 
 #include "component.h"
 #include "packagemanagercore.h"
+#include "tracer.h"
 
 #include <QDebug>
 
@@ -38,6 +39,10 @@ namespace QInstaller {
 InstallerCalculator::InstallerCalculator(const QList<Component *> &allComponents)
     : m_allComponents(allComponents)
 {
+    foreach (Component *component, m_allComponents) {
+        if (!m_componentsByName.contains(component->name()))
+            m_componentsByName.insert(component->name(), component);
+    }
 }
 
 void InstallerCalculator::insertInstallReason(Component *component,
@@ -106,11 +111,25 @@ QString InstallerCalculator::recursionError(Component *component)
         "already added with reason: \"%2\"").arg(component->name(), installReason(component));
 }
 
+Component *InstallerCalculator::componentByName(const QString &name) const
+{
+    QString fixedName;
+    QString fixedVersion;
+    PackageManagerCore::parseNameAndVersion(name, &fixedName, &fixedVersion);
+    Component *component = m_componentsByName.value(fixedName);
+    if (!component)
+        return 0;
+    // let the core evaluate a possible version requirement on the single candidate
+    return PackageManagerCore::componentByName(name, QList<Component *>() << component);
+}
+
 bool InstallerCalculator::appendComponentsToInstall(const QList<Component *> &components)
 {
     if (components.isEmpty())
         return true;
 
+    TraceSpan span("calculator", "Calculate components to install");
+
     QList<Component*> notAppendedComponents; // for example components with unresolved dependencies
     foreach (Component *component, components){
         if (m_toInstallComponentIds.contains(component->name())) {
@@ -159,10 +178,9 @@ bool InstallerCalculator::appendComponentToInstall(Component *component, const Q
     QSet<QString> allDependencies = component->dependencies().toSet();
     QString requiredDependencyVersion = version;
     foreach (const QString &dependencyComponentName, allDependencies) {
-        // PackageManagerCore::componentByName returns 0 if dependencyComponentName contains a
-        // version which is not available
-        Component *dependencyComponent =
-            PackageManagerCore::componentByName(dependencyComponentName, m_allComponents);
+        // componentByName returns 0 if dependencyComponentName contains a version which is
+        // not available
+        Component *dependencyComponent = componentByName(dependencyComponentName);
         if (!dependencyComponent) {
             const QString errorMessage = QCoreApplication::translate("InstallerCalculator",
                 "Cannot find missing dependency \"%1\" for \"%2\".").arg(dependencyComponentName,
@@ -173,13 +191,16 @@ bool InstallerCalculator::appendComponentToInstall(Component *component, const Q
         }
         //Check if component requires higher version than what might be already installed
         bool isUpdateRequired = false;
-        if (dependencyComponentName.contains(QChar::fromLatin1('-')) &&
+        QString dependencyName;
+        QString requiredVersion;
+        PackageManagerCore::parseNameAndVersion(dependencyComponentName, &dependencyName,
+            &requiredVersion);
+        if (!requiredVersion.isEmpty() &&
                 !dependencyComponent->value(scInstalledVersion).isEmpty()) {
             QRegExp compEx(QLatin1String("([<=>]+)(.*)"));
             const QString installedVersion = compEx.exactMatch(dependencyComponent->value(scInstalledVersion)) ?
                 compEx.cap(2) : dependencyComponent->value(scInstalledVersion);
 
-            QString requiredVersion = dependencyComponentName.section(QLatin1Char('-'), 1);
             requiredVersion = compEx.exactMatch(requiredVersion) ? compEx.cap(2) : requiredVersion;
 
             if (KDUpdater::compareVersion(requiredVersion, installedVersion) >= 1 ) {
@@ -67,8 +67,10 @@ private:
     void realAppendToInstallComponents(Component *component, const QString &version = QString());
     bool appendComponentToInstall(Component *components, const QString &version = QString());
     QString recursionError(Component *component);
+    Component *componentByName(const QString &name) const;
 
     QList<Component*> m_allComponents;
+    QHash<QString, Component*> m_componentsByName;
     QHash<Component*, QSet<Component*> > m_visitedComponents;
     QSet<QString> m_toInstallComponentIds; //for faster lookups
     QString m_componentsToInstallError;
@@ -68,9 +68,11 @@ namespace Lib7z
     };
 
     void INSTALLER_EXPORT createArchive(QFileDevice *archive, const QStringList &sources,
-        Compression level = Compression::Normal, UpdateCallback *callback = 0);
+        Compression level = Compression::Normal, UpdateCallback *callback = 0,
+        quint64 solidBlockSize = 0);
     void INSTALLER_EXPORT createArchive(const QString &archive, const QStringList &sources,
-        QTmpFile mode, Compression level = Compression::Normal, UpdateCallback *callback = 0);
+        QTmpFile mode, Compression level = Compression::Normal, UpdateCallback *callback = 0,
+        quint64 solidBlockSize = 0);
 
 } // namespace Lib7z
 
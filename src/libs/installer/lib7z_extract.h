@@ -47,18 +47,26 @@ QT_BEGIN_NAMESPACE
 class QFileDevice;
 QT_END_NAMESPACE
 
+namespace QInstaller {
+class RemoteFileEngine;
+}
+
 namespace Lib7z
 {
     class INSTALLER_EXPORT ExtractCallback : public IArchiveExtractCallback, public CMyUnknownImp
     {
         Q_DISABLE_COPY(ExtractCallback)
+        friend class ParallelExtractCallback;
+        friend class QInstaller::RemoteFileEngine;
 
     public:
         ExtractCallback() = default;
         virtual ~ExtractCallback() = default;
 
         void setArchive(CArc *carc) { arc = carc; }
-        void setTarget(const QString &dir) { targetDir = dir; }
+        void setTarget(const QString &dir) { targetDir = dir; error.clear(); }
+
+        QString errorString() const { return error; }
 
         MY_UNKNOWN_IMP
         INTERFACE_IArchiveExtractCallback(;)
@@ -72,13 +80,14 @@ namespace Lib7z
         CArc *arc = 0;
 
         QString targetDir;
+        QString error;
         quint64 total = 0;
         quint64 completed = 0;
         quint32 currentIndex = 0;
     };
 
     void INSTALLER_EXPORT extractArchive(QFileDevice *archive, const QString &targetDirectory,
-        ExtractCallback *callback = 0);
+        ExtractCallback *callback = 0, int maxThreadCount = 1);
 
 } // namespace Lib7z
 
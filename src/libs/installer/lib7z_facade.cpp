@@ -30,6 +30,8 @@
 
 #include "errors.h"
 #include "fileio.h"
+#include "remoteclient.h"
+#include "tracer.h"
 
 #include "lib7z_create.h"
 #include "lib7z_extract.h"
@@ -53,13 +55,18 @@
 #include <Windows/PropVariantConv.h>
 
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
 #include <QIODevice>
+#include <QMutex>
 #include <QPointer>
-#include <QReadWriteLock>
 #include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
 
+#include <algorithm>
 #include <mutex>
 #include <memory>
 
@@ -73,6 +80,8 @@ HINSTANCE g_hInstance = 0;
 # if !defined(Q_CC_MINGW)
 #  include <time.h> // for localtime_s
 # endif
+# include <fcntl.h>
+# include <io.h>
 #else
 extern "C" int global_use_utf16_conversion;
 
@@ -156,29 +165,35 @@ void initSevenZ()
 }
 
 
-// -- error handling
+// -- codecs
 
-Q_GLOBAL_STATIC(QString, getLastErrorString)
-Q_GLOBAL_STATIC(QReadWriteLock, lastErrorReadWriteLock)
+/*!
+    Returns the codecs and archive formats, loaded once for the whole process. They are only read
+    after loading, so all threads share them.
 
-QString lastError()
+    This is thread-safe: C++11 guarantees that the function local static is initialized exactly
+    once, threads calling in concurrently wait until Load() returned. A failed load is not
+    retried, every call throws then.
+*/
+static CCodecs *loadedCodecs()
 {
-    QReadLocker locker(lastErrorReadWriteLock());
-    Q_UNUSED(locker)
-    return *getLastErrorString();
+    initSevenZ();
+    static CCodecs *const codecs = [] {
+        std::unique_ptr<CCodecs> codecs(new CCodecs);
+        return codecs->Load() == S_OK ? codecs.release() : nullptr;
+    }();
+    if (!codecs)
+        throw SevenZipException(QCoreApplication::translate("Lib7z", "Cannot load codecs."));
+    return codecs;
 }
 
-void setLastError(const QString &errorString)
-{
-    QWriteLocker locker(lastErrorReadWriteLock());
-    Q_UNUSED(locker)
-    *getLastErrorString() = errorString;
-}
 
-QString errorMessageFrom7zResult(const LONG  &extractResult)
+// -- error handling
+
+QString errorMessageFrom7zResult(const LONG  &extractResult, const QString &errorString = QString())
 {
-    if (!lastError().isEmpty())
-        return lastError();
+    if (!errorString.isEmpty())
+        return errorString;
 
     QString errorMessage = QCoreApplication::translate("Lib7z", "internal code: %1");
     switch (extractResult) {
@@ -473,6 +488,221 @@ private:
     QPointer<QIODevice> m_device;
 };
 
+// -- opened archives
+
+static const int MaxCachedArchives = 16;
+
+/*!
+    Opens \a archive for reading and parses its headers into \a archiveLink. Returns \c false if
+    \a archive is not in a supported format.
+*/
+static bool openArchive(CArchiveLink *archiveLink, QFileDevice *archive)
+{
+    COpenOptions op;
+    op.codecs = loadedCodecs();
+
+    CObjectVector<COpenType> types;
+    op.types = &types;  // Empty, because we use a stream.
+
+    CIntVector excluded;
+    op.excludedFormats = &excluded;
+
+    const CMyComPtr<IInStream> stream = new QIODeviceInStream(archive);
+    op.stream = stream; // CMyComPtr is needed, otherwise it crashes in OpenStream().
+
+    CObjectVector<CProperty> properties;
+    op.props = &properties;
+
+    return archiveLink->Open2(op, nullptr) == S_OK;
+}
+
+/*!
+    An archive with parsed headers. If it was opened by file name, \c file is the device the
+    archive is read from.
+*/
+struct OpenedArchive
+{
+    std::unique_ptr<QFile> file;
+    CArchiveLink link;
+};
+
+/*!
+    Keeps the most recently used archives open, keyed by the identity of their file, so that
+    checking, listing and extracting the same archive parses its headers only once. An archive
+    is taken out of the cache while it is in use, so only one thread at a time reads from it.
+*/
+class ArchiveCache
+{
+public:
+    ArchiveCache() = default;
+    ~ArchiveCache()
+    {
+        for (int i = 0; i < m_archives.count(); ++i)
+            delete m_archives.at(i).second;
+    }
+
+    std::unique_ptr<OpenedArchive> take(const QString &key)
+    {
+        QMutexLocker _(&m_mutex);
+        for (int i = m_archives.count() - 1; i >= 0; --i) {
+            if (m_archives.at(i).first == key)
+                return std::unique_ptr<OpenedArchive>(m_archives.takeAt(i).second);
+        }
+        return nullptr;
+    }
+
+    void put(const QString &key, std::unique_ptr<OpenedArchive> archive)
+    {
+        OpenedArchive *evicted = 0;
+        {
+            QMutexLocker _(&m_mutex);
+            m_archives.append(qMakePair(key, archive.release()));
+            if (m_archives.count() > MaxCachedArchives)
+                evicted = m_archives.takeFirst().second;
+        }
+        delete evicted;
+    }
+
+    void clear()
+    {
+        QList<QPair<QString, OpenedArchive *> > archives;
+        {
+            QMutexLocker _(&m_mutex);
+            archives.swap(m_archives);
+        }
+        for (int i = 0; i < archives.count(); ++i)
+            delete archives.at(i).second;
+    }
+
+private:
+    Q_DISABLE_COPY(ArchiveCache)
+
+    QMutex m_mutex;
+    QList<QPair<QString, OpenedArchive *> > m_archives; // least recently used first
+};
+Q_GLOBAL_STATIC(ArchiveCache, archiveCache)
+
+/*!
+    Returns the key \a archive is cached with, or an empty string if it cannot be cached. The key
+    identifies the open file by its device and inode, or volume and file ID on Windows, together
+    with its size and modification time, so a file replaced under the same name, or modified in
+    place, gets a different key. Devices without a file handle, devices open for writing, as their
+    content might not be on disk yet, and files read through the elevated remote client are never
+    cached.
+*/
+static QString archiveCacheKey(QFileDevice *archive)
+{
+    if (archive->fileName().isEmpty() || archive->isWritable() || archive->handle() == -1
+        || QInstaller::RemoteClient::instance().isActive()) {
+            return QString();
+    }
+
+#ifdef Q_OS_WIN
+    BY_HANDLE_FILE_INFORMATION info;
+    const HANDLE handle = HANDLE(_get_osfhandle(archive->handle()));
+    if (handle == INVALID_HANDLE_VALUE || !GetFileInformationByHandle(handle, &info))
+        return QString();
+    const quint64 device = info.dwVolumeSerialNumber;
+    const quint64 id = (quint64(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    const quint64 size = (quint64(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    const quint64 modified = (quint64(info.ftLastWriteTime.dwHighDateTime) << 32)
+        | info.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat st;
+    if (::fstat(archive->handle(), &st) != 0)
+        return QString();
+    const quint64 device = st.st_dev;
+    const quint64 id = st.st_ino;
+    const quint64 size = st.st_size;
+# if defined(Q_OS_DARWIN)
+    const quint64 modified = quint64(st.st_mtimespec.tv_sec) * 1000000000
+        + st.st_mtimespec.tv_nsec;
+# else
+    const quint64 modified = quint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+# endif
+#endif
+    return QString::fromLatin1("%1:%2:%3:%4").arg(device).arg(id).arg(size).arg(modified);
+}
+
+/*!
+    Opens \a file for reading. On Windows, the file is opened so that it can still be removed or
+    renamed while the cache keeps it open.
+*/
+static bool openCachedFile(QFile *file)
+{
+#ifdef Q_OS_WIN
+    const HANDLE handle = CreateFileW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(
+        file->fileName()).utf16()), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    const int fd = _open_osfhandle(intptr_t(handle), _O_RDONLY | _O_BINARY);
+    if (fd == -1) {
+        CloseHandle(handle);
+        return false;
+    }
+    if (!file->open(fd, QIODevice::ReadOnly, QFileDevice::AutoCloseHandle)) {
+        _close(fd);
+        return false;
+    }
+    return true;
+#else
+    return file->open(QIODevice::ReadOnly);
+#endif
+}
+
+/*!
+    Returns the opened \a archive, taken from the cache if possible. Returns \c nullptr if
+    \a archive is not in a supported format. If \a key is not empty on return, the archive
+    can be handed back to the cache with releaseArchive().
+*/
+static std::unique_ptr<OpenedArchive> acquireArchive(QFileDevice *archive, QString *key)
+{
+    *key = archiveCacheKey(archive);
+    if (!key->isEmpty()) {
+        if (std::unique_ptr<OpenedArchive> cached = archiveCache()->take(*key))
+            return cached;
+    }
+
+    std::unique_ptr<OpenedArchive> opened(new OpenedArchive);
+    QFileDevice *device = archive;
+    if (!key->isEmpty()) {
+        // read from a device of our own, so the archive can outlive the one passed in
+        opened->file.reset(new QFile(archive->fileName()));
+        // the name might point to another file by now, then read from the device passed in
+        if (openCachedFile(opened->file.get()) && archiveCacheKey(opened->file.get()) == *key) {
+            device = opened->file.get();
+        } else {
+            opened->file.reset();
+            key->clear();
+        }
+    }
+
+    if (!openArchive(&opened->link, device))
+        return nullptr;
+    return opened;
+}
+
+/*!
+    Hands the \a archive opened by acquireArchive() back to the cache using \a key.
+*/
+static void releaseArchive(const QString &key, std::unique_ptr<OpenedArchive> archive)
+{
+    if (!key.isEmpty() && archive)
+        archiveCache()->put(key, std::move(archive));
+}
+
+/*!
+    Closes all archives kept open to speed up repeated access, so that their files can be removed
+    and their disk space gets freed. Call this once a set of archives is done with, for example at
+    the end of an installation.
+*/
+void clearArchiveCache()
+{
+    if (!archiveCache.isDestroyed())
+        archiveCache()->clear();
+}
+
 bool operator==(const File &lhs, const File &rhs)
 {
     return lhs.path == rhs.path
@@ -491,30 +721,13 @@ QVector<File> listArchive(QFileDevice *archive)
 
     const qint64 initialPos = archive->pos();
     try {
-        CCodecs codecs;
-        if (codecs.Load() != S_OK)
-            throw SevenZipException(QCoreApplication::translate("Lib7z", "Cannot load codecs."));
-
-        COpenOptions op;
-        op.codecs = &codecs;
-
-        CObjectVector<COpenType> types;
-        op.types = &types;  // Empty, because we use a stream.
-
-        CIntVector excluded;
-        op.excludedFormats = &excluded;
-
-        const CMyComPtr<IInStream> stream = new QIODeviceInStream(archive);
-        op.stream = stream; // CMyComPtr is needed, otherwise it crashes in OpenStream().
-
-        CObjectVector<CProperty> properties;
-        op.props = &properties;
-
-        CArchiveLink archiveLink;
-        if (archiveLink.Open2(op, nullptr) != S_OK) {
+        QString key;
+        std::unique_ptr<OpenedArchive> opened = acquireArchive(archive, &key);
+        if (!opened) {
             throw SevenZipException(QCoreApplication::translate("Lib7z",
                 "Cannot open archive \"%1\".").arg(archive->fileName()));
         }
+        CArchiveLink &archiveLink = opened->link;
 
         QVector<File> flat;
         for (unsigned i = 0; i < archiveLink.Arcs.Size(); ++i) {
@@ -543,6 +756,7 @@ QVector<File> listArchive(QFileDevice *archive)
                 flat.append(f);
             }
         }
+        releaseArchive(key, std::move(opened));
         return flat;
     } catch (const char *err) {
         archive->seek(initialPos);
@@ -588,8 +802,8 @@ STDMETHODIMP ExtractCallback::GetStream(UInt32 index, ISequentialOutStream **out
 
     UString s;
     if (arc->GetItemPath(index, s) != S_OK) {
-        setLastError(QCoreApplication::translate("ExtractCallbackImpl",
-            "Cannot retrieve path of archive item %1.").arg(index));
+        error = QCoreApplication::translate("ExtractCallbackImpl",
+            "Cannot retrieve path of archive item %1.").arg(index);
         return E_FAIL;
     }
 
@@ -616,16 +830,16 @@ STDMETHODIMP ExtractCallback::GetStream(UInt32 index, ISequentialOutStream **out
 #ifndef Q_OS_WIN
         // do not follow symlinks, so we need to remove an existing one
         if (fi.isSymLink() && (!QFile::remove(fi.absoluteFilePath()))) {
-            setLastError(QCoreApplication::translate("ExtractCallbackImpl",
-                "Cannot remove already existing symlink %1.").arg(fi.absoluteFilePath()));
+            error = QCoreApplication::translate("ExtractCallbackImpl",
+                "Cannot remove already existing symlink %1.").arg(fi.absoluteFilePath());
             return E_FAIL;
         }
 #endif
         std::unique_ptr<QFile> file(new QFile(fi.absoluteFilePath()));
         if (!file->open(QIODevice::WriteOnly)) {
-            setLastError(QCoreApplication::translate("ExtractCallbackImpl",
+            error = QCoreApplication::translate("ExtractCallbackImpl",
                                                      "Cannot open file \"%1\" for writing: %2").arg(
-                             QDir::toNativeSeparators(fi.absoluteFilePath()), file->errorString()));
+                             QDir::toNativeSeparators(fi.absoluteFilePath()), file->errorString());
             return E_FAIL;
         }
         CMyComPtr<ISequentialOutStream> stream =
@@ -649,8 +863,8 @@ STDMETHODIMP ExtractCallback::SetOperationResult(Int32 /*resultEOperationResult*
 
     UString s;
     if (arc->GetItemPath(currentIndex, s) != S_OK) {
-        setLastError(QCoreApplication::translate("ExtractCallbackImpl",
-            "Cannot retrieve path of archive item %1.").arg(currentIndex));
+        error = QCoreApplication::translate("ExtractCallbackImpl",
+            "Cannot retrieve path of archive item %1.").arg(currentIndex);
         return E_FAIL;
     }
 
@@ -673,15 +887,15 @@ STDMETHODIMP ExtractCallback::SetOperationResult(Int32 /*resultEOperationResult*
 #else
         QFileInfo symlinkPlaceHolderFileInfo(absFilePath);
         if (symlinkPlaceHolderFileInfo.isSymLink()) {
-            setLastError(QCoreApplication::translate("ExtractCallbackImpl",
+            error = QCoreApplication::translate("ExtractCallbackImpl",
                 "Cannot create symlink at \"%1\". Another one is already existing.")
-                .arg(absFilePath));
+                .arg(absFilePath);
             return E_FAIL;
         }
         QFile symlinkPlaceHolderFile(absFilePath);
         if (!symlinkPlaceHolderFile.open(QIODevice::ReadOnly)) {
-            setLastError(QCoreApplication::translate("ExtractCallbackImpl",
-                "Cannot read symlink target from file \"%1\".").arg(absFilePath));
+            error = QCoreApplication::translate("ExtractCallbackImpl",
+                "Cannot read symlink target from file \"%1\".").arg(absFilePath);
             return E_FAIL;
         }
 
@@ -690,9 +904,9 @@ STDMETHODIMP ExtractCallback::SetOperationResult(Int32 /*resultEOperationResult*
         symlinkPlaceHolderFile.remove();
         QFile targetFile(QString::fromLatin1(symlinkTarget));
         if (!targetFile.link(absFilePath)) {
-            setLastError(QCoreApplication::translate("ExtractCallbackImpl",
+            error = QCoreApplication::translate("ExtractCallbackImpl",
                 "Cannot create symlink at %1: %2").arg(absFilePath,
-                targetFile.errorString()));
+                targetFile.errorString());
             return E_FAIL;
         }
         return S_OK;
@@ -865,19 +1079,21 @@ static QString createTmp7z()
     more files, one or more directories or a combination of files and folders. The \c * wildcard
     is supported also. The value of \a level specifies the compression ratio, the default is set
     to \c 5 (Normal compression). The \a callback can be used to get information about the archive
-    creation process. If no \a callback is given, an empty implementation is used.
+    creation process. If no \a callback is given, an empty implementation is used. A non-zero
+    \a solidBlockSize limits the size in bytes of each solid block, so that the archive can be
+    decompressed by several threads.
 
     \note Throws SevenZipException on error.
     \note Filenames are stored case-sensitive with UTF-8 encoding.
     \note The ownership of \a callback is transferred to the function and gets delete on exit.
 */
 void INSTALLER_EXPORT createArchive(QFileDevice *archive, const QStringList &sources,
-    Compression level, UpdateCallback *callback)
+    Compression level, UpdateCallback *callback, quint64 solidBlockSize)
 {
     LIB7Z_ASSERTS(archive, Writable)
 
     const QString tmpArchive = createTmp7z();
-    Lib7z::createArchive(tmpArchive, sources, QTmpFile::No, level, callback);
+    Lib7z::createArchive(tmpArchive, sources, QTmpFile::No, level, callback, solidBlockSize);
 
     try {
         QFile source(tmpArchive);
@@ -894,7 +1110,9 @@ void INSTALLER_EXPORT createArchive(QFileDevice *archive, const QStringList &sou
     is supported. To be able to use the function during an elevated installation, set \a mode to
     \c QTmpFile::Yes. The value of \a level specifies the compression ratio, the default is set
     to \c 5 (Normal compression). The \a callback can be used to get information about the archive
-    creation process. If no \a callback is given, an empty implementation is used.
+    creation process. If no \a callback is given, an empty implementation is used. A non-zero
+    \a solidBlockSize limits the size in bytes of each solid block, so that the archive can be
+    decompressed by several threads.
 
     \note Throws SevenZipException on error.
     \note If \a archive exists, it will be overwritten.
@@ -902,7 +1120,7 @@ void INSTALLER_EXPORT createArchive(QFileDevice *archive, const QStringList &sou
     \note The ownership of \a callback is transferred to the function and gets delete on exit.
 */
 void createArchive(const QString &archive, const QStringList &sources, QTmpFile mode,
-    Compression level, UpdateCallback *callback)
+    Compression level, UpdateCallback *callback, quint64 solidBlockSize)
 {
     try {
         QString target = archive;
@@ -922,6 +1140,8 @@ void createArchive(const QString &archive, const QStringList &sources, QTmpFile
             commandStrings.Add(L"-sccUTF-8"); // files: case-sensitive|UTF8
 #endif
             commandStrings.Add(QString2UString(QString::fromLatin1("-mx=%1").arg(int(level)))); // compression: level
+            if (solidBlockSize > 0) // solid: block size in bytes
+                commandStrings.Add(QString2UString(QString::fromLatin1("-ms=%1b").arg(solidBlockSize)));
             commandStrings.Add(QString2UString(QDir::toNativeSeparators(target)));
             foreach (const QString &source, sources)
                 commandStrings.Add(QString2UString(source));
@@ -933,17 +1153,15 @@ void createArchive(const QString &archive, const QStringList &sources, QTmpFile
             throw SevenZipException(UString2QString(e));
         }
 
-        CCodecs codecs;
-        if (codecs.Load() != S_OK)
-            throw SevenZipException(QCoreApplication::translate("Lib7z", "Cannot load codecs."));
+        CCodecs *const codecs = loadedCodecs();
 
         CObjectVector<COpenType> types;
-        if (!ParseOpenTypes(codecs, options.ArcType, types))
+        if (!ParseOpenTypes(*codecs, options.ArcType, types))
             throw SevenZipException(QCoreApplication::translate("Lib7z", "Unsupported archive type."));
 
         CUpdateErrorInfo errorInfo;
         CMyComPtr<UpdateCallback> comCallback = callback == 0 ? new UpdateCallback : callback;
-        const HRESULT res = UpdateArchive(&codecs, types, options.ArchiveName, options.Censor,
+        const HRESULT res = UpdateArchive(codecs, types, options.ArchiveName, options.Censor,
             options.UpdateOptions, errorInfo, nullptr, comCallback, true);
 
         const QFile tempFile(UString2QString(options.ArchiveName));
@@ -988,17 +1206,284 @@ void createArchive(const QString &archive, const QStringList &sources, QTmpFile
     }
 }
 
+// -- parallel extraction
+
+/*!
+    Forwards the notifications of one extraction worker to the callback passed to extractArchive().
+    The calls are serialized with a mutex shared by all workers, and the progress of all workers is
+    summed up before it is reported.
+*/
+class ParallelExtractCallback : public ExtractCallback
+{
+    Q_DISABLE_COPY(ParallelExtractCallback)
+
+public:
+    struct State
+    {
+        QMutex mutex;
+        quint64 total = 0;
+        quint64 completed = 0;
+        bool failed = false;
+    };
+
+    ParallelExtractCallback(ExtractCallback *target, State *state)
+        : m_target(target)
+        , m_state(state)
+    {}
+
+    void setFailed()
+    {
+        QMutexLocker _(&m_state->mutex);
+        m_state->failed = true;
+    }
+
+private:
+    bool prepareForFile(const QString &filename) Q_DECL_OVERRIDE
+    {
+        QMutexLocker _(&m_state->mutex);
+        return m_target->prepareForFile(filename);
+    }
+
+    void setCurrentFile(const QString &filename) Q_DECL_OVERRIDE
+    {
+        QMutexLocker _(&m_state->mutex);
+        m_target->setCurrentFile(filename);
+    }
+
+    HRESULT setCompleted(quint64 completed, quint64 /*total*/) Q_DECL_OVERRIDE
+    {
+        QMutexLocker _(&m_state->mutex);
+        if (m_state->failed)
+            return E_ABORT; // another worker failed, no need to continue
+
+        m_state->completed += completed - m_completed;
+        m_completed = completed;
+        if (m_state->total == 0)
+            return S_OK;
+        return m_target->setCompleted(m_state->completed, m_state->total);
+    }
+
+private:
+    ExtractCallback *m_target;
+    State *m_state;
+    quint64 m_completed = 0;
+};
+
+/*!
+    Limits the number of worker threads used by all concurrently running extractions together to
+    the number of processor cores. Reserves up to \a count workers on construction and releases
+    them on destruction.
+*/
+class ExtractWorkerReservation
+{
+    Q_DISABLE_COPY(ExtractWorkerReservation)
+
+public:
+    explicit ExtractWorkerReservation(int count)
+    {
+        const int maximum = QThread::idealThreadCount();
+        forever {
+            const int used = s_workers.load();
+            m_count = qMin(count, maximum - used);
+            if (m_count <= 0) {
+                m_count = 0;
+                break;
+            }
+            if (s_workers.testAndSetOrdered(used, used + m_count))
+                break;
+        }
+    }
+
+    ~ExtractWorkerReservation()
+    {
+        s_workers.fetchAndAddOrdered(-m_count);
+    }
+
+    int count() const { return m_count; }
+
+private:
+    int m_count = 0;
+    static QAtomicInt s_workers;
+};
+
+QAtomicInt ExtractWorkerReservation::s_workers;
+
+/*!
+    Splits the items of \a archive into at most \a count groups of independent solid blocks
+    (folders), balanced by their uncompressed size. Items that are not stored in a folder, like
+    directories and empty files, are returned in \a unassigned. The overall uncompressed size is
+    returned in \a total. Returns an empty list if the archive has less than two folders.
+*/
+static QVector<QVector<UInt32> > splitItemsByFolder(IInArchive *archive, int count,
+    QVector<UInt32> *unassigned, quint64 *total)
+{
+    UInt32 numItems = 0;
+    if (archive->GetNumberOfItems(&numItems) != S_OK) {
+        throw SevenZipException(QCoreApplication::translate("Lib7z",
+            "Cannot retrieve number of items in archive."));
+    }
+
+    QHash<quint32, QVector<UInt32> > folders;
+    QHash<quint32, quint64> folderSizes;
+    for (UInt32 item = 0; item < numItems; ++item) {
+        const quint64 size = getUInt64Property(archive, item, kpidSize, 0);
+        *total += size;
+
+        const NCOM::CPropVariant prop = readProperty(archive, item, kpidBlock);
+        if (prop.vt == VT_UI4) {
+            folders[prop.ulVal].append(item);
+            folderSizes[prop.ulVal] += size;
+        } else {
+            unassigned->append(item);
+        }
+    }
+
+    if (folders.count() < 2)
+        return QVector<QVector<UInt32> >();
+
+    // hand the largest folder to the least loaded group first
+    QList<quint32> order = folders.keys();
+    std::sort(order.begin(), order.end(), [&folderSizes](quint32 lhs, quint32 rhs) {
+        return folderSizes.value(lhs) > folderSizes.value(rhs);
+    });
+
+    QVector<QVector<UInt32> > groups(qMin(count, folders.count()));
+    QVector<quint64> load(groups.count(), 0);
+    foreach (const quint32 folder, order) {
+        const int group = std::min_element(load.constBegin(), load.constEnd()) - load.constBegin();
+        groups[group] += folders.value(folder);
+        load[group] += folderSizes.value(folder);
+    }
+
+    for (int i = 0; i < groups.count(); ++i)
+        std::sort(groups[i].begin(), groups[i].end()); // 7z expects sorted indices
+    return groups;
+}
+
+/*!
+    Extracts \a items of the archive at \a archivePath into \a directory. Every worker opens the
+    archive on its own, so that the decoders do not share a stream position. Returns an empty
+    string on success, otherwise the error message.
+*/
+static QString extractItems(const QString &archivePath, const QString &directory,
+    const QVector<UInt32> &items, ParallelExtractCallback *callback)
+{
+    try {
+        QFile archive(archivePath);
+        if (!archive.open(QIODevice::ReadOnly)) {
+            throw SevenZipException(QCoreApplication::translate("Lib7z",
+                "Cannot open archive \"%1\" for reading: %2").arg(archivePath, archive.errorString()));
+        }
+
+        QString key;
+        const std::unique_ptr<OpenedArchive> opened = acquireArchive(&archive, &key);
+        if (!opened) {
+            throw SevenZipException(QCoreApplication::translate("Lib7z",
+                "Cannot open archive \"%1\".").arg(archivePath));
+        }
+
+        callback->setTarget(directory);
+        callback->setArchive(&opened->link.Arcs[0]);
+        const LONG result = opened->link.Arcs[0].Archive->Extract(items.constData(),
+            static_cast<UInt32>(items.count()), false, callback);
+        if (result != S_OK)
+            throw SevenZipException(errorMessageFrom7zResult(result, callback->errorString()));
+    } catch (const SevenZipException &e) {
+        callback->setFailed();
+        return e.message();
+    } catch (...) {
+        callback->setFailed();
+        return QCoreApplication::translate("Lib7z", "Unknown exception caught (%1).")
+            .arg(QString::fromLatin1(Q_FUNC_INFO));
+    }
+    return QString();
+}
+
+/*!
+    Extracts the independent solid blocks of \a archiveLink on up to \a maxThreadCount worker
+    threads. Returns \c false if the archive cannot be split, in which case nothing was extracted.
+*/
+static bool extractArchiveParallel(QFileDevice *archive, CArchiveLink *archiveLink,
+    const QString &directory, ExtractCallback *callback, int maxThreadCount)
+{
+    if (maxThreadCount < 2 || archiveLink->Arcs.Size() != 1 || archive->fileName().isEmpty())
+        return false;
+
+    IInArchive *const arch = archiveLink->Arcs[0].Archive;
+
+    UInt64 numFolders = 0;
+    NCOM::CPropVariant prop;
+    if (arch->GetArchiveProperty(kpidNumBlocks, &prop) != S_OK
+        || !ConvertPropVariantToUInt64(prop, numFolders) || numFolders < 2) {
+        return false;
+    }
+
+    const ExtractWorkerReservation workers(qMin<UInt64>(maxThreadCount, numFolders));
+    if (workers.count() < 2)
+        return false;
+
+    ParallelExtractCallback::State state;
+    QVector<UInt32> unassigned;
+    const QVector<QVector<UInt32> > groups = splitItemsByFolder(arch, workers.count(),
+        &unassigned, &state.total);
+    if (groups.isEmpty())
+        return false;
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(groups.count());
+
+    QVector<CMyComPtr<ParallelExtractCallback> > callbacks;
+    QList<QFuture<QString> > futures;
+    foreach (const QVector<UInt32> &group, groups) {
+        CMyComPtr<ParallelExtractCallback> workerCallback = new ParallelExtractCallback(callback,
+            &state);
+        callbacks.append(workerCallback);
+        futures.append(QtConcurrent::run(&pool, extractItems, archive->fileName(), directory, group,
+            static_cast<ParallelExtractCallback *>(workerCallback)));
+    }
+
+    QString errorString;
+    foreach (const QFuture<QString> &future, futures) {
+        const QString result = future.result(); // blocks until the worker is done
+        if (errorString.isEmpty())
+            errorString = result;
+    }
+    if (!errorString.isEmpty())
+        throw SevenZipException(errorString);
+
+    // Directories and empty files go last, so restricted directory permissions do not get into
+    // the way of the workers.
+    if (!unassigned.isEmpty()) {
+        callback->setArchive(&archiveLink->Arcs[0]);
+        const LONG result = arch->Extract(unassigned.constData(),
+            static_cast<UInt32>(unassigned.count()), false, callback);
+        if (result != S_OK)
+            throw SevenZipException(errorMessageFrom7zResult(result, callback->errorString()));
+    }
+    return true;
+}
+
 /*!
     Extracts the given \a archive content into target directory \a directory using the provided
     extract callback \a callback. The output filenames are deduced from the \a archive content.
 
+    If \a maxThreadCount is greater than \c 1 and the archive consists of several independent solid
+    blocks, the blocks are decompressed on up to \a maxThreadCount threads at the same time. The
+    number of threads used by all extractions running in the process is limited to the number of
+    processor cores. The calls to \a callback are serialized in that case.
+
     \note Throws SevenZipException on error.
     \note The ownership of \a callback is not transferred to the function.
 */
-void extractArchive(QFileDevice *archive, const QString &directory, ExtractCallback *callback)
+void extractArchive(QFileDevice *archive, const QString &directory, ExtractCallback *callback,
+    int maxThreadCount)
 {
     LIB7Z_ASSERTS(archive, Readable)
 
+    TraceSpan span("archive", "Extract archive");
+    if (span.isActive())
+        span.setDetail(archive->fileName());
+
     // Guard a given object against unwanted delete.
     CMyComPtr<ExtractCallback> externCallback = callback;
 
@@ -1012,39 +1497,25 @@ void extractArchive(QFileDevice *archive, const QString &directory, ExtractCallb
     try {
         outDir.tryCreate();
 
-        CCodecs codecs;
-        if (codecs.Load() != S_OK)
-            throw SevenZipException(QCoreApplication::translate("Lib7z", "Cannot load codecs."));
-
-        COpenOptions op;
-        op.codecs = &codecs;
-
-        CObjectVector<COpenType> types;
-        op.types = &types;  // Empty, because we use a stream.
-
-        CIntVector excluded;
-        op.excludedFormats = &excluded;
-
-        const CMyComPtr<IInStream> stream = new QIODeviceInStream(archive);
-        op.stream = stream; // CMyComPtr is needed, otherwise it crashes in OpenStream().
-
-        CObjectVector<CProperty> properties;
-        op.props = &properties;
-
-        CArchiveLink archiveLink;
-        if (archiveLink.Open2(op, nullptr) != S_OK) {
+        // extraction is the last use of an archive, so it is not handed back to the cache
+        QString key;
+        const std::unique_ptr<OpenedArchive> opened = acquireArchive(archive, &key);
+        if (!opened) {
             throw SevenZipException(QCoreApplication::translate("Lib7z",
                 "Cannot open archive \"%1\".").arg(archive->fileName()));
         }
+        CArchiveLink &archiveLink = opened->link;
 
         callback->setTarget(directory);
-        for (unsigned a = 0; a < archiveLink.Arcs.Size(); ++a) {
-            callback->setArchive(&archiveLink.Arcs[a]);
-            IInArchive *const arch = archiveLink.Arcs[a].Archive;
-
-            const LONG result = arch->Extract(0, static_cast<UInt32>(-1), false, callback);
-            if (result != S_OK)
-                throw SevenZipException(errorMessageFrom7zResult(result));
+        if (!extractArchiveParallel(archive, &archiveLink, directory, callback, maxThreadCount)) {
+            for (unsigned a = 0; a < archiveLink.Arcs.Size(); ++a) {
+                callback->setArchive(&archiveLink.Arcs[a]);
+                IInArchive *const arch = archiveLink.Arcs[a].Archive;
+
+                const LONG result = arch->Extract(0, static_cast<UInt32>(-1), false, callback);
+                if (result != S_OK)
+                    throw SevenZipException(errorMessageFrom7zResult(result, callback->errorString()));
+            }
         }
     } catch (const SevenZipException &e) {
         externCallback.Detach();
@@ -1069,30 +1540,13 @@ bool isSupportedArchive(QFileDevice *archive)
 
     const qint64 initialPos = archive->pos();
     try {
-        CCodecs codecs;
-        if (codecs.Load() != S_OK)
-            throw SevenZipException(QCoreApplication::translate("Lib7z", "Cannot load codecs."));
-
-        COpenOptions op;
-        op.codecs = &codecs;
-
-        CObjectVector<COpenType> types;
-        op.types = &types;  // Empty, because we use a stream.
-
-        CIntVector excluded;
-        op.excludedFormats = &excluded;
-
-        const CMyComPtr<IInStream> stream = new QIODeviceInStream(archive);
-        op.stream = stream; // CMyComPtr is needed, otherwise it crashes in OpenStream().
-
-        CObjectVector<CProperty> properties;
-        op.props = &properties;
-
-        CArchiveLink archiveLink;
-        const HRESULT result = archiveLink.Open2(op, nullptr);
+        QString key;
+        std::unique_ptr<OpenedArchive> opened = acquireArchive(archive, &key);
+        const bool supported = (opened != nullptr);
+        releaseArchive(key, std::move(opened));
 
         archive->seek(initialPos);
-        return result == S_OK;
+        return supported;
     } catch (const char *err) {
         archive->seek(initialPos);
         throw SevenZipException(err);
@@ -43,6 +43,7 @@ namespace Lib7z
     void INSTALLER_EXPORT initSevenZ();
     bool INSTALLER_EXPORT isSupportedArchive(QFileDevice *archive);
     bool INSTALLER_EXPORT isSupportedArchive(const QString &archive);
+    void INSTALLER_EXPORT clearArchiveCache();
 
     class INSTALLER_EXPORT SevenZipException : public QInstaller::Error
     {
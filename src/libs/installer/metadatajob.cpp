@@ -28,6 +28,8 @@
 #include "metadatajob.h"
 
 #include "metadatajob_p.h"
+#include "downloadcache.h"
+#include "errors.h"
 #include "packagemanagercore.h"
 #include "packagemanagerproxyfactory.h"
 #include "productkeycheck.h"
@@ -35,11 +37,17 @@
 #include "serverauthenticationdialog.h"
 #include "settings.h"
 #include "testrepository.h"
+#include "tracer.h"
+#include "updatesinfo_p.h"
 
+#include <QCryptographicHash>
+#include <QStandardPaths>
 #include <QTemporaryDir>
 
 namespace QInstaller {
 
+static const QLatin1String scValidatorsFile("validators");
+
 static QUrl resolveUrl(const FileTaskResult &result, const QString &url)
 {
     QUrl u(url);
@@ -52,6 +60,9 @@ MetadataJob::MetadataJob(QObject *parent)
     : Job(parent)
     , m_core(0)
     , m_addCompressedPackages(false)
+    , m_xmlTaskStart(-1)
+    , m_metadataTaskStart(-1)
+    , m_unzipTasksStart(-1)
 {
     setCapabilities(Cancelable);
     connect(&m_xmlTask, &QFutureWatcherBase::finished, this, &MetadataJob::xmlTaskFinished);
@@ -99,8 +110,18 @@ void MetadataJob::doStart()
                         if (!m_core->value(scUrlQueryString).isEmpty())
                             url += m_core->value(scUrlQueryString) + QLatin1Char('&');
 
-                        // also append a random string to avoid proxy caches
-                        FileTaskItem item(url.append(QString::number(qrand() * qrand())));
+                        const QPair<QByteArray, QByteArray> validators
+                            = cachedValidators(cacheDirectory(repo));
+                        if (validators.first.isEmpty() && validators.second.isEmpty()) {
+                            // also append a random string to avoid proxy caches
+                            url.append(QString::number(qrand() * qrand()));
+                        } else {
+                            url.chop(1);    // the conditional request revalidates proxy caches
+                        }
+
+                        FileTaskItem item(url);
+                        item.insert(TaskRole::ETag, validators.first);
+                        item.insert(TaskRole::LastModified, validators.second);
                         item.insert(TaskRole::UserRole, QVariant::fromValue(repo));
                         item.insert(TaskRole::Authenticator, QVariant::fromValue(authenticator));
                         items.append(item);
@@ -155,6 +176,7 @@ void MetadataJob::startXMLTask(const QList<FileTaskItem> items)
 {
     DownloadFileTask *const xmlTask = new DownloadFileTask(items);
     xmlTask->setProxyFactory(m_core->proxyFactory());
+    m_xmlTaskStart = Tracer::now();
     m_xmlTask.setFuture(QtConcurrent::run(&DownloadFileTask::doTask, xmlTask));
 }
 
@@ -256,9 +278,12 @@ void MetadataJob::unzipRepositoryTaskFinished()
 
 void MetadataJob::xmlTaskFinished()
 {
+    Tracer::instance()->addEvent("metadata", "Download Updates.xml", m_xmlTaskStart);
+
     Status status = XmlDownloadFailure;
     try {
         m_xmlTask.waitForFinished();
+        TraceSpan span("metadata", "Parse Updates.xml");
         status = parseUpdatesXml(m_xmlTask.future().results());
     } catch (const AuthenticationRequiredException &e) {
         if (e.type() == AuthenticationRequiredException::Type::Proxy) {
@@ -328,6 +353,7 @@ void MetadataJob::xmlTaskFinished()
         setProcessedAmount(0);
         DownloadFileTask *const metadataTask = new DownloadFileTask(m_packages);
         metadataTask->setProxyFactory(m_core->proxyFactory());
+        m_metadataTaskStart = Tracer::now();
         m_metadataTask.setFuture(QtConcurrent::run(&DownloadFileTask::doTask, metadataTask));
         setProgressTotalAmount(100);
         emit infoMessage(this, tr("Retrieving meta information from remote repository..."));
@@ -360,6 +386,8 @@ void MetadataJob::unzipTaskFinished()
     delete watcher;
 
     if (m_unzipTasks.isEmpty()) {
+        Tracer::instance()->addEvent("metadata", "Extract metadata", m_unzipTasksStart);
+        updateCache();
         setProcessedAmount(100);
         emitFinished();
     }
@@ -377,11 +405,13 @@ void MetadataJob::setProgressTotalAmount(int maximum)
 
 void MetadataJob::metadataTaskFinished()
 {
+    Tracer::instance()->addEvent("metadata", "Download metadata", m_metadataTaskStart);
     try {
         m_metadataTask.waitForFinished();
         QFuture<FileTaskResult> future = m_metadataTask.future();
         if (future.resultCount() > 0) {
             emit infoMessage(this, tr("Extracting meta information..."));
+            m_unzipTasksStart = Tracer::now();
             foreach (const FileTaskResult &result, future.results()) {
                 const FileTaskItem item = result.value(TaskRole::TaskItem).value<FileTaskItem>();
                 UnzipArchiveTask *task = new UnzipArchiveTask(result.target(),
@@ -393,6 +423,7 @@ void MetadataJob::metadataTaskFinished()
                 watcher->setFuture(QtConcurrent::run(&UnzipArchiveTask::doTask, task));
             }
         } else {
+            updateCache();
             emitFinished();
         }
     } catch (const TaskException &e) {
@@ -414,6 +445,7 @@ void MetadataJob::reset()
 {
     m_packages.clear();
     m_metadata.clear();
+    m_validators.clear();
 
     setError(Job::NoError);
     setErrorString(QString());
@@ -424,6 +456,7 @@ void MetadataJob::reset()
         m_metadataTask.cancel();
     } catch (...) {}
     m_tempDirDeleter.releaseAndDeleteAll();
+    KDUpdater::UpdatesInfo::clearCache();
 }
 
 void MetadataJob::resetCompressedFetch()
@@ -457,6 +490,40 @@ MetadataJob::Status MetadataJob::parseUpdatesXml(const QList<FileTaskResult> &re
         if (error() != Job::NoError)
             return XmlDownloadFailure;
 
+        const FileTaskItem item = result.value(TaskRole::TaskItem).value<FileTaskItem>();
+        if (result.value(TaskRole::NotModified).toBool()) {
+            // The repository did not change since the last fetch, reuse the cached copy
+            // including the already extracted meta information of all its packages. It is
+            // copied, as other runs might replace the cached copy while this one reads it.
+            Metadata metadata;
+            metadata.repository = item.value(TaskRole::UserRole).value<Repository>();
+            const QString cacheDir = cacheDirectory(metadata.repository);
+            QTemporaryDir tmp(QDir::tempPath() + QLatin1String("/remoterepo-XXXXXX"));
+            if (!tmp.isValid()) {
+                qDebug() << "Cannot create unique temporary directory.";
+                return XmlDownloadFailure;
+            }
+
+            tmp.setAutoRemove(false);
+            metadata.directory = tmp.path();
+            m_tempDirDeleter.add(metadata.directory);
+            try {
+                if (QFileInfo(cacheDir).isDir())
+                    copyDirectoryContents(cacheDir, metadata.directory);
+            } catch (const Error &e) {
+                qDebug() << "Cannot copy cached meta information from" << cacheDir << ":"
+                    << e.message();
+            }
+            if (!QFileInfo(metadata.directory + QLatin1String("/Updates.xml")).isFile()) {
+                qDebug() << "Cached copy of Updates.xml from repository"
+                    << metadata.repository.displayname() << "is missing, fetching again.";
+                QFile::remove(cacheDir + QLatin1Char('/') + scValidatorsFile);
+                return XmlDownloadRetry;
+            }
+            m_metadata.insert(metadata.directory, metadata);
+            continue;
+        }
+
         //If repository is not found, target might be empty. Do not continue parsing the
         //repository and do not prevent further repositories usage.
         if (result.target().isEmpty()) {
@@ -479,109 +546,117 @@ MetadataJob::Status MetadataJob::parseUpdatesXml(const QList<FileTaskResult> &re
             return XmlDownloadFailure;
         }
 
-        if (!file.open(QIODevice::ReadOnly)) {
-            qDebug() << "Cannot open Updates.xml for reading:" << file.errorString();
-            return XmlDownloadFailure;
-        }
+        metadata.repository = item.value(TaskRole::UserRole).value<Repository>();
+        const bool online = !(metadata.repository.url().scheme()).isEmpty();
 
-        QString error;
-        QDomDocument doc;
-        if (!doc.setContent(&file, &error)) {
+        KDUpdater::UpdatesInfo updatesInfo;
+        updatesInfo.setFileName(file.fileName());
+        if (!updatesInfo.isValid()) {
             qDebug().nospace() << "Cannot fetch a valid version of Updates.xml from repository "
-                               << metadata.repository.displayname() << ": " << error;
+                               << metadata.repository.displayname() << ": "
+                               << updatesInfo.errorString();
             //If there are other repositories, try to use those
             continue;
         }
-        file.close();
-
-        const FileTaskItem item = result.value(TaskRole::TaskItem).value<FileTaskItem>();
-        metadata.repository = item.value(TaskRole::UserRole).value<Repository>();
-        const bool online = !(metadata.repository.url().scheme()).isEmpty();
 
         bool testCheckSum = true;
-        const QDomElement root = doc.documentElement();
-        const QDomNode checksum = root.firstChildElement(QLatin1String("Checksum"));
+        const QString checksum = updatesInfo.value(QLatin1String("Checksum"));
         if (!checksum.isNull())
-            testCheckSum = (checksum.toElement().text().toLower() == scTrue);
-
-        QDomNodeList children = root.childNodes();
-        for (int i = 0; i < children.count(); ++i) {
-            const QDomElement el = children.at(i).toElement();
-            if (!el.isNull() && el.tagName() == QLatin1String("PackageUpdate")) {
-                const QDomNodeList c2 = el.childNodes();
-                QString packageName, packageVersion, packageHash;
-                for (int j = 0; j < c2.count(); ++j) {
-                    if (c2.at(j).toElement().tagName() == scName)
-                        packageName = c2.at(j).toElement().text();
-                    else if (c2.at(j).toElement().tagName() == scVersion)
-                        packageVersion = (online ? c2.at(j).toElement().text() : QString());
-                    else if ((c2.at(j).toElement().tagName() == QLatin1String("SHA1")) && testCheckSum)
-                        packageHash = c2.at(j).toElement().text();
-                }
-
-                const QString repoUrl = metadata.repository.url().toString();
-                FileTaskItem item(QString::fromLatin1("%1/%2/%3meta.7z").arg(repoUrl, packageName,
-                    packageVersion), metadata.directory + QString::fromLatin1("/%1-%2-meta.7z")
-                    .arg(packageName, packageVersion));
-
-                QAuthenticator authenticator;
-                authenticator.setUser(metadata.repository.username());
-                authenticator.setPassword(metadata.repository.password());
-
-                item.insert(TaskRole::UserRole, metadata.directory);
-                item.insert(TaskRole::Checksum, packageHash.toLatin1());
-                item.insert(TaskRole::Authenticator, QVariant::fromValue(authenticator));
-                m_packages.append(item);
+            testCheckSum = (checksum.toLower() == scTrue);
+
+        const QString repoUrl = metadata.repository.url().toString();
+        QAuthenticator authenticator;
+        authenticator.setUser(metadata.repository.username());
+        authenticator.setPassword(metadata.repository.password());
+
+        // prefer the united meta data of all packages over one download per package
+        const QString unitedMetadata = updatesInfo.value(QLatin1String("MetadataName"));
+        if (!unitedMetadata.isEmpty()) {
+            FileTaskItem package(QString::fromLatin1("%1/%2").arg(repoUrl, unitedMetadata),
+                metadata.directory + QLatin1Char('/') + unitedMetadata);
+
+            package.insert(TaskRole::UserRole, metadata.directory);
+            if (testCheckSum) {
+                package.insert(TaskRole::Checksum, updatesInfo.value(QLatin1String("MetadataSHA1"))
+                    .toLatin1());
+            }
+            package.insert(TaskRole::Authenticator, QVariant::fromValue(authenticator));
+            m_packages.append(package);
+        } else {
+            foreach (const KDUpdater::UpdateInfo &info, updatesInfo.updatesInfo()) {
+                const QString packageName = info.data.value(scName).toString();
+                const QString packageVersion = online ? info.data.value(scVersion).toString()
+                    : QString();
+                const QString packageHash = testCheckSum
+                    ? info.data.value(QLatin1String("SHA1")).toString() : QString();
+
+                FileTaskItem package(QString::fromLatin1("%1/%2/%3meta.7z").arg(repoUrl,
+                    packageName, packageVersion), metadata.directory
+                    + QString::fromLatin1("/%1-%2-meta.7z").arg(packageName, packageVersion));
+
+                package.insert(TaskRole::UserRole, metadata.directory);
+                package.insert(TaskRole::Checksum, packageHash.toLatin1());
+                package.insert(TaskRole::Authenticator, QVariant::fromValue(authenticator));
+                m_packages.append(package);
             }
         }
         m_metadata.insert(metadata.directory, metadata);
 
         // search for additional repositories that we might need to check
-        const QDomNode repositoryUpdate = root.firstChildElement(QLatin1String("RepositoryUpdate"));
-        if (repositoryUpdate.isNull())
+        const QList<KDUpdater::RepositoryUpdateInfo> repositoryUpdateInfos
+            = updatesInfo.repositoryUpdates();
+        if (repositoryUpdateInfos.isEmpty()) {
+            // Repository updates must be applied on each run, so only indexes without them
+            // are kept for conditional requests.
+            const QByteArray etag = result.value(TaskRole::ETag).toByteArray();
+            const QByteArray lastModified = result.value(TaskRole::LastModified).toByteArray();
+            if (!etag.isEmpty() || !lastModified.isEmpty())
+                m_validators.insert(metadata.directory, qMakePair(etag, lastModified));
             continue;
+        }
 
         QHash<QString, QPair<Repository, Repository> > repositoryUpdates;
-        children = repositoryUpdate.toElement().childNodes();
-        for (int i = 0; i < children.count(); ++i) {
-            const QDomElement el = children.at(i).toElement();
-            if (!el.isNull() && el.tagName() == QLatin1String("Repository")) {
-                const QString action = el.attribute(QLatin1String("action"));
-                if (action == QLatin1String("add")) {
-                    // add a new repository to the defaults list
-                    Repository repository(resolveUrl(result, el.attribute(QLatin1String("url"))), true);
-                    repository.setUsername(el.attribute(QLatin1String("username")));
-                    repository.setPassword(el.attribute(QLatin1String("password")));
-                    repository.setDisplayName(el.attribute(QLatin1String("displayname")));
-                    if (ProductKeyCheck::instance()->isValidRepository(repository)) {
-                        repositoryUpdates.insertMulti(action, qMakePair(repository, Repository()));
-                        qDebug() << "Repository to add:" << repository.displayname();
-                    }
-                } else if (action == QLatin1String("remove")) {
-                    // remove possible default repositories using the given server url
-                    Repository repository(resolveUrl(result, el.attribute(QLatin1String("url"))), true);
-                    repository.setDisplayName(el.attribute(QLatin1String("displayname")));
+        foreach (const KDUpdater::RepositoryUpdateInfo &update, repositoryUpdateInfos) {
+            const QHash<QString, QString> &attributes = update.attributes;
+            const QString action = attributes.value(QLatin1String("action"));
+            if (action == QLatin1String("add")) {
+                // add a new repository to the defaults list
+                Repository repository(resolveUrl(result, attributes.value(QLatin1String("url"))),
+                    true);
+                repository.setUsername(attributes.value(QLatin1String("username")));
+                repository.setPassword(attributes.value(QLatin1String("password")));
+                repository.setDisplayName(attributes.value(QLatin1String("displayname")));
+                if (ProductKeyCheck::instance()->isValidRepository(repository)) {
                     repositoryUpdates.insertMulti(action, qMakePair(repository, Repository()));
-
-                    qDebug() << "Repository to remove:" << repository.displayname();
-                } else if (action == QLatin1String("replace")) {
-                    // replace possible default repositories using the given server url
-                    Repository oldRepository(resolveUrl(result, el.attribute(QLatin1String("oldUrl"))), true);
-                    Repository newRepository(resolveUrl(result, el.attribute(QLatin1String("newUrl"))), true);
-                    newRepository.setUsername(el.attribute(QLatin1String("username")));
-                    newRepository.setPassword(el.attribute(QLatin1String("password")));
-                    newRepository.setDisplayName(el.attribute(QLatin1String("displayname")));
-
-                    if (ProductKeyCheck::instance()->isValidRepository(newRepository)) {
-                        // store the new repository and the one old it replaces
-                        repositoryUpdates.insertMulti(action, qMakePair(newRepository, oldRepository));
-                        qDebug() << "Replace repository" << oldRepository.displayname() << "with"
-                            << newRepository.displayname();
-                    }
-                } else {
-                    qDebug() << "Invalid additional repositories action set in Updates.xml fetched "
-                        "from" << metadata.repository.displayname() << "line:" << el.lineNumber();
+                    qDebug() << "Repository to add:" << repository.displayname();
+                }
+            } else if (action == QLatin1String("remove")) {
+                // remove possible default repositories using the given server url
+                Repository repository(resolveUrl(result, attributes.value(QLatin1String("url"))),
+                    true);
+                repository.setDisplayName(attributes.value(QLatin1String("displayname")));
+                repositoryUpdates.insertMulti(action, qMakePair(repository, Repository()));
+
+                qDebug() << "Repository to remove:" << repository.displayname();
+            } else if (action == QLatin1String("replace")) {
+                // replace possible default repositories using the given server url
+                Repository oldRepository(resolveUrl(result, attributes.value(QLatin1String("oldUrl"))),
+                    true);
+                Repository newRepository(resolveUrl(result, attributes.value(QLatin1String("newUrl"))),
+                    true);
+                newRepository.setUsername(attributes.value(QLatin1String("username")));
+                newRepository.setPassword(attributes.value(QLatin1String("password")));
+                newRepository.setDisplayName(attributes.value(QLatin1String("displayname")));
+
+                if (ProductKeyCheck::instance()->isValidRepository(newRepository)) {
+                    // store the new repository and the one old it replaces
+                    repositoryUpdates.insertMulti(action, qMakePair(newRepository, oldRepository));
+                    qDebug() << "Replace repository" << oldRepository.displayname() << "with"
+                        << newRepository.displayname();
                 }
+            } else {
+                qDebug() << "Invalid additional repositories action set in Updates.xml fetched "
+                    "from" << metadata.repository.displayname() << "line:" << update.lineNumber;
             }
         }
 
@@ -618,4 +693,109 @@ MetadataJob::Status MetadataJob::parseUpdatesXml(const QList<FileTaskResult> &re
     return XmlDownloadSuccess;
 }
 
+/*!
+    \internal
+
+    Returns the directory that keeps the last fetched meta information of \a repo for
+    conditional requests, or an empty string if no such cache should be used. The directory
+    lives inside the download cache if one is set, otherwise the maintenance tool uses the
+    cache location of the user.
+*/
+QString MetadataJob::cacheDirectory(const Repository &repo) const
+{
+    QString root;
+    if (DownloadCache::instance()->isEnabled())
+        root = DownloadCache::instance()->path();
+    else if (m_core->isMaintainer())
+        root = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (root.isEmpty())
+        return QString();
+
+    const QByteArray key = QCryptographicHash::hash((repo.url().toString()
+        + m_core->value(scUrlQueryString)).toUtf8(), QCryptographicHash::Sha1).toHex();
+    return root + QLatin1String("/metadata/") + QString::fromLatin1(key);
+}
+
+/*!
+    \internal
+
+    Returns the entity tag and last modification date stored alongside the cached copy of
+    Updates.xml in \a cacheDir. Both are empty if there is no usable copy.
+*/
+QPair<QByteArray, QByteArray> MetadataJob::cachedValidators(const QString &cacheDir) const
+{
+    QPair<QByteArray, QByteArray> validators;
+    if (cacheDir.isEmpty() || !QFileInfo(cacheDir + QLatin1String("/Updates.xml")).isFile())
+        return validators;
+
+    QFile file(cacheDir + QLatin1Char('/') + scValidatorsFile);
+    if (!file.open(QIODevice::ReadOnly))
+        return validators;
+
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (line.startsWith("ETag:"))
+            validators.first = line.mid(5).trimmed();
+        else if (line.startsWith("Last-Modified:"))
+            validators.second = line.mid(14).trimmed();
+    }
+    return validators;
+}
+
+/*!
+    \internal
+
+    Replaces the cached meta information of all repositories that were fetched completely and
+    reported validators, so the next run can issue conditional requests for them. The new copy
+    is written next to the cached one and then renamed into place, so other runs never see a
+    partially written or removed copy.
+*/
+void MetadataJob::updateCache()
+{
+    QHash<QString, QPair<QByteArray, QByteArray> >::const_iterator it;
+    for (it = m_validators.constBegin(); it != m_validators.constEnd(); ++it) {
+        const QString cacheDir = cacheDirectory(m_metadata.value(it.key()).repository);
+        if (cacheDir.isEmpty())
+            continue;
+
+        // on the same file system as the cached copy, so it can be renamed into place
+        QDir().mkpath(QFileInfo(cacheDir).path());
+        QTemporaryDir staging(cacheDir + QLatin1String("-XXXXXX"));
+        QTemporaryDir replaced(cacheDir + QLatin1String("-XXXXXX"));
+        try {
+            if (!staging.isValid() || !replaced.isValid())
+                throw Error(tr("Cannot create unique temporary directory."));
+            copyDirectoryContents(it.key(), staging.path());
+
+            QDir dir(staging.path());
+            foreach (const QString &archive, dir.entryList(QStringList(QLatin1String("*meta.7z")),
+                    QDir::Files)) {
+                dir.remove(archive);
+            }
+
+            QFile file(staging.path() + QLatin1Char('/') + scValidatorsFile);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+                throw Error(file.errorString());
+            if (!it.value().first.isEmpty())
+                file.write("ETag: " + it.value().first + '\n');
+            if (!it.value().second.isEmpty())
+                file.write("Last-Modified: " + it.value().second + '\n');
+            file.close();
+
+            // move the cached copy out of the way, it is removed together with replaced
+            KDUpdater::UpdatesInfo::removeFromCache(cacheDir + QLatin1String("/Updates.xml"));
+            if (QFileInfo(cacheDir).exists()
+                && !QDir().rename(cacheDir, replaced.path() + QLatin1String("/metadata"))) {
+                    throw Error(tr("Cannot move the cached copy out of the way."));
+            }
+            // another run might have published its copy meanwhile, then that one is kept
+            if (!QDir().rename(staging.path(), cacheDir))
+                qDebug() << "Cannot publish cached meta information in" << cacheDir;
+        } catch (const Error &e) {
+            qDebug() << "Cannot cache meta information in" << cacheDir << ":" << e.message();
+        }
+    }
+    m_validators.clear();
+}
+
 }   // namespace QInstaller
@@ -84,18 +84,28 @@ private:
     void resetCompressedFetch();
     Status parseUpdatesXml(const QList<FileTaskResult> &results);
 
+    QString cacheDirectory(const Repository &repo) const;
+    QPair<QByteArray, QByteArray> cachedValidators(const QString &cacheDir) const;
+    void updateCache();
+
 private:
     PackageManagerCore *m_core;
 
     QList<FileTaskItem> m_packages;
     TempDirDeleter m_tempDirDeleter;
     QHash<QString, Metadata> m_metadata;
+    QHash<QString, QPair<QByteArray, QByteArray> > m_validators;
     QFutureWatcher<FileTaskResult> m_xmlTask;
     QFutureWatcher<FileTaskResult> m_metadataTask;
     QHash<QFutureWatcher<void> *, QObject*> m_unzipTasks;
     QHash<QFutureWatcher<void> *, QObject*> m_unzipRepositoryTasks;
     bool m_addCompressedPackages;
     QList<FileTaskItem> m_unzipRepositoryitems;
+
+    // start times of the phases, see Tracer::now()
+    qint64 m_xmlTaskStart;
+    qint64 m_metadataTaskStart;
+    qint64 m_unzipTasksStart;
 };
 
 }   // namespace QInstaller
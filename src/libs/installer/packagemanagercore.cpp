@@ -419,7 +419,8 @@ void PackageManagerCore::writeMaintenanceTool()
 {
     if (d->m_needToWriteMaintenanceTool) {
         try {
-            d->writeMaintenanceTool(d->m_performedOperationsOld + d->m_performedOperationsCurrentSession);
+            d->writeMaintenanceTool(d->m_performedOperationsOld
+                + d->m_performedOperationsCurrentSession);
 
             bool gainedAdminRights = false;
             QTemporaryFile tempAdminFile(d->targetDir()
@@ -440,6 +441,19 @@ void PackageManagerCore::writeMaintenanceTool()
     }
 }
 
+/*!
+    \internal
+
+    Disables writing the maintenance tool if \a disable is \c true. The installation then keeps
+    its operations in memory only, and uninstalling does not remove the maintenance tool, which
+    would be the running binary. Tests and benchmarks that run the installation in process reach
+    this through PackageManagerCoreTestAccess.
+*/
+void PackageManagerCore::disableWriteMaintenanceTool(bool disable)
+{
+    d->m_disableWriteMaintenanceTool = disable;
+}
+
 /*!
     Creates the maintenance tool configuration files.
 */
@@ -619,49 +633,15 @@ int PackageManagerCore::downloadNeededArchives(double partProgressSize)
 {
     Q_ASSERT(partProgressSize >= 0 && partProgressSize <= 1);
 
-    QList<QPair<QString, QString> > archivesToDownload;
-    QList<Component*> neededComponents = orderedComponentsToInstall();
-    foreach (Component *component, neededComponents) {
-        // collect all archives to be downloaded
-        const QStringList toDownload = component->downloadableArchives();
-        foreach (const QString &versionFreeString, toDownload) {
-            archivesToDownload.push_back(qMakePair(QString::fromLatin1("installer://%1/%2")
-                .arg(component->name(), versionFreeString), QString::fromLatin1("%1/%2/%3")
-                .arg(component->repositoryUrl().toString(), component->name(), versionFreeString)));
-        }
-    }
-
-    if (archivesToDownload.isEmpty())
+    QScopedPointer<DownloadArchivesJob> archivesJob(d->createDownloadArchivesJob(
+        orderedComponentsToInstall(), partProgressSize));
+    if (archivesJob.isNull())
         return 0;
 
-    ProgressCoordinator::instance()->emitLabelAndDetailTextChanged(tr("\nDownloading packages..."));
-
-    DownloadArchivesJob archivesJob(this);
-    archivesJob.setAutoDelete(false);
-    archivesJob.setArchivesToDownload(archivesToDownload);
-    connect(this, &PackageManagerCore::installationInterrupted, &archivesJob, &Job::cancel);
-    connect(&archivesJob, &DownloadArchivesJob::outputTextChanged,
-            ProgressCoordinator::instance(), &ProgressCoordinator::emitLabelAndDetailTextChanged);
-    connect(&archivesJob, &DownloadArchivesJob::downloadStatusChanged,
-            ProgressCoordinator::instance(), &ProgressCoordinator::downloadStatusChanged);
-
-    ProgressCoordinator::instance()->registerPartProgress(&archivesJob,
-        SIGNAL(progressChanged(double)), partProgressSize);
-
-    archivesJob.start();
-    archivesJob.waitForFinished();
+    archivesJob->start();
+    d->finishDownloadArchivesJob(archivesJob.data());
 
-    if (archivesJob.error() == Job::Canceled)
-        interrupt();
-    else if (archivesJob.error() != Job::NoError)
-        throw Error(archivesJob.errorString());
-
-    if (d->statusCanceledOrFailed())
-        throw Error(tr("Installation canceled by user."));
-
-    ProgressCoordinator::instance()->emitDownloadStatus(tr("All downloads finished."));
-
-    return archivesJob.numberOfDownloads();
+    return archivesJob->numberOfDownloads();
 }
 
 /*!
@@ -736,11 +716,12 @@ void PackageManagerCore::rollBackInstallation()
                 }
             }
 
-            d->m_localPackageHub->writeToDisk();
+            d->m_localPackageHub->writeJournal();
             if (isInstaller()) {
                 if (d->m_localPackageHub->packageInfoCount() == 0) {
                     QFile file(d->m_localPackageHub->fileName());
                     file.remove();
+                    QFile::remove(d->m_localPackageHub->journalFileName());
                 }
             }
 
@@ -757,6 +738,8 @@ void PackageManagerCore::rollBackInstallation()
                 "error happened."));
         }
     }
+    // compact the journal written while rolling back
+    d->m_localPackageHub->writeToDisk();
 }
 
 /*!
@@ -920,12 +903,10 @@ private:
 */
 PackageManagerCore::~PackageManagerCore()
 {
-    if (!isUninstaller() && !(isInstaller() && status() == PackageManagerCore::Canceled)) {
-        QDir targetDir(value(scTargetDir));
-        QString logFileName = targetDir.absoluteFilePath(value(QLatin1String("LogFileName"),
-            QLatin1String("InstallationLog.txt")));
-        QInstaller::VerboseWriter::instance()->setFileName(logFileName);
-    }
+    if (!isUninstaller() && !(isInstaller() && status() == PackageManagerCore::Canceled))
+        QInstaller::VerboseWriter::instance()->setFileName(d->logFilePath());
+    else
+        QInstaller::VerboseWriter::instance()->releaseFile();
     delete d;
 
     try {
@@ -1455,6 +1436,7 @@ ScriptEngine *PackageManagerCore::controlScriptEngine() const
 void PackageManagerCore::appendRootComponent(Component *component)
 {
     d->m_rootComponents.append(component);
+    d->invalidateComponentRegistry();
     emit componentAdded(component);
 }
 
@@ -1525,6 +1507,7 @@ void PackageManagerCore::appendUpdaterComponent(Component *component)
 {
     component->setUpdateAvailable(true);
     d->m_updaterComponents.append(component);
+    d->invalidateComponentRegistry();
     emit componentAdded(component);
 }
 
@@ -1536,7 +1519,17 @@ void PackageManagerCore::appendUpdaterComponent(Component *component)
 */
 Component *PackageManagerCore::componentByName(const QString &name) const
 {
-    return componentByName(name, components(ComponentType::AllNoReplacements));
+    if (name.isEmpty())
+        return 0;
+
+    const PackageManagerCorePrivate::DependencyConstraint constraint
+        = PackageManagerCorePrivate::DependencyConstraint::parse(0, name);
+
+    // can be remote or local version
+    Component *component = d->registeredComponent(constraint.name);
+    if (component && constraint.matches(component->value(scVersion)))
+        return component;
+    return 0;
 }
 
 /*!
@@ -1551,13 +1544,9 @@ Component *PackageManagerCore::componentByName(const QString &name, const QList<
     if (name.isEmpty())
         return 0;
 
+    QString fixedName;
     QString fixedVersion;
-    QString fixedName = name;
-    if (name.contains(QChar::fromLatin1('-'))) {
-        // the last part is considered to be the version, then
-        fixedVersion = name.section(QLatin1Char('-'), 1);
-        fixedName = name.section(QLatin1Char('-'), 0, 0);
-    }
+    parseNameAndVersion(name, &fixedName, &fixedVersion);
 
     foreach (Component *component, components) {
         if (componentMatches(component, fixedName, fixedVersion))
@@ -1567,6 +1556,20 @@ Component *PackageManagerCore::componentByName(const QString &name, const QList<
     return 0;
 }
 
+/*!
+    Splits the dependency \a requirement into the component \a name and the \a version
+    requirement at the first dash, the same way dependencies have always been read. For example,
+    \c{org.qt-project.sdk.qt->=4.5} is split into \c org.qt and \c{project.sdk.qt->=4.5}, so
+    component names used in dependencies cannot contain dashes. The version is empty if
+    \a requirement does not contain a dash.
+*/
+void PackageManagerCore::parseNameAndVersion(const QString &requirement, QString *name,
+    QString *version)
+{
+    *name = requirement.section(QLatin1Char('-'), 0, 0);
+    *version = requirement.section(QLatin1Char('-'), 1);
+}
+
 /*!
     Returns a list of components that are marked for installation. The list can
     be empty.
@@ -1748,21 +1751,13 @@ QList<Component*> PackageManagerCore::dependees(const Component *_component) con
     if (!_component)
         return QList<Component *>();
 
-    const QList<QInstaller::Component *> availableComponents = components(ComponentType::All);
-    if (availableComponents.isEmpty())
-        return QList<Component *>();
-
-    const QLatin1Char dash('-');
+    // can be remote or local version
+    const QString version = _component->value(scVersion);
     QList<Component *> dependees;
-    foreach (Component *component, availableComponents) {
-        const QStringList &dependencies = component->dependencies();
-        foreach (const QString &dependency, dependencies) {
-            // the last part is considered to be the version then
-            const QString name = dependency.contains(dash) ? dependency.section(dash, 0, 0) : dependency;
-            const QString version = dependency.contains(dash) ? dependency.section(dash, 1) : QString();
-            if (componentMatches(_component, name, version))
-                dependees.append(component);
-        }
+    typedef PackageManagerCorePrivate::DependencyConstraint DependencyConstraint;
+    foreach (const DependencyConstraint &constraint, d->registeredDependees(_component->name())) {
+        if (!constraint.automatic && constraint.matches(version))
+            dependees.append(constraint.component);
     }
     return dependees;
 }
@@ -2135,24 +2130,9 @@ bool PackageManagerCore::performOperation(const QString &name, const QStringList
 */
 bool PackageManagerCore::versionMatches(const QString &version, const QString &requirement)
 {
-    QRegExp compEx(QLatin1String("([<=>]+)(.*)"));
-    const QString comparator = compEx.exactMatch(requirement) ? compEx.cap(1) : QLatin1String("=");
-    const QString ver = compEx.exactMatch(requirement) ? compEx.cap(2) : requirement;
-
-    const bool allowEqual = comparator.contains(QLatin1Char('='));
-    const bool allowLess = comparator.contains(QLatin1Char('<'));
-    const bool allowMore = comparator.contains(QLatin1Char('>'));
-
-    if (allowEqual && version == ver)
-        return true;
-
-    if (allowLess && KDUpdater::compareVersion(ver, version) > 0)
-        return true;
-
-    if (allowMore && KDUpdater::compareVersion(ver, version) < 0)
-        return true;
-
-    return false;
+    PackageManagerCorePrivate::DependencyConstraint constraint;
+    constraint.setVersionRequirement(requirement);
+    return constraint.matches(version);
 }
 
 /*!
@@ -2665,6 +2645,12 @@ void PackageManagerCore::storeReplacedComponents(QHash<QString, Component *> &co
             d->componentsToReplace().insert(componentName, qMakePair(it.key(), componentToReplace));
         }
     }
+    d->invalidateComponentRegistry();
+}
+
+void PackageManagerCore::invalidateComponentRegistry()
+{
+    d->invalidateComponentRegistry();
 }
 
 bool PackageManagerCore::fetchAllPackages(const PackagesList &remotes, const LocalPackagesHash &locals)
@@ -112,6 +112,7 @@ public:
     static void setCreateLocalRepositoryFromBinary(bool create);
 
     static Component *componentByName(const QString &name, const QList<Component *> &components);
+    static void parseNameAndVersion(const QString &requirement, QString *name, QString *version);
 
     bool fetchLocalPackagesTree();
     LocalPackagesHash localInstalledPackages();
@@ -340,11 +341,18 @@ private:
     QList<Component *> componentsMarkedForInstallation() const;
 
     bool fetchPackagesTree(const PackagesList &packages, const LocalPackagesHash installedPackages);
+    void invalidateComponentRegistry();
 
 private:
     PackageManagerCorePrivate *const d;
+    friend class Component;
     friend class PackageManagerCorePrivate;
 
+private:
+    // for tests and benchmarks only
+    friend class PackageManagerCoreTestAccess;
+    void disableWriteMaintenanceTool(bool disable = true);
+
 private:
     // remove once we deprecate isSelected, setSelected etc...
     friend class ComponentSelectionPage;
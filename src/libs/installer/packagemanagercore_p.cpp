@@ -34,6 +34,7 @@
 #include "component.h"
 #include "scriptengine.h"
 #include "componentmodel.h"
+#include "downloadarchivesjob.h"
 #include "errors.h"
 #include "fileio.h"
 #include "remotefileengine.h"
@@ -45,13 +46,18 @@
 #include "protocol.h"
 #include "qsettingswrapper.h"
 #include "installercalculator.h"
+#include "lib7z_facade.h"
+#include "lib7z_list.h"
 #include "uninstallercalculator.h"
 #include "componentchecker.h"
 #include "globals.h"
+#include "tracer.h"
+#include "utils.h"
 
 #include "selfrestarter.h"
 #include "filedownloaderfactory.h"
 #include "updateoperationfactory.h"
+#include "updatesinfo_p.h"
 
 #include <productkeycheck.h>
 
@@ -60,6 +66,7 @@
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDir>
 #include <QtCore/QDirIterator>
+#include <QtCore/QEventLoop>
 #include <QtCore/QUuid>
 #include <QtCore/QFuture>
 #include <QtCore/QFutureWatcher>
@@ -109,6 +116,12 @@ private:
 static bool runOperation(Operation *operation, PackageManagerCorePrivate::OperationType type)
 {
     OperationTracer tracer(operation);
+    TraceSpan span("operation", type == PackageManagerCorePrivate::Backup ? "Backup"
+        : type == PackageManagerCorePrivate::Perform ? "Perform" : "Undo");
+    if (span.isActive()) {
+        span.setDetail(QString::fromLatin1("%1 (%2)").arg(operation->name(),
+            operation->value(QLatin1String("component")).toString()));
+    }
     switch (type) {
         case PackageManagerCorePrivate::Backup:
             tracer.trace(QLatin1String("backup"));
@@ -126,6 +139,86 @@ static bool runOperation(Operation *operation, PackageManagerCorePrivate::Operat
     return false;
 }
 
+static bool backupAndPerformOperation(Operation *operation)
+{
+    runOperation(operation, PackageManagerCorePrivate::Backup);
+    return runOperation(operation, PackageManagerCorePrivate::Perform);
+}
+
+static bool waitForOperationFuture(const QFuture<bool> &future)
+{
+    QFutureWatcher<bool> futureWatcher;
+
+    QEventLoop loop;
+    QObject::connect(&futureWatcher, &decltype(futureWatcher)::finished, &loop, &QEventLoop::quit,
+                     Qt::QueuedConnection);
+    futureWatcher.setFuture(future);
+
+    if (!future.isFinished())
+        loop.exec();
+
+    return future.result();
+}
+
+/*!
+    Returns \c true if \a operation is an archive extraction that can run concurrently to the
+    operations of other components. Operations that require elevated rights are excluded, as
+    gaining them has to happen on the installer thread.
+*/
+static bool isConcurrentExtractOperation(Operation *operation)
+{
+    return operation->name() == QLatin1String("Extract")
+        && !operation->value(QLatin1String("admin")).toBool();
+}
+
+static QString normalizedTargetPath(const QString &path)
+{
+    const QString cleanPath = QDir::cleanPath(QDir::fromNativeSeparators(path));
+#ifdef Q_OS_WIN
+    return cleanPath.toLower();
+#else
+    return cleanPath;
+#endif
+}
+
+/*
+    Returns \c true if \a path is one of \a paths, lies inside one of them, or contains one of
+    them. \a parents holds all parent directories of \a paths.
+*/
+static bool overlapsTargets(const QString &path, const QSet<QString> &paths,
+    const QSet<QString> &parents)
+{
+    if (paths.contains(path) || parents.contains(path))
+        return true;
+    for (int index = path.lastIndexOf(QLatin1Char('/')); index > 0;
+        index = path.lastIndexOf(QLatin1Char('/'), index - 1)) {
+            if (paths.contains(path.left(index)))
+                return true;
+    }
+    return false;
+}
+
+/*
+    Returns the files \a archivePath extracts into \a targetDir. Runs on a worker thread, so the
+    archive is never listed on the installer thread. If the archive cannot be listed, it might
+    write anything below \a targetDir.
+*/
+static QStringList listExtractedFiles(const QString &archivePath, const QString &targetDir)
+{
+    QStringList paths;
+    try {
+        QFile archive(archivePath);
+        QInstaller::openForRead(&archive);
+        foreach (const Lib7z::File &file, Lib7z::listArchive(&archive)) {
+            if (!file.isDirectory)
+                paths.append(targetDir + QLatin1Char('/') + normalizedTargetPath(file.path));
+        }
+    } catch (const Error &) {
+        paths = QStringList(targetDir);
+    }
+    return paths;
+}
+
 static QStringList checkRunningProcessesFromList(const QStringList &processList)
 {
     const QList<ProcessInfo> allProcesses = runningProcesses();
@@ -191,6 +284,8 @@ PackageManagerCorePrivate::PackageManagerCorePrivate(PackageManagerCore *core)
     : m_updateFinder(0)
     , m_compressedFinder(0)
     , m_localPackageHub(std::make_shared<LocalPackageHub>())
+    , m_needToWriteMaintenanceTool(false)
+    , m_disableWriteMaintenanceTool(false)
     , m_core(core)
     , m_updates(false)
     , m_repoFetched(false)
@@ -200,11 +295,14 @@ PackageManagerCorePrivate::PackageManagerCorePrivate(PackageManagerCore *core)
     , m_controlScriptEngine(0)
     , m_installerCalculator(0)
     , m_uninstallerCalculator(0)
+    , m_componentRegistryValid(false)
+    , m_componentRegistryUpdater(false)
     , m_proxyFactory(0)
     , m_defaultModel(0)
     , m_updaterModel(0)
     , m_guiObject(0)
     , m_remoteFileEngineHandler(0)
+    , m_archivesJob(0)
 {
 }
 
@@ -219,6 +317,7 @@ PackageManagerCorePrivate::PackageManagerCorePrivate(PackageManagerCore *core, q
     , m_launchedAsRoot(AdminAuthorization::hasAdminRights())
     , m_completeUninstall(false)
     , m_needToWriteMaintenanceTool(false)
+    , m_disableWriteMaintenanceTool(false)
     , m_dependsOnLocalInstallerBinary(false)
     , m_core(core)
     , m_updates(false)
@@ -230,11 +329,14 @@ PackageManagerCorePrivate::PackageManagerCorePrivate(PackageManagerCore *core, q
     , m_controlScriptEngine(0)
     , m_installerCalculator(0)
     , m_uninstallerCalculator(0)
+    , m_componentRegistryValid(false)
+    , m_componentRegistryUpdater(false)
     , m_proxyFactory(0)
     , m_defaultModel(0)
     , m_updaterModel(0)
     , m_guiObject(0)
     , m_remoteFileEngineHandler(new RemoteFileEngineHandler)
+    , m_archivesJob(0)
 {
     foreach (const OperationBlob &operation, performedOperations) {
         QScopedPointer<QInstaller::Operation> op(KDUpdater::UpdateOperationFactory::instance()
@@ -244,7 +346,13 @@ PackageManagerCorePrivate::PackageManagerCorePrivate(PackageManagerCore *core, q
             continue;
         }
 
-        if (!op->fromXml(operation.xml)) {
+        if (!operation.data.isNull()) {
+            // the XML is only parsed once the operation is inspected or undone
+            QVariantMap knownValues;
+            knownValues.insert(QLatin1String("component"), operation.component.isEmpty()
+                ? QVariant() : QVariant(operation.component));
+            op->setDeferredXml(operation.data, knownValues);
+        } else if (!op->fromXml(operation.xml)) {
             qWarning() << "Failed to load XML for operation" << operation.name;
             continue;
         }
@@ -282,6 +390,72 @@ PackageManagerCorePrivate::~PackageManagerCorePrivate()
     // delete m_gui;
 }
 
+/*!
+    \internal
+
+    Returns the dependency \a requirement declared by \a component, for example
+    \c{org.example.tool->=4.5}, split into the name and the version requirement.
+    \a automatic is \c true for dependencies declared as \c AutoDependOn.
+*/
+/* static */
+PackageManagerCorePrivate::DependencyConstraint PackageManagerCorePrivate::DependencyConstraint
+    ::parse(Component *component, const QString &requirement, bool automatic)
+{
+    DependencyConstraint constraint;
+    constraint.component = component;
+    constraint.automatic = automatic;
+
+    QString version;
+    PackageManagerCore::parseNameAndVersion(requirement, &constraint.name, &version);
+    if (!version.isEmpty())
+        constraint.setVersionRequirement(version);
+    return constraint;
+}
+
+/*!
+    \internal
+
+    Splits the version \a requirement, for example \c{>=4.5}, into the comparator and the
+    version. A requirement without comparator asks for exactly that version.
+*/
+void PackageManagerCorePrivate::DependencyConstraint::setVersionRequirement(
+    const QString &requirement)
+{
+    static const QRegExp comparatorEx(QLatin1String("([<=>]+)(.*)"));
+    QRegExp ex = comparatorEx;
+    if (ex.exactMatch(requirement)) {
+        comparator = ex.cap(1);
+        version = ex.cap(2);
+    } else {
+        comparator = QLatin1String("=");
+        version = requirement;
+    }
+}
+
+/*!
+    \internal
+
+    Returns \c true if \a version satisfies the constraint. Any version satisfies a constraint
+    without version requirement.
+*/
+bool PackageManagerCorePrivate::DependencyConstraint::matches(const QString &version) const
+{
+    if (comparator.isEmpty())
+        return true;
+
+    if (comparator.contains(QLatin1Char('=')) && version == this->version)
+        return true;
+
+    const int result = KDUpdater::compareVersion(this->version, version);
+    if (comparator.contains(QLatin1Char('<')) && result > 0)
+        return true;
+
+    if (comparator.contains(QLatin1Char('>')) && result < 0)
+        return true;
+
+    return false;
+}
+
 /*!
     Return true, if a process with \a name is running. On Windows, comparison is case-insensitive.
 */
@@ -316,18 +490,7 @@ bool PackageManagerCorePrivate::isProcessRunning(const QString &name,
 /* static */
 bool PackageManagerCorePrivate::performOperationThreaded(Operation *operation, OperationType type)
 {
-    QFutureWatcher<bool> futureWatcher;
-    const QFuture<bool> future = QtConcurrent::run(runOperation, operation, type);
-
-    QEventLoop loop;
-    QObject::connect(&futureWatcher, &decltype(futureWatcher)::finished, &loop, &QEventLoop::quit,
-                     Qt::QueuedConnection);
-    futureWatcher.setFuture(future);
-
-    if (!future.isFinished())
-        loop.exec();
-
-    return future.result();
+    return waitForOperationFuture(QtConcurrent::run(runOperation, operation, type));
 }
 
 QString PackageManagerCorePrivate::targetDir() const
@@ -335,6 +498,12 @@ QString PackageManagerCorePrivate::targetDir() const
     return m_core->value(scTargetDir);
 }
 
+QString PackageManagerCorePrivate::logFilePath() const
+{
+    return QDir(targetDir()).absoluteFilePath(m_core->value(QLatin1String("LogFileName"),
+        QLatin1String("InstallationLog.txt")));
+}
+
 QString PackageManagerCorePrivate::configurationFileName() const
 {
     return m_core->value(scTargetConfigurationFile, QLatin1String("components.xml"));
@@ -460,6 +629,7 @@ void PackageManagerCorePrivate::clearAllComponentLists()
         toDelete << list.at(i).second;
     m_componentsToReplaceAllMode.clear();
     m_componentsToInstallCalculated = false;
+    invalidateComponentRegistry();
 
     qDeleteAll(toDelete);
     cleanUpComponentEnvironment();
@@ -485,6 +655,7 @@ void PackageManagerCorePrivate::clearUpdaterComponentLists()
 
     m_componentsToReplaceUpdaterMode.clear();
     m_componentsToInstallCalculated = false;
+    invalidateComponentRegistry();
 
     qDeleteAll(usedComponents);
     cleanUpComponentEnvironment();
@@ -500,6 +671,89 @@ QHash<QString, QPair<Component*, Component*> > &PackageManagerCorePrivate::compo
     return (!isUpdater()) ? m_componentsToReplaceAllMode : m_componentsToReplaceUpdaterMode;
 }
 
+/*!
+    \internal
+
+    Marks the component registry outdated, so it gets rebuilt on the next lookup. Needs to be
+    called whenever a component is added to or removed from one of the component lists, or a
+    registered component changes its name or dependencies.
+*/
+void PackageManagerCorePrivate::invalidateComponentRegistry()
+{
+    QMutexLocker _(&m_componentRegistryMutex);
+    m_componentRegistryValid = false;
+}
+
+/*!
+    \internal
+
+    Returns the component registered as \a name, ignoring replacements, or \c 0 if there is no
+    such component.
+*/
+Component *PackageManagerCorePrivate::registeredComponent(const QString &name) const
+{
+    QMutexLocker _(&m_componentRegistryMutex);
+    updateComponentRegistry();
+    return m_componentsByName.value(name);
+}
+
+/*!
+    \internal
+
+    Returns the dependencies and automatic dependencies of all components, including
+    replacements, that refer to \a name.
+*/
+QList<PackageManagerCorePrivate::DependencyConstraint>
+    PackageManagerCorePrivate::registeredDependees(const QString &name) const
+{
+    QMutexLocker _(&m_componentRegistryMutex);
+    updateComponentRegistry();
+    return m_dependees.value(name);
+}
+
+/*!
+    \internal
+
+    Returns the dependencies and automatic dependencies declared by \a component.
+*/
+QList<PackageManagerCorePrivate::DependencyConstraint>
+    PackageManagerCorePrivate::registeredDependencies(const Component *component) const
+{
+    QMutexLocker _(&m_componentRegistryMutex);
+    updateComponentRegistry();
+    return m_dependencies.value(component);
+}
+
+void PackageManagerCorePrivate::updateComponentRegistry() const
+{
+    if (m_componentRegistryValid && m_componentRegistryUpdater == isUpdater())
+        return;
+
+    m_componentsByName.clear();
+    m_dependees.clear();
+    m_dependencies.clear();
+
+    const QList<Component *> components
+        = m_core->components(PackageManagerCore::ComponentType::AllNoReplacements);
+    foreach (Component *component, components) {
+        if (!m_componentsByName.contains(component->name()))
+            m_componentsByName.insert(component->name(), component);
+    }
+
+    foreach (Component *component, m_core->components(PackageManagerCore::ComponentType::All)) {
+        QList<DependencyConstraint> &constraints = m_dependencies[component];
+        foreach (const QString &dependency, component->dependencies())
+            constraints.append(DependencyConstraint::parse(component, dependency));
+        foreach (const QString &dependency, component->autoDependencies())
+            constraints.append(DependencyConstraint::parse(component, dependency, true));
+        foreach (const DependencyConstraint &constraint, constraints)
+            m_dependees[constraint.name].append(constraint);
+    }
+
+    m_componentRegistryUpdater = isUpdater();
+    m_componentRegistryValid = true;
+}
+
 void PackageManagerCorePrivate::clearInstallerCalculator()
 {
     delete m_installerCalculator;
@@ -994,56 +1248,6 @@ void PackageManagerCorePrivate::writeMaintenanceToolBinary(QFile *const input, q
     qDebug() << "Writing maintenance tool:" << maintenanceToolRenamedName;
     ProgressCoordinator::instance()->emitLabelAndDetailTextChanged(tr("Writing maintenance tool."));
 
-    QTemporaryFile out;
-    QInstaller::openForWrite(&out); // throws an exception in case of error
-
-    if (!input->seek(0))
-        throw Error(tr("Failed to seek in file %1: %2").arg(input->fileName(), input->errorString()));
-
-    QInstaller::appendData(&out, input, size);
-    if (writeBinaryLayout) {
-#ifdef Q_OS_OSX
-        QDir resourcePath(QFileInfo(maintenanceToolRenamedName).dir());
-        if (!resourcePath.path().endsWith(QLatin1String("Contents/MacOS")))
-            throw Error(tr("Maintenance tool is not a bundle"));
-        resourcePath.cdUp();
-        resourcePath.cd(QLatin1String("Resources"));
-        // It's a bit odd to have only the magic in the data file, but this simplifies
-        // other code a lot (since installers don't have any appended data either)
-        QTemporaryFile dataOut;
-        QInstaller::openForWrite(&dataOut);
-        QInstaller::appendInt64(&dataOut, 0);   // operations start
-        QInstaller::appendInt64(&dataOut, 0);   // operations end
-        QInstaller::appendInt64(&dataOut, 0);   // resource count
-        QInstaller::appendInt64(&dataOut, 4 * sizeof(qint64));   // data block size
-        QInstaller::appendInt64(&dataOut, BinaryContent::MagicUninstallerMarker);
-        QInstaller::appendInt64(&dataOut, BinaryContent::MagicCookie);
-
-        {
-            QFile dummy(resourcePath.filePath(QLatin1String("installer.dat")));
-            if (dummy.exists() && !dummy.remove()) {
-                throw Error(tr("Cannot remove data file \"%1\": %2").arg(dummy.fileName(),
-                    dummy.errorString()));
-            }
-        }
-
-        if (!dataOut.rename(resourcePath.filePath(QLatin1String("installer.dat")))) {
-            throw Error(tr("Cannot write maintenance tool data to %1: %2").arg(out.fileName(),
-                out.errorString()));
-        }
-        dataOut.setAutoRemove(false);
-        dataOut.setPermissions(dataOut.permissions() | QFile::WriteUser | QFile::ReadGroup
-            | QFile::ReadOther);
-#else
-        QInstaller::appendInt64(&out, 0);   // operations start
-        QInstaller::appendInt64(&out, 0);   // operations end
-        QInstaller::appendInt64(&out, 0);   // resource count
-        QInstaller::appendInt64(&out, 4 * sizeof(qint64));   // data block size
-        QInstaller::appendInt64(&out, BinaryContent::MagicUninstallerMarker);
-        QInstaller::appendInt64(&out, BinaryContent::MagicCookie);
-#endif
-    }
-
     {
         QFile dummy(maintenanceToolRenamedName);
         if (dummy.exists() && !dummy.remove()) {
@@ -1052,9 +1256,69 @@ void PackageManagerCorePrivate::writeMaintenanceToolBinary(QFile *const input, q
         }
     }
 
-    if (!out.copy(maintenanceToolRenamedName)) {
-        throw Error(tr("Cannot write maintenance tool to \"%1\": %2").arg(maintenanceToolRenamedName,
-            out.errorString()));
+    // written in place rather than copied from a temporary file, so the executable is transferred
+    // only once and can share its data with the input on file systems that support it
+    QFile out(maintenanceToolRenamedName);
+    try {
+        QInstaller::openForWrite(&out); // throws an exception in case of error
+
+        if (!input->seek(0))
+            throw Error(tr("Failed to seek in file %1: %2").arg(input->fileName(),
+                input->errorString()));
+
+        QInstaller::appendData(&out, input, size);
+        if (writeBinaryLayout) {
+#ifdef Q_OS_OSX
+            QDir resourcePath(QFileInfo(maintenanceToolRenamedName).dir());
+            if (!resourcePath.path().endsWith(QLatin1String("Contents/MacOS")))
+                throw Error(tr("Maintenance tool is not a bundle"));
+            resourcePath.cdUp();
+            resourcePath.cd(QLatin1String("Resources"));
+            // It's a bit odd to have only the magic in the data file, but this simplifies
+            // other code a lot (since installers don't have any appended data either)
+            QTemporaryFile dataOut;
+            QInstaller::openForWrite(&dataOut);
+            QInstaller::appendInt64(&dataOut, 0);   // operations start
+            QInstaller::appendInt64(&dataOut, 0);   // operations end
+            QInstaller::appendInt64(&dataOut, 0);   // resource count
+            QInstaller::appendInt64(&dataOut, 4 * sizeof(qint64));   // data block size
+            QInstaller::appendInt64(&dataOut, BinaryContent::MagicUninstallerMarker);
+            QInstaller::appendInt64(&dataOut, BinaryContent::MagicCookie);
+
+            {
+                QFile dummy(resourcePath.filePath(QLatin1String("installer.dat")));
+                if (dummy.exists() && !dummy.remove()) {
+                    throw Error(tr("Cannot remove data file \"%1\": %2").arg(dummy.fileName(),
+                        dummy.errorString()));
+                }
+            }
+
+            if (!dataOut.rename(resourcePath.filePath(QLatin1String("installer.dat")))) {
+                throw Error(tr("Cannot write maintenance tool data to %1: %2").arg(out.fileName(),
+                    out.errorString()));
+            }
+            dataOut.setAutoRemove(false);
+            dataOut.setPermissions(dataOut.permissions() | QFile::WriteUser | QFile::ReadGroup
+                | QFile::ReadOther);
+#else
+            QInstaller::appendInt64(&out, 0);   // operations start
+            QInstaller::appendInt64(&out, 0);   // operations end
+            QInstaller::appendInt64(&out, 0);   // resource count
+            QInstaller::appendInt64(&out, 4 * sizeof(qint64));   // data block size
+            QInstaller::appendInt64(&out, BinaryContent::MagicUninstallerMarker);
+            QInstaller::appendInt64(&out, BinaryContent::MagicCookie);
+#endif
+        }
+        out.close();
+        if (out.error() != QFile::NoError) {
+            throw Error(tr("Cannot write maintenance tool to \"%1\": %2")
+                .arg(maintenanceToolRenamedName, out.errorString()));
+        }
+    } catch (...) {
+        // don't leave a partially written maintenance tool behind
+        out.close();
+        QFile::remove(maintenanceToolRenamedName);
+        throw;
     }
 
     QFile mt(maintenanceToolRenamedName);
@@ -1095,16 +1359,23 @@ void PackageManagerCorePrivate::writeMaintenanceToolBinaryData(QFileDevice *outp
         QInstaller::appendData(output, input, segment.length());
     }
 
-    const qint64 operationsStart = output->pos();
-    QInstaller::appendInt64(output, performedOperations.count());
+    QList<OperationBlob> operations;
     foreach (Operation *operation, performedOperations) {
-        QInstaller::appendString(output, operation->name());
-        QInstaller::appendString(output, operation->toXml().toString());
-
-        // for the ui not to get blocked
-        qApp->processEvents();
+        const QString component = operation->value(QLatin1String("component")).toString();
+        if (operation->isDeferred()) {
+            // untouched since it was read, write it back as is
+            operations.append(OperationBlob(operation->name(), component,
+                operation->deferredXml()));
+        } else {
+            operations.append(OperationBlob(operation->name(), component,
+                operation->toXml().toString().toUtf8()));
+            // for the ui not to get blocked
+            qApp->processEvents();
+        }
     }
-    QInstaller::appendInt64(output, performedOperations.count());
+
+    const qint64 operationsStart = output->pos();
+    BinaryContent::writeOperations(output, operations);
     const qint64 operationsEnd = output->pos();
 
     // we don't save any component-indexes.
@@ -1130,6 +1401,15 @@ void PackageManagerCorePrivate::writeMaintenanceToolBinaryData(QFileDevice *outp
 
 void PackageManagerCorePrivate::writeMaintenanceTool(OperationList performedOperations)
 {
+    if (m_disableWriteMaintenanceTool) {
+        // the performed operations are kept in memory only
+        commitSessionOperations();
+        m_needToWriteMaintenanceTool = false;
+        return;
+    }
+
+    TraceSpan span("io", "Write maintenance tool");
+
     bool gainedAdminRights = false;
     QTemporaryFile tempAdminFile(targetDir() + QLatin1String("/testjsfdjlkdsjflkdsjfldsjlfds")
         + QString::number(qrand() % 1000));
@@ -1336,8 +1616,13 @@ void PackageManagerCorePrivate::writeMaintenanceTool(OperationList performedOper
         m_core->setValue(QLatin1String("installedOperationAreSorted"), QLatin1String("true"));
 
         try {
-            QTemporaryFile file;
-            QInstaller::openForWrite(&file);
+            // next to the data file, so renaming it does not copy and unchanged resources can be
+            // shared with the input
+            QTemporaryFile file(dataFile + QLatin1String(".XXXXXX"));
+            if (!file.open()) {
+                file.setFileTemplate(QDir::tempPath() + QLatin1String("/maintenancetool.XXXXXX"));
+                QInstaller::openForWrite(&file);
+            }
 
             writeMaintenanceToolBinaryData(&file, &input, performedOperations, layout);
             QInstaller::appendInt64(&file, BinaryContent::MagicCookieDat);
@@ -1466,6 +1751,10 @@ bool PackageManagerCorePrivate::runInstaller()
         if (QVariant(remove).toBool())
             addPerformed(takeOwnedOperation(mkdirOp));
 
+        // stream the log into the target directory from now on instead of collecting it, unless
+        // that needs admin rights; then the log is written at the end with the admin output
+        VerboseWriter::instance()->setFileName(logFilePath());
+
         // to show that there was some work
         ProgressCoordinator::instance()->addManualPercentagePoints(1);
         ProgressCoordinator::instance()->emitLabelAndDetailTextChanged(tr("Preparing the installation..."));
@@ -1494,10 +1783,14 @@ bool PackageManagerCorePrivate::runInstaller()
 
         const double downloadPartProgressSize = double(1) / double(3);
         double componentsInstallPartProgressSize = double(2) / double(3);
-        const int downloadedArchivesCount = m_core->downloadNeededArchives(downloadPartProgressSize);
+        int downloadedArchivesCount = 0;
+        if (m_data.settings().extractWhileDownloading())
+            startArchivesDownload(componentsToInstall, downloadPartProgressSize);
+        else
+            downloadedArchivesCount = m_core->downloadNeededArchives(downloadPartProgressSize);
 
         // if there was no download we have the whole progress for installing components
-        if (!downloadedArchivesCount)
+        if (!downloadedArchivesCount && !m_archivesJob)
             componentsInstallPartProgressSize = double(1);
 
         // Force an update on the components xml as the install dir might have changed.
@@ -1509,13 +1802,19 @@ bool PackageManagerCorePrivate::runInstaller()
             m_data.settings().applicationName()).toString());
         m_localPackageHub->setApplicationVersion(QLatin1String(QUOTE(IFW_REPOSITORY_FORMAT_VERSION)));
 
-        const int progressOperationCount = countProgressOperations(componentsToInstall)
-            // add one more operation as we support progress
-            + (PackageManagerCore::createLocalRepositoryFromBinary() ? 1 : 0);
-        double progressOperationSize = componentsInstallPartProgressSize / progressOperationCount;
+        double progressOperationSize = 0;
+        if (m_archivesJob) {
+            // operations can only be created once the archives are present, split per component
+            progressOperationSize = componentsInstallPartProgressSize / componentsToInstall.count();
+        } else {
+            const int progressOperationCount = countProgressOperations(componentsToInstall)
+                // add one more operation as we support progress
+                + (PackageManagerCore::createLocalRepositoryFromBinary() ? 1 : 0);
+            progressOperationSize = componentsInstallPartProgressSize / progressOperationCount;
+        }
 
-        foreach (Component *component, componentsToInstall)
-            installComponent(component, progressOperationSize, adminRightsGained);
+        installComponents(componentsToInstall, progressOperationSize, adminRightsGained);
+        finishArchivesDownload();
 
         if (m_core->isOfflineOnly() && PackageManagerCore::createLocalRepositoryFromBinary()) {
             emit m_core->titleMessageChanged(tr("Creating local repository"));
@@ -1580,6 +1879,7 @@ bool PackageManagerCorePrivate::runInstaller()
         setStatus(PackageManagerCore::Success);
         emit installationFinished();
     } catch (const Error &err) {
+        abortArchivesDownload();
         if (m_core->status() != PackageManagerCore::Canceled) {
             setStatus(PackageManagerCore::Failure);
             MessageBoxHandler::critical(MessageBoxHandler::currentBestSuitParent(),
@@ -1587,6 +1887,8 @@ bool PackageManagerCorePrivate::runInstaller()
             qDebug() << "ROLLING BACK operations=" << m_performedOperationsCurrentSession.count();
         }
 
+        // take the log back out of the target directory, the roll back may remove it
+        VerboseWriter::instance()->releaseFile();
         m_core->rollBackInstallation();
 
         ProgressCoordinator::instance()->emitLabelAndDetailTextChanged(tr("\nInstallation aborted!"));
@@ -1615,6 +1917,8 @@ bool PackageManagerCorePrivate::runPackageUpdater()
         if (!QTemporaryFile(targetDir() + QStringLiteral("/XXXXXX")).open())
             adminRightsGained = m_core->gainAdminRights();
 
+        VerboseWriter::instance()->setFileName(logFilePath());
+
         const QList<Component *> componentsToInstall = m_core->orderedComponentsToInstall();
         qDebug() << "Install size:" << componentsToInstall.size() << "components";
 
@@ -1690,6 +1994,9 @@ bool PackageManagerCorePrivate::runPackageUpdater()
                 Q_ASSERT_X(false, Q_FUNC_INFO, "Invalid package manager mode!");
             }
 
+            // the operation is about to be undone, restore it once instead of for every value read
+            operation->restoreDeferredXml();
+
             // Filter out the create target dir undo operation, it's only needed for full uninstall.
             // Note: We filter for unnamed operations as well, since old installations had the remove target
             //  dir operation without the "uninstall-only", which will result in a complete uninstallation
@@ -1722,8 +2029,12 @@ bool PackageManagerCorePrivate::runPackageUpdater()
 
         ProgressCoordinator::instance()->emitLabelAndDetailTextChanged(tr("Preparing the installation..."));
 
-        // following, we download the needed archives
-        m_core->downloadNeededArchives(downloadPartProgressSize);
+        // following, we download the needed archives, with ExtractWhileDownloading in the
+        // background, so the undo operations and the first components run meanwhile
+        if (m_data.settings().extractWhileDownloading())
+            startArchivesDownload(componentsToInstall, downloadPartProgressSize);
+        else
+            m_core->downloadNeededArchives(downloadPartProgressSize);
 
         if (undoOperations.count() > 0) {
             ProgressCoordinator::instance()->emitLabelAndDetailTextChanged(tr("Removing deselected components..."));
@@ -1731,11 +2042,17 @@ bool PackageManagerCorePrivate::runPackageUpdater()
         }
         m_performedOperationsOld = nonRevertedOperations; // these are all operations left: those not reverted
 
-        const double progressOperationCount = countProgressOperations(componentsToInstall);
-        const double progressOperationSize = componentsInstallPartProgressSize / progressOperationCount;
+        double progressOperationSize = 0;
+        if (m_archivesJob) {
+            // operations can only be created once the archives are present, split per component
+            progressOperationSize = componentsInstallPartProgressSize / componentsToInstall.count();
+        } else {
+            const double progressOperationCount = countProgressOperations(componentsToInstall);
+            progressOperationSize = componentsInstallPartProgressSize / progressOperationCount;
+        }
 
-        foreach (Component *component, componentsToInstall)
-            installComponent(component, progressOperationSize, adminRightsGained);
+        installComponents(componentsToInstall, progressOperationSize, adminRightsGained);
+        finishArchivesDownload();
 
         emit m_core->titleMessageChanged(tr("Creating Maintenance Tool"));
 
@@ -1754,6 +2071,7 @@ bool PackageManagerCorePrivate::runPackageUpdater()
         setStatus(PackageManagerCore::Success);
         emit installationFinished();
     } catch (const Error &err) {
+        abortArchivesDownload();
         if (m_core->status() != PackageManagerCore::Canceled) {
             setStatus(PackageManagerCore::Failure);
             MessageBoxHandler::critical(MessageBoxHandler::currentBestSuitParent(),
@@ -1791,6 +2109,7 @@ bool PackageManagerCorePrivate::runUninstaller()
         bool updateAdminRights = false;
         if (!adminRightsGained) {
             foreach (Operation *op, m_performedOperationsOld) {
+                op->restoreDeferredXml(); // it is undone right after anyway
                 updateAdminRights |= op->value(QLatin1String("admin")).toBool();
                 if (updateAdminRights)
                     break;  // an operation needs elevation to be able to perform their undo
@@ -1809,7 +2128,8 @@ bool PackageManagerCorePrivate::runUninstaller()
         runUndoOperations(undoOperations, undoOperationProgressSize, adminRightsGained, false);
         // No operation delete here, as all old undo operations are deleted in the destructor.
 
-        deleteMaintenanceTool();    // this will also delete the TargetDir on Windows
+        if (!m_disableWriteMaintenanceTool)
+            deleteMaintenanceTool();    // this will also delete the TargetDir on Windows
 
         // If not on Windows, we need to remove TargetDir manually.
         if (QVariant(m_core->value(scRemoveTargetDir)).toBool() && !targetDir().isEmpty()) {
@@ -1829,6 +2149,7 @@ bool PackageManagerCorePrivate::runUninstaller()
                 QLatin1String("installationError"), tr("Error"), err.message());
         }
     }
+    Lib7z::clearArchiveCache();
 
     const bool success = (m_core->status() == PackageManagerCore::Success);
     if (adminRightsGained)
@@ -1866,14 +2187,21 @@ void PackageManagerCorePrivate::installComponent(Component *component, double pr
             qDebug() << operation->name() << "as admin:" << becameAdmin;
         }
 
-        connectOperationToInstaller(operation, progressOperationSize);
-        connectOperationCallMethodRequest(operation);
+        bool ok = false;
+        if (m_scheduledOperations.contains(operation)) {
+            // already started by installComponents(), backup included
+            ok = waitForOperationFuture(m_scheduledOperations.take(operation));
+        } else {
+            connectOperationToInstaller(operation, progressOperationSize);
+            connectOperationCallMethodRequest(operation);
 
-        // allow the operation to backup stuff before performing the operation
-        performOperationThreaded(operation, PackageManagerCorePrivate::Backup);
+            // allow the operation to backup stuff before performing the operation
+            performOperationThreaded(operation, PackageManagerCorePrivate::Backup);
+
+            ok = performOperationThreaded(operation);
+        }
 
         bool ignoreError = false;
-        bool ok = performOperationThreaded(operation);
         while (!ok && !ignoreError && m_core->status() != PackageManagerCore::Canceled) {
             qDebug() << QString::fromLatin1("Operation \"%1\" with arguments \"%2\" failed: %3")
                 .arg(operation->name(), operation->arguments().join(QLatin1String("; ")),
@@ -1932,14 +2260,371 @@ void PackageManagerCorePrivate::installComponent(Component *component, double pr
                                   component->value(scUncompressedSize).toULongLong(),
                                   component->value(scInheritVersion),
                                   component->isCheckable());
-    m_localPackageHub->writeToDisk();
+    m_localPackageHub->writeJournal();
 
     component->setInstalled();
     component->markAsPerformedInstallation();
 }
 
+/*!
+    Installs \a components in the given order. While a component is being installed, the leading
+    \c Extract operations of following components whose dependencies are already installed, and
+    whose files no component in front of them touches, get started on a bounded thread pool, so
+    that several archives are decompressed at the same time.
+    The operations are still registered as performed in component order, which keeps progress,
+    rollback and the stored operation list deterministic.
+*/
+void PackageManagerCorePrivate::installComponents(const QList<Component*> &components,
+    double progressOperationSize, bool adminRightsGained)
+{
+    QSet<QString> pendingComponents;
+    foreach (Component *component, components)
+        pendingComponents.insert(component->name());
+
+    try {
+        for (int i = 0; i < components.count(); ++i) {
+            Component *component = components.at(i);
+            while (hasPendingArchives(component)) {
+                // install what is already downloaded while waiting for the archives
+                scheduleExtractOperations(components, i, pendingComponents, progressOperationSize);
+                waitForArchivesDownload(component);
+            }
+            scheduleExtractOperations(components, i + 1, pendingComponents, progressOperationSize);
+            installComponent(component, operationProgressSize(component, progressOperationSize),
+                adminRightsGained);
+            pendingComponents.remove(component->name());
+        }
+    } catch (const Error &) {
+        collectScheduledOperations(components);
+        releaseOperationTargets();
+        throw;
+    }
+    m_scheduledComponents.clear();
+    releaseOperationTargets();
+    // compact the journal written by installComponent() into the components file
+    m_localPackageHub->writeToDisk();
+}
+
+/*!
+    Creates a job that downloads the archives of \a components, or returns \c 0 if there is
+    nothing to download. The job reports its progress as \a partProgressSize of the overall
+    progress. The caller takes ownership of the job.
+*/
+DownloadArchivesJob *PackageManagerCorePrivate::createDownloadArchivesJob(
+    const QList<Component*> &components, double partProgressSize)
+{
+    QList<QPair<QString, QString> > archivesToDownload;
+    foreach (Component *component, components) {
+        // collect all archives to be downloaded
+        const QStringList toDownload = component->downloadableArchives();
+        foreach (const QString &versionFreeString, toDownload) {
+            archivesToDownload.push_back(qMakePair(QString::fromLatin1("installer://%1/%2")
+                .arg(component->name(), versionFreeString), QString::fromLatin1("%1/%2/%3")
+                .arg(component->repositoryUrl().toString(), component->name(), versionFreeString)));
+        }
+    }
+
+    if (archivesToDownload.isEmpty())
+        return 0;
+
+    ProgressCoordinator::instance()->emitLabelAndDetailTextChanged(tr("\nDownloading packages..."));
+
+    DownloadArchivesJob *archivesJob = new DownloadArchivesJob(m_core);
+    archivesJob->setAutoDelete(false);
+    archivesJob->setArchivesToDownload(archivesToDownload);
+    connect(m_core, &PackageManagerCore::installationInterrupted, archivesJob, &Job::cancel);
+    connect(archivesJob, &DownloadArchivesJob::outputTextChanged,
+            ProgressCoordinator::instance(), &ProgressCoordinator::emitLabelAndDetailTextChanged);
+    connect(archivesJob, &DownloadArchivesJob::downloadStatusChanged,
+            ProgressCoordinator::instance(), &ProgressCoordinator::downloadStatusChanged);
+
+    ProgressCoordinator::instance()->registerPartProgress(archivesJob,
+        SIGNAL(progressChanged(double)), partProgressSize);
+
+    return archivesJob;
+}
+
+/*!
+    Waits until \a archivesJob has finished and throws if it failed or got canceled.
+*/
+void PackageManagerCorePrivate::finishDownloadArchivesJob(DownloadArchivesJob *archivesJob)
+{
+    if (!archivesJob->isFinished())
+        archivesJob->waitForFinished();
+
+    if (archivesJob->error() == Job::Canceled)
+        m_core->interrupt();
+    else if (archivesJob->error() != Job::NoError)
+        throw Error(archivesJob->errorString());
+
+    if (statusCanceledOrFailed())
+        throw Error(tr("Installation canceled by user."));
+
+    ProgressCoordinator::instance()->emitDownloadStatus(tr("All downloads finished."));
+}
+
+/*!
+    Starts downloading the archives of \a components in the background. installComponents() waits
+    for the archives of each component before installing it, so components can be installed while
+    the archives of later ones are still being downloaded.
+*/
+void PackageManagerCorePrivate::startArchivesDownload(const QList<Component*> &components,
+    double partProgressSize)
+{
+    Q_ASSERT(!m_archivesJob);
+    m_archivesJob = createDownloadArchivesJob(components, partProgressSize);
+    if (m_archivesJob)
+        m_archivesJob->start();
+}
+
+/*!
+    Waits for the background download started by startArchivesDownload() to finish and throws if
+    it failed.
+*/
+void PackageManagerCorePrivate::finishArchivesDownload()
+{
+    QScopedPointer<DownloadArchivesJob> archivesJob(m_archivesJob);
+    m_archivesJob = 0;
+    if (!archivesJob.isNull())
+        finishDownloadArchivesJob(archivesJob.data());
+}
+
+/*!
+    Cancels the background download started by startArchivesDownload(), if any.
+*/
+void PackageManagerCorePrivate::abortArchivesDownload()
+{
+    QScopedPointer<DownloadArchivesJob> archivesJob(m_archivesJob);
+    m_archivesJob = 0;
+    if (!archivesJob.isNull() && !archivesJob->isFinished())
+        archivesJob->cancel();
+}
+
 // -- private
 
+/*!
+    Starts the leading \c Extract operations of the components in \a components beginning at
+    index \a from, as long as none of their dependencies is part of \a pendingComponents and none
+    of the files they extract is touched by an operation of a component in front of them that is
+    not yet installed. That keeps the last writer of every path the same as in a serial
+    installation. At most as many components as the extraction thread pool has threads are kept
+    in flight, and only a limited number of components ahead is looked at.
+*/
+void PackageManagerCorePrivate::scheduleExtractOperations(const QList<Component*> &components,
+    int from, const QSet<QString> &pendingComponents, double progressOperationSize)
+{
+    if (m_extractThreadPool.maxThreadCount() < 2)
+        return;
+
+    // paths written by the not yet installed components in front of the candidate, and all
+    // their parent directories; from - 1 is the component being installed right now
+    QSet<QString> earlierPaths;
+    QSet<QString> earlierParents;
+    const int end = qMin(components.count(), from + 4 * m_extractThreadPool.maxThreadCount());
+    for (int i = qMax(0, from - 1); i < end; ++i) {
+        if (m_scheduledOperations.count() >= m_extractThreadPool.maxThreadCount())
+            return;
+
+        Component *component = components.at(i);
+        if (!pendingComponents.contains(component->name()))
+            continue;
+        if (hasPendingArchives(component))
+            return; // what it writes is unknown until its archives arrive
+        const OperationTargets &targets = operationTargets(component);
+        if (!targets.listings.isEmpty())
+            return; // its archives are still being listed, it might write anything
+
+        if (i >= from && !m_scheduledComponents.contains(component)
+            && component->operationsCreatedSuccessfully()) {
+                bool schedule = true;
+                foreach (const DependencyConstraint &constraint, registeredDependencies(component)) {
+                    if (pendingComponents.contains(constraint.name)) {
+                        schedule = false;
+                        break;
+                    }
+                }
+                foreach (const QString &path, targets.extractedPaths) {
+                    if (!schedule)
+                        break;
+                    schedule = !overlapsTargets(path, earlierPaths, earlierParents);
+                }
+                if (schedule)
+                    startExtractOperations(component, progressOperationSize);
+        }
+
+        if (targets.unbounded)
+            return; // nothing behind it may be reordered
+        foreach (const QString &path, targets.paths) {
+            earlierPaths.insert(path);
+            for (int index = path.lastIndexOf(QLatin1Char('/')); index > 0;
+                index = path.lastIndexOf(QLatin1Char('/'), index - 1)) {
+                    const QString parent = path.left(index);
+                    if (earlierParents.contains(parent))
+                        break;
+                    earlierParents.insert(parent);
+            }
+        }
+    }
+}
+
+void PackageManagerCorePrivate::startExtractOperations(Component *component,
+    double progressOperationSize)
+{
+    m_scheduledComponents.insert(component);
+    const double operationSize = operationProgressSize(component, progressOperationSize);
+    foreach (Operation *operation, component->operations()) {
+        if (!isConcurrentExtractOperation(operation))
+            break;  // keep the order with respect to the component's other operations
+
+        connectOperationToInstaller(operation, operationSize);
+        connectOperationCallMethodRequest(operation);
+        m_scheduledOperations.insert(operation, QtConcurrent::run(&m_extractThreadPool,
+            backupAndPerformOperation, operation));
+    }
+}
+
+/*!
+    \internal
+
+    Returns the paths the operations of \a component write to. Files of archives extracted by
+    the leading \c Extract operations are listed separately, because only those operations get
+    started ahead of their component. Directories inside the archives are left out, creating the
+    same directory twice does not depend on the order. If an operation can write anywhere, like
+    \c Execute, the targets are marked unbounded.
+
+    The archives are listed on a worker thread. Until all listings of \a component are done,
+    the returned targets still hold them in \c listings and must be treated as unbounded.
+*/
+const PackageManagerCorePrivate::OperationTargets &PackageManagerCorePrivate::operationTargets(
+    Component *component)
+{
+    QHash<Component*, OperationTargets>::iterator it = m_operationTargets.find(component);
+    if (it == m_operationTargets.end()) {
+        OperationTargets targets;
+        bool leading = true;
+        foreach (Operation *operation, component->operations()) {
+            leading = leading && isConcurrentExtractOperation(operation);
+            const QStringList arguments = operation->arguments();
+            if (operation->name() == QLatin1String("Extract") && arguments.count() >= 2) {
+                targets.listings.append(QtConcurrent::run(listExtractedFiles, arguments.at(0),
+                    normalizedTargetPath(arguments.at(1))));
+                if (leading)
+                    ++targets.leadingListings;
+            } else if (operation->name() == QLatin1String("Execute")) {
+                targets.unbounded = true;
+            } else if (operation->name() != QLatin1String("Mkdir")
+                && operation->name() != QLatin1String("MinimumProgress")) {
+                    foreach (const QString &argument, arguments) {
+                        if (!argument.isEmpty() && QDir::isAbsolutePath(argument))
+                            targets.paths.append(normalizedTargetPath(argument));
+                    }
+            }
+        }
+        it = m_operationTargets.insert(component, targets);
+    }
+
+    OperationTargets &targets = it.value();
+    foreach (const QFuture<QStringList> &listing, targets.listings) {
+        if (!listing.isFinished())
+            return targets;
+    }
+    for (int i = 0; i < targets.listings.count(); ++i) {
+        const QStringList paths = targets.listings.at(i).result();
+        if (i < targets.leadingListings)
+            targets.extractedPaths.append(paths);
+        targets.paths.append(paths);
+    }
+    targets.listings.clear();
+    targets.leadingListings = 0;
+    return targets;
+}
+
+/*!
+    Forgets the targets found by operationTargets() and closes the archives that were kept open
+    while listing and extracting them, so their files can be removed. Waits for listings still
+    running, as they would open their archives again.
+*/
+void PackageManagerCorePrivate::releaseOperationTargets()
+{
+    foreach (const OperationTargets &targets, m_operationTargets) {
+        foreach (QFuture<QStringList> listing, targets.listings)
+            listing.waitForFinished();
+    }
+    m_operationTargets.clear();
+    Lib7z::clearArchiveCache();
+}
+
+/*!
+    Waits for all operations started by scheduleExtractOperations() that were not yet handled by
+    installComponent() and registers them as performed, so that a following rollback removes the
+    extracted files as well. The order of \a components is kept.
+*/
+void PackageManagerCorePrivate::collectScheduledOperations(const QList<Component*> &components)
+{
+    foreach (Component *component, components) {
+        if (m_scheduledOperations.isEmpty())
+            break;
+        if (!m_scheduledComponents.contains(component))
+            continue;
+
+        foreach (Operation *operation, component->operations()) {
+            if (!m_scheduledOperations.contains(operation))
+                continue;
+            const bool ok = waitForOperationFuture(m_scheduledOperations.take(operation));
+            if (ok || operation->error() > Operation::InvalidArguments)
+                addPerformed(operation);
+        }
+    }
+    m_scheduledOperations.clear();
+    m_scheduledComponents.clear();
+}
+
+/*!
+    Returns \c true if archives of \a component are still being downloaded in the background.
+*/
+bool PackageManagerCorePrivate::hasPendingArchives(Component *component) const
+{
+    return m_archivesJob && m_archivesJob->hasPendingArchives(component->name());
+}
+
+/*!
+    Waits until the background download registered the archives of one more component. Throws
+    if the download failed or got canceled, or if it finished without the archives of
+    \a component, since those would never arrive.
+*/
+void PackageManagerCorePrivate::waitForArchivesDownload(Component *component)
+{
+    if (!m_archivesJob->isFinished()) {
+        QEventLoop loop;
+        connect(m_archivesJob, &DownloadArchivesJob::archivesDownloaded, &loop, &QEventLoop::quit);
+        connect(m_archivesJob, &Job::finished, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+
+    if (!m_archivesJob->isFinished())
+        return;
+    const bool archivesMissing = hasPendingArchives(component);
+    if (m_archivesJob->error() != Job::NoError)
+        finishArchivesDownload();
+    if (archivesMissing) {
+        throw Error(tr("Cannot download the archives of component %1.")
+            .arg(component->name()));
+    }
+}
+
+/*!
+    Returns the progress share of each operation of \a component. While archives are downloaded
+    in the background, \a progressOperationSize is the share of the whole component, since its
+    operations can only be counted once its archives are present.
+*/
+double PackageManagerCorePrivate::operationProgressSize(Component *component,
+    double progressOperationSize)
+{
+    if (!m_archivesJob)
+        return progressOperationSize;
+    return progressOperationSize / qMax(1, countProgressOperations(component->operations()));
+}
+
 void PackageManagerCorePrivate::deleteMaintenanceTool()
 {
 #ifdef Q_OS_WIN
@@ -1977,7 +2662,8 @@ void PackageManagerCorePrivate::deleteMaintenanceTool()
     arguments << QLatin1String("//Nologo") << batchfile; // execute the batchfile
     arguments << QDir::toNativeSeparators(QFileInfo(installerBinaryPath()).absoluteFilePath());
     if (!m_performedOperationsOld.isEmpty()) {
-        const Operation *const op = m_performedOperationsOld.first();
+        Operation *const op = m_performedOperationsOld.first();
+        op->restoreDeferredXml();
         if (op->name() == QLatin1String("Mkdir")) // the target directory name
             arguments << QDir::toNativeSeparators(QFileInfo(op->arguments().first()).absoluteFilePath());
     }
@@ -2059,11 +2745,21 @@ void PackageManagerCorePrivate::unregisterMaintenanceTool()
 void PackageManagerCorePrivate::runUndoOperations(const OperationList &undoOperations, double progressSize,
     bool adminRightsGained, bool deleteOperation)
 {
+    // Removing the files of a component may continue in the background while the operations of
+    // components that are not related to it are undone.
+    const QHash<QString, QSet<QString> > related = m_extractThreadPool.maxThreadCount() > 1
+        ? relatedComponents() : QHash<QString, QSet<QString> >();
+    OperationList scheduled;
+
     try {
         foreach (Operation *undoOperation, undoOperations) {
             if (statusCanceledOrFailed())
                 throw Error(tr("Installation canceled by user"));
 
+            const QString componentName = undoOperation->value(QLatin1String("component")).toString();
+            finishScheduledUndoOperations(&scheduled, componentName, related, deleteOperation);
+            undoOperation->restoreDeferredXml();
+
             bool becameAdmin = false;
             if (!adminRightsGained && undoOperation->value(QLatin1String("admin")).toBool())
                 becameAdmin = m_core->gainAdminRights();
@@ -2071,49 +2767,136 @@ void PackageManagerCorePrivate::runUndoOperations(const OperationList &undoOpera
             connectOperationToInstaller(undoOperation, progressSize);
             qDebug() << "undo operation=" << undoOperation->name();
 
-            bool ignoreError = false;
-            bool ok = performOperationThreaded(undoOperation, PackageManagerCorePrivate::Undo);
-
-            const QString componentName = undoOperation->value(QLatin1String("component")).toString();
-
-            if (!componentName.isEmpty()) {
-                while (!ok && !ignoreError && m_core->status() != PackageManagerCore::Canceled) {
-                    const QMessageBox::StandardButton button =
-                        MessageBoxHandler::warning(MessageBoxHandler::currentBestSuitParent(),
-                        QLatin1String("installationErrorWithRetry"), tr("Installer Error"),
-                        tr("Error during uninstallation process:\n%1").arg(undoOperation->errorString()),
-                        QMessageBox::Retry | QMessageBox::Ignore, QMessageBox::Retry);
-
-                    if (button == QMessageBox::Retry)
-                        ok = performOperationThreaded(undoOperation, Undo);
-                    else if (button == QMessageBox::Ignore)
-                        ignoreError = true;
-                }
-                Component *component = m_core->componentByName(componentName);
-                if (!component)
-                    component = componentsToReplace().value(componentName).second;
-                if (component) {
-                    component->setUninstalled();
-                    m_localPackageHub->removePackage(component->name());
+            if (related.contains(componentName) && isConcurrentExtractOperation(undoOperation)) {
+                if (scheduled.count() >= m_extractThreadPool.maxThreadCount()) {
+                    Operation *oldest = scheduled.takeFirst();
+                    finishUndoOperation(oldest, waitForOperationFuture(m_scheduledOperations
+                        .take(oldest)), deleteOperation);
                 }
+                scheduled.append(undoOperation);
+                m_scheduledOperations.insert(undoOperation, QtConcurrent::run(&m_extractThreadPool,
+                    runOperation, undoOperation, PackageManagerCorePrivate::Undo));
+                continue;
             }
 
+            const bool ok = performOperationThreaded(undoOperation, PackageManagerCorePrivate::Undo);
+            finishUndoOperation(undoOperation, ok, deleteOperation);
+
             if (becameAdmin)
                 m_core->dropAdminRights();
-
-            if (deleteOperation)
-                delete undoOperation;
         }
+        finishScheduledUndoOperations(&scheduled, QString(), related, deleteOperation);
     } catch (const Error &error) {
+        finishScheduledUndoOperations(&scheduled, QString(), related, deleteOperation);
         m_localPackageHub->writeToDisk();
         throw Error(error.message());
     } catch (...) {
+        finishScheduledUndoOperations(&scheduled, QString(), related, deleteOperation);
         m_localPackageHub->writeToDisk();
         throw Error(tr("Unknown error"));
     }
     m_localPackageHub->writeToDisk();
 }
 
+/*!
+    Handles the result \a ok of undoing \a undoOperation. If the operation failed, the user is
+    asked whether to retry it. The component of the operation is marked as uninstalled and
+    \a undoOperation is deleted if \a deleteOperation is \c true.
+*/
+void PackageManagerCorePrivate::finishUndoOperation(Operation *undoOperation, bool ok,
+    bool deleteOperation)
+{
+    const QString componentName = undoOperation->value(QLatin1String("component")).toString();
+
+    if (!componentName.isEmpty()) {
+        bool ignoreError = false;
+        while (!ok && !ignoreError && m_core->status() != PackageManagerCore::Canceled) {
+            const QMessageBox::StandardButton button =
+                MessageBoxHandler::warning(MessageBoxHandler::currentBestSuitParent(),
+                QLatin1String("installationErrorWithRetry"), tr("Installer Error"),
+                tr("Error during uninstallation process:\n%1").arg(undoOperation->errorString()),
+                QMessageBox::Retry | QMessageBox::Ignore, QMessageBox::Retry);
+
+            if (button == QMessageBox::Retry)
+                ok = performOperationThreaded(undoOperation, Undo);
+            else if (button == QMessageBox::Ignore)
+                ignoreError = true;
+        }
+        Component *component = m_core->componentByName(componentName);
+        if (!component)
+            component = componentsToReplace().value(componentName).second;
+        if (component) {
+            component->setUninstalled();
+            m_localPackageHub->removePackage(component->name());
+        }
+    }
+
+    if (deleteOperation)
+        delete undoOperation;
+}
+
+/*!
+    Waits for the operations in \a scheduled that were started by runUndoOperations() and must
+    be undone before the operations of \a componentName, and removes them from \a scheduled.
+    These are the operations of the component itself and of all components that are in
+    \a relatedComponents of it. If \a componentName is empty or unknown, waits for all of them.
+*/
+void PackageManagerCorePrivate::finishScheduledUndoOperations(OperationList *scheduled,
+    const QString &componentName, const QHash<QString, QSet<QString> > &relatedComponents,
+    bool deleteOperation)
+{
+    const bool waitForAll = !relatedComponents.contains(componentName);
+    const QSet<QString> related = relatedComponents.value(componentName);
+
+    for (int i = 0; i < scheduled->count();) {
+        Operation *undoOperation = scheduled->at(i);
+        const QString name = undoOperation->value(QLatin1String("component")).toString();
+        if (!waitForAll && name != componentName && !related.contains(name)) {
+            ++i;
+            continue;
+        }
+        scheduled->removeAt(i);
+        finishUndoOperation(undoOperation, waitForOperationFuture(m_scheduledOperations
+            .take(undoOperation)), deleteOperation);
+    }
+}
+
+/*!
+    Returns for each known component the names of all components it depends on or that depend
+    on it, directly or indirectly. Operations of related components are never undone at the
+    same time.
+*/
+QHash<QString, QSet<QString> > PackageManagerCorePrivate::relatedComponents() const
+{
+    QHash<QString, QStringList> dependencies;
+    {
+        QMutexLocker _(&m_componentRegistryMutex);
+        updateComponentRegistry();
+        for (auto it = m_dependencies.constBegin(); it != m_dependencies.constEnd(); ++it) {
+            QStringList &names = dependencies[it.key()->name()];
+            foreach (const DependencyConstraint &constraint, it.value())
+                names.append(constraint.name);
+        }
+    }
+
+    QHash<QString, QSet<QString> > related;
+    for (auto it = dependencies.constBegin(); it != dependencies.constEnd(); ++it) {
+        QSet<QString> reachable;
+        QStringList pending = it.value();
+        while (!pending.isEmpty()) {
+            const QString dependency = pending.takeLast();
+            if (dependency == it.key() || reachable.contains(dependency))
+                continue;
+            reachable.insert(dependency);
+            pending.append(dependencies.value(dependency));
+        }
+        related[it.key()].unite(reachable);
+        foreach (const QString &dependency, reachable)
+            related[dependency].insert(it.key());
+    }
+    return related;
+}
+
 PackagesList PackageManagerCorePrivate::remotePackages()
 {
     if (m_updates && m_updateFinder)
@@ -2299,30 +3082,19 @@ bool PackageManagerCorePrivate::addUpdateResourcesFromRepositories(bool parseChe
             continue;
 
         if (parseChecksum) {
-            const QString updatesXmlPath = data.directory + QLatin1String("/Updates.xml");
-            QFile updatesFile(updatesXmlPath);
-            try {
-                QInstaller::openForRead(&updatesFile);
-            } catch(const Error &e) {
-                qDebug() << "Error opening Updates.xml:" << e.message();
-                setStatus(PackageManagerCore::Failure, tr("Cannot add temporary update source information."));
-                return false;
-            }
-
-            int line = 0;
-            int column = 0;
-            QString error;
-            QDomDocument doc;
-            if (!doc.setContent(&updatesFile, &error, &line, &column)) {
-                qDebug().nospace() << "Parse error in file" << updatesFile.fileName()
-                                   << ": " << error << " at line " << line << " col " << column;
+            // shares the index MetadataJob already read for this repository
+            KDUpdater::UpdatesInfo updatesInfo;
+            updatesInfo.setFileName(data.directory + QLatin1String("/Updates.xml"));
+            if (updatesInfo.error() == KDUpdater::UpdatesInfo::CouldNotReadUpdateInfoFileError
+                    || updatesInfo.error() == KDUpdater::UpdatesInfo::InvalidXmlError) {
+                qDebug().noquote() << "Error reading Updates.xml:" << updatesInfo.errorString();
                 setStatus(PackageManagerCore::Failure, tr("Cannot add temporary update source information."));
                 return false;
             }
 
-            const QDomNode checksum = doc.documentElement().firstChildElement(QLatin1String("Checksum"));
+            const QString checksum = updatesInfo.value(QLatin1String("Checksum"));
             if (!checksum.isNull())
-                m_core->setTestChecksum(checksum.toElement().text().toLower() == scTrue);
+                m_core->setTestChecksum(checksum.toLower() == scTrue);
         }
         if (compressedRepository)
             m_compressedPackageSources.insert(PackageSource(QUrl::fromLocalFile(data.directory), 1));
@@ -2398,8 +3170,8 @@ OperationList PackageManagerCorePrivate::sortOperationsBasedOnComponentDependenc
 
     const QStringList resolvedComponents = componentGraph.sort();
     if (componentGraph.hasCycle()) {
-        throw Error(tr("Dependency cycle between components \"%1\" and \"%2\" detected.")
-            .arg(componentGraph.cycle().first, componentGraph.cycle().second));
+        throw Error(tr("Dependency cycle between components detected: %1.")
+            .arg(componentGraph.cycleNodes().join(QLatin1String(" -> "))));
     }
     foreach (const QString &componentName, resolvedComponents)
         sortedOperations.append(componentOperationHash.value(componentName));
@@ -40,6 +40,9 @@
 #include "updatefinder.h"
 
 #include <QObject>
+#include <QFuture>
+#include <QMutex>
+#include <QThreadPool>
 
 class Job;
 
@@ -53,6 +56,7 @@ namespace QInstaller {
 
 struct BinaryLayout;
 class Component;
+class DownloadArchivesJob;
 class ScriptEngine;
 class ComponentModel;
 class TempDirDeleter;
@@ -73,6 +77,23 @@ public:
         Undo
     };
 
+    // a dependency of a component, split into the name and the version requirement
+    struct DependencyConstraint
+    {
+        DependencyConstraint() : component(0), automatic(false) {}
+
+        static DependencyConstraint parse(Component *component, const QString &requirement,
+            bool automatic = false);
+        void setVersionRequirement(const QString &requirement);
+        bool matches(const QString &version) const;
+
+        Component *component; // the component declaring the dependency
+        QString name;
+        QString comparator; // any combination of <, = and >, empty if there is no version
+        QString version;
+        bool automatic; // declared as AutoDependOn instead of Dependencies
+    };
+
     explicit PackageManagerCorePrivate(PackageManagerCore *core);
     explicit PackageManagerCorePrivate(PackageManagerCore *core, qint64 magicInstallerMaker,
         const QList<OperationBlob> &performedOperations);
@@ -91,6 +112,7 @@ public:
 
     QString targetDir() const;
     QString registerPath();
+    QString logFilePath() const;
 
     QString maintenanceToolName() const;
     QString installerBinaryPath() const;
@@ -114,6 +136,11 @@ public:
     QList<Component*> &replacementDependencyComponents();
     QHash<QString, QPair<Component*, Component*> > &componentsToReplace();
 
+    void invalidateComponentRegistry();
+    Component *registeredComponent(const QString &name) const;
+    QList<DependencyConstraint> registeredDependees(const QString &name) const;
+    QList<DependencyConstraint> registeredDependencies(const Component *component) const;
+
     void clearInstallerCalculator();
     InstallerCalculator *installerCalculator() const;
 
@@ -161,6 +188,16 @@ public:
 
     void installComponent(Component *component, double progressOperationSize,
         bool adminRightsGained = false);
+    void installComponents(const QList<Component*> &components, double progressOperationSize,
+        bool adminRightsGained = false);
+
+    DownloadArchivesJob *createDownloadArchivesJob(const QList<Component*> &components,
+        double partProgressSize);
+    void finishDownloadArchivesJob(DownloadArchivesJob *archivesJob);
+
+    void startArchivesDownload(const QList<Component*> &components, double partProgressSize);
+    void finishArchivesDownload();
+    void abortArchivesDownload();
 
 signals:
     void installationStarted();
@@ -184,6 +221,7 @@ public:
     bool m_launchedAsRoot;
     bool m_completeUninstall;
     bool m_needToWriteMaintenanceTool;
+    bool m_disableWriteMaintenanceTool;
     PackageManagerCoreData m_data;
     QHash<QString, bool> m_sharedFlags;
     QString m_installerBaseBinaryUnreplaced;
@@ -226,6 +264,33 @@ private:
 
     void runUndoOperations(const OperationList &undoOperations, double undoOperationProgressSize,
         bool adminRightsGained, bool deleteOperation);
+    void finishUndoOperation(Operation *undoOperation, bool ok, bool deleteOperation);
+    void finishScheduledUndoOperations(OperationList *scheduled, const QString &componentName,
+        const QHash<QString, QSet<QString> > &relatedComponents, bool deleteOperation);
+    QHash<QString, QSet<QString> > relatedComponents() const;
+
+    struct OperationTargets
+    {
+        OperationTargets() : unbounded(false), leadingListings(0) {}
+
+        QStringList extractedPaths;
+        QStringList paths;
+        bool unbounded;
+        // archive listings still running, the first leadingListings belong to leading Extracts
+        QList<QFuture<QStringList> > listings;
+        int leadingListings;
+    };
+
+    void scheduleExtractOperations(const QList<Component*> &components, int from,
+        const QSet<QString> &pendingComponents, double progressOperationSize);
+    void startExtractOperations(Component *component, double progressOperationSize);
+    const OperationTargets &operationTargets(Component *component);
+    void releaseOperationTargets();
+    void collectScheduledOperations(const QList<Component*> &components);
+
+    bool hasPendingArchives(Component *component) const;
+    void waitForArchivesDownload(Component *component);
+    double operationProgressSize(Component *component, double progressOperationSize);
 
     PackagesList remotePackages();
     PackagesList compressedPackages();
@@ -257,6 +322,16 @@ private:
     InstallerCalculator *m_installerCalculator;
     UninstallerCalculator *m_uninstallerCalculator;
 
+    // name index and reverse dependencies of all components, rebuilt on first use after the
+    // component lists, names or dependencies changed
+    mutable QMutex m_componentRegistryMutex;
+    mutable bool m_componentRegistryValid;
+    mutable bool m_componentRegistryUpdater;
+    mutable QHash<QString, Component *> m_componentsByName;
+    // dependencies and auto dependencies, by the name they refer to and by declaring component
+    mutable QHash<QString, QList<DependencyConstraint> > m_dependees;
+    mutable QHash<const Component *, QList<DependencyConstraint> > m_dependencies;
+
     PackageManagerProxyFactory *m_proxyFactory;
 
     ComponentModel *m_defaultModel;
@@ -265,10 +340,20 @@ private:
     QObject *m_guiObject;
     QScopedPointer<RemoteFileEngineHandler> m_remoteFileEngineHandler;
 
+    // extract operations started ahead of their component by installComponents()
+    QThreadPool m_extractThreadPool;
+    QSet<Component*> m_scheduledComponents;
+    QHash<Operation*, QFuture<bool> > m_scheduledOperations;
+    QHash<Component*, OperationTargets> m_operationTargets;
+
+    // archives still downloading while runInstaller() installs the components already present
+    DownloadArchivesJob *m_archivesJob;
+
 private:
     // remove once we deprecate isSelected, setSelected etc...
     void restoreCheckState();
     void storeCheckState();
+    void updateComponentRegistry() const;
     QHash<Component*, Qt::CheckState> m_coreCheckedHash;
 };
 
@@ -27,12 +27,89 @@
 **************************************************************************/
 
 #include "protocol.h"
+
+#include <QHash>
 #include <QIODevice>
 
 namespace QInstaller {
 
 typedef qint32 PackageSize;
 
+namespace Protocol {
+
+// The position of a command in this table is its opcode on the wire. Both peers have to agree
+// on it, so new commands may only ever be appended.
+static const char *const Commands[] = {
+    Create, Destroy, Shutdown, Authorize, Reply, Negotiate, Batch, QProcessCloseWriteChannel,
+    QProcessExitCode, QProcessExitStatus, QProcessKill, QProcessReadAll,
+    QProcessReadAllStandardOutput, QProcessReadAllStandardError, QProcessStartDetached,
+    QProcessSetWorkingDirectory, QProcessSetEnvironment, QProcessEnvironment, QProcessStart3Arg,
+    QProcessStart2Arg, QProcessState, QProcessTerminate, QProcessWaitForFinished,
+    QProcessWaitForStarted, QProcessWorkingDirectory, QProcessErrorString, QProcessReadChannel,
+    QProcessSetReadChannel, QProcessWrite, QProcessProcessChannelMode,
+    QProcessSetProcessChannelMode, QProcessSetNativeArguments, GetQProcessSignals, QSettingsAllKeys,
+    QSettingsBeginGroup, QSettingsBeginWriteArray, QSettingsBeginReadArray, QSettingsChildGroups,
+    QSettingsChildKeys, QSettingsClear, QSettingsContains, QSettingsEndArray, QSettingsEndGroup,
+    QSettingsFallbacksEnabled, QSettingsFileName, QSettingsGroup, QSettingsIsWritable,
+    QSettingsRemove, QSettingsSetArrayIndex, QSettingsSetFallbacksEnabled, QSettingsStatus,
+    QSettingsSync, QSettingsSetValue, QSettingsValue, QSettingsOrganizationName,
+    QSettingsApplicationName, QAbstractFileEngineAtEnd, QAbstractFileEngineCaseSensitive,
+    QAbstractFileEngineClose, QAbstractFileEngineCopy, QAbstractFileEngineEntryList,
+    QAbstractFileEngineError, QAbstractFileEngineErrorString, QAbstractFileEngineFileFlags,
+    QAbstractFileEngineFileName, QAbstractFileEngineFlush, QAbstractFileEngineHandle,
+    QAbstractFileEngineIsRelativePath, QAbstractFileEngineIsSequential, QAbstractFileEngineLink,
+    QAbstractFileEngineMkdir, QAbstractFileEngineOpen, QAbstractFileEngineOwner,
+    QAbstractFileEngineOwnerId, QAbstractFileEnginePos, QAbstractFileEngineRead,
+    QAbstractFileEngineReadLine, QAbstractFileEngineRemove, QAbstractFileEngineRename,
+    QAbstractFileEngineRmdir, QAbstractFileEngineSeek, QAbstractFileEngineSetFileName,
+    QAbstractFileEngineSetPermissions, QAbstractFileEngineSetSize, QAbstractFileEngineSize,
+    QAbstractFileEngineSupportsExtension, QAbstractFileEngineExtension, QAbstractFileEngineWrite,
+    QAbstractFileEngineSyncToDisk, QAbstractFileEngineRenameOverwrite, QAbstractFileEngineFileTime,
+    Progress, Cancel, QAbstractFileEngineExtractArchive
+};
+
+static QHash<QByteArray, Opcode> createOpcodeHash()
+{
+    QHash<QByteArray, Opcode> hash;
+    for (size_t i = 0; i < sizeof(Commands) / sizeof(Commands[0]); ++i)
+        hash.insert(QByteArray(Commands[i]), Opcode(i));
+    return hash;
+}
+
+/*!
+    Returns the opcode sent on the wire instead of the name of \a command, or \c InvalidOpcode
+    if \a command is unknown.
+ */
+Opcode opcode(const QByteArray &command)
+{
+    static const QHash<QByteArray, Opcode> opcodes = createOpcodeHash();
+    return opcodes.value(command, InvalidOpcode);
+}
+
+/*!
+    Returns the name of the command identified by \a opcode, or an empty byte array if
+    \a opcode is unknown.
+ */
+QByteArray commandName(Opcode opcode)
+{
+    if (opcode >= sizeof(Commands) / sizeof(Commands[0]))
+        return QByteArray();
+    return QByteArray::fromRawData(Commands[opcode], qstrlen(Commands[opcode]));
+}
+
+} // namespace Protocol
+
+static void writeAll(QIODevice *device, QByteArray packet)
+{
+    forever {
+        const int bytesWritten = device->write(packet);
+        Q_ASSERT(bytesWritten >= 0);
+        if (bytesWritten == packet.size())
+            break;
+        packet.remove(0, bytesWritten);
+    }
+}
+
 /*!
     Write a packet containing \a command and \a data to \a device.
 
@@ -52,13 +129,7 @@ void sendPacket(QIODevice *device, const QByteArray &command, const QByteArray &
     packet.append('\0');
     packet.append(data);
 
-    forever {
-        const int bytesWritten = device->write(packet);
-        Q_ASSERT(bytesWritten >= 0);
-        if (bytesWritten == packet.size())
-            break;
-        packet.remove(0, bytesWritten);
-    }
+    writeAll(device, packet);
 }
 
 /*!
@@ -93,4 +164,70 @@ bool receivePacket(QIODevice *device, QByteArray *command, QByteArray *data)
     return true;
 }
 
+static const int FrameHeaderSize = sizeof(Protocol::Opcode) + sizeof(quint8) + sizeof(quint32);
+
+/*!
+    Returns a frame containing \a header and \a data, as written by sendFrame(). Frames created
+    this way can be concatenated to form the payload of a \c Protocol::Batch frame.
+
+    \note Both client and server need to have the same endianness.
+ */
+QByteArray createFrame(const Protocol::FrameHeader &header, const QByteArray &data)
+{
+    const PackageSize payloadSize = FrameHeaderSize + data.size();
+
+    QByteArray frame;
+    frame.reserve(sizeof(PackageSize) + payloadSize);
+    frame.append(reinterpret_cast<const char *>(&payloadSize), sizeof(PackageSize));
+    frame.append(reinterpret_cast<const char *>(&header.opcode), sizeof(Protocol::Opcode));
+    frame.append(reinterpret_cast<const char *>(&header.flags), sizeof(quint8));
+    frame.append(reinterpret_cast<const char *>(&header.requestId), sizeof(quint32));
+    frame.append(data);
+    return frame;
+}
+
+/*!
+    Write a frame containing \a header and \a data to \a device. Frames replace the packets
+    written by sendPacket() once both peers agreed on \c Protocol::Version or later.
+
+    \note Both client and server need to have the same endianness.
+ */
+void sendFrame(QIODevice *device, const Protocol::FrameHeader &header, const QByteArray &data)
+{
+    writeAll(device, createFrame(header, data));
+}
+
+/*!
+    Reads a frame from \a device, and stores its content into \a header and \a data.
+
+    Returns \c false if the frame in the device buffer is yet incomplete, \c true otherwise.
+
+    \note Both client and server need to have the same endianness.
+ */
+bool receiveFrame(QIODevice *device, Protocol::FrameHeader *header, QByteArray *data)
+{
+    const qint64 sizeBytes = sizeof(PackageSize);
+    PackageSize payloadSize;
+    if (device->peek(reinterpret_cast<char *>(&payloadSize), sizeBytes) < sizeBytes)
+        return false;
+
+    // not enough data yet? back off ...
+    if (device->bytesAvailable() < sizeBytes + payloadSize)
+        return false;
+
+    device->read(sizeof(PackageSize));
+    const QByteArray payload = device->read(payloadSize);
+    Q_ASSERT(payload.size() >= FrameHeaderSize);
+
+    const char *raw = payload.constData();
+    memcpy(&header->opcode, raw, sizeof(Protocol::Opcode));
+    raw += sizeof(Protocol::Opcode);
+    memcpy(&header->flags, raw, sizeof(quint8));
+    raw += sizeof(quint8);
+    memcpy(&header->requestId, raw, sizeof(quint32));
+
+    *data = payload.mid(FrameHeaderSize);
+    return true;
+}
+
 } // namespace QInstaller
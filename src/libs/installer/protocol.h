@@ -57,6 +57,44 @@ const char Shutdown[] = "Shutdown";
 const char Authorize[] = "Authorize";
 const char Reply[] = "Reply";
 
+// Version negotiation, see RemoteObject::authorize()
+const char Negotiate[] = "Negotiate";
+const qint32 LegacyVersion = 1;
+const qint32 Version = 2;
+
+// Frames sent once both peers speak Version 2 or later
+const char Batch[] = "Batch";
+const char Progress[] = "Progress";
+const char Cancel[] = "Cancel";
+
+// Notifications sent as Progress frames while a server side extraction is running
+enum struct ExtractProgress : qint32 {
+    CurrentFile,
+    Completed,
+    PrepareForFile
+};
+
+typedef quint16 Opcode;
+const Opcode InvalidOpcode = 0xffff;
+
+enum FrameFlag {
+    NoReply = 0x01,         // request: the sender does not wait for a reply
+    DeferredFailure = 0x02  // reply: a preceding NoReply request failed
+};
+
+struct FrameHeader
+{
+    FrameHeader() : opcode(InvalidOpcode), flags(0), requestId(0) {}
+    FrameHeader(Opcode op, quint8 f, quint32 id) : opcode(op), flags(f), requestId(id) {}
+
+    Opcode opcode;
+    quint8 flags;
+    quint32 requestId;
+};
+
+Opcode INSTALLER_EXPORT opcode(const QByteArray &command);
+QByteArray INSTALLER_EXPORT commandName(Opcode opcode);
+
 // QProcessWrapper
 const char QProcess[] = "QProcess";
 const char QProcessCloseWriteChannel[] = "QProcess::closeWriteChannel";
@@ -162,12 +200,19 @@ const char QAbstractFileEngineWrite[] = "QAbstractFileEngine::write";
 const char QAbstractFileEngineSyncToDisk[] = "QAbstractFileEngine::syncToDisk";
 const char QAbstractFileEngineRenameOverwrite[] = "QAbstractFileEngine::renameOverwrite";
 const char QAbstractFileEngineFileTime[] = "QAbstractFileEngine::fileTime";
+const char QAbstractFileEngineExtractArchive[] = "QAbstractFileEngine::extractArchive";
 
 } // namespace Protocol
 
 void INSTALLER_EXPORT sendPacket(QIODevice *device, const QByteArray &command, const QByteArray &data);
 bool INSTALLER_EXPORT receivePacket(QIODevice *device, QByteArray *command, QByteArray *data);
 
+QByteArray INSTALLER_EXPORT createFrame(const Protocol::FrameHeader &header, const QByteArray &data);
+void INSTALLER_EXPORT sendFrame(QIODevice *device, const Protocol::FrameHeader &header,
+    const QByteArray &data);
+bool INSTALLER_EXPORT receiveFrame(QIODevice *device, Protocol::FrameHeader *header,
+    QByteArray *data);
+
 } // namespace QInstaller
 
 #endif // PROTOCOL_H
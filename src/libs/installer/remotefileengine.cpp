@@ -28,13 +28,18 @@
 
 #include "remotefileengine.h"
 
+#include "lib7z_extract.h"
 #include "protocol.h"
 #include "remoteclient.h"
 
+#include <QDebug>
 #include <QRegExp>
 
 namespace QInstaller {
 
+// Amount of data read ahead, or collected before it is written, in a single call to the server.
+static const int TransferWindowSize = 2 * 1024 * 1024;
+
 
 // -- RemoteFileEngineHandler
 
@@ -114,11 +119,158 @@ QString RemoteFileEngineIterator::currentFileName() const
 
 RemoteFileEngine::RemoteFileEngine()
     : RemoteObject(QLatin1String(Protocol::QAbstractFileEngine))
+    , m_openMode(QIODevice::NotOpen)
+    , m_readPos(0)
+    , m_unconfirmedBytes(0)
+    , m_writeFailed(false)
+    , m_extractCallback(0)
 {
 }
 
 RemoteFileEngine::~RemoteFileEngine()
 {
+    if (!m_writeWindow.isEmpty() && !flushWriteWindow()) {
+        qWarning() << "Cannot write the remaining data to" << m_fileEngine.fileName()
+            << "through the server.";
+    }
+}
+
+/*!
+    Returns whether calls on the open file go to the server. A file opened on the server stays
+    there until it is closed, even if the remote client was deactivated in between, for
+    example when admin rights were dropped. Otherwise the data written so far would end up
+    in the local file engine, which never opened the file.
+*/
+bool RemoteFileEngine::useServer() const
+{
+    if (m_openMode != QIODevice::NotOpen && hasOpenConnection())
+        return true;
+    return const_cast<RemoteFileEngine *>(this)->connectToServer();
+}
+
+/*!
+    Sends the data collected by write() to the server, and waits for the result.
+
+    Files opened write-only are written in windows of \c TransferWindowSize bytes. Returns
+    \c false if this or an earlier write failed, or if the connection to the server is gone
+    and the window is lost. The failure is reported by all following writes, flush() and
+    close().
+*/
+bool RemoteFileEngine::flushWriteWindow()
+{
+    if (m_writeWindow.isEmpty())
+        return checkWrites();
+
+    const QByteArray window = m_writeWindow;
+    m_writeWindow.clear();
+    if (!hasOpenConnection()) {
+        m_writeFailed = true;
+        return false;
+    }
+    const qint64 written = callRemoteMethod<qint64>
+        (QString::fromLatin1(Protocol::QAbstractFileEngineWrite), window);
+    if (written != window.size())
+        m_writeFailed = true;
+    return checkWrites();
+}
+
+/*!
+    Returns \c false if a write sent to the server failed since the file was opened. A failed
+    write makes all following writes fail as well, since they would land at the wrong offset.
+*/
+bool RemoteFileEngine::checkWrites()
+{
+    if (takeDeferredFailure())
+        m_writeFailed = true;
+    return !m_writeFailed;
+}
+
+/*!
+    Waits for the server to process the writes sent without waiting for their result, and
+    returns checkWrites().
+*/
+bool RemoteFileEngine::confirmWrites()
+{
+    m_unconfirmedBytes = 0;
+    // any call with a reply reports whether the deferred calls sent before it failed
+    callRemoteMethod<qint64>(QString::fromLatin1(Protocol::QAbstractFileEnginePos));
+    return checkWrites();
+}
+
+/*!
+    Returns the number of bytes read ahead from the server, but not yet returned by read().
+*/
+qint64 RemoteFileEngine::readAheadSize() const
+{
+    return m_readAhead.size() - m_readPos;
+}
+
+/*!
+    Discards the data read ahead, and moves the position on the server back to the position
+    seen by the caller.
+*/
+void RemoteFileEngine::dropReadAhead()
+{
+    if (readAheadSize() == 0)
+        return;
+    const qint64 position = pos();
+    m_readAhead.clear();
+    m_readPos = 0;
+    seek(position);
+}
+
+/*!
+    Lets the server extract the archive this engine was set up for into \a targetDirectory.
+    Only the notifications passed to \a callback and the result cross the process boundary,
+    existing files are handed to the \a callback for backup before they are overwritten.
+
+    Returns \c true on success. Otherwise sets \a errorString and returns \c false.
+
+    \note Needs \c Protocol::Version or later, see supportsDeferredCalls().
+*/
+bool RemoteFileEngine::extractArchive(const QString &targetDirectory,
+    Lib7z::ExtractCallback *callback, QString *errorString)
+{
+    Q_ASSERT(supportsDeferredCalls());
+
+    m_extractCallback = callback;
+    *errorString = callRemoteMethod<QString>
+        (QString::fromLatin1(Protocol::QAbstractFileEngineExtractArchive), targetDirectory);
+    m_extractCallback = 0;
+    return errorString->isEmpty();
+}
+
+/*!
+    Forwards the extraction notifications sent by the server to the callback passed to
+    extractArchive().
+*/
+void RemoteFileEngine::progressReceived(const QByteArray &data)
+{
+    if (!m_extractCallback)
+        return;
+
+    QDataStream stream(data);
+    qint32 type;
+    stream >> type;
+    switch (static_cast<Protocol::ExtractProgress>(type)) {
+    case Protocol::ExtractProgress::CurrentFile: {
+        QString filename;
+        stream >> filename;
+        m_extractCallback->setCurrentFile(filename);
+    }   break;
+    case Protocol::ExtractProgress::Completed: {
+        quint64 completed, total;
+        stream >> completed >> total;
+        if (m_extractCallback->setCompleted(completed, total) != S_OK)
+            callRemoteMethod(QString::fromLatin1(Protocol::Cancel));
+    }   break;
+    case Protocol::ExtractProgress::PrepareForFile: {
+        QString filename;
+        stream >> filename;
+        callRemoteMethod(QString::fromLatin1(Protocol::Reply),
+            m_extractCallback->prepareForFile(filename), dummy);
+    }   break;
+    }
 }
 
 /*!
@@ -126,8 +278,12 @@ RemoteFileEngine::~RemoteFileEngine()
 */
 bool RemoteFileEngine::atEnd() const
 {
-    if ((const_cast<RemoteFileEngine *>(this))->connectToServer())
+    if (useServer()) {
+        if (readAheadSize() > 0)
+            return false;
+        const_cast<RemoteFileEngine *>(this)->flushWriteWindow();
         return callRemoteMethod<bool>(QString::fromLatin1(Protocol::QAbstractFileEngineAtEnd));
+    }
     return m_fileEngine.atEnd();
 }
 
@@ -168,8 +324,18 @@ bool RemoteFileEngine::caseSensitive() const
 */
 bool RemoteFileEngine::close()
 {
-    if (connectToServer())
-        return callRemoteMethod<bool>(QString::fromLatin1(Protocol::QAbstractFileEngineClose));
+    if (useServer()) {
+        flushWriteWindow();
+        m_readAhead.clear();
+        m_readPos = 0;
+        m_openMode = QIODevice::NotOpen;
+        const bool result = callRemoteMethod<bool>
+            (QString::fromLatin1(Protocol::QAbstractFileEngineClose));
+        const bool written = checkWrites();
+        m_writeFailed = false;
+        m_unconfirmedBytes = 0;
+        return written && result;
+    }
     return m_fileEngine.close();
 }
 
@@ -258,8 +424,13 @@ QString RemoteFileEngine::fileName(FileName file) const
 */
 bool RemoteFileEngine::flush()
 {
-    if (connectToServer())
-        return callRemoteMethod<bool>(QString::fromLatin1(Protocol::QAbstractFileEngineFlush));
+    if (useServer()) {
+        flushWriteWindow();
+        const bool result = callRemoteMethod<bool>
+            (QString::fromLatin1(Protocol::QAbstractFileEngineFlush));
+        m_unconfirmedBytes = 0;
+        return checkWrites() && result;
+    }
     return m_fileEngine.flush();
 }
 
@@ -323,6 +494,9 @@ bool RemoteFileEngine::mkdir(const QString &dirName, bool createParentDirectorie
 bool RemoteFileEngine::open(QIODevice::OpenMode mode)
 {
     if (connectToServer()) {
+        m_openMode = mode;
+        m_writeFailed = false;
+        m_unconfirmedBytes = 0;
         return callRemoteMethod<bool>(QString::fromLatin1(Protocol::QAbstractFileEngineOpen),
             static_cast<qint32>(mode));
     }
@@ -358,8 +532,11 @@ uint RemoteFileEngine::ownerId(FileOwner owner) const
 */
 qint64 RemoteFileEngine::pos() const
 {
-    if ((const_cast<RemoteFileEngine *>(this))->connectToServer())
-        return callRemoteMethod<qint64>(QString::fromLatin1(Protocol::QAbstractFileEnginePos));
+    if (useServer()) {
+        const_cast<RemoteFileEngine *>(this)->flushWriteWindow();
+        return callRemoteMethod<qint64>(QString::fromLatin1(Protocol::QAbstractFileEnginePos))
+            - readAheadSize();
+    }
     return m_fileEngine.pos();
 }
 
@@ -402,8 +579,13 @@ bool RemoteFileEngine::rmdir(const QString &dirName, bool recurseParentDirectori
 */
 bool RemoteFileEngine::seek(qint64 offset)
 {
-    if (connectToServer())
+    if (useServer()) {
+        m_readAhead.clear();
+        m_readPos = 0;
+        if (!flushWriteWindow())
+            return false; // the data before the new position is missing
         return callRemoteMethod<bool>(QString::fromLatin1(Protocol::QAbstractFileEngineSeek), offset);
+    }
     return m_fileEngine.seek(offset);
 }
 
@@ -436,7 +618,8 @@ bool RemoteFileEngine::setPermissions(uint perms)
 */
 bool RemoteFileEngine::setSize(qint64 size)
 {
-    if (connectToServer()) {
+    if (useServer()) {
+        flushWriteWindow();
         return callRemoteMethod<bool>(QString::fromLatin1(Protocol::QAbstractFileEngineSetSize),
             size);
     }
@@ -448,8 +631,10 @@ bool RemoteFileEngine::setSize(qint64 size)
 */
 qint64 RemoteFileEngine::size() const
 {
-    if ((const_cast<RemoteFileEngine *>(this))->connectToServer())
+    if (useServer()) {
+        const_cast<RemoteFileEngine *>(this)->flushWriteWindow();
         return callRemoteMethod<qint64>(QString::fromLatin1(Protocol::QAbstractFileEngineSize));
+    }
     return m_fileEngine.size();
 }
 
@@ -468,16 +653,35 @@ bool RemoteFileEngine::supportsExtension(Extension extension) const
 */
 qint64 RemoteFileEngine::read(char *data, qint64 maxlen)
 {
-    if (connectToServer()) {
+    if (useServer()) {
+        qint64 copied = 0;
+        if (readAheadSize() > 0) {
+            copied = qMin(maxlen, readAheadSize());
+            memcpy(data, m_readAhead.constData() + m_readPos, copied);
+            m_readPos += copied;
+            if (copied == maxlen)
+                return copied;
+            m_readAhead.clear();    // the read continues past the end of the window
+            m_readPos = 0;
+        }
+
+        // Files opened read-only are read in windows of TransferWindowSize bytes.
+        const qint64 wanted = maxlen - copied;
+        const qint64 window = (m_openMode & QIODevice::WriteOnly) ? wanted
+            : qMax<qint64>(wanted, TransferWindowSize);
         QPair<qint64, QByteArray> result = callRemoteMethod<QPair<qint64, QByteArray> >
-            (QString::fromLatin1(Protocol::QAbstractFileEngineRead), maxlen);
+            (QString::fromLatin1(Protocol::QAbstractFileEngineRead), window);
 
         if (result.first <= 0)
-            return result.first;
-
-        QDataStream dataStream(result.second);
-        dataStream.readRawData(data, result.first);
-        return result.first;
+            return copied > 0 ? copied : result.first;
+
+        const qint64 count = qMin(wanted, result.first);
+        memcpy(data + copied, result.second.constData(), count);
+        if (count < result.first) {
+            m_readAhead = result.second.left(result.first);
+            m_readPos = count;
+        }
+        return copied + count;
     }
     return m_fileEngine.read(data, maxlen);
 }
@@ -487,7 +691,8 @@ qint64 RemoteFileEngine::read(char *data, qint64 maxlen)
 */
 qint64 RemoteFileEngine::readLine(char *data, qint64 maxlen)
 {
-    if (connectToServer()) {
+    if (useServer()) {
+        dropReadAhead();
         QPair<qint64, QByteArray> result = callRemoteMethod<QPair<qint64, QByteArray> >
             (QString::fromLatin1(Protocol::QAbstractFileEngineReadLine), maxlen);
 
@@ -506,8 +711,27 @@ qint64 RemoteFileEngine::readLine(char *data, qint64 maxlen)
 */
 qint64 RemoteFileEngine::write(const char *data, qint64 len)
 {
-    if (connectToServer()) {
+    if (useServer()) {
+        if (!checkWrites())
+            return -1;
+        if (supportsDeferredCalls() && !(m_openMode & QIODevice::ReadOnly)) {
+            m_writeWindow.append(data, len);
+            if (m_writeWindow.size() >= TransferWindowSize && !flushWriteWindow())
+                return -1;
+            return len;
+        }
+
+        dropReadAhead();
         QByteArray ba(data, len);
+        if (supportsDeferredCalls()) {
+            // Writes are batched. A full batch is confirmed by a call with reply, so a failing
+            // write fails the writes after it, and at the latest the next flush or close.
+            callRemoteMethodDeferred(QString::fromLatin1(Protocol::QAbstractFileEngineWrite), ba);
+            m_unconfirmedBytes += len;
+            if (m_unconfirmedBytes >= RemoteObject::MaxPendingBytes && !confirmWrites())
+                return -1;
+            return len;
+        }
         return callRemoteMethod<qint64>(QString::fromLatin1(Protocol::QAbstractFileEngineWrite), ba);
     }
     return m_fileEngine.write(data, len);
@@ -515,8 +739,13 @@ qint64 RemoteFileEngine::write(const char *data, qint64 len)
 
 bool RemoteFileEngine::syncToDisk()
 {
-    if (connectToServer())
-        return callRemoteMethod<bool>(QString::fromLatin1(Protocol::QAbstractFileEngineSyncToDisk));
+    if (useServer()) {
+        flushWriteWindow();
+        const bool result = callRemoteMethod<bool>
+            (QString::fromLatin1(Protocol::QAbstractFileEngineSyncToDisk));
+        m_unconfirmedBytes = 0;
+        return checkWrites() && result;
+    }
     return m_fileEngine.syncToDisk();
 }
 
@@ -34,6 +34,10 @@
 #include <QtCore/private/qabstractfileengine_p.h>
 #include <QtCore/private/qfsfileengine_p.h>
 
+namespace Lib7z {
+class ExtractCallback;
+}
+
 namespace QInstaller {
 
 class INSTALLER_EXPORT RemoteFileEngineHandler : public QAbstractFileEngineHandler
@@ -45,7 +49,7 @@ public:
     QAbstractFileEngine* create(const QString &fileName) const Q_DECL_OVERRIDE;
 };
 
-class RemoteFileEngine : public RemoteObject, public QAbstractFileEngine
+class INSTALLER_EXPORT RemoteFileEngine : public RemoteObject, public QAbstractFileEngine
 {
     Q_DISABLE_COPY(RemoteFileEngine)
 
@@ -98,8 +102,30 @@ public:
         ExtensionReturn *output = 0) Q_DECL_OVERRIDE;
     bool supportsExtension(Extension extension) const Q_DECL_OVERRIDE;
 
+    bool extractArchive(const QString &targetDirectory, Lib7z::ExtractCallback *callback,
+        QString *errorString);
+
+protected:
+    void progressReceived(const QByteArray &data) Q_DECL_OVERRIDE;
+
+private:
+    bool useServer() const;
+    bool flushWriteWindow();
+    bool checkWrites();
+    bool confirmWrites();
+    qint64 readAheadSize() const;
+    void dropReadAhead();
+
 private:
     QFSFileEngine m_fileEngine;
+
+    QIODevice::OpenMode m_openMode;
+    QByteArray m_writeWindow;
+    QByteArray m_readAhead;
+    int m_readPos;
+    qint64 m_unconfirmedBytes;
+    bool m_writeFailed;
+    Lib7z::ExtractCallback *m_extractCallback;
 };
 
 } // namespace QInstaller
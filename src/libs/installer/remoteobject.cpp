@@ -42,6 +42,10 @@ RemoteObject::RemoteObject(const QString &wrappedType, QObject *parent)
     , dummy(0)
     , m_type(wrappedType)
     , m_socket(0)
+    , m_protocolVersion(Protocol::LegacyVersion)
+    , m_lastRequestId(0)
+    , m_pendingBytes(0)
+    , m_deferredFailure(false)
 {
     Q_ASSERT_X(!m_type.isEmpty(), Q_FUNC_INFO, "The wrapped Qt type needs to be passed as "
         "argument and cannot be empty.");
@@ -52,7 +56,7 @@ RemoteObject::~RemoteObject()
     if (m_socket) {
         if (QThread::currentThread() == m_socket->thread()) {
             if (m_type != QLatin1String("RemoteClientPrivate"))
-                writeData(QLatin1String(Protocol::Destroy), m_type, dummy, dummy);
+                writeData(QLatin1String(Protocol::Destroy), m_type, dummy, dummy, FireAndForget);
         } else {
             Q_ASSERT_X(false, Q_FUNC_INFO, "Socket running in a different Thread than this object.");
         }
@@ -72,16 +76,64 @@ bool RemoteObject::authorize()
     m_socket->connectToServer(RemoteClient::instance().socketName());
 
     if (m_socket->waitForConnected()) {
-        bool authorized = callRemoteMethod<bool>(QString::fromLatin1(Protocol::Authorize),
-                                                 RemoteClient::instance().authorizationKey());
-        if (authorized)
+        if (negotiate())
             return true;
+
+        // A server that does not know the negotiation command drops the connection, retry
+        // using the legacy handshake.
+        if (m_socket->state() != QLocalSocket::ConnectedState) {
+            delete m_socket;
+            m_socket = new QLocalSocket;
+            m_socket->connectToServer(RemoteClient::instance().socketName());
+
+            if (m_socket->waitForConnected()) {
+                bool authorized = callRemoteMethod<bool>(QString::fromLatin1(Protocol::Authorize),
+                                                         RemoteClient::instance().authorizationKey());
+                if (authorized)
+                    return true;
+            }
+        }
     }
     delete m_socket;
     m_socket = 0;
     return false;
 }
 
+/*!
+    Sends the authorization key together with the highest protocol version supported by the
+    client. On success, the lower of both versions is used for all following calls.
+
+    Returns \c false if the key was rejected or the server closed the connection.
+ */
+bool RemoteObject::negotiate()
+{
+    m_protocolVersion = Protocol::LegacyVersion;
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << RemoteClient::instance().authorizationKey() << Protocol::Version;
+    sendPacket(m_socket, Protocol::Negotiate, data);
+    m_socket->flush();
+
+    QByteArray command;
+    QByteArray reply;
+    while (!receivePacket(m_socket, &command, &reply)) {
+        if (!m_socket->waitForReadyRead(-1))
+            return false;
+    }
+    Q_ASSERT(command == Protocol::Reply);
+
+    bool authorized = false;
+    qint32 version = Protocol::LegacyVersion;
+    QDataStream in(reply);
+    in >> authorized >> version;
+    if (!authorized || in.status() != QDataStream::Ok)
+        return false;
+
+    m_protocolVersion = qMin(version, Protocol::Version);
+    return true;
+}
+
 bool RemoteObject::connectToServer(const QVariantList &arguments)
 {
     if (!RemoteClient::instance().isActive())
@@ -99,8 +151,7 @@ bool RemoteObject::connectToServer(const QVariantList &arguments)
     foreach (const QVariant &arg, arguments)
         out << arg;
 
-    sendPacket(m_socket, Protocol::Create, data);
-    m_socket->flush();
+    sendCommand(Protocol::Create, data, FireAndForget);
 
     return true;
 }
@@ -114,9 +165,158 @@ bool RemoteObject::isConnectedToServer() const
     return false;
 }
 
+/*!
+    Returns whether the connection to the server is still open. Unlike isConnectedToServer(),
+    this does not depend on the remote client being active, so objects that hold state on the
+    server can finish their work after the client was deactivated.
+ */
+bool RemoteObject::hasOpenConnection() const
+{
+    return m_socket && (m_socket->state() == QLocalSocket::ConnectedState);
+}
+
 void RemoteObject::callRemoteMethod(const QString &name)
 {
-    writeData(name, dummy, dummy, dummy);
+    writeData(name, dummy, dummy, dummy, FireAndForget);
+}
+
+/*!
+    Called for every \c Protocol::Progress frame the server sends with \a data while a
+    synchronous call is waiting for its reply. The default implementation ignores it.
+ */
+void RemoteObject::progressReceived(const QByteArray &data)
+{
+    Q_UNUSED(data)
+}
+
+/*!
+    Returns whether the server supports callRemoteMethodDeferred(). This is the case for
+    \c Protocol::Version and later.
+ */
+bool RemoteObject::supportsDeferredCalls() const
+{
+    return m_protocolVersion >= Protocol::Version;
+}
+
+/*!
+    Returns whether one of the deferred calls sent since the last invocation failed on the
+    server, and resets the state.
+
+    A deferred call does not wait for the result, the server instead flags the next reply
+    if the call returned \c false, or if a write did not write all of its data.
+ */
+bool RemoteObject::takeDeferredFailure()
+{
+    const bool failure = m_deferredFailure;
+    m_deferredFailure = false;
+    return failure;
+}
+
+/*!
+    \internal
+
+    Sends \a command with \a data to the server and returns the request id the reply will carry.
+
+    Synchronous and fire-and-forget calls are written immediately, together with all pending
+    deferred calls. Deferred calls are queued until then, or until they exceed
+    \c MaxPendingBytes. Using the legacy protocol, every call is sent as its own packet.
+ */
+quint32 RemoteObject::sendCommand(const QByteArray &command, const QByteArray &data,
+    CallType type) const
+{
+    if (m_protocolVersion < Protocol::Version) {
+        Q_ASSERT_X(type != Deferred, Q_FUNC_INFO, "Deferred calls need Protocol::Version.");
+        sendPacket(m_socket, command, data);
+        m_socket->flush();
+        return 0;
+    }
+
+    const Protocol::Opcode opcode = Protocol::opcode(command);
+    Q_ASSERT_X(opcode != Protocol::InvalidOpcode, Q_FUNC_INFO, command.constData());
+
+    const Protocol::FrameHeader header(opcode, type == Synchronous ? 0 : Protocol::NoReply,
+        ++m_lastRequestId);
+    m_pendingCalls.append(qMakePair(header, data));
+    m_pendingBytes += data.size();
+
+    if (type != Deferred || m_pendingBytes >= MaxPendingBytes)
+        flushPendingCalls();
+    return header.requestId;
+}
+
+/*!
+    \internal
+
+    Writes all pending calls to the socket, using a single \c Protocol::Batch frame if there is
+    more than one.
+ */
+void RemoteObject::flushPendingCalls() const
+{
+    if (m_pendingCalls.isEmpty())
+        return;
+
+    if (m_pendingCalls.count() == 1) {
+        sendFrame(m_socket, m_pendingCalls.first().first, m_pendingCalls.first().second);
+    } else {
+        QByteArray batch;
+        batch.reserve(m_pendingBytes + m_pendingCalls.count() * 16);
+        for (int i = 0; i < m_pendingCalls.count(); ++i)
+            batch.append(createFrame(m_pendingCalls.at(i).first, m_pendingCalls.at(i).second));
+        sendFrame(m_socket, Protocol::FrameHeader(Protocol::opcode(Protocol::Batch),
+            Protocol::NoReply, ++m_lastRequestId), batch);
+    }
+    m_pendingCalls.clear();
+    m_pendingBytes = 0;
+    m_socket->flush();
+}
+
+/*!
+    \internal
+
+    Blocks until the reply to the request \a requestId for the method \a name arrived, and
+    returns its data.
+ */
+QByteArray RemoteObject::readReply(const QString &name, quint32 requestId) const
+{
+    while (m_socket->bytesToWrite())
+        m_socket->waitForBytesWritten();
+
+    QByteArray command;
+    QByteArray data;
+    if (m_protocolVersion < Protocol::Version) {
+        while (!receivePacket(m_socket, &command, &data)) {
+            if (!m_socket->waitForReadyRead(-1)) {
+                throw Error(tr("Cannot read all data after sending command: %1. "
+                    "Bytes expected: %2, Bytes received: %3. Error: %4").arg(name).arg(0)
+                    .arg(m_socket->bytesAvailable()).arg(m_socket->errorString()));
+            }
+        }
+        Q_ASSERT(command == Protocol::Reply);
+        return data;
+    }
+
+    Protocol::FrameHeader header;
+    forever {
+        while (!receiveFrame(m_socket, &header, &data)) {
+            if (!m_socket->waitForReadyRead(-1)) {
+                throw Error(tr("Cannot read all data after sending command: %1. "
+                    "Bytes expected: %2, Bytes received: %3. Error: %4").arg(name).arg(0)
+                    .arg(m_socket->bytesAvailable()).arg(m_socket->errorString()));
+            }
+        }
+        if (header.opcode != Protocol::opcode(Protocol::Progress) || header.requestId != requestId)
+            break;
+        // Long running calls report progress before the reply, the handler may send answers.
+        const_cast<RemoteObject *>(this)->progressReceived(data);
+    }
+
+    if (header.opcode != Protocol::opcode(Protocol::Reply) || header.requestId != requestId) {
+        throw Error(tr("Unexpected reply %1 after sending command: %2 (request %3).")
+            .arg(header.requestId).arg(name).arg(requestId));
+    }
+    if (header.flags & Protocol::DeferredFailure)
+        m_deferredFailure = true;
+    return data;
 }
 
 } // namespace QInstaller
@@ -50,18 +50,19 @@ public:
     virtual ~RemoteObject() = 0;
 
     bool isConnectedToServer() const;
+    bool hasOpenConnection() const;
     void callRemoteMethod(const QString &name);
 
     template<typename T1, typename T2>
     void callRemoteMethod(const QString &name, const T1 &arg, const T2 &arg2)
     {
-        writeData(name, arg, arg2, dummy);
+        writeData(name, arg, arg2, dummy, FireAndForget);
     }
 
     template<typename T1, typename T2, typename T3>
     void callRemoteMethod(const QString &name, const T1 &arg, const T2 &arg2, const T3 & arg3)
     {
-        writeData(name, arg, arg2, arg3);
+        writeData(name, arg, arg2, arg3, FireAndForget);
     }
 
     template<typename T>
@@ -85,23 +86,10 @@ public:
     template<typename T, typename T1, typename T2, typename T3>
     T callRemoteMethod(const QString &name, const T1 &arg, const T2 &arg2, const T3 &arg3) const
     {
-        writeData(name, arg, arg2, arg3);
-        while (m_socket->bytesToWrite())
-            m_socket->waitForBytesWritten();
+        const quint32 requestId = writeData(name, arg, arg2, arg3, Synchronous);
+        const QByteArray data = readReply(name, requestId);
 
-        QByteArray command;
-        QByteArray data;
-        while (!receivePacket(m_socket, &command, &data)) {
-            if (!m_socket->waitForReadyRead(-1)) {
-                throw Error(tr("Cannot read all data after sending command: %1. "
-                    "Bytes expected: %2, Bytes received: %3. Error: %4").arg(name).arg(0)
-                    .arg(m_socket->bytesAvailable()).arg(m_socket->errorString()));
-            }
-        }
-
-        Q_ASSERT(command == Protocol::Reply);
-
-        QDataStream stream(&data, QIODevice::ReadOnly);
+        QDataStream stream(data);
 
         T result;
         stream >> result;
@@ -110,9 +98,22 @@ public:
         return result;
     }
 
+    // Deferred calls are sent as one batch frame once they exceed this many bytes.
+    static const int MaxPendingBytes = 64 * 1024;
+
+    bool supportsDeferredCalls() const;
+    bool takeDeferredFailure();
+
+    template<typename T1>
+    void callRemoteMethodDeferred(const QString &name, const T1 &arg)
+    {
+        writeData(name, arg, dummy, dummy, Deferred);
+    }
+
 protected:
     bool authorize();
     bool connectToServer(const QVariantList &arguments = QVariantList());
+    virtual void progressReceived(const QByteArray &data);
 
     // Use this structure to allow derived classes to manipulate the template
     // function signature of the callRemoteMethod templates, since most of the
@@ -120,6 +121,12 @@ protected:
     struct Dummy {}; Dummy *dummy;
 
 private:
+    enum CallType {
+        Synchronous,
+        FireAndForget,
+        Deferred
+    };
+
     template<typename T> bool isValueType(T) const
     {
         return true;
@@ -134,7 +141,8 @@ private:
     }
 
     template<typename T1, typename T2, typename T3>
-    void writeData(const QString &name, const T1 &arg, const T2 &arg2, const T3 &arg3) const
+    quint32 writeData(const QString &name, const T1 &arg, const T2 &arg2, const T3 &arg3,
+        CallType type) const
     {
         QByteArray data;
         QDataStream out(&data, QIODevice::WriteOnly);
@@ -146,13 +154,23 @@ private:
         if (isValueType(arg3))
             out << arg3;
 
-        sendPacket(m_socket, name.toLatin1(), data);
-        m_socket->flush();
+        return sendCommand(name.toLatin1(), data, type);
     }
 
+    quint32 sendCommand(const QByteArray &command, const QByteArray &data, CallType type) const;
+    void flushPendingCalls() const;
+    QByteArray readReply(const QString &name, quint32 requestId) const;
+    bool negotiate();
+
 private:
     QString m_type;
     QLocalSocket *m_socket;
+
+    qint32 m_protocolVersion;
+    mutable quint32 m_lastRequestId;
+    mutable QList<QPair<Protocol::FrameHeader, QByteArray> > m_pendingCalls;
+    mutable int m_pendingBytes;
+    mutable bool m_deferredFailure;
 };
 
 } // namespace QInstaller
@@ -29,6 +29,7 @@
 #include "remoteserverconnection.h"
 
 #include "errors.h"
+#include "lib7z_facade.h"
 #include "protocol.h"
 #include "remoteserverconnection_p.h"
 #include "utils.h"
@@ -37,6 +38,7 @@
 #include <QCoreApplication>
 #include <QDataStream>
 #include <QLocalSocket>
+#include <QtConcurrentRun>
 
 namespace QInstaller {
 
@@ -48,6 +50,9 @@ RemoteServerConnection::RemoteServerConnection(qintptr socketDescriptor, const Q
     , m_engine(0)
     , m_authorizationKey(key)
     , m_signalReceiver(0)
+    , m_authorized(false)
+    , m_protocolVersion(Protocol::LegacyVersion)
+    , m_deferredFailure(false)
 {
     setObjectName(QString::fromLatin1("RemoteServerConnection(%1)").arg(socketDescriptor));
 }
@@ -69,128 +74,223 @@ void RemoteServerConnection::run()
     socket.setSocketDescriptor(m_socketDescriptor);
     QScopedPointer<PermissionSettings> settings;
 
-    bool authorized = false;
     while (socket.state() == QLocalSocket::ConnectedState) {
         QByteArray cmd;
         QByteArray data;
 
-        if (!receivePacket(&socket, &cmd, &data)) {
+        if (m_protocolVersion < Protocol::Version) {
+            if (!receivePacket(&socket, &cmd, &data)) {
+                socket.waitForReadyRead(250);
+                continue;
+            }
+            m_request = Protocol::FrameHeader();
+            if (!handleCommand(&socket, cmd, data, &settings))
+                return;
+            continue;
+        }
+
+        Protocol::FrameHeader header;
+        if (!receiveFrame(&socket, &header, &data)) {
             socket.waitForReadyRead(250);
             continue;
         }
 
-        const QString command = QString::fromLatin1(cmd);
-        QBuffer buf;
-        buf.setBuffer(&data);
-        buf.open(QIODevice::ReadOnly);
-        QDataStream stream;
-        stream.setDevice(&buf);
-        StreamChecker streamChecker(&stream);
-
-        if (authorized && command == QLatin1String(Protocol::Shutdown)) {
-            authorized = false;
-            sendData(&socket, true);
-            socket.flush();
-            socket.close();
-            emit shutdownRequested();
-            return;
-        } else if (command == QLatin1String(Protocol::Authorize)) {
-            QString key;
-            stream >> key;
-            sendData(&socket, (authorized = (key == m_authorizationKey)));
-            socket.flush();
-            if (!authorized) {
-                socket.close();
+        if (header.opcode != Protocol::opcode(Protocol::Batch)) {
+            m_request = header;
+            if (!handleCommand(&socket, Protocol::commandName(header.opcode), data, &settings))
                 return;
-            }
-        } else if (authorized) {
-            if (command.isEmpty())
-                continue;
+            continue;
+        }
 
-            if (command == QLatin1String(Protocol::Create)) {
-                QString type;
-                stream >> type;
-                if (type == QLatin1String(Protocol::QSettings)) {
-                    QVariant application;
-                    QVariant organization;
-                    QVariant scope, format;
-                    QVariant fileName;
-                    stream >> application; stream >> organization; stream >> scope; stream >> format;
-                    stream >> fileName;
-
-                    if (fileName.toString().isEmpty()) {
-                        settings.reset(new PermissionSettings(QSettings::Format(format.toInt()),
-                            QSettings::Scope(scope.toInt()), organization.toString(), application
-                            .toString()));
-                    } else {
-                        settings.reset(new PermissionSettings(fileName.toString(), QSettings::Format(format.toInt())));
-                    }
-                } else if (type == QLatin1String(Protocol::QProcess)) {
-                    if (m_process)
-                        m_process->deleteLater();
-                    m_process = new QProcess;
-                    m_signalReceiver = new QProcessSignalReceiver(m_process);
-                } else if (type == QLatin1String(Protocol::QAbstractFileEngine)) {
-                    if (m_engine)
-                        delete m_engine;
-                    m_engine = new QFSFileEngine;
-                }
-                continue;
+        // Dispatch the calls of a batch in order. Only calls the client waits for are replied to,
+        // which is at most the last one.
+        QBuffer batch(&data);
+        batch.open(QIODevice::ReadOnly);
+        QByteArray callData;
+        while (receiveFrame(&batch, &m_request, &callData)) {
+            if (!handleCommand(&socket, Protocol::commandName(m_request.opcode), callData,
+                &settings)) {
+                return;
             }
+        }
+    }
+}
+
+/*!
+    Handles the command \a cmd with its \a data received on \a socket. Returns \c false if the
+    connection should be closed.
+ */
+bool RemoteServerConnection::handleCommand(QLocalSocket *socket, const QByteArray &cmd,
+    QByteArray &data, QScopedPointer<PermissionSettings> *settings)
+{
+    const QString command = QString::fromLatin1(cmd);
+    QBuffer buf;
+    buf.setBuffer(&data);
+    buf.open(QIODevice::ReadOnly);
+    QDataStream stream;
+    stream.setDevice(&buf);
+    StreamChecker streamChecker(&stream);
 
-            if (command == QLatin1String(Protocol::Destroy)) {
-                QString type;
-                stream >> type;
-                if (type == QLatin1String(Protocol::QSettings)) {
-                    settings.reset();
-                } else if (type == QLatin1String(Protocol::QProcess)) {
-                    m_signalReceiver->m_receivedSignals.clear();
+    if (m_authorized && command == QLatin1String(Protocol::Shutdown)) {
+        m_authorized = false;
+        sendData(socket, true);
+        socket->flush();
+        socket->close();
+        emit shutdownRequested();
+        return false;
+    } else if (command == QLatin1String(Protocol::Authorize)) {
+        QString key;
+        stream >> key;
+        sendData(socket, (m_authorized = (key == m_authorizationKey)));
+        socket->flush();
+        if (!m_authorized) {
+            socket->close();
+            return false;
+        }
+    } else if (command == QLatin1String(Protocol::Negotiate)) {
+        QString key;
+        qint32 version;
+        stream >> key;
+        stream >> version;
+        m_authorized = (key == m_authorizationKey);
+
+        // The client switches to the agreed version only after receiving this reply, so it
+        // is always sent as a legacy packet.
+        QByteArray reply;
+        QDataStream replyStream(&reply, QIODevice::WriteOnly);
+        replyStream << m_authorized << Protocol::Version;
+        sendPacket(socket, Protocol::Reply, reply);
+        socket->flush();
+        if (!m_authorized) {
+            socket->close();
+            return false;
+        }
+        m_protocolVersion = qBound(Protocol::LegacyVersion, version, Protocol::Version);
+    } else if (m_authorized) {
+        if (command.isEmpty())
+            return true;
+
+        if (command == QLatin1String(Protocol::Create)) {
+            QString type;
+            stream >> type;
+            if (type == QLatin1String(Protocol::QSettings)) {
+                QVariant application;
+                QVariant organization;
+                QVariant scope, format;
+                QVariant fileName;
+                stream >> application; stream >> organization; stream >> scope; stream >> format;
+                stream >> fileName;
+
+                if (fileName.toString().isEmpty()) {
+                    settings->reset(new PermissionSettings(QSettings::Format(format.toInt()),
+                        QSettings::Scope(scope.toInt()), organization.toString(), application
+                        .toString()));
+                } else {
+                    settings->reset(new PermissionSettings(fileName.toString(), QSettings::Format(format.toInt())));
+                }
+            } else if (type == QLatin1String(Protocol::QProcess)) {
+                if (m_process)
                     m_process->deleteLater();
-                    m_process = 0;
-                } else if (type == QLatin1String(Protocol::QAbstractFileEngine)) {
+                m_process = new QProcess;
+                m_signalReceiver = new QProcessSignalReceiver(m_process);
+            } else if (type == QLatin1String(Protocol::QAbstractFileEngine)) {
+                if (m_engine)
                     delete m_engine;
-                    m_engine = 0;
-                }
-                return;
+                m_engine = new QFSFileEngine;
             }
+            return true;
+        }
 
-            if (command == QLatin1String(Protocol::GetQProcessSignals)) {
-                if (m_signalReceiver) {
-                    QMutexLocker _(&m_signalReceiver->m_lock);
-                    sendData(&socket, m_signalReceiver->m_receivedSignals);
-                    socket.flush();
-                    m_signalReceiver->m_receivedSignals.clear();
-                }
-                continue;
+        if (command == QLatin1String(Protocol::Destroy)) {
+            QString type;
+            stream >> type;
+            if (type == QLatin1String(Protocol::QSettings)) {
+                settings->reset();
+            } else if (type == QLatin1String(Protocol::QProcess)) {
+                m_signalReceiver->m_receivedSignals.clear();
+                m_process->deleteLater();
+                m_process = 0;
+            } else if (type == QLatin1String(Protocol::QAbstractFileEngine)) {
+                delete m_engine;
+                m_engine = 0;
             }
+            return false;
+        }
 
-            if (command.startsWith(QLatin1String(Protocol::QProcess))) {
-                handleQProcess(&socket, command, stream);
-            } else if (command.startsWith(QLatin1String(Protocol::QSettings))) {
-                handleQSettings(&socket, command, stream, settings.data());
-            } else if (command.startsWith(QLatin1String(Protocol::QAbstractFileEngine))) {
-                handleQFSFileEngine(&socket, command, stream);
-            } else {
-                qDebug() << "Unknown command:" << command;
+        if (command == QLatin1String(Protocol::GetQProcessSignals)) {
+            if (m_signalReceiver) {
+                QMutexLocker _(&m_signalReceiver->m_lock);
+                sendData(socket, m_signalReceiver->m_receivedSignals);
+                socket->flush();
+                m_signalReceiver->m_receivedSignals.clear();
             }
-            socket.flush();
+            return true;
+        }
+
+        if (command.startsWith(QLatin1String(Protocol::QProcess))) {
+            handleQProcess(socket, command, stream);
+        } else if (command.startsWith(QLatin1String(Protocol::QSettings))) {
+            handleQSettings(socket, command, stream, settings->data());
+        } else if (command.startsWith(QLatin1String(Protocol::QAbstractFileEngine))) {
+            handleQFSFileEngine(socket, command, stream);
         } else {
-            // authorization failed, connection not wanted
-            socket.close();
             qDebug() << "Unknown command:" << command;
-            return;
         }
+        socket->flush();
+    } else {
+        // authorization failed, connection not wanted
+        socket->close();
+        qDebug() << "Unknown command:" << command;
+        return false;
     }
+    return true;
+}
+
+// Used to detect failures of calls the client did not wait for, see Protocol::DeferredFailure.
+template <typename T>
+static bool isFailure(const T &)
+{
+    return false;
+}
+
+static bool isFailure(bool result)
+{
+    return !result;
 }
 
 template <typename T>
 void RemoteServerConnection::sendData(QIODevice *device, const T &data)
 {
+    sendData(device, data, isFailure(data));
+}
+
+/*!
+    \internal
+
+    Sends \a data as the reply to the current request. If the client did not wait for the reply,
+    nothing is sent, and \a failed is reported with the next reply instead.
+ */
+template <typename T>
+void RemoteServerConnection::sendData(QIODevice *device, const T &data, bool failed)
+{
+    if (m_request.flags & Protocol::NoReply) {
+        m_deferredFailure = m_deferredFailure || failed;
+        return;
+    }
+
     QByteArray result;
     QDataStream returnStream(&result, QIODevice::WriteOnly);
     returnStream << data;
 
-    sendPacket(device, Protocol::Reply, result);
+    if (m_protocolVersion < Protocol::Version) {
+        sendPacket(device, Protocol::Reply, result);
+        return;
+    }
+
+    const quint8 flags = m_deferredFailure ? Protocol::DeferredFailure : 0;
+    m_deferredFailure = false;
+    sendFrame(device, Protocol::FrameHeader(Protocol::opcode(Protocol::Reply), flags,
+        m_request.requestId), result);
 }
 
 void RemoteServerConnection::handleQProcess(QIODevice *socket, const QString &command, QDataStream &data)
@@ -440,6 +540,7 @@ void RemoteServerConnection::handleQFSFileEngine(QIODevice *socket, const QStrin
         data >> maxlen;
         QByteArray byteArray(maxlen, '\0');
         const qint64 r = m_engine->read(byteArray.data(), maxlen);
+        byteArray.resize(qMax<qint64>(r, 0)); // clients read ahead, do not send the unused tail
         sendData(socket, qMakePair<qint64, QByteArray>(r, byteArray));
     } else if (command == QLatin1String(Protocol::QAbstractFileEngineReadLine)) {
         qint64 maxlen;
@@ -483,7 +584,9 @@ void RemoteServerConnection::handleQFSFileEngine(QIODevice *socket, const QStrin
     } else if (command == QLatin1String(Protocol::QAbstractFileEngineWrite)) {
         QByteArray content;
         data >> content;
-        sendData(socket, m_engine->write(content.data(), content.size()));
+        // a short write fails as well, the client does not retry the rest of a deferred write
+        const qint64 written = m_engine->write(content.data(), content.size());
+        sendData(socket, written, written != content.size());
     } else if (command == QLatin1String(Protocol::QAbstractFileEngineSyncToDisk)) {
         sendData(socket, m_engine->syncToDisk());
     } else if (command == QLatin1String(Protocol::QAbstractFileEngineRenameOverwrite)) {
@@ -494,9 +597,80 @@ void RemoteServerConnection::handleQFSFileEngine(QIODevice *socket, const QStrin
         qint32 filetime;
         data >> filetime;
         sendData(socket, m_engine->fileTime(static_cast<QAbstractFileEngine::FileTime> (filetime)));
+    } else if (command == QLatin1String(Protocol::QAbstractFileEngineExtractArchive)) {
+        QString targetDirectory;
+        data >> targetDirectory;
+        sendData(socket, extractArchive(socket, targetDirectory));
     } else if (!command.isEmpty()) {
         qDebug() << "Unknown QAbstractFileEngine command:" << command;
     }
 }
 
+static QString extractArchiveFile(const QString &archivePath, const QString &targetDirectory,
+    Lib7z::ExtractCallback *callback)
+{
+    QFile archive(archivePath);
+    if (!archive.open(QIODevice::ReadOnly)) {
+        return QCoreApplication::translate("RemoteServerConnection",
+            "Cannot open archive \"%1\" for reading: %2").arg(archivePath, archive.errorString());
+    }
+
+    try {
+        Lib7z::initSevenZ();
+        Lib7z::extractArchive(&archive, targetDirectory, callback, QThread::idealThreadCount());
+    } catch (const Lib7z::SevenZipException &e) {
+        return e.message();
+    } catch (...) {
+        return QCoreApplication::translate("RemoteServerConnection",
+            "Unknown exception caught while extracting \"%1\".").arg(archivePath);
+    }
+    return QString();
+}
+
+/*!
+    Extracts the archive the file engine was set up with into \a targetDirectory, and returns
+    an empty string on success or the error message otherwise.
+
+    The extraction runs on worker threads, while this thread forwards the file names and the
+    progress to the client as \c Protocol::Progress frames. The client answers backup requests
+    for existing files with \c Protocol::Reply frames, and may send \c Protocol::Cancel.
+*/
+QString RemoteServerConnection::extractArchive(QIODevice *socket, const QString &targetDirectory)
+{
+    if (m_protocolVersion < Protocol::Version)
+        return tr("Extracting archives needs protocol version %1.").arg(Protocol::Version);
+
+    const Protocol::FrameHeader progress(Protocol::opcode(Protocol::Progress), 0,
+        m_request.requestId);
+
+    RemoteExtractCallback callback;
+    QFuture<QString> result = QtConcurrent::run(extractArchiveFile, m_engine->fileName(),
+        targetDirectory, static_cast<Lib7z::ExtractCallback *>(&callback));
+
+    forever {
+        const bool finished = result.isFinished();
+        foreach (const QByteArray &notification, callback.takeNotifications(finished ? 0 : 20))
+            sendFrame(socket, progress, notification);
+        socket->waitForBytesWritten(0);
+        if (finished)
+            break;
+
+        socket->waitForReadyRead(callback.isWaitingForAnswer() ? 20 : 0);
+
+        Protocol::FrameHeader header;
+        QByteArray data;
+        while (receiveFrame(socket, &header, &data)) {
+            if (header.opcode == Protocol::opcode(Protocol::Cancel)) {
+                callback.cancel();
+            } else if (header.opcode == Protocol::opcode(Protocol::Reply)) {
+                bool prepared = false;
+                QDataStream stream(data);
+                stream >> prepared;
+                callback.answer(prepared);
+            }
+        }
+    }
+    return result.result();
+}
+
 } // namespace QInstaller
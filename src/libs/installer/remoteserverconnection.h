@@ -29,7 +29,10 @@
 #ifndef REMOTESERVERCONNECTION_H
 #define REMOTESERVERCONNECTION_H
 
+#include "protocol.h"
+
 #include <QPointer>
+#include <QScopedPointer>
 #include <QThread>
 
 #include <QtCore/private/qfsfileengine_p.h>
@@ -37,6 +40,7 @@
 QT_BEGIN_NAMESPACE
 class QProcess;
 class QIODevice;
+class QLocalSocket;
 QT_END_NAMESPACE
 
 namespace QInstaller {
@@ -60,12 +64,17 @@ signals:
     void shutdownRequested();
 
 private:
+    bool handleCommand(QLocalSocket *socket, const QByteArray &cmd, QByteArray &data,
+                       QScopedPointer<PermissionSettings> *settings);
     template <typename T>
     void sendData(QIODevice *device, const T &arg);
+    template <typename T>
+    void sendData(QIODevice *device, const T &arg, bool failed);
     void handleQProcess(QIODevice *device, const QString &command, QDataStream &data);
     void handleQSettings(QIODevice *device, const QString &command, QDataStream &data,
                          PermissionSettings *settings);
     void handleQFSFileEngine(QIODevice *device, const QString &command, QDataStream &data);
+    QString extractArchive(QIODevice *socket, const QString &targetDirectory);
 
 private:
     qintptr m_socketDescriptor;
@@ -74,6 +83,11 @@ private:
     QFSFileEngine *m_engine;
     QString m_authorizationKey;
     QProcessSignalReceiver *m_signalReceiver;
+
+    bool m_authorized;
+    qint32 m_protocolVersion;
+    Protocol::FrameHeader m_request;
+    bool m_deferredFailure;
 };
 
 } // namespace QInstaller
@@ -29,11 +29,15 @@
 #ifndef REMOTESERVERCONNECTION_P_H
 #define REMOTESERVERCONNECTION_P_H
 
+#include "lib7z_extract.h"
 #include "protocol.h"
 
+#include <QDataStream>
+#include <QFileInfo>
 #include <QMutex>
 #include <QProcess>
 #include <QVariant>
+#include <QWaitCondition>
 
 namespace QInstaller {
 
@@ -124,6 +128,113 @@ private:
     QVariantList m_receivedSignals;
 };
 
+/*!
+    Collects the notifications of an archive extracted by the server, so the connection thread
+    can send them to the client as Protocol::Progress frames. The extraction workers only block
+    if an existing file needs to be backed up by the client.
+*/
+class RemoteExtractCallback : public Lib7z::ExtractCallback
+{
+    Q_DISABLE_COPY(RemoteExtractCallback)
+    friend class RemoteServerConnection;
+
+public:
+    RemoteExtractCallback() = default;
+
+private:
+    bool prepareForFile(const QString &filename) Q_DECL_OVERRIDE
+    {
+        const QFileInfo fi(filename);
+        if (!fi.exists() && !fi.isSymLink())
+            return true;
+
+        QMutexLocker _(&m_mutex);
+        m_notifications.append(notification(Protocol::ExtractProgress::PrepareForFile, filename));
+        m_waitingForAnswer = true;
+        m_condition.wakeAll();
+        while (m_waitingForAnswer && !m_canceled)
+            m_condition.wait(&m_mutex);
+        return m_answer && !m_canceled;
+    }
+
+    void setCurrentFile(const QString &filename) Q_DECL_OVERRIDE
+    {
+        QMutexLocker _(&m_mutex);
+        m_notifications.append(notification(Protocol::ExtractProgress::CurrentFile, filename));
+        m_condition.wakeAll();
+    }
+
+    HRESULT setCompleted(quint64 completed, quint64 total) Q_DECL_OVERRIDE
+    {
+        QMutexLocker _(&m_mutex);
+        m_completed = completed;
+        m_total = total;
+        m_progressChanged = true;
+        return m_canceled ? E_ABORT : S_OK;
+    }
+
+    template <typename T>
+    static QByteArray notification(Protocol::ExtractProgress type, const T &value)
+    {
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << static_cast<qint32>(type) << value;
+        return data;
+    }
+
+    // Called by the connection thread, waits up to msecs for new notifications.
+    QList<QByteArray> takeNotifications(int msecs)
+    {
+        QMutexLocker _(&m_mutex);
+        if (m_notifications.isEmpty() && !m_progressChanged && !m_waitingForAnswer)
+            m_condition.wait(&m_mutex, msecs);
+
+        QList<QByteArray> notifications;
+        notifications.swap(m_notifications);
+        if (m_progressChanged) {
+            QByteArray data;
+            QDataStream stream(&data, QIODevice::WriteOnly);
+            stream << static_cast<qint32>(Protocol::ExtractProgress::Completed) << m_completed
+                << m_total;
+            notifications.append(data);
+            m_progressChanged = false;
+        }
+        return notifications;
+    }
+
+    bool isWaitingForAnswer()
+    {
+        QMutexLocker _(&m_mutex);
+        return m_waitingForAnswer;
+    }
+
+    void answer(bool prepared)
+    {
+        QMutexLocker _(&m_mutex);
+        m_answer = prepared;
+        m_waitingForAnswer = false;
+        m_condition.wakeAll();
+    }
+
+    void cancel()
+    {
+        QMutexLocker _(&m_mutex);
+        m_canceled = true;
+        m_condition.wakeAll();
+    }
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    QList<QByteArray> m_notifications;
+    quint64 m_completed = 0;
+    quint64 m_total = 0;
+    bool m_progressChanged = false;
+    bool m_waitingForAnswer = false;
+    bool m_answer = false;
+    bool m_canceled = false;
+};
+
 } // namespace QInstaller
 
 #endif // REMOTESERVERCONNECTION_P_H
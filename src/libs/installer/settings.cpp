@@ -256,7 +256,8 @@ Settings Settings::fromFileAndPrefix(const QString &path, const QString &prefix,
                 << scWizardDefaultWidth << scWizardDefaultHeight
                 << scRepositorySettingsPageVisible << scTargetConfigurationFile
                 << scRemoteRepositories << scTranslations << scUrlQueryString << QLatin1String(scControlScript)
-                << scCreateLocalRepository << scInstallActionColumnVisible << scSupportsModify;
+                << scCreateLocalRepository << scInstallActionColumnVisible << scSupportsModify
+                << scMaxConcurrentDownloads << scExtractWhileDownloading << scServerSideExtraction;
 
     Settings s;
     s.d->m_data.insert(scPrefix, prefix);
@@ -743,3 +744,20 @@ bool Settings::supportsModify() const
 {
     return d->m_data.value(scSupportsModify, true).toBool();
 }
+
+int Settings::maxConcurrentDownloads() const
+{
+    bool ok = false;
+    const int count = d->m_data.value(scMaxConcurrentDownloads).toInt(&ok);
+    return (ok && count > 0) ? count : 1;
+}
+
+bool Settings::extractWhileDownloading() const
+{
+    return d->m_data.value(scExtractWhileDownloading, false).toBool();
+}
+
+bool Settings::serverSideExtraction() const
+{
+    return d->m_data.value(scServerSideExtraction, false).toBool();
+}
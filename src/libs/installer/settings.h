@@ -154,6 +154,10 @@ public:
 
     bool supportsModify() const;
 
+    int maxConcurrentDownloads() const;
+    bool extractWhileDownloading() const;
+    bool serverSideExtraction() const;
+
 private:
     class Private;
     QSharedDataPointer<Private> d;
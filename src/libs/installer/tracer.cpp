@@ -0,0 +1,297 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include "tracer.h"
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSaveFile>
+#include <QtCore/QThread>
+#include <QtCore/QThreadStorage>
+
+namespace QInstaller {
+
+namespace {
+
+struct TraceEvent
+{
+    TraceEvent() : category(0), name(0), start(0), duration(0) {}
+
+    const char *category;
+    const char *name;
+    QString detail;
+    qint64 start;
+    qint64 duration;
+};
+
+struct Chunk
+{
+    enum { Capacity = 1024 };
+
+    Chunk() : count(0), next(0) {}
+
+    TraceEvent events[Capacity];
+    QAtomicInt count;
+    QAtomicPointer<Chunk> next;
+};
+
+} // namespace
+
+/*
+    Events of one thread. Only the owning thread appends, each event is published by increasing
+    the chunk's count, so the writer never takes a lock and the reader only sees complete events.
+*/
+struct Tracer::ThreadBuffer
+{
+    ThreadBuffer(int i, const QString &n)
+        : id(i)
+        , name(n)
+        , first(new Chunk)
+        , last(first)
+    {}
+
+    ~ThreadBuffer()
+    {
+        Chunk *chunk = first;
+        while (chunk) {
+            Chunk *next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+    }
+
+    void append(const char *category, const char *name, qint64 start, qint64 duration,
+        const QString &detail)
+    {
+        int count = last->count.load();
+        if (count == Chunk::Capacity) {
+            Chunk *chunk = new Chunk;
+            last->next.storeRelease(chunk);
+            last = chunk;
+            count = 0;
+        }
+        TraceEvent &event = last->events[count];
+        event.category = category;
+        event.name = name;
+        event.detail = detail;
+        event.start = start;
+        event.duration = duration;
+        last->count.storeRelease(count + 1);
+    }
+
+    const int id;
+    const QString name;
+    Chunk *const first;
+    Chunk *last;    // only touched by the owning thread
+};
+
+struct Tracer::ThreadBufferRef
+{
+    ThreadBufferRef() : buffer(0) {}
+    ThreadBuffer *buffer;   // owned by the tracer, outlives the thread
+};
+
+QBasicAtomicInt Tracer::s_enabled = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+/*!
+    \class QInstaller::Tracer
+    \inmodule QtInstallerFramework
+    \brief The Tracer class records where the installer spends its time and writes it as a
+        Chrome trace-event file.
+
+    Spans are recorded with TraceSpan, or with addEvent() for work that finishes in a different
+    function than it started. Each thread appends to its own buffer without locking. The file
+    written by stop() can be opened in \c{chrome://tracing} or the Perfetto UI.
+
+    Tracing is disabled until start() is called. While disabled, a TraceSpan costs a single
+    atomic load.
+*/
+
+Tracer::Tracer()
+{
+}
+
+Tracer::~Tracer()
+{
+    qDeleteAll(m_buffers);
+}
+
+/*!
+    Returns the tracer used by the installer.
+*/
+Tracer *Tracer::instance()
+{
+    static Tracer instance;
+    return &instance;
+}
+
+/*!
+    Returns the name of the file the trace is written to.
+*/
+QString Tracer::fileName() const
+{
+    QMutexLocker _(&m_mutex);
+    return m_fileName;
+}
+
+/*!
+    Enables tracing. The trace is written to \a fileName when stop() is called.
+*/
+void Tracer::start(const QString &fileName)
+{
+    QMutexLocker _(&m_mutex);
+    m_fileName = QDir::fromNativeSeparators(QDir().absoluteFilePath(fileName));
+    if (!m_timer.isValid())
+        m_timer.start();
+    s_enabled.store(1);
+}
+
+/*!
+    Disables tracing and writes the events recorded so far to fileName(). Returns \c true on
+    success or if tracing was not enabled.
+*/
+bool Tracer::stop()
+{
+    if (!s_enabled.testAndSetOrdered(1, 0))
+        return true;
+
+    const bool success = write();
+    if (success) {
+        qDebug().noquote() << "Wrote performance trace to"
+            << QDir::toNativeSeparators(fileName());
+    }
+    return success;
+}
+
+/*!
+    Records an event of \a category named \a name that started at \a start, as returned by now(),
+    and ends now. The optional \a detail, for example a file name, is shown with the event.
+    Nothing is recorded if tracing is disabled or \a start is negative.
+
+    \a category and \a name must point to string literals, they are not copied.
+*/
+void Tracer::addEvent(const char *category, const char *name, qint64 start, const QString &detail)
+{
+    if (start < 0 || !isEnabled())
+        return;
+    threadBuffer()->append(category, name, start, elapsed() - start, detail);
+}
+
+Tracer::ThreadBuffer *Tracer::threadBuffer()
+{
+    static QThreadStorage<ThreadBufferRef> buffers;
+    ThreadBufferRef &ref = buffers.localData();
+    if (!ref.buffer) {
+        QThread *thread = QThread::currentThread();
+        QString name = thread->objectName();
+        if (qApp && thread == qApp->thread())
+            name = QLatin1String("main");
+
+        QMutexLocker _(&m_mutex);
+        const int id = m_buffers.count() + 1;
+        if (name.isEmpty())
+            name = QString::fromLatin1("thread %1").arg(id);
+        ref.buffer = new ThreadBuffer(id, name);
+        m_buffers.append(ref.buffer);
+    }
+    return ref.buffer;
+}
+
+/*
+    Returns the microseconds since tracing was started.
+*/
+qint64 Tracer::elapsed() const
+{
+    return m_timer.nsecsElapsed() / 1000;
+}
+
+bool Tracer::write() const
+{
+    QMutexLocker _(&m_mutex);
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QJsonArray events;
+    QJsonObject processName;
+    processName.insert(QLatin1String("name"), QLatin1String("process_name"));
+    processName.insert(QLatin1String("ph"), QLatin1String("M"));
+    processName.insert(QLatin1String("pid"), pid);
+    processName.insert(QLatin1String("args"), QJsonObject{ { QLatin1String("name"),
+        QCoreApplication::applicationName() } });
+    events.append(processName);
+
+    foreach (const ThreadBuffer *buffer, m_buffers) {
+        QJsonObject threadName;
+        threadName.insert(QLatin1String("name"), QLatin1String("thread_name"));
+        threadName.insert(QLatin1String("ph"), QLatin1String("M"));
+        threadName.insert(QLatin1String("pid"), pid);
+        threadName.insert(QLatin1String("tid"), buffer->id);
+        threadName.insert(QLatin1String("args"), QJsonObject{ { QLatin1String("name"),
+            buffer->name } });
+        events.append(threadName);
+
+        for (const Chunk *chunk = buffer->first; chunk; chunk = chunk->next.loadAcquire()) {
+            const int count = chunk->count.loadAcquire();
+            for (int i = 0; i < count; ++i) {
+                const TraceEvent &event = chunk->events[i];
+                QJsonObject object;
+                object.insert(QLatin1String("name"), QLatin1String(event.name));
+                object.insert(QLatin1String("cat"), QLatin1String(event.category));
+                object.insert(QLatin1String("ph"), QLatin1String("X"));
+                object.insert(QLatin1String("ts"), event.start);
+                object.insert(QLatin1String("dur"), event.duration);
+                object.insert(QLatin1String("pid"), pid);
+                object.insert(QLatin1String("tid"), buffer->id);
+                if (!event.detail.isEmpty()) {
+                    object.insert(QLatin1String("args"), QJsonObject{ { QLatin1String("detail"),
+                        event.detail } });
+                }
+                events.append(object);
+            }
+        }
+    }
+
+    QJsonObject root;
+    root.insert(QLatin1String("traceEvents"), events);
+    root.insert(QLatin1String("displayTimeUnit"), QLatin1String("ms"));
+
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) < 0 || !file.commit()) {
+        qWarning().noquote() << "Cannot write performance trace to"
+            << QDir::toNativeSeparators(m_fileName) << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+} // namespace QInstaller
@@ -0,0 +1,117 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "installer_global.h"
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+namespace QInstaller {
+
+class INSTALLER_EXPORT Tracer
+{
+    Q_DISABLE_COPY(Tracer)
+
+public:
+    static Tracer *instance();
+
+    static bool isEnabled() { return s_enabled.load() != 0; }
+    static qint64 now() { return isEnabled() ? instance()->elapsed() : -1; }
+
+    QString fileName() const;
+    void start(const QString &fileName);
+    bool stop();
+
+    void addEvent(const char *category, const char *name, qint64 start,
+        const QString &detail = QString());
+
+private:
+    Tracer();
+    ~Tracer();
+
+    struct ThreadBuffer;
+    struct ThreadBufferRef;
+    ThreadBuffer *threadBuffer();
+    qint64 elapsed() const;
+    bool write() const;
+
+private:
+    static QBasicAtomicInt s_enabled;
+
+    mutable QMutex m_mutex;
+    QString m_fileName;
+    QElapsedTimer m_timer;
+    QList<ThreadBuffer *> m_buffers;
+};
+
+class TraceSpan
+{
+    Q_DISABLE_COPY(TraceSpan)
+
+public:
+    TraceSpan(const char *category, const char *name)
+        : m_category(category)
+        , m_name(name)
+        , m_start(Tracer::now())
+    {}
+
+    TraceSpan(const char *category, const char *name, const QString &detail)
+        : m_category(category)
+        , m_name(name)
+        , m_start(Tracer::now())
+    {
+        if (m_start >= 0)
+            m_detail = detail;
+    }
+
+    ~TraceSpan()
+    {
+        if (m_start >= 0)
+            Tracer::instance()->addEvent(m_category, m_name, m_start, m_detail);
+    }
+
+    bool isActive() const { return m_start >= 0; }
+    void setDetail(const QString &detail) { m_detail = detail; }
+
+private:
+    const char *const m_category;
+    const char *const m_name;
+    const qint64 m_start;
+    QString m_detail;
+};
+
+} // namespace QInstaller
+
+#endif // TRACER_H
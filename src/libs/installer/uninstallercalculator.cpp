@@ -31,6 +31,7 @@
 #include "component.h"
 #include "packagemanagercore.h"
 #include "globals.h"
+#include "tracer.h"
 
 #include <QDebug>
 
@@ -67,6 +68,7 @@ void UninstallerCalculator::appendComponentToUninstall(Component *component)
 
 void UninstallerCalculator::appendComponentsToUninstall(const QList<Component*> &components)
 {
+    TraceSpan span("calculator", "Calculate components to uninstall");
     foreach (Component *component, components)
         appendComponentToUninstall(component);
 
@@ -28,12 +28,20 @@
 
 #include "utils.h"
 
+#include "lib7z_create.h"
+#include "lib7z_facade.h"
+#include "remoteclient.h"
+
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDir>
+#include <QFileInfo>
+#include <QMutex>
 #include <QProcessEnvironment>
+#include <QTemporaryFile>
 #include <QThread>
 #include <QVector>
+#include <QWaitCondition>
 
 #if defined(Q_OS_WIN) || defined(Q_OS_WINCE)
 #   include "qt_windows.h"
@@ -146,7 +154,7 @@ QByteArray QInstaller::calculateHash(QIODevice *device, QCryptographicHash::Algo
 {
     Q_ASSERT(device);
     QCryptographicHash hash(algo);
-    static QByteArray buffer(1024 * 1024, '\0');
+    QByteArray buffer(1024 * 1024, '\0');
     while (true) {
         const qint64 numRead = device->read(buffer.data(), buffer.size());
         if (numRead <= 0)
@@ -205,54 +213,653 @@ QString QInstaller::replaceWindowsEnvironmentVariables(const QString &str)
     return res;
 }
 
+namespace QInstaller {
+
+static const qint64 scMaxQueuedBytes = 1024 * 1024;   // appendLine() waits for the writer beyond this
+static const qint64 scMaxBufferedBytes = 1024 * 1024; // pending lines spill into a temporary file beyond this
+static const qint64 scCopyChunkSize = 1024 * 1024;
+static const int scDefaultRotatedFileCount = 5;
+static const QIODevice::OpenMode scLogFileOpenMode = QIODevice::ReadWrite | QIODevice::Append
+    | QIODevice::Text;
+
+/*
+    Writes the verbose log on a background thread. As long as the log file is unknown, the lines
+    are kept in memory and, once that grows too large, in a temporary file. As soon as the log
+    file is set and can be opened, the pending lines are written to it and every following line
+    is appended as it arrives, so neither the installer thread nor the memory usage depend on how
+    much is logged.
+*/
+class VerboseWriterPrivate : public QThread
+{
+public:
+    VerboseWriterPrivate()
+        : m_header(QString(QLatin1String("************************************* Invoked: ")
+            + QDateTime::currentDateTime().toString() + QLatin1String("\n")).toLocal8Bit())
+        , m_queuedBytes(0)
+        , m_started(false)
+        , m_idle(true)
+        , m_parked(false)
+        , m_stopping(false)
+        , m_closed(false)
+        , m_fileNameChanged(false)
+        , m_streamFile(false)
+        , m_maxFileSize(0)
+        , m_rotatedFileCount(scDefaultRotatedFileCount)
+        , m_compressRotatedFiles(false)
+        , m_spillFailed(false)
+        , m_logFileExisted(false)
+        , m_logFileStart(0)
+        , m_logFileBodyStart(0)
+        , m_logFileSize(0)
+        , m_writerMaxFileSize(0)
+        , m_writerRotatedFileCount(scDefaultRotatedFileCount)
+    {
+        setObjectName(QLatin1String("VerboseWriter"));
+    }
+
+    ~VerboseWriterPrivate()
+    {
+        stop();
+    }
+
+    void append(const QByteArray &line);
+    void setFileName(const QString &fileName, bool stream);
+    QString fileName();
+    bool isClosed();
+
+    void setMaxFileSize(qint64 maxFileSize);
+    int rotatedFileCount();
+    void setRotatedFileCount(int count);
+    void setCompressRotatedFiles(bool compress);
+
+    void pause();
+    void resume(bool close);
+    bool writePendingLines(VerboseWriterOutput *output, const QString &fileName);
+    void compressRotatedFiles(const QString &fileName);
+    void stop();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    void startLocked();
+    void openLogFile(const QString &fileName, bool stream);
+    bool ensureLogFileOpen();
+    void releaseLogFile();
+    bool writeBufferedLines(VerboseWriterOutput *output, const QString &fileName,
+        const QByteArray &header);
+    void write(const QByteArray &data);
+    void writeToLogFile(const QByteArray &data);
+    void buffer(const QByteArray &data);
+    void rotate();
+    QString rotatedFileName(const QString &fileName, int index, bool compressed) const;
+
+private:
+    const QByteArray m_header;
+
+    // guarded by m_mutex
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+    QList<QByteArray> m_queue;
+    qint64 m_queuedBytes;
+    bool m_started;
+    bool m_idle;
+    bool m_parked;
+    bool m_stopping;
+    bool m_closed;
+    bool m_fileNameChanged;
+    bool m_streamFile;
+    QString m_fileName;
+    qint64 m_maxFileSize;
+    int m_rotatedFileCount;
+    bool m_compressRotatedFiles;
+
+    // owned by the writer thread, or by the caller of pause() until resume()
+    QByteArray m_buffer;
+    QScopedPointer<QTemporaryFile> m_spillFile;
+    bool m_spillFailed;
+    QScopedPointer<QFile> m_logFile; // set while streaming, closed if it cannot be (re)opened
+    QString m_logFileName;
+    bool m_logFileExisted;
+    qint64 m_logFileStart;      // size of the log file before this run wrote to it
+    qint64 m_logFileBodyStart;  // position of the first line after the header
+    qint64 m_logFileSize;
+    qint64 m_writerMaxFileSize;
+    int m_writerRotatedFileCount;
+};
+
+void VerboseWriterPrivate::append(const QByteArray &line)
+{
+    QMutexLocker _(&m_mutex);
+    if (m_closed)
+        return;
+
+    // Keep the queue bounded, unless the writer can't drain it right now or is the one logging.
+    while (m_queuedBytes > scMaxQueuedBytes && !m_parked && !m_stopping
+        && QThread::currentThread() != this) {
+        m_condition.wait(&m_mutex);
+    }
+    m_queue.append(line);
+    m_queuedBytes += line.size();
+    startLocked();
+    m_condition.wakeAll();
+}
+
+void VerboseWriterPrivate::setFileName(const QString &fileName, bool stream)
+{
+    QMutexLocker _(&m_mutex);
+    m_fileName = fileName;
+    m_streamFile = stream;
+    m_fileNameChanged = true;
+    startLocked();
+    m_condition.wakeAll();
+}
+
+QString VerboseWriterPrivate::fileName()
+{
+    QMutexLocker _(&m_mutex);
+    return m_fileName;
+}
+
+bool VerboseWriterPrivate::isClosed()
+{
+    QMutexLocker _(&m_mutex);
+    return m_closed;
+}
+
+void VerboseWriterPrivate::setMaxFileSize(qint64 maxFileSize)
+{
+    QMutexLocker _(&m_mutex);
+    m_maxFileSize = maxFileSize;
+}
+
+int VerboseWriterPrivate::rotatedFileCount()
+{
+    QMutexLocker _(&m_mutex);
+    return m_rotatedFileCount;
+}
+
+void VerboseWriterPrivate::setRotatedFileCount(int count)
+{
+    QMutexLocker _(&m_mutex);
+    m_rotatedFileCount = count;
+}
+
+void VerboseWriterPrivate::setCompressRotatedFiles(bool compress)
+{
+    QMutexLocker _(&m_mutex);
+    m_compressRotatedFiles = compress;
+}
+
+/*
+    Waits until every queued line and file name change has been handled by the writer thread
+    and keeps the thread from picking up new ones, so that the caller may access the writer owned
+    state until resume().
+*/
+void VerboseWriterPrivate::pause()
+{
+    QMutexLocker _(&m_mutex);
+    while (m_started && !m_stopping && (!m_idle || !m_queue.isEmpty() || m_fileNameChanged))
+        m_condition.wait(&m_mutex);
+    m_parked = true;
+}
+
+void VerboseWriterPrivate::resume(bool close)
+{
+    if (close) {
+        m_buffer.clear();
+        m_spillFile.reset();
+        m_logFile.reset();
+    }
+
+    QMutexLocker _(&m_mutex);
+    if (close) {
+        m_closed = true;
+        m_queue.clear();
+        m_queuedBytes = 0;
+    }
+    m_parked = false;
+    m_condition.wakeAll();
+}
+
+/*
+    Must be called between pause() and resume(). Returns true if all lines logged so far ended up
+    in \a fileName, either because they were streamed there already or because \a output wrote
+    them.
+*/
+bool VerboseWriterPrivate::writePendingLines(VerboseWriterOutput *output, const QString &fileName)
+{
+    if (!m_logFile.isNull() && m_logFileName == fileName) {
+        if (ensureLogFileOpen())
+            return m_logFile->flush();
+        return writeBufferedLines(output, fileName, QByteArray()); // the header is there already
+    }
+    return writeBufferedLines(output, fileName, m_header);
+}
+
+/*
+    Must be called between pause() and resume(). Compresses the rotated segments of \a fileName
+    into 7z archives, if requested. This is done on the calling thread at the end of the run
+    instead of on the writer thread while rotating, so that Lib7z is never used concurrently.
+*/
+void VerboseWriterPrivate::compressRotatedFiles(const QString &fileName)
+{
+    int count = 0;
+    {
+        QMutexLocker _(&m_mutex);
+        if (!m_compressRotatedFiles)
+            return;
+        count = qMax(1, m_rotatedFileCount);
+    }
+
+    for (int i = 1; i <= count; ++i) {
+        const QString rotated = rotatedFileName(fileName, i, false);
+        if (!QFileInfo::exists(rotated))
+            continue;
+        try {
+            Lib7z::createArchive(rotatedFileName(fileName, i, true), QStringList(rotated),
+                Lib7z::QTmpFile::No);
+            QFile::remove(rotated);
+        } catch (const Lib7z::SevenZipException &) {
+            // keep the uncompressed file
+        }
+    }
+}
+
+void VerboseWriterPrivate::stop()
+{
+    {
+        QMutexLocker _(&m_mutex);
+        m_stopping = true;
+        m_condition.wakeAll();
+    }
+    wait();
+}
+
+void VerboseWriterPrivate::run()
+{
+    forever {
+        QList<QByteArray> lines;
+        QString fileName;
+        bool fileNameChanged = false;
+        bool streamFile = false;
+        {
+            QMutexLocker _(&m_mutex);
+            while (!m_stopping && (m_parked || (m_queue.isEmpty() && !m_fileNameChanged))) {
+                m_idle = true;
+                m_condition.wakeAll();
+                m_condition.wait(&m_mutex);
+            }
+            if (m_stopping) {
+                m_idle = true;
+                m_condition.wakeAll();
+                return;
+            }
+            m_idle = false;
+            lines.swap(m_queue);
+            m_queuedBytes = 0;
+            fileNameChanged = m_fileNameChanged;
+            m_fileNameChanged = false;
+            fileName = m_fileName;
+            streamFile = m_streamFile;
+            m_writerMaxFileSize = m_maxFileSize;
+            m_writerRotatedFileCount = m_rotatedFileCount;
+            m_condition.wakeAll(); // there is room in the queue again
+        }
+
+        if (fileNameChanged)
+            openLogFile(fileName, streamFile);
+
+        // line by line, so that rotation happens at line boundaries; QFile buffers the writes
+        foreach (const QByteArray &line, lines)
+            write(line);
+
+        if (!m_logFile.isNull() && m_logFile->isOpen())
+            m_logFile->flush();
+    }
+}
+
+void VerboseWriterPrivate::startLocked()
+{
+    if (m_started)
+        return;
+    m_started = true;
+    start(QThread::LowPriority);
+}
+
+/*
+    Starts streaming to \a fileName if \a stream is true. If another file was streamed to before,
+    what this run wrote into it is taken back first. An empty \a fileName only does the latter.
+    A file that is streamed to already stays open, it was opened with the local file engine.
+*/
+void VerboseWriterPrivate::openLogFile(const QString &fileName, bool stream)
+{
+    if (!m_logFile.isNull() && m_logFileName == fileName)
+        return;
+    releaseLogFile();
+
+    if (fileName.isEmpty() || !stream)
+        return;
+    // If the installer installed nothing, there is no target directory to save the log file to.
+    if (!QFileInfo(fileName).absoluteDir().exists())
+        return;
+
+    QScopedPointer<QFile> file(new QFile(fileName));
+    const bool existed = file->exists();
+    // On failure, e.g. missing access rights, flush() retries with its own output.
+    if (!file->open(scLogFileOpenMode))
+        return;
+
+    m_logFile.swap(file);
+    m_logFileName = fileName;
+    m_logFileExisted = existed;
+    m_logFileStart = m_logFile->size();
+    m_logFile->write(m_header);
+    m_logFile->flush();
+    m_logFileBodyStart = m_logFile->size();
+    m_logFileSize = m_logFileBodyStart;
+
+    // the lines logged before the file was known
+    QByteArray pending;
+    pending.swap(m_buffer);
+    QScopedPointer<QTemporaryFile> spillFile;
+    spillFile.swap(m_spillFile);
+    m_spillFailed = false;
+
+    write(pending);
+    if (!spillFile.isNull()) {
+        spillFile->seek(0);
+        while (!spillFile->atEnd())
+            write(spillFile->read(scCopyChunkSize));
+    }
+}
+
+/*
+    Opens the log file again if that failed after a rotation, and writes the lines that were
+    buffered meanwhile. Returns true if the file is open.
+*/
+bool VerboseWriterPrivate::ensureLogFileOpen()
+{
+    if (m_logFile->isOpen())
+        return true;
+    if (!m_logFile->open(scLogFileOpenMode))
+        return false;
+    m_logFileSize = m_logFile->size();
+
+    QByteArray pending;
+    pending.swap(m_buffer);
+    QScopedPointer<QTemporaryFile> spillFile;
+    spillFile.swap(m_spillFile);
+    m_spillFailed = false;
+
+    writeToLogFile(pending);
+    if (!spillFile.isNull()) {
+        spillFile->seek(0);
+        while (!spillFile->atEnd())
+            writeToLogFile(spillFile->read(scCopyChunkSize));
+    }
+    return m_logFile->isOpen();
+}
+
+/*
+    Stops streaming to the current log file and moves what this run wrote into it back into the
+    buffer, leaving the file as it was before. Segments rotated away in the meantime stay.
+*/
+void VerboseWriterPrivate::releaseLogFile()
+{
+    if (m_logFile.isNull())
+        return;
+
+    QScopedPointer<QFile> logFile;
+    logFile.swap(m_logFile);
+    const QString fileName = m_logFileName;
+    m_logFileName.clear();
+    logFile->close();
+
+    // lines buffered while the file could not be opened follow the ones written to it
+    QByteArray pending;
+    pending.swap(m_buffer);
+    QScopedPointer<QTemporaryFile> spillFile;
+    spillFile.swap(m_spillFile);
+    m_spillFailed = false;
+
+    QFile written(fileName);
+    if (written.open(QIODevice::ReadOnly | QIODevice::Text) && written.seek(m_logFileBodyStart)) {
+        while (!written.atEnd())
+            buffer(written.read(scCopyChunkSize));
+    }
+    written.close();
+
+    buffer(pending);
+    if (!spillFile.isNull()) {
+        spillFile->seek(0);
+        while (!spillFile->atEnd())
+            buffer(spillFile->read(scCopyChunkSize));
+    }
+
+    if (!m_logFileExisted && m_logFileStart == 0)
+        QFile::remove(fileName);
+    else
+        QFile::resize(fileName, m_logFileStart);
+}
+
+bool VerboseWriterPrivate::writeBufferedLines(VerboseWriterOutput *output,
+    const QString &fileName, const QByteArray &header)
+{
+    if (!output->write(fileName, scLogFileOpenMode, header + m_buffer))
+        return false;
+    if (m_spillFile.isNull())
+        return true;
+
+    bool success = m_spillFile->seek(0);
+    while (success && !m_spillFile->atEnd())
+        success = output->write(fileName, scLogFileOpenMode, m_spillFile->read(scCopyChunkSize));
+    m_spillFile->seek(m_spillFile->size());
+    return success;
+}
+
+void VerboseWriterPrivate::write(const QByteArray &data)
+{
+    if (data.isEmpty())
+        return;
+
+    if (!m_logFile.isNull() && ensureLogFileOpen())
+        writeToLogFile(data);
+    else
+        buffer(data);
+}
+
+void VerboseWriterPrivate::writeToLogFile(const QByteArray &data)
+{
+    if (data.isEmpty())
+        return;
+
+    if (m_writerMaxFileSize > 0 && m_logFileSize > 0
+        && m_logFileSize + data.size() > m_writerMaxFileSize) {
+        rotate();
+    }
+    if (!m_logFile->isOpen()) {
+        buffer(data); // written by ensureLogFileOpen() once the file can be opened again
+        return;
+    }
+    m_logFile->write(data);
+    m_logFileSize += data.size();
+}
+
+void VerboseWriterPrivate::buffer(const QByteArray &data)
+{
+    if (data.isEmpty())
+        return;
+
+    if (!m_spillFile.isNull()) {
+        m_spillFile->write(data);
+        return;
+    }
+
+    m_buffer.append(data);
+    if (m_buffer.size() <= scMaxBufferedBytes || m_spillFailed)
+        return;
+
+    QScopedPointer<QTemporaryFile> file(new QTemporaryFile(QDir::tempPath()
+        + QLatin1String("/installerlog-XXXXXX.txt")));
+    if (file->open() && file->write(m_buffer) == m_buffer.size()) {
+        m_spillFile.swap(file);
+        m_buffer.clear();
+    } else {
+        m_spillFailed = true; // keep everything in memory
+    }
+}
+
+/*
+    Moves the current log file to log.1, log.1 to log.2 and so on, dropping the oldest one, and
+    starts a new log file. Compressed segments of earlier runs, log.1.7z and so on, are shifted
+    as well. If the new file cannot be opened, it stays closed and ensureLogFileOpen() retries
+    with the next lines.
+*/
+void VerboseWriterPrivate::rotate()
+{
+    m_logFile->close();
+
+    const int count = qMax(1, m_writerRotatedFileCount);
+    QFile::remove(rotatedFileName(m_logFileName, count, false));
+    QFile::remove(rotatedFileName(m_logFileName, count, true));
+    for (int i = count - 1; i > 0; --i) {
+        QFile::rename(rotatedFileName(m_logFileName, i, false),
+            rotatedFileName(m_logFileName, i + 1, false));
+        QFile::rename(rotatedFileName(m_logFileName, i, true),
+            rotatedFileName(m_logFileName, i + 1, true));
+    }
+
+    if (QFile::rename(m_logFileName, rotatedFileName(m_logFileName, 1, false))) {
+        // nothing of this run can be taken back from the new file beyond its start
+        m_logFileExisted = false;
+        m_logFileStart = 0;
+        m_logFileBodyStart = 0;
+    }
+
+    if (m_logFile->open(scLogFileOpenMode)) {
+        // if renaming failed, don't retry before another maxFileSize bytes got written
+        m_logFileSize = 0;
+    }
+}
+
+QString VerboseWriterPrivate::rotatedFileName(const QString &fileName, int index,
+    bool compressed) const
+{
+    return fileName + QLatin1Char('.') + QString::number(index)
+        + (compressed ? QLatin1String(".7z") : QLatin1String(""));
+}
+
+} // namespace QInstaller
+
+
+/*!
+    \class QInstaller::VerboseWriter
+    \inmodule QtInstallerFramework
+    \brief The VerboseWriter class collects the verbose output and writes it to the log file.
+
+    Lines are written on a background thread. Until the log file name is set, they are kept in
+    memory and, if they grow too large, in a temporary file. Once the log file can be opened, all
+    lines are appended to it as they arrive.
+*/
+
 QInstaller::VerboseWriter::VerboseWriter()
+    : d(new VerboseWriterPrivate)
 {
-    preFileBuffer.open(QIODevice::ReadWrite);
-    stream.setDevice(&preFileBuffer);
-    currentDateTimeAsString = QDateTime::currentDateTime().toString();
 }
 
 QInstaller::VerboseWriter::~VerboseWriter()
 {
-    if (preFileBuffer.isOpen()) {
+    if (!d->isClosed()) {
         PlainVerboseWriterOutput output;
         (void)flush(&output);
     }
+    delete d;
 }
 
+/*!
+    Makes sure all lines logged so far end up in the log file, using \a output to write the lines
+    that could not be streamed to it yet, and compresses rotated log files if requested. Returns
+    \c true on success or if there is nothing to write to; otherwise returns \c false. After a
+    successful call, further lines are dropped.
+*/
 bool QInstaller::VerboseWriter::flush(VerboseWriterOutput *output)
 {
-    stream.flush();
+    const QString logFileName = d->fileName();
     if (logFileName.isEmpty()) // binarycreator
         return true;
-    if (!preFileBuffer.isOpen())
+    if (d->isClosed())
         return true;
     //if the installer installed nothing - there is no target directory - where the logfile can be saved
     if (!QFileInfo(logFileName).absoluteDir().exists())
         return true;
 
-    QString logInfo;
-    logInfo += QLatin1String("************************************* Invoked: ");
-    logInfo += currentDateTimeAsString;
-    logInfo += QLatin1String("\n");
+    d->pause();
+    const bool success = d->writePendingLines(output, logFileName);
+    if (success)
+        d->compressRotatedFiles(logFileName);
+    d->resume(success);
+    return success;
+}
 
-    QBuffer buffer;
-    buffer.open(QIODevice::WriteOnly);
-    buffer.write(logInfo.toLocal8Bit());
-    buffer.write(preFileBuffer.data());
-    buffer.close();
+/*!
+    Sets the log file to \a fileName. The lines logged so far are written to it in the background,
+    as are all following ones.
 
-    if (output->write(logFileName, QIODevice::ReadWrite | QIODevice::Append | QIODevice::Text, buffer.data())) {
-        preFileBuffer.close();
-        stream.setDevice(0);
-        return true;
-    }
-    return false;
+    While the remote client is active, the file would be opened through the elevated server on
+    the writer thread, and the lines written after admin rights are dropped would be lost. The
+    lines are kept then, and flush() writes them with its output.
+*/
+void QInstaller::VerboseWriter::setFileName(const QString &fileName)
+{
+    d->setFileName(fileName, !RemoteClient::instance().isActive());
 }
 
-void QInstaller::VerboseWriter::setFileName(const QString &fileName)
+/*!
+    Stops writing to the log file set with setFileName() and takes back what was written to it,
+    so that the file is left as it was before, for example before rolling back an installation
+    removes its directory. The lines are kept until a log file is set again. Returns once the
+    file is closed.
+*/
+void QInstaller::VerboseWriter::releaseFile()
+{
+    d->setFileName(QString(), false);
+    d->pause();
+    d->resume(false);
+}
+
+/*!
+    Rotates the log file once it would grow beyond \a maxFileSize bytes. \c 0, the default,
+    disables the rotation.
+*/
+void QInstaller::VerboseWriter::setMaxFileSize(qint64 maxFileSize)
+{
+    d->setMaxFileSize(maxFileSize);
+}
+
+/*!
+    Returns the number of rotated log files that are kept.
+*/
+int QInstaller::VerboseWriter::rotatedFileCount() const
+{
+    return d->rotatedFileCount();
+}
+
+/*!
+    Keeps up to \a count rotated log files. The default is \c 5.
+*/
+void QInstaller::VerboseWriter::setRotatedFileCount(int count)
+{
+    d->setRotatedFileCount(count);
+}
+
+/*!
+    Compresses rotated log files into 7z archives if \a compress is \c true. The files are
+    compressed when the log is flushed at the end of the run.
+*/
+void QInstaller::VerboseWriter::setCompressRotatedFiles(bool compress)
 {
-    logFileName = fileName;
+    d->setCompressRotatedFiles(compress);
 }
 
 
@@ -265,7 +872,9 @@ QInstaller::VerboseWriter *QInstaller::VerboseWriter::instance()
 
 void QInstaller::VerboseWriter::appendLine(const QString &msg)
 {
-    stream << msg << endl;
+    QByteArray line = msg.toLocal8Bit();
+    line.append('\n');
+    d->append(line);
 }
 
 QInstaller::VerboseWriterOutput::~VerboseWriterOutput()
@@ -82,8 +82,11 @@ namespace QInstaller {
         virtual bool write(const QString &fileName, QIODevice::OpenMode openMode, const QByteArray &data);
     };
 
+    class VerboseWriterPrivate;
     class INSTALLER_EXPORT VerboseWriter
     {
+        Q_DISABLE_COPY(VerboseWriter)
+
     public:
         VerboseWriter();
         ~VerboseWriter();
@@ -94,12 +97,15 @@ namespace QInstaller {
 
         void appendLine(const QString &msg);
         void setFileName(const QString &fileName);
+        void releaseFile();
+
+        void setMaxFileSize(qint64 maxFileSize);
+        int rotatedFileCount() const;
+        void setRotatedFileCount(int count);
+        void setCompressRotatedFiles(bool compress);
 
     private:
-        QTextStream stream;
-        QBuffer preFileBuffer;
-        QString logFileName;
-        QString currentDateTimeAsString;
+        VerboseWriterPrivate *const d;
     };
 
 }
@@ -221,6 +221,7 @@ struct KDUpdater::FileDownloader::Private
     QAuthenticator m_authenticator;
     FileDownloaderProxyFactory *m_factory;
     bool m_ignoreSslErrors;
+    QPointer<QNetworkAccessManager> m_networkAccessManager;
 };
 
 /*!
@@ -611,6 +612,26 @@ void KDUpdater::FileDownloader::setIgnoreSslErrors(bool ignore)
     d->m_ignoreSslErrors = ignore;
 }
 
+/*!
+    Returns the network access manager set with setNetworkAccessManager(), or \c 0 if the
+    downloader uses its own.
+*/
+QNetworkAccessManager *KDUpdater::FileDownloader::networkAccessManager() const
+{
+    return d->m_networkAccessManager;
+}
+
+/*!
+    Sets the network access manager used to issue requests to \a manager. Downloaders that share
+    one manager also share its connection cache, so consecutive or parallel requests to the same
+    host can reuse kept-alive connections. The downloader does not take ownership of \a manager.
+    This might only be of use for HTTP or FTP requests.
+*/
+void KDUpdater::FileDownloader::setNetworkAccessManager(QNetworkAccessManager *manager)
+{
+    d->m_networkAccessManager = manager;
+}
+
 // -- KDUpdater::LocalFileDownloader
 
 /*!
@@ -1056,6 +1077,13 @@ struct KDUpdater::HttpDownloader::Private
     bool aborted;
     int m_authenticationCount;
 
+    QNetworkAccessManager *networkManager()
+    {
+        if (QNetworkAccessManager *shared = q->networkAccessManager())
+            return shared;
+        return &manager;
+    }
+
     void shutDown()
     {
         disconnect(http, &QNetworkReply::finished, q, &HttpDownloader::httpReqFinished);
@@ -1075,12 +1103,6 @@ KDUpdater::HttpDownloader::HttpDownloader(QObject *parent)
     : KDUpdater::FileDownloader(QLatin1String("http"), parent)
     , d(new Private(this))
 {
-#ifndef QT_NO_SSL
-    connect(&d->manager, &QNetworkAccessManager::sslErrors,
-            this, &HttpDownloader::onSslErrors);
-#endif
-    connect(&d->manager, &QNetworkAccessManager::authenticationRequired,
-            this, &HttpDownloader::onAuthenticationRequired);
 }
 
 /*!
@@ -1301,8 +1323,18 @@ void KDUpdater::HttpDownloader::timerEvent(QTimerEvent *event)
 void KDUpdater::HttpDownloader::startDownload(const QUrl &url)
 {
     d->m_authenticationCount = 0;
-    d->manager.setProxyFactory(proxyFactory());
-    d->http = d->manager.get(QNetworkRequest(url));
+
+    // The manager might be shared with other downloaders, the slots filter for our own reply.
+    QNetworkAccessManager *manager = d->networkManager();
+#ifndef QT_NO_SSL
+    connect(manager, &QNetworkAccessManager::sslErrors, this, &HttpDownloader::onSslErrors,
+        Qt::UniqueConnection);
+#endif
+    connect(manager, &QNetworkAccessManager::authenticationRequired,
+        this, &HttpDownloader::onAuthenticationRequired, Qt::UniqueConnection);
+
+    manager->setProxyFactory(proxyFactory());
+    d->http = manager->get(QNetworkRequest(url));
 
     connect(d->http, &QIODevice::readyRead, this, &HttpDownloader::httpReadyRead);
     connect(d->http, &QNetworkReply::downloadProgress,
@@ -1331,7 +1363,9 @@ void KDUpdater::HttpDownloader::startDownload(const QUrl &url)
 
 void KDUpdater::HttpDownloader::onAuthenticationRequired(QNetworkReply *reply, QAuthenticator *authenticator)
 {
-    Q_UNUSED(reply)
+    if (reply != d->http)
+        return;
+
     // first try with the information we have already
     if (d->m_authenticationCount == 0) {
         d->m_authenticationCount++;
@@ -1372,7 +1406,9 @@ void KDUpdater::HttpDownloader::onAuthenticationRequired(QNetworkReply *reply, Q
 
 void KDUpdater::HttpDownloader::onSslErrors(QNetworkReply* reply, const QList<QSslError> &errors)
 {
-    Q_UNUSED(reply)
+    if (reply != d->http)
+        return;
+
     QString errorString;
     foreach (const QSslError &error, errors) {
         if (!errorString.isEmpty())
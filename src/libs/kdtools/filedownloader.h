@@ -36,6 +36,10 @@
 
 #include <QtNetwork/QAuthenticator>
 
+QT_BEGIN_NAMESPACE
+class QNetworkAccessManager;
+QT_END_NAMESPACE
+
 namespace KDUpdater {
 
 class FileDownloaderProxyFactory;
@@ -87,6 +91,9 @@ public:
     bool ignoreSslErrors();
     void setIgnoreSslErrors(bool ignore);
 
+    QNetworkAccessManager *networkAccessManager() const;
+    void setNetworkAccessManager(QNetworkAccessManager *manager);
+
 public Q_SLOTS:
     virtual void cancelDownload();
 
@@ -30,10 +30,13 @@
 #include "localpackagehub.h"
 #include "globals.h"
 #include "constants.h"
+#include "tracer.h"
 
+#include <QDataStream>
 #include <QDomDocument>
 #include <QDomElement>
 #include <QFileInfo>
+#include <QSaveFile>
 
 using namespace KDUpdater;
 using namespace QInstaller;
@@ -52,6 +55,11 @@ using namespace QInstaller;
         \li Get information about the number of packages installed and their meta-data via the
             packageInfoCount() and packageInfo() methods.
     \endlist
+
+    Changes can either be written as a complete snapshot with writeToDisk(), or appended as small
+    records to a journal file next to the installation information file with writeJournal().
+    refresh() replays the journal on top of the snapshot and compacts both into the snapshot, so
+    the information survives a crash between two calls to writeToDisk().
 */
 
 /*!
@@ -69,6 +77,36 @@ using namespace QInstaller;
                                             descriptions.
 */
 
+namespace {
+
+enum JournalRecord
+{
+    JournalApplication = 1,
+    JournalClear,
+    JournalAddPackage,
+    JournalRemovePackage
+};
+
+}   // namespace
+
+static QDataStream &operator<<(QDataStream &stream, const LocalPackage &package)
+{
+    stream << package.name << package.title << package.description << package.version
+        << package.inheritVersionFrom << package.dependencies << package.autoDependencies
+        << package.lastUpdateDate << package.installDate << package.forcedInstallation
+        << package.virtualComp << package.uncompressedSize << package.checkable;
+    return stream;
+}
+
+static QDataStream &operator>>(QDataStream &stream, LocalPackage &package)
+{
+    stream >> package.name >> package.title >> package.description >> package.version
+        >> package.inheritVersionFrom >> package.dependencies >> package.autoDependencies
+        >> package.lastUpdateDate >> package.installDate >> package.forcedInstallation
+        >> package.virtualComp >> package.uncompressedSize >> package.checkable;
+    return stream;
+}
+
 struct LocalPackageHub::PackagesInfoData
 {
     PackagesInfoData() :
@@ -83,11 +121,79 @@ struct LocalPackageHub::PackagesInfoData
     bool modified;
 
     QMap<QString, LocalPackage> m_packageInfoMap;
+    // serialized records not yet appended to the journal
+    QList<QByteArray> m_journalRecords;
 
     void addPackageFrom(const QDomElement &packageE);
     void setInvalidContentError(const QString &detail);
+
+    template <typename T>
+    void appendJournalRecord(JournalRecord type, const T &value);
+    bool replayJournal();
 };
 
+template <typename T>
+void LocalPackageHub::PackagesInfoData::appendJournalRecord(JournalRecord type, const T &value)
+{
+    QByteArray record;
+    QDataStream stream(&record, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream << qint32(type) << value;
+    m_journalRecords.append(record);
+}
+
+/*!
+    \internal
+
+    Applies all complete records of the journal file to the package information read from the
+    snapshot. A truncated record at the end of the journal, left by a crash while appending, is
+    ignored. Returns \c true if at least one record was applied.
+*/
+bool LocalPackageHub::PackagesInfoData::replayJournal()
+{
+    QFile file(fileName + QLatin1String(".journal"));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    bool replayed = false;
+    QDataStream journal(&file);
+    journal.setVersion(QDataStream::Qt_5_6);
+    while (!journal.atEnd()) {
+        QByteArray record;
+        journal >> record;
+        if (journal.status() != QDataStream::Ok)
+            break;
+
+        QDataStream stream(record);
+        stream.setVersion(QDataStream::Qt_5_6);
+        qint32 type;
+        stream >> type;
+        switch (type) {
+        case JournalApplication:
+            stream >> applicationName >> applicationVersion;
+            break;
+        case JournalClear:
+            m_packageInfoMap.clear();
+            break;
+        case JournalAddPackage: {
+            LocalPackage info;
+            stream >> info;
+            if (stream.status() == QDataStream::Ok)
+                m_packageInfoMap.insert(info.name, info);
+        }   break;
+        case JournalRemovePackage: {
+            QString name;
+            stream >> name;
+            m_packageInfoMap.remove(name);
+        }   break;
+        default:
+            break;
+        }
+        replayed = true;
+    }
+    return replayed;
+}
+
 void LocalPackageHub::PackagesInfoData::setInvalidContentError(const QString &detail)
 {
     error = LocalPackageHub::InvalidContentError;
@@ -238,6 +344,7 @@ void LocalPackageHub::refresh()
     d->applicationName.clear();
     d->applicationVersion.clear();
     d->m_packageInfoMap.clear();
+    d->m_journalRecords.clear();
     d->modified = false;
 
     QFile file(d->fileName);
@@ -246,6 +353,13 @@ void LocalPackageHub::refresh()
     if (!file.exists()) {
         d->error = NotYetReadError;
         d->errorMessage = tr("The file %1 does not exist.").arg(d->fileName);
+        // a previous run might have crashed before it wrote the first snapshot
+        if (d->replayJournal()) {
+            d->error = NoError;
+            d->errorMessage.clear();
+            d->modified = true;
+            writeToDisk();
+        }
         return;
     }
 
@@ -297,6 +411,12 @@ void LocalPackageHub::refresh()
 
     d->error = NoError;
     d->errorMessage.clear();
+
+    // a previous run did not finish, compact its journal into the snapshot
+    if (d->replayJournal()) {
+        d->modified = true;
+        writeToDisk();
+    }
 }
 
 /*!
@@ -345,6 +465,7 @@ void LocalPackageHub::addPackage(const QString &name,
         info.checkable = checkable;
         d->m_packageInfoMap.insert(name, info);
     }
+    d->appendJournalRecord(JournalAddPackage, d->m_packageInfoMap.value(name));
     d->modified = true;
 }
 
@@ -356,6 +477,7 @@ bool LocalPackageHub::removePackage(const QString &name)
     if (d->m_packageInfoMap.remove(name) <= 0)
         return false;
 
+    d->appendJournalRecord(JournalRemovePackage, name);
     d->modified = true;
     return true;
 }
@@ -376,11 +498,18 @@ static void addTextChildHelper(QDomNode *node,
 }
 
 /*!
-    Writes the installation information file to disk.
+    Writes the installation information file to disk and removes the journal, as all of its
+    records are contained in the written file. The file is replaced atomically.
+
+    \sa writeJournal()
 */
 void LocalPackageHub::writeToDisk()
 {
     if (d->modified && (!d->m_packageInfoMap.isEmpty() || QFile::exists(d->fileName))) {
+        TraceSpan span("io", "Write installation information");
+        if (span.isActive())
+            span.setDetail(d->fileName);
+
         QDomDocument doc;
         QDomElement root = doc.createElement(QLatin1String("Packages")) ;
         doc.appendChild(root);
@@ -421,14 +550,71 @@ void LocalPackageHub::writeToDisk()
         }
 
         // Open Packages.xml
-        QFile file(d->fileName);
+        QSaveFile file(d->fileName);
+        file.setDirectWriteFallback(true);
         if (!file.open(QFile::WriteOnly))
             return;
 
         file.write(doc.toByteArray(4));
-        file.close();
+        if (!file.commit())
+            return;
         d->modified = false;
     }
+    d->m_journalRecords.clear();
+    QFile::remove(journalFileName());
+}
+
+/*!
+    Appends the changes made since the last call to writeJournal() or writeToDisk() to the
+    journal file. This is considerably cheaper than writeToDisk() when a lot of packages are
+    installed, because only the changed packages are written. The journal is replayed by
+    refresh() and removed by the next writeToDisk(). If the journal cannot be written, the
+    function falls back to writeToDisk().
+
+    \sa journalFileName()
+*/
+void LocalPackageHub::writeJournal()
+{
+    if (d->m_journalRecords.isEmpty())
+        return;
+
+    QFile file(journalFileName());
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        writeToDisk();
+        return;
+    }
+
+    // the application name and version are part of the snapshot, keep them in sync as well
+    d->m_journalRecords.prepend(QByteArray());
+    {
+        QDataStream stream(&d->m_journalRecords.first(), QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_5_6);
+        stream << qint32(JournalApplication) << d->applicationName << d->applicationVersion;
+    }
+
+    // write all records with one call, each is prefixed by its size so a partial write
+    // can be detected while replaying
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_6);
+    foreach (const QByteArray &record, d->m_journalRecords)
+        stream << record;
+
+    if (file.write(data) != data.size() || !file.flush()) {
+        file.close();
+        writeToDisk();
+        return;
+    }
+    d->m_journalRecords.clear();
+}
+
+/*!
+    Returns the name of the journal file, which is the installation information file name with a
+    \c .journal suffix.
+*/
+QString LocalPackageHub::journalFileName() const
+{
+    return d->fileName + QLatin1String(".journal");
 }
 
 void LocalPackageHub::PackagesInfoData::addPackageFrom(const QDomElement &packageE)
@@ -488,6 +674,7 @@ void LocalPackageHub::PackagesInfoData::addPackageFrom(const QDomElement &packag
 void LocalPackageHub::clearPackageInfos()
 {
     d->m_packageInfoMap.clear();
+    d->appendJournalRecord(JournalClear, QString());
     d->modified = true;
 }
 
@@ -109,6 +109,9 @@ public:
 
     void refresh();
     void writeToDisk();
+    void writeJournal();
+
+    QString journalFileName() const;
 
 private:
     struct PackagesInfoData;
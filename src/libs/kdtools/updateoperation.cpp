@@ -31,6 +31,7 @@
 #include "constants.h"
 #include "fileutils.h"
 #include "packagemanagercore.h"
+#include "updateoperationfactory.h"
 
 #include <QDataStream>
 #include <QDebug>
@@ -120,6 +121,10 @@ QString UpdateOperation::name() const
 */
 QString UpdateOperation::operationCommand() const
 {
+    if (isDeferred()) {
+        const UpdateOperation *const restored = restoredCopy();
+        return restored ? restored->operationCommand() : QString();
+    }
     QString argsStr = m_arguments.join(QLatin1String( " " ));
     return QString::fromLatin1( "%1 %2" ).arg(m_name, argsStr);
 }
@@ -129,6 +134,12 @@ QString UpdateOperation::operationCommand() const
 */
 bool UpdateOperation::hasValue(const QString &name) const
 {
+    if (!m_deferredXml.isNull() && m_deferredValues.contains(name))
+        return m_deferredValues.value(name).isValid();
+    if (isDeferred()) {
+        const UpdateOperation *const restored = restoredCopy();
+        return restored && restored->hasValue(name);
+    }
     return m_values.contains(name);
 }
 
@@ -137,6 +148,7 @@ bool UpdateOperation::hasValue(const QString &name) const
 */
 void UpdateOperation::clearValue(const QString &name)
 {
+    restoreDeferredXml();
     m_values.remove(name);
 }
 
@@ -145,6 +157,12 @@ void UpdateOperation::clearValue(const QString &name)
 */
 QVariant UpdateOperation::value(const QString &name) const
 {
+    if (!m_deferredXml.isNull() && m_deferredValues.contains(name))
+        return m_deferredValues.value(name);
+    if (isDeferred()) {
+        const UpdateOperation *const restored = restoredCopy();
+        return restored ? restored->value(name) : QVariant();
+    }
     return m_values.value(name);
 }
 
@@ -153,6 +171,7 @@ QVariant UpdateOperation::value(const QString &name) const
 */
 void UpdateOperation::setValue(const QString &name, const QVariant &value)
 {
+    restoreDeferredXml();
     m_values[name] = value;
 }
 
@@ -170,6 +189,7 @@ void UpdateOperation::setName(const QString &name)
 */
 void UpdateOperation::setArguments(const QStringList &args)
 {
+    restoreDeferredXml();
     m_arguments = args;
 }
 
@@ -178,6 +198,10 @@ void UpdateOperation::setArguments(const QStringList &args)
 */
 QStringList UpdateOperation::arguments() const
 {
+    if (isDeferred()) {
+        const UpdateOperation *const restored = restoredCopy();
+        return restored ? restored->arguments() : QStringList();
+    }
     return m_arguments;
 }
 
@@ -301,6 +325,7 @@ void UpdateOperation::setError(int error, const QString &errorString)
 */
 void UpdateOperation::clear()
 {
+    restoreDeferredXml();
     m_arguments.clear();
 }
 
@@ -394,6 +419,19 @@ bool UpdateOperation::deleteFileNowOrLater(const QString &file, QString *errorSt
 */
 QDomDocument UpdateOperation::toXml() const
 {
+    return xmlWithoutValues(QStringList());
+}
+
+/*!
+    Saves operation arguments and values as an XML document like toXml(), but leaves out the
+    values listed in \a names. Subclasses use this to store some values in their own format.
+*/
+QDomDocument UpdateOperation::xmlWithoutValues(const QStringList &names) const
+{
+    if (isDeferred()) {
+        const UpdateOperation *const restored = restoredCopy();
+        return restored ? restored->xmlWithoutValues(names) : QDomDocument();
+    }
     QDomDocument doc;
     QDomElement root = doc.createElement(QLatin1String("operation"));
     doc.appendChild(root);
@@ -414,7 +452,7 @@ QDomDocument UpdateOperation::toXml() const
     QDomElement values = doc.createElement(QLatin1String("values"));
     for (QVariantMap::const_iterator it = m_values.constBegin(); it != m_values.constEnd(); ++it) {
         // the installer can't be put into XML, ignore
-        if (it.key() == QLatin1String("installer"))
+        if (it.key() == QLatin1String("installer") || names.contains(it.key()))
             continue;
 
         QDomElement value = doc.createElement(QLatin1String("value"));
@@ -429,14 +467,8 @@ QDomDocument UpdateOperation::toXml() const
                     target, QLatin1String(QInstaller::scRelocatable))));
         } else {
             // no? then we have to go the hard way...
-            if (variant.type() == QVariant::StringList) {
-                QStringList list = variant.toStringList();
-                for (int i = 0; i < list.count(); ++i) {
-                    list[i] = QInstaller::replacePath(list.at(i), target,
-                        QLatin1String(QInstaller::scRelocatable));
-                }
-                variant = QVariant::fromValue(list);
-            }
+            if (variant.type() == QVariant::StringList)
+                variant = QVariant::fromValue(relocatablePaths(variant.toStringList()));
             QByteArray data;
             QDataStream stream(&data, QIODevice::WriteOnly);
             stream << variant;
@@ -454,6 +486,10 @@ QDomDocument UpdateOperation::toXml() const
 */
 bool UpdateOperation::fromXml(const QDomDocument &doc)
 {
+    m_deferredXml.clear();
+    m_deferredValues.clear();
+    m_restoredCopy.reset();
+
     QString target = QCoreApplication::applicationDirPath();
     // Does not change target on non OSX platforms.
     if (QInstaller::isInBundle(target, &target))
@@ -488,14 +524,8 @@ bool UpdateOperation::fromXml(const QDomDocument &doc)
         if (t == QVariant::List || t == QVariant::StringList || !var.convert(t)) {
             QDataStream stream(QByteArray::fromBase64( value.toLatin1()));
             stream >> var;
-            if (t == QVariant::StringList) {
-                QStringList list = var.toStringList();
-                for (int i = 0; i < list.count(); ++i) {
-                    list[i] = QInstaller::replacePath(list.at(i),
-                        QLatin1String(QInstaller::scRelocatable), target);
-                }
-                var = QVariant::fromValue(list);
-            }
+            if (t == QVariant::StringList)
+                var = QVariant::fromValue(resolvedPaths(var.toStringList()));
         }
 
         m_values[name] = var;
@@ -504,6 +534,42 @@ bool UpdateOperation::fromXml(const QDomDocument &doc)
     return true;
 }
 
+/*!
+    Returns \a paths with the target directory replaced by the relocatable path placeholder, the
+    way toXml() stores paths.
+*/
+QStringList UpdateOperation::relocatablePaths(const QStringList &paths) const
+{
+    const QString target = m_core ? m_core->value(QInstaller::scTargetDir) : QString();
+    QStringList result;
+    result.reserve(paths.count());
+    Q_FOREACH (const QString &path, paths) {
+        result.append(QInstaller::replacePath(path, target,
+            QLatin1String(QInstaller::scRelocatable)));
+    }
+    return result;
+}
+
+/*!
+    Returns \a paths with the relocatable path placeholder replaced by the directory the
+    application is installed in, the way fromXml() restores paths.
+*/
+QStringList UpdateOperation::resolvedPaths(const QStringList &paths)
+{
+    QString target = QCoreApplication::applicationDirPath();
+    // Does not change target on non OSX platforms.
+    if (QInstaller::isInBundle(target, &target))
+        target = QDir::cleanPath(target + QLatin1String("/.."));
+
+    QStringList result;
+    result.reserve(paths.count());
+    Q_FOREACH (const QString &path, paths) {
+        result.append(QInstaller::replacePath(path, QLatin1String(QInstaller::scRelocatable),
+            target));
+    }
+    return result;
+}
+
 /*!
     \overload
 
@@ -522,3 +588,79 @@ bool UpdateOperation::fromXml(const QString &xml)
     }
     return fromXml(doc);
 }
+
+/*!
+    Stores the UTF-8 encoded XML document \a xml, as written by toXml(), without parsing it. The
+    document is restored with fromXml() by restoreDeferredXml(), or the first time the operation is
+    changed. This keeps loading a large number of stored operations cheap, as most of them are
+    never touched.
+
+    \a knownValues holds values that can be queried without restoring the document, for example
+    the component the operation belongs to. An invalid QVariant marks a value as not existing.
+
+    \sa isDeferred(), deferredXml(), restoreDeferredXml()
+*/
+void UpdateOperation::setDeferredXml(const QByteArray &xml, const QVariantMap &knownValues)
+{
+    m_deferredXml = xml.isNull() ? QByteArray("") : xml;
+    m_deferredValues = knownValues;
+    m_restoredCopy.reset();
+}
+
+/*!
+    Returns \c true if the operation was set up with setDeferredXml() and the XML document was not
+    restored yet.
+*/
+bool UpdateOperation::isDeferred() const
+{
+    return !m_deferredXml.isNull();
+}
+
+/*!
+    Returns the XML document set with setDeferredXml() while the operation is deferred, otherwise
+    returns an empty byte array. Writing the document back is cheaper than calling toXml().
+*/
+QByteArray UpdateOperation::deferredXml() const
+{
+    return m_deferredXml;
+}
+
+/*!
+    Restores the XML document set with setDeferredXml() with fromXml(), if the operation is still
+    deferred. Functions that change the operation call this first. Const functions leave the
+    operation deferred and answer from a copy that is restored once, on first use.
+
+    \sa isDeferred()
+*/
+void UpdateOperation::restoreDeferredXml()
+{
+    if (m_deferredXml.isNull())
+        return;
+
+    const QString xml = QString::fromUtf8(m_deferredXml);
+    m_deferredXml.clear();
+    m_deferredValues.clear();
+    m_restoredCopy.reset();
+    if (!fromXml(xml))
+        qWarning() << "Failed to load XML for operation" << name();
+}
+
+/*
+    Returns an operation of the same type restored from the deferred XML document, or \c nullptr
+    if the type is not registered with UpdateOperationFactory. The copy is created the first time
+    it is needed and kept until the operation itself gets restored or set up again, so the
+    document is parsed only once however often the operation is inspected.
+*/
+const UpdateOperation *UpdateOperation::restoredCopy() const
+{
+    if (!m_restoredCopy) {
+        m_restoredCopy.reset(UpdateOperationFactory::instance().create(m_name, m_core));
+        if (!m_restoredCopy) {
+            qWarning() << "Cannot restore XML for unknown operation" << m_name;
+            return nullptr;
+        }
+        m_restoredCopy->setDeferredXml(m_deferredXml);
+        m_restoredCopy->restoreDeferredXml();
+    }
+    return m_restoredCopy.get();
+}
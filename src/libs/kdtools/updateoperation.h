@@ -36,6 +36,8 @@
 #include <QVariant>
 #include <QtXml/QDomDocument>
 
+#include <memory>
+
 namespace QInstaller {
 class PackageManagerCore;
 }
@@ -83,6 +85,11 @@ public:
     virtual bool fromXml(const QString &xml);
     virtual bool fromXml(const QDomDocument &doc);
 
+    void setDeferredXml(const QByteArray &xml, const QVariantMap &knownValues = QVariantMap());
+    bool isDeferred() const;
+    QByteArray deferredXml() const;
+    void restoreDeferredXml();
+
 protected:
     void setName(const QString &name);
     void setErrorString(const QString &errorString);
@@ -92,6 +99,13 @@ protected:
     bool checkArgumentCount(int minArgCount, int maxArgCount, const QString &argDescription = QString());
     bool checkArgumentCount(int argCount);
 
+    QDomDocument xmlWithoutValues(const QStringList &names) const;
+    QStringList relocatablePaths(const QStringList &paths) const;
+    static QStringList resolvedPaths(const QStringList &paths);
+
+private:
+    const UpdateOperation *restoredCopy() const;
+
 private:
     QString m_name;
     QStringList m_arguments;
@@ -100,6 +114,10 @@ private:
     QVariantMap m_values;
     QStringList m_delayedDeletionFiles;
     QInstaller::PackageManagerCore *m_core;
+
+    QByteArray m_deferredXml;
+    QVariantMap m_deferredValues;
+    mutable std::unique_ptr<UpdateOperation> m_restoredCopy;
 };
 
 } // namespace KDUpdater
@@ -29,15 +29,34 @@
 #include "updatesinfo_p.h"
 #include "utils.h"
 
-#include <QDomDocument>
+#include <QDateTime>
 #include <QFile>
+#include <QFileInfo>
 #include <QLocale>
+#include <QMutex>
 #include <QPair>
 #include <QVector>
 #include <QUrl>
+#include <QXmlStreamReader>
 
 using namespace KDUpdater;
 
+namespace {
+
+struct CacheEntry
+{
+    qint64 size;
+    QDateTime lastModified;
+    QSharedDataPointer<UpdatesInfoData> data;
+};
+
+// Updates.xml files are read by several consumers, parse every file only once.
+Q_GLOBAL_STATIC(QMutex, cacheMutex)
+typedef QHash<QString, CacheEntry> Cache;
+Q_GLOBAL_STATIC(Cache, cache)
+
+} // namespace
+
 UpdatesInfoData::UpdatesInfoData()
      : error(UpdatesInfo::NotYetReadError)
 {
@@ -62,43 +81,45 @@ void UpdatesInfoData::parseFile(const QString &updateXmlFile)
         return;
     }
 
-    QDomDocument doc;
-    QString parseErrorMessage;
-    int parseErrorLine, parseErrorColumn;
-    if (!doc.setContent(&file, &parseErrorMessage, &parseErrorLine, &parseErrorColumn)) {
-        error = UpdatesInfo::InvalidXmlError;
-        errorMessage = tr("Parse error in %1 at %2, %3: %4").arg(updateXmlFile,
-            QString::number(parseErrorLine), QString::number(parseErrorColumn), parseErrorMessage);
-        return;
-    }
+    QXmlStreamReader reader(&file);
+    if (reader.readNextStartElement()) {
+        if (reader.name() != QLatin1String("Updates")) {
+            setInvalidContentError(tr("Root element %1 unexpected, should be \"Updates\".")
+                .arg(reader.name().toString()));
+            return;
+        }
 
-    QDomElement rootE = doc.documentElement();
-    if (rootE.tagName() != QLatin1String("Updates")) {
-        setInvalidContentError(tr("Root element %1 unexpected, should be \"Updates\".").arg(rootE.tagName()));
-        return;
+        while (reader.readNextStartElement()) {
+            if (reader.name() == QLatin1String("PackageUpdate")) {
+                if (!parsePackageUpdateElement(reader))
+                    return; //error handled in subroutine
+            } else if (reader.name() == QLatin1String("RepositoryUpdate")) {
+                parseRepositoryUpdateElement(reader);
+            } else {
+                const QString tagName = intern(reader.name().toString());
+                values.insert(tagName, reader.readElementText(QXmlStreamReader::IncludeChildElements));
+            }
+        }
     }
+    while (!reader.atEnd())
+        reader.readNext();
+    m_strings.clear();
 
-    QDomNodeList childNodes = rootE.childNodes();
-    for(int i = 0; i < childNodes.count(); i++) {
-        const QDomElement childE = childNodes.at(i).toElement();
-        if (childE.isNull())
-            continue;
-
-        if (childE.tagName() == QLatin1String("ApplicationName"))
-            applicationName = childE.text();
-        else if (childE.tagName() == QLatin1String("ApplicationVersion"))
-            applicationVersion = childE.text();
-        else if (childE.tagName() == QLatin1String("PackageUpdate")) {
-            if (!parsePackageUpdateElement(childE))
-                return; //error handled in subroutine
-        }
+    if (reader.hasError()) {
+        error = UpdatesInfo::InvalidXmlError;
+        errorMessage = tr("Parse error in %1 at %2, %3: %4").arg(updateXmlFile,
+            QString::number(reader.lineNumber()), QString::number(reader.columnNumber()),
+            reader.errorString());
+        return;
     }
 
+    applicationName = values.value(QLatin1String("ApplicationName"));
     if (applicationName.isEmpty()) {
         setInvalidContentError(tr("ApplicationName element is missing."));
         return;
     }
 
+    applicationVersion = values.value(QLatin1String("ApplicationVersion"));
     if (applicationVersion.isEmpty()) {
         setInvalidContentError(tr("ApplicationVersion element is missing."));
         return;
@@ -108,49 +129,50 @@ void UpdatesInfoData::parseFile(const QString &updateXmlFile)
     error = UpdatesInfo::NoError;
 }
 
-bool UpdatesInfoData::parsePackageUpdateElement(const QDomElement &updateE)
+bool UpdatesInfoData::parsePackageUpdateElement(QXmlStreamReader &reader)
 {
-    if (updateE.isNull())
-        return false;
-
     UpdateInfo info;
     QMap<QString, QString> localizedDescriptions;
-    for (int i = 0; i < updateE.childNodes().count(); i++) {
-        QDomElement childE = updateE.childNodes().at(i).toElement();
-        if (childE.isNull())
-            continue;
-
-        if (childE.tagName() == QLatin1String("ReleaseNotes")) {
-            info.data[childE.tagName()] = QUrl(childE.text());
-        } else if (childE.tagName() == QLatin1String("Licenses")) {
+    while (reader.readNextStartElement()) {
+        const QString tagName = intern(reader.name().toString());
+        const QXmlStreamAttributes attributes = reader.attributes();
+
+        if (tagName == QLatin1String("ReleaseNotes")) {
+            info.data[tagName] = QUrl(reader.readElementText());
+        } else if (tagName == QLatin1String("Licenses")) {
             QHash<QString, QVariant> licenseHash;
-            const QDomNodeList licenseNodes = childE.childNodes();
-            for (int i = 0; i < licenseNodes.count(); ++i) {
-                const QDomNode licenseNode = licenseNodes.at(i);
-                if (licenseNode.nodeName() == QLatin1String("License")) {
-                    QDomElement element = licenseNode.toElement();
-                    licenseHash.insert(element.attributeNode(QLatin1String("name")).value(),
-                        element.attributeNode(QLatin1String("file")).value());
+            while (reader.readNextStartElement()) {
+                if (reader.name() == QLatin1String("License")) {
+                    licenseHash.insert(reader.attributes().value(QLatin1String("name")).toString(),
+                        reader.attributes().value(QLatin1String("file")).toString());
                 }
+                reader.skipCurrentElement();
             }
             if (!licenseHash.isEmpty())
                 info.data.insert(QLatin1String("Licenses"), licenseHash);
-        } else if (childE.tagName() == QLatin1String("Version")) {
+        } else if (tagName == QLatin1String("Version")) {
             info.data.insert(QLatin1String("inheritVersionFrom"),
-                childE.attribute(QLatin1String("inheritVersionFrom")));
-            info.data[childE.tagName()] = childE.text();
-        } else if (childE.tagName() == QLatin1String("DisplayName")) {
-            processLocalizedTag(childE, info.data);
-        } else if (childE.tagName() == QLatin1String("Description")) {
-            if (!childE.hasAttribute(QLatin1String("xml:lang")))
-                info.data[QLatin1String("Description")] = childE.text();
-            QString languageAttribute = childE.attribute(QLatin1String("xml:lang"), QLatin1String("en"));
-            localizedDescriptions.insert(languageAttribute.toLower(), childE.text());
-        } else if (childE.tagName() == QLatin1String("UpdateFile")) {
-            info.data[QLatin1String("CompressedSize")] = childE.attribute(QLatin1String("CompressedSize"));
-            info.data[QLatin1String("UncompressedSize")] = childE.attribute(QLatin1String("UncompressedSize"));
+                attributes.value(QLatin1String("inheritVersionFrom")).toString());
+            info.data[tagName] = intern(reader.readElementText());
+        } else if (tagName == QLatin1String("DisplayName")) {
+            processLocalizedTag(tagName, attributes.value(QLatin1String("xml:lang")).toString()
+                .toLower(), reader.readElementText(), info.data);
+        } else if (tagName == QLatin1String("Description")) {
+            const bool hasLanguage = attributes.hasAttribute(QLatin1String("xml:lang"));
+            const QString languageAttribute = hasLanguage
+                ? attributes.value(QLatin1String("xml:lang")).toString() : QLatin1String("en");
+            const QString text = reader.readElementText();
+            if (!hasLanguage)
+                info.data[QLatin1String("Description")] = text;
+            localizedDescriptions.insert(languageAttribute.toLower(), text);
+        } else if (tagName == QLatin1String("UpdateFile")) {
+            info.data[QLatin1String("CompressedSize")]
+                = attributes.value(QLatin1String("CompressedSize")).toString();
+            info.data[QLatin1String("UncompressedSize")]
+                = attributes.value(QLatin1String("UncompressedSize")).toString();
+            reader.skipCurrentElement();
         } else {
-            info.data[childE.tagName()] = childE.text();
+            info.data[tagName] = intern(reader.readElementText(QXmlStreamReader::IncludeChildElements));
         }
     }
 
@@ -181,15 +203,48 @@ bool UpdatesInfoData::parsePackageUpdateElement(const QDomElement &updateE)
     return true;
 }
 
-void UpdatesInfoData::processLocalizedTag(const QDomElement &childE, QHash<QString, QVariant> &info) const
+void UpdatesInfoData::parseRepositoryUpdateElement(QXmlStreamReader &reader)
+{
+    while (reader.readNextStartElement()) {
+        if (reader.name() == QLatin1String("Repository")) {
+            RepositoryUpdateInfo info;
+            info.lineNumber = reader.lineNumber();
+            foreach (const QXmlStreamAttribute &attribute, reader.attributes()) {
+                info.attributes.insert(attribute.qualifiedName().toString(),
+                    attribute.value().toString());
+            }
+            repositoryUpdateList.append(info);
+        }
+        reader.skipCurrentElement();
+    }
+}
+
+/*!
+    \internal
+
+    Returns a shared copy of \a string if an equal string was seen before while parsing the
+    current file. Tag names, versions and flags repeat for every package, so this keeps the
+    memory footprint of large indexes low.
+*/
+QString UpdatesInfoData::intern(const QString &string)
 {
-    QString languageAttribute = childE.attribute(QLatin1String("xml:lang")).toLower();
-    if (!info.contains(childE.tagName()) && (languageAttribute.isEmpty()))
-        info[childE.tagName()] = childE.text();
+    QSet<QString>::const_iterator it = m_strings.constFind(string);
+    if (it != m_strings.constEnd())
+        return *it;
+    if (string.size() <= 32)
+        m_strings.insert(string);
+    return string;
+}
+
+void UpdatesInfoData::processLocalizedTag(const QString &tagName, const QString &language,
+    const QString &text, QHash<QString, QVariant> &info) const
+{
+    if (!info.contains(tagName) && (language.isEmpty()))
+        info[tagName] = text;
 
     // overwrite default if we have a language specific description
-    if (QLocale().name().startsWith(languageAttribute, Qt::CaseInsensitive))
-        info[childE.tagName()] = childE.text();
+    if (QLocale().name().startsWith(language, Qt::CaseInsensitive))
+        info[tagName] = text;
 }
 
 
@@ -215,17 +270,60 @@ QString UpdatesInfo::errorString() const
     return d->errorMessage;
 }
 
+UpdatesInfo::Error UpdatesInfo::error() const
+{
+    return static_cast<Error>(d->error);
+}
+
+/*!
+    Reads the update information from \a updateXmlFile. A file that was already read and did
+    not change in between is not parsed again, but shares the result of the previous read.
+*/
 void UpdatesInfo::setFileName(const QString &updateXmlFile)
 {
     if (d->updateXmlFile == updateXmlFile)
         return;
 
-    d->applicationName.clear();
-    d->applicationVersion.clear();
-    d->updateInfoList.clear();
+    const QFileInfo fi(updateXmlFile);
+    const QString key = fi.absoluteFilePath();
+
+    QMutexLocker _(cacheMutex());
+    const Cache::const_iterator it = cache()->constFind(key);
+    if (it != cache()->constEnd() && it->size == fi.size() && it->lastModified == fi.lastModified()) {
+        d = it->data;
+        return;
+    }
 
+    d = new UpdatesInfoData;
     d->updateXmlFile = updateXmlFile;
     d->parseFile(d->updateXmlFile);
+
+    if (d->error == NoError) {
+        CacheEntry entry = { fi.size(), fi.lastModified(), d };
+        cache()->insert(key, entry);
+    } else {
+        cache()->remove(key);
+    }
+}
+
+/*!
+    Drops all parsed files kept for sharing between consumers.
+*/
+void UpdatesInfo::clearCache()
+{
+    QMutexLocker _(cacheMutex());
+    cache()->clear();
+}
+
+/*!
+    Drops the parsed result of \a updateXmlFile kept for sharing between consumers. Call this when
+    replacing the file, as a rewrite with the same size within the resolution of the
+    modification time would not be noticed otherwise.
+*/
+void UpdatesInfo::removeFromCache(const QString &updateXmlFile)
+{
+    QMutexLocker _(cacheMutex());
+    cache()->remove(QFileInfo(updateXmlFile).absoluteFilePath());
 }
 
 QString UpdatesInfo::fileName() const
@@ -243,6 +341,15 @@ QString UpdatesInfo::applicationVersion() const
     return d->applicationVersion;
 }
 
+/*!
+    Returns the text of the top-level element \a elementName, or a null string if the file
+    does not contain such an element.
+*/
+QString UpdatesInfo::value(const QString &elementName) const
+{
+    return d->values.value(elementName);
+}
+
 int UpdatesInfo::updateInfoCount() const
 {
     return d->updateInfoList.count();
@@ -259,3 +366,8 @@ QList<UpdateInfo> UpdatesInfo::updatesInfo() const
 {
     return d->updateInfoList;
 }
+
+QList<RepositoryUpdateInfo> UpdatesInfo::repositoryUpdates() const
+{
+    return d->repositoryUpdateList;
+}
@@ -46,6 +46,12 @@ struct KDTOOLS_EXPORT UpdateInfo
     QHash<QString, QVariant> data;
 };
 
+struct KDTOOLS_EXPORT RepositoryUpdateInfo
+{
+    QHash<QString, QString> attributes;
+    qint64 lineNumber;
+};
+
 class KDTOOLS_EXPORT UpdatesInfo
 {
 public:
@@ -71,11 +77,17 @@ public:
 
     QString applicationName() const;
     QString applicationVersion() const;
+    QString value(const QString &elementName) const;
 
     int updateInfoCount() const;
     UpdateInfo updateInfo(int index) const;
     QList<UpdateInfo> updatesInfo() const;
 
+    QList<RepositoryUpdateInfo> repositoryUpdates() const;
+
+    static void clearCache();
+    static void removeFromCache(const QString &updateXmlFile);
+
 private:
     QSharedDataPointer<UpdatesInfoData> d;
 };
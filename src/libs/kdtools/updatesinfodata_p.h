@@ -30,13 +30,16 @@
 #define UPDATESINFODATA_P_H
 
 #include <QCoreApplication>
+#include <QHash>
+#include <QSet>
 #include <QSharedData>
 
-QT_FORWARD_DECLARE_CLASS(QDomElement)
+QT_FORWARD_DECLARE_CLASS(QXmlStreamReader)
 
 namespace KDUpdater {
 
 struct UpdateInfo;
+struct RepositoryUpdateInfo;
 
 struct UpdatesInfoData : public QSharedData
 {
@@ -51,15 +54,23 @@ public:
     QString updateXmlFile;
     QString applicationName;
     QString applicationVersion;
+    QHash<QString, QString> values;
     QList<UpdateInfo> updateInfoList;
+    QList<RepositoryUpdateInfo> repositoryUpdateList;
 
     void parseFile(const QString &updateXmlFile);
-    bool parsePackageUpdateElement(const QDomElement &updateE);
+    bool parsePackageUpdateElement(QXmlStreamReader &reader);
+    void parseRepositoryUpdateElement(QXmlStreamReader &reader);
 
     void setInvalidContentError(const QString &detail);
 
 private:
-    void processLocalizedTag(const QDomElement &childE, QHash<QString, QVariant> &info) const;
+    QString intern(const QString &string);
+    void processLocalizedTag(const QString &tagName, const QString &language, const QString &text,
+        QHash<QString, QVariant> &info) const;
+
+private:
+    QSet<QString> m_strings;
 };
 
 } // namespace KDUpdater
@@ -31,6 +31,8 @@
 #include "constants.h"
 #include "globals.h"
 
+#include <utils.h>
+
 namespace CommandLineOptions {
 const char KeyValue[] = "Key=Value";
 } // namespace CommandLineOptions
@@ -117,6 +119,21 @@ CommandLineParser::CommandLineParser()
         QLatin1String("Updates all packages silently.")));
     m_parser.addOption(QCommandLineOption(QLatin1String(CommandLineOptions::Platform),
         QLatin1String("Use the specified platform plugin."), QLatin1String("plugin")));
+    m_parser.addOption(QCommandLineOption(QLatin1String(CommandLineOptions::DownloadCache),
+        QLatin1String("Keep downloaded archives and metadata in the given directory and reuse them "
+        "by checksum in later runs."), QLatin1String("directory")));
+    m_parser.addOption(QCommandLineOption(QLatin1String(CommandLineOptions::DownloadCacheSize),
+        QLatin1String("Maximum size of the download cache in megabytes. Least recently used files "
+        "are removed first. Defaults to 2048."), QLatin1String("MB")));
+    m_parser.addOption(QCommandLineOption(QLatin1String(CommandLineOptions::Trace),
+        QLatin1String("Record where the installer spends its time and write it to the given file "
+        "in Chrome trace-event format."), QLatin1String("file")));
+    m_parser.addOption(QCommandLineOption(QLatin1String(CommandLineOptions::LogMaxSize),
+        QString::fromLatin1("Rotate the installation log once it grows beyond the given size in "
+        "megabytes. Up to %1 rotated logs are kept.")
+        .arg(QInstaller::VerboseWriter::instance()->rotatedFileCount()), QLatin1String("MB")));
+    m_parser.addOption(QCommandLineOption(QLatin1String(CommandLineOptions::LogCompress),
+        QLatin1String("Compress rotated installation logs.")));
     m_parser.addPositionalArgument(QLatin1String(CommandLineOptions::KeyValue),
         QLatin1String("Key Value pair to be set."));
 }
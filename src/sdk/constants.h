@@ -54,6 +54,11 @@ const char StartClient[] = "startclient";
 const char InstallCompressedRepository[] = "installCompressedRepository";
 const char SilentUpdate[] = "silentUpdate";
 const char Platform[] = "platform";
+const char DownloadCache[] = "download-cache";
+const char DownloadCacheSize[] = "download-cache-size";
+const char Trace[] = "trace";
+const char LogMaxSize[] = "log-max-size";
+const char LogCompress[] = "log-compress";
 
 } // namespace CommandLineOptions
 
@@ -34,6 +34,7 @@
 
 #include <binaryformatenginehandler.h>
 #include <copydirectoryoperation.h>
+#include <downloadcache.h>
 #include <errors.h>
 #include <init.h>
 #include <updateoperations.h>
@@ -44,6 +45,7 @@
 #include <protocol.h>
 #include <productkeycheck.h>
 #include <settings.h>
+#include <tracer.h>
 #include <utils.h>
 #include <globals.h>
 
@@ -68,6 +70,7 @@ InstallerBase::InstallerBase(int &argc, char *argv[])
 InstallerBase::~InstallerBase()
 {
     delete m_core;
+    QInstaller::Tracer::instance()->stop();
 }
 
 int InstallerBase::run()
@@ -131,7 +134,10 @@ int InstallerBase::run()
         .value(0, QLatin1String("No UI language set")).toUtf8().constData();
     qDebug().noquote() << "Arguments:" << arguments().join(QLatin1String(", "));
 
-    SDKApp::registerMetaResources(manager.collectionByName("QResources"));
+    // The installer binary cannot be replaced while it runs, so its meta resources can be used
+    // straight from the file. The maintenance tool rewrites its data file, so copy them.
+    SDKApp::registerMetaResources(manager.collectionByName("QResources"),
+        magicMarker == QInstaller::BinaryContent::MagicInstallerMarker);
     if (parser.isSet(QLatin1String(CommandLineOptions::StartClient))) {
         const QStringList arguments = parser.value(QLatin1String(CommandLineOptions::StartClient))
             .split(QLatin1Char(','), QString::SkipEmptyParts);
@@ -169,6 +175,32 @@ int InstallerBase::run()
         KDUpdater::FileDownloaderFactory::instance().setProxyFactory(m_core->proxyFactory());
     }
 
+    if (parser.isSet(QLatin1String(CommandLineOptions::DownloadCache))) {
+        QInstaller::DownloadCache::instance()->setPath(parser
+            .value(QLatin1String(CommandLineOptions::DownloadCache)));
+    }
+
+    if (parser.isSet(QLatin1String(CommandLineOptions::DownloadCacheSize))) {
+        bool ok = false;
+        const qint64 size = parser.value(QLatin1String(CommandLineOptions::DownloadCacheSize))
+            .toLongLong(&ok);
+        if (!ok || size < 0)
+            throw QInstaller::Error(QLatin1String("Invalid size for option 'download-cache-size'."));
+        QInstaller::DownloadCache::instance()->setMaxSize(size * 1024 * 1024);
+    }
+
+    if (parser.isSet(QLatin1String(CommandLineOptions::LogMaxSize))) {
+        bool ok = false;
+        const qint64 size = parser.value(QLatin1String(CommandLineOptions::LogMaxSize))
+            .toLongLong(&ok);
+        if (!ok || size < 0)
+            throw QInstaller::Error(QLatin1String("Invalid size for option 'log-max-size'."));
+        QInstaller::VerboseWriter::instance()->setMaxFileSize(size * 1024 * 1024);
+    }
+
+    if (parser.isSet(QLatin1String(CommandLineOptions::LogCompress)))
+        QInstaller::VerboseWriter::instance()->setCompressRotatedFiles(true);
+
     if (parser.isSet(QLatin1String(CommandLineOptions::ShowVirtualComponents))) {
         QFont f;
         f.setItalic(true);
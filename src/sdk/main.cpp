@@ -36,6 +36,7 @@
 #include <errors.h>
 #include <selfrestarter.h>
 #include <remoteserver.h>
+#include <tracer.h>
 #include <utils.h>
 
 #include <QCommandLineParser>
@@ -185,6 +186,12 @@ int main(int argc, char *argv[])
                 QInstaller::setVerbose(true);
         }
 
+        // started as early as possible, the trace is written when InstallerBase is destroyed
+        if (parser.isSet(QLatin1String(CommandLineOptions::Trace))) {
+            QInstaller::Tracer::instance()->start(parser
+                .value(QLatin1String(CommandLineOptions::Trace)));
+        }
+
         // On Windows we need the console window from above, we are a GUI application.
         const QStringList unknownOptionNames = parser.unknownOptionNames();
         if (!unknownOptionNames.isEmpty()) {
@@ -114,13 +114,27 @@ public:
         return QString();
     }
 
-    void registerMetaResources(const QInstaller::ResourceCollection &collection)
+    /*!
+        Registers the resources in \a collection under \c{:/metadata}. If \a keepMapped is
+        \c true, resources that can be mapped into memory are registered from the mapping
+        and stay open for the lifetime of the application, instead of being copied to the heap.
+        This must not be used if the file might be replaced while the application runs.
+    */
+    void registerMetaResources(const QInstaller::ResourceCollection &collection, bool keepMapped)
     {
         foreach (const QSharedPointer<QInstaller::Resource> &resource, collection.resources()) {
             const bool isOpen = resource->isOpen();
             if ((!isOpen) && (!resource->open()))
                 continue;
 
+            if (keepMapped && resource->mappedData()) {
+                if (QResource::registerResource(resource->mappedData(), QLatin1String(":/metadata")))
+                    m_mappedResources.append(resource);
+                else if (!isOpen)
+                    resource->close();
+                continue;
+            }
+
             if (!resource->seek(0))
                 continue;
 
@@ -138,6 +152,7 @@ public:
 
 private:
     QList<QByteArray> m_resourceMappings;
+    QList<QSharedPointer<QInstaller::Resource> > m_mappedResources;
 };
 
 #endif  // SDKAPP_H
@@ -81,7 +81,7 @@ int UpdateChecker::check()
     if (magicMarker == QInstaller::BinaryContent::MagicInstallerMarker)
         throw QInstaller::Error(QLatin1String("Installers cannot check for updates."));
 
-    SDKApp::registerMetaResources(manager.collectionByName("QResources"));
+    SDKApp::registerMetaResources(manager.collectionByName("QResources"), false);
 
     QInstaller::PackageManagerCore core(QInstaller::BinaryContent::MagicUpdaterMarker, operations);
     QInstaller::PackageManagerCore::setVirtualComponentsVisible(true);
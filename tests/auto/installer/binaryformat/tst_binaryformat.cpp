@@ -31,6 +31,7 @@
 #include <errors.h>
 #include <fileio.h>
 #include <updateoperation.h>
+#include <updateoperationfactory.h>
 
 #include <QTest>
 #include <QTemporaryFile>
@@ -304,8 +305,11 @@ private slots:
         QCOMPARE(resource.isNull(), false);
         QCOMPARE(resource->isOpen(), false);
         QCOMPARE(resource->open(), true);
+        QVERIFY(resource->segment().start() > 0);
+        QVERIFY(resource->mappedData() != 0); // the segment starts inside a page of the binary
         QCOMPARE(resource->readAll(), QByteArray("Collection 1, Resource 1."));
         resource->close();
+        QVERIFY(resource->mappedData() == 0);
 
         collection = m_manager.collectionByName(QByteArray("Collection 2"));
         QCOMPARE(collection.resources().count(), 1);
@@ -392,6 +396,198 @@ private slots:
         resource->close();
     }
 
+    void testMappedResourceAtOffset()
+    {
+        QByteArray content;
+        for (int i = 0; content.size() < 3 * 4096 + 123; ++i)
+            content.append(QByteArray::number(i)).append(',');
+
+        QTemporaryFile file;
+        QInstaller::openForWrite(&file);
+        QInstaller::blockingWrite(&file, content);
+        file.close();
+
+        // neither start nor end of the segments are aligned to a page
+        const Range<qint64> first = Range<qint64>::fromStartAndLength(4097, 5000);
+        const Range<qint64> second = Range<qint64>::fromStartAndLength(13, 4100);
+        Resource resource(file.fileName(), first);
+        Resource other(file.fileName(), second);
+        QCOMPARE(resource.open(), true);
+        QCOMPARE(other.open(), true);
+        QVERIFY(resource.mappedData() != 0);
+        QVERIFY(other.mappedData() != 0);
+        QCOMPARE(QByteArray(reinterpret_cast<const char *>(resource.mappedData()), 5000),
+            content.mid(4097, 5000));
+
+        // reads of both resources interleave without disturbing each other
+        QCOMPARE(resource.read(100), content.mid(4097, 100));
+        QCOMPARE(other.read(100), content.mid(13, 100));
+        QCOMPARE(resource.read(100), content.mid(4197, 100));
+        QVERIFY(resource.seek(4900));
+        QCOMPARE(resource.read(1000), content.mid(4097 + 4900, 100));
+        QCOMPARE(resource.atEnd(), true);
+        QCOMPARE(resource.read(10), QByteArray());
+        QVERIFY(other.seek(0));
+        QCOMPARE(other.readAll(), content.mid(13, 4100));
+
+        // copying writes straight from the mapping
+        QVERIFY(resource.seek(0));
+        QTemporaryFile copy;
+        QInstaller::openForWrite(&copy);
+        try {
+            resource.copyData(&copy);
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+        copy.close();
+        QInstaller::openForRead(&copy);
+        QCOMPARE(copy.readAll(), content.mid(4097, 5000));
+
+        resource.close();
+        other.close();
+        QVERIFY(resource.mappedData() == 0);
+    }
+
+    void testResourceWithoutMapping()
+    {
+#ifdef Q_OS_LINUX
+        // procfs files can be read and seeked, but not mapped
+        const QString path = QLatin1String("/proc/self/cmdline");
+        QFile file(path);
+        QInstaller::openForRead(&file);
+        const QByteArray content = file.readAll();
+        file.close();
+        QVERIFY(content.size() > 4);
+
+        const Range<qint64> segment = Range<qint64>::fromStartAndLength(2, content.size() - 3);
+        Resource resource(path, segment);
+        QCOMPARE(resource.open(), true);
+        if (resource.mappedData())
+            QSKIP("The file system supports mapping procfs files.");
+
+        QCOMPARE(resource.read(1), content.mid(2, 1));
+        QCOMPARE(resource.readAll(), content.mid(3, segment.length() - 1));
+        QCOMPARE(resource.atEnd(), true);
+        QVERIFY(resource.seek(1));
+        QCOMPARE(resource.read(2), content.mid(3, 2));
+
+        // copying falls back to reading through a buffer
+        QVERIFY(resource.seek(0));
+        QTemporaryFile copy;
+        QInstaller::openForWrite(&copy);
+        try {
+            resource.copyData(&copy);
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+        copy.close();
+        QInstaller::openForRead(&copy);
+        QCOMPARE(copy.readAll(), content.mid(2, segment.length()));
+        resource.close();
+#else
+        QSKIP("Needs a file that cannot be mapped into memory.");
+#endif
+    }
+
+    void testIndexedOperationLog()
+    {
+        QList<OperationBlob> operations;
+        operations.append(OperationBlob(m_operations.at(0).name, QLatin1String("A"),
+            m_operations.at(0).xml.toUtf8()));
+        operations.append(OperationBlob(m_operations.at(1).name, QString(),
+            m_operations.at(1).xml.toUtf8()));
+
+        QTemporaryFile file;
+        QInstaller::openForWrite(&file);
+        BinaryContent::writeOperations(&file, operations);
+        file.close();
+
+        QInstaller::openForRead(&file);
+        const QList<OperationBlob> read = BinaryContent::readOperations(&file);
+        QCOMPARE(file.pos(), file.size());
+        QCOMPARE(read.count(), operations.count());
+        for (int i = 0; i < read.count(); ++i) {
+            QCOMPARE(read.at(i).name, operations.at(i).name);
+            QCOMPARE(read.at(i).component, operations.at(i).component);
+            QCOMPARE(read.at(i).data, operations.at(i).data);
+        }
+
+        // the data is decoded once restored only
+        TestOperation op(read.at(0).name);
+        QVariantMap knownValues;
+        knownValues.insert(QLatin1String("component"), read.at(0).component);
+        op.setDeferredXml(read.at(0).data, knownValues);
+        QCOMPARE(op.isDeferred(), true);
+        QCOMPARE(op.value(QLatin1String("component")).toString(), QLatin1String("A"));
+        QCOMPARE(op.isDeferred(), true);
+        op.restoreDeferredXml();
+        QCOMPARE(op.isDeferred(), false);
+        QCOMPARE(op.value(QLatin1String("key")).toString(), QLatin1String("Operation 1 value."));
+        QCOMPARE(op.arguments(), QStringList() << QLatin1String("arg1") << QLatin1String("arg2"));
+    }
+
+    void testReadDeferredOperation()
+    {
+        KDUpdater::UpdateOperationFactory &factory = KDUpdater::UpdateOperationFactory::instance();
+        QScopedPointer<KDUpdater::UpdateOperation> op(factory.create(QLatin1String("Copy"), 0));
+        op->setArguments(QStringList() << QLatin1String("source") << QLatin1String("target"));
+        op->setValue(QLatin1String("key"), QLatin1String("value"));
+        const QString xml = op->toXml().toString();
+
+        // const functions answer from a copy restored once and keep the operation deferred
+        QScopedPointer<KDUpdater::UpdateOperation> deferred(factory.create(QLatin1String("Copy"),
+            0));
+        deferred->setDeferredXml(xml.toUtf8());
+        const KDUpdater::UpdateOperation &constDeferred = *deferred;
+        QCOMPARE(constDeferred.arguments(), op->arguments());
+        QCOMPARE(constDeferred.value(QLatin1String("key")).toString(), QLatin1String("value"));
+        QCOMPARE(constDeferred.hasValue(QLatin1String("missing")), false);
+        QCOMPARE(constDeferred.operationCommand(), op->operationCommand());
+        QCOMPARE(constDeferred.toXml().toString(), xml);
+        QCOMPARE(deferred->isDeferred(), true);
+        QCOMPARE(deferred->deferredXml(), xml.toUtf8());
+
+        // setting up the operation again drops the restored copy
+        op->setValue(QLatin1String("key"), QLatin1String("new value"));
+        deferred->setDeferredXml(op->toXml().toString().toUtf8());
+        QCOMPARE(constDeferred.value(QLatin1String("key")).toString(), QLatin1String("new value"));
+        deferred->setDeferredXml(xml.toUtf8());
+
+        // changing the operation restores it in place
+        deferred->setValue(QLatin1String("other"), QLatin1String("changed"));
+        QCOMPARE(deferred->isDeferred(), false);
+        QCOMPARE(deferred->value(QLatin1String("key")).toString(), QLatin1String("value"));
+        QCOMPARE(deferred->arguments(), op->arguments());
+    }
+
+    void testResourceCollectionLookup()
+    {
+        ResourceCollection collection("Collection");
+        QSharedPointer<Resource> first(new Resource(m_binary, QByteArray("Resource 1")));
+        QSharedPointer<Resource> second(new Resource(m_binary, QByteArray("Resource 2")));
+        QSharedPointer<Resource> duplicate(new Resource(m_binary, QByteArray("Resource 1")));
+        collection.appendResources(QList<QSharedPointer<Resource> >() << first << second);
+        collection.appendResource(duplicate);
+
+        QCOMPARE(collection.resources().count(), 3);
+        QCOMPARE(collection.resourceByName("Resource 1"), first); // the first appended wins
+        QCOMPARE(collection.resourceByName("Resource 2"), second);
+        QVERIFY(collection.resourceByName("Resource 3").isNull());
+
+        // the lookup keeps using the name a resource was appended with
+        second->setName("Renamed");
+        QCOMPARE(collection.resourceByName("Resource 2"), second);
+        QVERIFY(collection.resourceByName("Renamed").isNull());
+
+        // copies share the resources, but not later additions
+        ResourceCollection copy = collection;
+        QSharedPointer<Resource> third(new Resource(m_binary, QByteArray("Resource 3")));
+        copy.appendResource(third);
+        QCOMPARE(copy.resourceByName("Resource 3"), third);
+        QCOMPARE(copy.resourceByName("Resource 1"), first);
+        QVERIFY(collection.resourceByName("Resource 3").isNull());
+    }
+
     void cleanupTestCase()
     {
         m_manager.clear();
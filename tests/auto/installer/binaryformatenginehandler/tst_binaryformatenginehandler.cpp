@@ -0,0 +1,176 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include <binaryformat.h>
+#include <binaryformatenginehandler.h>
+#include <fileio.h>
+
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace QInstaller;
+
+class tst_BinaryFormatEngineHandler : public QObject
+{
+    Q_OBJECT
+
+private:
+    QString writeFile(const QString &name, const QByteArray &content)
+    {
+        const QString path = m_dir.path() + QLatin1Char('/') + name;
+        QFile file(path);
+        QInstaller::openForWrite(&file);
+        QInstaller::blockingWrite(&file, content);
+        return path;
+    }
+
+    QByteArray readFile(const QString &path)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return QByteArray();
+        return file.readAll();
+    }
+
+    void registerCollection(const QByteArray &name, const QList<QPair<QByteArray, QString> > &files)
+    {
+        ResourceCollection collection(name);
+        for (int i = 0; i < files.count(); ++i) {
+            collection.appendResource(QSharedPointer<Resource>(new Resource(files.at(i).second,
+                files.at(i).first)));
+        }
+        BinaryFormatEngineHandler::instance()->registerResources(QList<ResourceCollection>()
+            << collection);
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(m_dir.isValid());
+        m_first = writeFile(QLatin1String("first.txt"), "First resource.");
+        m_second = writeFile(QLatin1String("second.txt"), "Second resource.");
+        m_third = writeFile(QLatin1String("third.txt"), "Third resource.");
+    }
+
+    void cleanup()
+    {
+        BinaryFormatEngineHandler::instance()->clear();
+    }
+
+    void testLookupByName()
+    {
+        registerCollection("collection", QList<QPair<QByteArray, QString> >()
+            << qMakePair(QByteArray("first"), m_first)
+            << qMakePair(QByteArray("second"), m_second));
+
+        QCOMPARE(readFile(QLatin1String("installer://collection/first")),
+            QByteArray("First resource."));
+        QCOMPARE(readFile(QLatin1String("installer://collection/second")),
+            QByteArray("Second resource."));
+        QVERIFY(QFileInfo(QLatin1String("installer://collection/second")).isFile());
+
+        // unknown resources and collections cannot be opened
+        QFile unknown(QLatin1String("installer://collection/third"));
+        QVERIFY(!unknown.open(QIODevice::ReadOnly));
+        QVERIFY(!QFileInfo(QLatin1String("installer://collection/third")).isFile());
+        QFile missing(QLatin1String("installer://other/first"));
+        QVERIFY(!missing.open(QIODevice::ReadOnly));
+
+        // single resources are added to the existing collection
+        BinaryFormatEngineHandler::instance()->registerResource(
+            QLatin1String("installer://collection/third"), m_third);
+        QCOMPARE(readFile(QLatin1String("installer://collection/third")),
+            QByteArray("Third resource."));
+        QCOMPARE(readFile(QLatin1String("installer://collection/first")),
+            QByteArray("First resource."));
+    }
+
+    void testReplaceRegisteredResource()
+    {
+        registerCollection("collection", QList<QPair<QByteArray, QString> >()
+            << qMakePair(QByteArray("resource"), m_first));
+
+        QFile before(QLatin1String("installer://collection/resource"));
+        QVERIFY(before.open(QIODevice::ReadOnly));
+        QCOMPARE(before.read(6), QByteArray("First "));
+
+        // registering a collection with the same name replaces the whole collection
+        registerCollection("collection", QList<QPair<QByteArray, QString> >()
+            << qMakePair(QByteArray("resource"), m_second));
+        QCOMPARE(readFile(QLatin1String("installer://collection/resource")),
+            QByteArray("Second resource."));
+
+        // an engine created before keeps reading the resource it was created with
+        QCOMPARE(before.readAll(), QByteArray("resource."));
+        before.close();
+
+        // a resource registered again under a taken name does not shadow the first one
+        BinaryFormatEngineHandler::instance()->registerResource(
+            QLatin1String("installer://collection/resource"), m_third);
+        QCOMPARE(readFile(QLatin1String("installer://collection/resource")),
+            QByteArray("Second resource."));
+    }
+
+    void testEngineOutlivesClear()
+    {
+        registerCollection("collection", QList<QPair<QByteArray, QString> >()
+            << qMakePair(QByteArray("first"), m_first)
+            << qMakePair(QByteArray("second"), m_second));
+
+        QFile opened(QLatin1String("installer://collection/first"));
+        QVERIFY(opened.open(QIODevice::ReadOnly));
+        QFile unopened(QLatin1String("installer://collection/second"));
+        QVERIFY(unopened.exists()); // creates the engine on the current table
+
+        BinaryFormatEngineHandler::instance()->clear();
+
+        // the engines hold on to the table they were created with
+        QCOMPARE(opened.readAll(), QByteArray("First resource."));
+        QVERIFY(opened.seek(6));
+        QCOMPARE(opened.readAll(), QByteArray("resource."));
+        opened.close();
+        QVERIFY(unopened.open(QIODevice::ReadOnly));
+        QCOMPARE(unopened.readAll(), QByteArray("Second resource."));
+
+        // new engines see the empty table
+        QFile cleared(QLatin1String("installer://collection/first"));
+        QVERIFY(!cleared.open(QIODevice::ReadOnly));
+        QVERIFY(!QFileInfo(QLatin1String("installer://collection/first")).isFile());
+    }
+
+private:
+    QTemporaryDir m_dir;
+    QString m_first;
+    QString m_second;
+    QString m_third;
+};
+
+QTEST_MAIN(tst_BinaryFormatEngineHandler)
+
+#include "tst_binaryformatenginehandler.moc"
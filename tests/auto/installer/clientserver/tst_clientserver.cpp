@@ -26,14 +26,21 @@
 **
 **************************************************************************/
 
+#include <errors.h>
+#include <fileio.h>
+#include <lib7z_create.h>
+#include <lib7z_extract.h>
 #include <protocol.h>
 #include <qprocesswrapper.h>
 #include <qsettingswrapper.h>
 #include <remoteclient.h>
 #include <remotefileengine.h>
+#include <remoteobject.h>
 #include <remoteserver.h>
 
 #include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
 #include <QSettings>
 #include <QLocalSocket>
 #include <QTest>
@@ -41,9 +48,133 @@
 #include <QTemporaryFile>
 #include <QUuid>
 #include <QLocalServer>
+#include <QSemaphore>
+#include <QTemporaryDir>
+#include <QThread>
 
 using namespace QInstaller;
 
+class TestRemoteObject : public RemoteObject
+{
+public:
+    explicit TestRemoteObject(const QString &type)
+        : RemoteObject(type)
+    {}
+
+    using RemoteObject::connectToServer;
+
+    template<typename T>
+    void callRemoteMethodWithoutReply(const QString &name, const T &arg)
+    {
+        callRemoteMethod(name, arg, dummy);
+    }
+};
+
+// Answers like a server that predates Protocol::Negotiate: any command received before the
+// authorization closes the connection.
+class LegacyServer : public QThread
+{
+public:
+    explicit LegacyServer(const QString &socketName)
+        : m_socketName(socketName)
+    {}
+
+    void waitForListening()
+    {
+        m_listening.acquire();
+    }
+
+    // only valid once the thread finished
+    QList<QByteArray> commands() const
+    {
+        return m_commands;
+    }
+
+protected:
+    void run() Q_DECL_OVERRIDE
+    {
+        QLocalServer server;
+        server.listen(m_socketName);
+        m_listening.release();
+
+        bool destroyed = false;
+        while (!destroyed && server.waitForNewConnection(5000)) {
+            QScopedPointer<QLocalSocket> socket(server.nextPendingConnection());
+            bool authorized = false;
+            while (socket->state() == QLocalSocket::ConnectedState) {
+                QByteArray command;
+                QByteArray data;
+                if (!receivePacket(socket.data(), &command, &data)) {
+                    socket->waitForReadyRead(250);
+                    continue;
+                }
+                m_commands.append(command);
+
+                if (command == Protocol::Authorize) {
+                    authorized = true;
+                    reply(socket.data(), true);
+                } else if (!authorized) {
+                    socket->disconnectFromServer();
+                } else if (command == Protocol::QSettingsFileName) {
+                    reply(socket.data(), QString::fromLatin1("legacy"));
+                } else if (command == Protocol::Destroy) {
+                    destroyed = true;
+                    socket->disconnectFromServer();
+                }
+            }
+        }
+    }
+
+private:
+    template<typename T>
+    void reply(QLocalSocket *socket, const T &value)
+    {
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << value;
+        sendPacket(socket, Protocol::Reply, data);
+        socket->waitForBytesWritten();
+    }
+
+    QString m_socketName;
+    QSemaphore m_listening;
+    QList<QByteArray> m_commands;
+};
+
+// Records what the server reports while extracting an archive through a RemoteFileEngine.
+class RecordingExtractCallback : public Lib7z::ExtractCallback
+{
+public:
+    bool prepareAnswer = true;
+    bool cancel = false;
+
+    QStringList currentFiles;
+    QStringList preparedFiles;
+    int completedCount = 0;
+    quint64 completed = 0;
+    quint64 total = 0;
+
+protected:
+    bool prepareForFile(const QString &filename) Q_DECL_OVERRIDE
+    {
+        preparedFiles.append(QFileInfo(filename).fileName());
+        return prepareAnswer;
+    }
+
+    void setCurrentFile(const QString &filename) Q_DECL_OVERRIDE
+    {
+        currentFiles.append(QFileInfo(filename).fileName());
+    }
+
+    HRESULT setCompleted(quint64 c, quint64 t) Q_DECL_OVERRIDE
+    {
+        ++completedCount;
+        completed = c;
+        total = t;
+        return cancel ? E_ABORT : S_OK;
+    }
+};
+
 class tst_ClientServer : public QObject
 {
     Q_OBJECT
@@ -139,6 +270,68 @@ private slots:
         }
     }
 
+    void sendReceiveFrame()
+    {
+        QCOMPARE(Protocol::commandName(Protocol::opcode(Protocol::QAbstractFileEngineWrite)),
+            QByteArray(Protocol::QAbstractFileEngineWrite));
+        QCOMPARE(Protocol::opcode("say"), Protocol::InvalidOpcode);
+        QCOMPARE(Protocol::commandName(Protocol::InvalidOpcode), QByteArray());
+
+        const Protocol::FrameHeader seek(Protocol::opcode(Protocol::QAbstractFileEngineSeek),
+            Protocol::NoReply, 1);
+        const Protocol::FrameHeader pos(Protocol::opcode(Protocol::QAbstractFileEnginePos), 0, 2);
+
+        QByteArray batch = createFrame(seek, "hello");
+        batch.append(createFrame(pos, QByteArray()));
+
+        QByteArray buffer;
+        {
+            QBuffer device(&buffer);
+            device.open(QBuffer::WriteOnly);
+            sendFrame(&device, Protocol::FrameHeader(Protocol::opcode(Protocol::Batch),
+                Protocol::NoReply, 3), batch);
+        }
+
+        // incomplete frames are left untouched ...
+        {
+            QByteArray incomplete = buffer.left(buffer.size() - 1);
+            QBuffer device(&incomplete);
+            device.open(QBuffer::ReadOnly);
+
+            Protocol::FrameHeader header;
+            QByteArray data;
+            QCOMPARE(receiveFrame(&device, &header, &data), false);
+            QCOMPARE(device.pos(), 0);
+        }
+
+        QBuffer device(&buffer);
+        device.open(QBuffer::ReadOnly);
+
+        Protocol::FrameHeader header;
+        QByteArray data;
+        QCOMPARE(receiveFrame(&device, &header, &data), true);
+        QCOMPARE(device.pos(), device.size());
+        QCOMPARE(header.opcode, Protocol::opcode(Protocol::Batch));
+        QCOMPARE(header.requestId, quint32(3));
+        QCOMPARE(data, batch);
+
+        // ... and the batch unpacks into its calls in order
+        QBuffer calls(&data);
+        calls.open(QBuffer::ReadOnly);
+        QByteArray callData;
+        QCOMPARE(receiveFrame(&calls, &header, &callData), true);
+        QCOMPARE(header.opcode, seek.opcode);
+        QCOMPARE(header.flags, quint8(Protocol::NoReply));
+        QCOMPARE(header.requestId, quint32(1));
+        QCOMPARE(callData, QByteArray("hello"));
+        QCOMPARE(receiveFrame(&calls, &header, &callData), true);
+        QCOMPARE(header.opcode, pos.opcode);
+        QCOMPARE(header.flags, quint8(0));
+        QCOMPARE(header.requestId, quint32(2));
+        QCOMPARE(callData, QByteArray());
+        QCOMPARE(receiveFrame(&calls, &header, &callData), false);
+    }
+
     void localSocket()
     {
         //
@@ -196,6 +389,91 @@ private slots:
     }
 
 
+    void testNegotiateWithLegacyServer()
+    {
+        const QString socketName = QUuid::createUuid().toString();
+        LegacyServer server(socketName);
+        server.start();
+        server.waitForListening();
+
+        RemoteClient::instance().init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Debug,
+                                      Protocol::StartAs::User);
+        {
+            // the server drops the connection on negotiation, the client reconnects and falls
+            // back to the legacy handshake and packets
+            TestRemoteObject object(QLatin1String(Protocol::QSettings));
+            QCOMPARE(object.connectToServer(), true);
+            QCOMPARE(object.supportsDeferredCalls(), false);
+            QCOMPARE(object.callRemoteMethod<QString>(QString::fromLatin1(
+                Protocol::QSettingsFileName)), QString::fromLatin1("legacy"));
+        }
+
+        QVERIFY(server.wait(10000));
+        QCOMPARE(server.commands(), QList<QByteArray>() << Protocol::Negotiate
+            << Protocol::Authorize << Protocol::Create << Protocol::QSettingsFileName
+            << Protocol::Destroy);
+    }
+
+    void testDeferredCalls()
+    {
+        RemoteServer server;
+        QString socketName = QUuid::createUuid().toString();
+        server.init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Production);
+        server.start();
+
+        RemoteClient::instance().init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Debug,
+                                      Protocol::StartAs::User);
+
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        const QString fileName = file.fileName();
+        file.close();
+
+        TestRemoteObject engine(QLatin1String(Protocol::QAbstractFileEngine));
+        QCOMPARE(engine.connectToServer(), true);
+        QCOMPARE(engine.supportsDeferredCalls(), true);
+        engine.callRemoteMethodWithoutReply(QString::fromLatin1(
+            Protocol::QAbstractFileEngineSetFileName), fileName);
+        QCOMPARE(engine.callRemoteMethod<bool>(QString::fromLatin1(
+            Protocol::QAbstractFileEngineOpen), qint32(QIODevice::WriteOnly)), true);
+
+        // deferred calls stay with the client until a call needs a reply, and are then sent
+        // together with it as one batch
+        engine.callRemoteMethodDeferred(QString::fromLatin1(Protocol::QAbstractFileEngineWrite),
+            QByteArray("hello "));
+        engine.callRemoteMethodDeferred(QString::fromLatin1(Protocol::QAbstractFileEngineWrite),
+            QByteArray("world"));
+        QTest::qWait(100);
+        QCOMPARE(QFileInfo(fileName).size(), qint64(0));
+
+        QCOMPARE(engine.callRemoteMethod<qint64>(QString::fromLatin1(
+            Protocol::QAbstractFileEnginePos)), qint64(11));
+        QCOMPARE(engine.takeDeferredFailure(), false);
+        QCOMPARE(QFileInfo(fileName).size(), qint64(11));
+
+        // a failing deferred call flags the next reply only
+        QCOMPARE(engine.callRemoteMethod<bool>(QString::fromLatin1(
+            Protocol::QAbstractFileEngineClose)), true);
+        QCOMPARE(engine.callRemoteMethod<bool>(QString::fromLatin1(
+            Protocol::QAbstractFileEngineOpen), qint32(QIODevice::ReadOnly)), true);
+        engine.callRemoteMethodDeferred(QString::fromLatin1(Protocol::QAbstractFileEngineWrite),
+            QByteArray("read only"));
+        QCOMPARE(engine.callRemoteMethod<qint64>(QString::fromLatin1(
+            Protocol::QAbstractFileEnginePos)), qint64(0));
+        QCOMPARE(engine.takeDeferredFailure(), true);
+        QCOMPARE(engine.takeDeferredFailure(), false);
+
+        QCOMPARE(engine.callRemoteMethod<qint64>(QString::fromLatin1(
+            Protocol::QAbstractFileEngineSize)), qint64(11));
+        QCOMPARE(engine.takeDeferredFailure(), false);
+        QCOMPARE(engine.callRemoteMethod<bool>(QString::fromLatin1(
+            Protocol::QAbstractFileEngineClose)), true);
+
+        QFile result(fileName);
+        QVERIFY(result.open(QIODevice::ReadOnly));
+        QCOMPARE(result.readAll(), QByteArray("hello world"));
+    }
+
     void testServerConnectDebug()
     {
         RemoteServer server;
@@ -513,6 +791,373 @@ private slots:
         file.resize(0);
         file.write(QProcess::systemEnvironment().join(QLatin1String("\n")).toLocal8Bit());
         QCOMPARE(file.atEnd(), true);
+        file.close();
+
+        // write and read more than one transfer window in small chunks
+        QByteArray payload;
+        for (int i = 0; payload.size() < 5 * 1024 * 1024; ++i)
+            payload.append(QByteArray::number(i)).append('\n');
+
+        QFile out(filename);
+        QCOMPARE(out.open(QIODevice::WriteOnly | QIODevice::Unbuffered), true);
+        for (int i = 0; i < payload.size(); i += 4096)
+            QCOMPARE(out.write(payload.mid(i, 4096)), qint64(payload.mid(i, 4096).size()));
+        QCOMPARE(out.size(), qint64(payload.size()));
+        QCOMPARE(out.flush(), true);
+        out.close();
+
+        QFile in(filename);
+        QCOMPARE(in.open(QIODevice::ReadOnly | QIODevice::Unbuffered), true);
+        QCOMPARE(in.read(4096), payload.left(4096));
+        QCOMPARE(in.pos(), qint64(4096));
+        QVERIFY(in.seek(payload.size() - 10));
+        QCOMPARE(in.readAll(), payload.right(10));
+        QVERIFY(in.seek(0));
+        QByteArray content;
+        while (!in.atEnd())
+            content.append(in.read(1000));
+        QCOMPARE(content, payload);
+        in.close();
+    }
+
+    void testRemoteFileEngineReadWindows()
+    {
+        RemoteServer server;
+        QString socketName = QUuid::createUuid().toString();
+        server.init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Production);
+        server.start();
+
+        RemoteClient::instance().init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Debug,
+                                      Protocol::StartAs::User);
+
+        // the engine reads ahead in windows of 2 MiB, cover the edges of the first two windows
+        const int window = 2 * 1024 * 1024;
+        QByteArray payload;
+        for (int i = 0; payload.size() < 2 * window + 123; ++i)
+            payload.append(QByteArray::number(i)).append('\n');
+        payload.truncate(2 * window + 123);
+
+        QTemporaryFile file;
+        QCOMPARE(file.open(), true);
+        QCOMPARE(file.write(payload), qint64(payload.size()));
+        file.close();
+
+        RemoteFileEngineHandler handler;
+
+        QFile in(file.fileName());
+        QCOMPARE(in.open(QIODevice::ReadOnly | QIODevice::Unbuffered), true);
+
+        // exactly one window, the next read starts a new one
+        QCOMPARE(in.read(window), payload.left(window));
+        QCOMPARE(in.pos(), qint64(window));
+        QCOMPARE(in.read(10), payload.mid(window, 10));
+        QCOMPARE(in.pos(), qint64(window + 10));
+
+        // a read straddling the end of the read-ahead
+        QVERIFY(in.seek(0));
+        QCOMPARE(in.read(100), payload.left(100));
+        QCOMPARE(in.pos(), qint64(100));
+        QCOMPARE(in.read(window - 110), payload.mid(100, window - 110));
+        QCOMPARE(in.pos(), qint64(window - 10));
+        QCOMPARE(in.read(20), payload.mid(window - 10, 20));
+        QCOMPARE(in.pos(), qint64(window + 10));
+
+        // a read larger than a window is served in one piece
+        QVERIFY(in.seek(window - 1));
+        QCOMPARE(in.read(window + 2), payload.mid(window - 1, window + 2));
+        QCOMPARE(in.pos(), qint64(2 * window + 1));
+
+        // seeking drops the read-ahead, also when seeking back into it
+        QVERIFY(in.seek(10));
+        QCOMPARE(in.read(10), payload.mid(10, 10));
+        QVERIFY(in.seek(5));
+        QCOMPARE(in.read(10), payload.mid(5, 10));
+
+        // the last window is shorter than the request
+        QVERIFY(in.seek(2 * window));
+        QCOMPARE(in.atEnd(), false);
+        QCOMPARE(in.read(window), payload.mid(2 * window));
+        QCOMPARE(in.pos(), qint64(payload.size()));
+        QCOMPARE(in.atEnd(), true);
+        QCOMPARE(in.read(10), QByteArray());
+        in.close();
+
+        // the engine itself reports the position of the caller, not the one of the server
+        RemoteFileEngine engine;
+        engine.setFileName(file.fileName());
+        QCOMPARE(engine.open(QIODevice::ReadOnly), true);
+        QByteArray buffer(window, '\0');
+        QCOMPARE(engine.read(buffer.data(), 100), qint64(100));
+        QCOMPARE(engine.pos(), qint64(100));
+        QCOMPARE(engine.read(buffer.data(), window - 110), qint64(window - 110));
+        QCOMPARE(buffer.left(window - 110), payload.mid(100, window - 110));
+        QCOMPARE(engine.pos(), qint64(window - 10));
+        QCOMPARE(engine.read(buffer.data(), 20), qint64(20));
+        QCOMPARE(buffer.left(20), payload.mid(window - 10, 20));
+        QCOMPARE(engine.pos(), qint64(window + 10));
+        QCOMPARE(engine.close(), true);
+    }
+
+    void testRemoteFileEngineWriteFailures()
+    {
+#ifdef Q_OS_LINUX
+        RemoteServer server;
+        QString socketName = QUuid::createUuid().toString();
+        server.init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Production);
+        server.start();
+
+        RemoteClient::instance().init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Debug,
+                                      Protocol::StartAs::User);
+
+        // seeks are answered by the server right away
+        QTemporaryFile file;
+        QCOMPARE(file.open(), true);
+        file.close();
+        RemoteFileEngine seeking;
+        seeking.setFileName(file.fileName());
+        QCOMPARE(seeking.open(QIODevice::ReadWrite), true);
+        QCOMPARE(seeking.seek(-1), false);
+        QCOMPARE(seeking.seek(10), true);
+        QCOMPARE(seeking.write("data", 4), qint64(4));
+        QCOMPARE(seeking.close(), true);
+
+        // every write to /dev/full fails with ENOSPC on the server; the failure shows up at the
+        // latest once a batch of writes is confirmed, and then in every following call
+        RemoteFileEngine engine;
+        engine.setFileName(QLatin1String("/dev/full"));
+        QCOMPARE(engine.open(QIODevice::ReadWrite), true);
+        const QByteArray chunk(4096, 'x');
+        int written = 0;
+        qint64 result = 0;
+        while (result >= 0 && written <= RemoteObject::MaxPendingBytes) {
+            result = engine.write(chunk.constData(), chunk.size());
+            written += chunk.size();
+        }
+        QCOMPARE(result, qint64(-1));
+        QCOMPARE(engine.write(chunk.constData(), chunk.size()), qint64(-1));
+        QCOMPARE(engine.flush(), false);
+        QCOMPARE(engine.close(), false);
+
+        // the failure does not carry over to the next time the file is opened
+        QCOMPARE(engine.open(QIODevice::ReadWrite), true);
+        QCOMPARE(engine.close(), true);
+#else
+        QSKIP("Needs /dev/full to make writes fail on the server.");
+#endif
+    }
+
+    void testRemoteFileEngineWriteWindow()
+    {
+        RemoteServer server;
+        QString socketName = QUuid::createUuid().toString();
+        server.init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Production);
+        server.start();
+
+        RemoteClient::instance().init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Debug,
+                                      Protocol::StartAs::User);
+
+        QTemporaryFile file;
+        QCOMPARE(file.open(), true);
+        file.close();
+
+        // data still collected by the engine is written after the client was deactivated, as
+        // happens when admin rights are dropped before the file is closed
+        const QByteArray payload(100000, 'x');
+        {
+            RemoteFileEngineHandler handler;
+            QFile out(file.fileName());
+            QCOMPARE(out.open(QIODevice::WriteOnly | QIODevice::Unbuffered), true);
+            QCOMPARE(out.write(payload), qint64(payload.size()));
+            RemoteClient::instance().setActive(false);
+            QCOMPARE(out.write(payload), qint64(payload.size()));
+            QCOMPARE(out.flush(), true);
+            QCOMPARE(out.write(payload), qint64(payload.size()));
+            out.close();
+            QCOMPARE(out.error(), QFileDevice::NoError);
+            RemoteClient::instance().setActive(true);
+        }
+        QCOMPARE(QFileInfo(file.fileName()).size(), qint64(3 * payload.size()));
+
+#ifdef Q_OS_LINUX
+        // a window that cannot be written fails the write that sends it and all after it
+        RemoteFileEngine engine;
+        engine.setFileName(QLatin1String("/dev/full"));
+        QCOMPARE(engine.open(QIODevice::WriteOnly), true);
+        const QByteArray window(2 * 1024 * 1024, 'x');
+        QCOMPARE(engine.write(window.constData(), 100), qint64(100));
+        QCOMPARE(engine.write(window.constData(), window.size()), qint64(-1));
+        QCOMPARE(engine.write(window.constData(), 100), qint64(-1));
+        QCOMPARE(engine.flush(), false);
+        QCOMPARE(engine.close(), false);
+#endif
+    }
+
+    void testAppendDataToRemoteFile()
+    {
+        RemoteServer server;
+        QString socketName = QUuid::createUuid().toString();
+        server.init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Production);
+        server.start();
+
+        RemoteClient::instance().init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Debug,
+                                      Protocol::StartAs::User);
+
+        QByteArray payload;
+        for (int i = 0; payload.size() < 3 * 1024 * 1024; ++i)
+            payload.append(QByteArray::number(i)).append('\n');
+
+        QTemporaryFile source;
+        QCOMPARE(source.open(), true);
+        QCOMPARE(source.write(payload), qint64(payload.size()));
+        QVERIFY(source.seek(0));
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString whole = dir.path() + QLatin1String("/whole");
+        const QString partial = dir.path() + QLatin1String("/partial");
+
+        // the output goes through the server, its handle() is no descriptor of this process
+        RemoteFileEngineHandler handler;
+        {
+            QFile out(whole);
+            QCOMPARE(out.open(QIODevice::WriteOnly), true);
+            try {
+                QInstaller::appendData(&out, &source, payload.size());
+            } catch (const QInstaller::Error &error) {
+                QFAIL(qPrintable(error.message()));
+            }
+            QCOMPARE(out.pos(), qint64(payload.size()));
+            QCOMPARE(source.pos(), qint64(payload.size()));
+            QCOMPARE(out.flush(), true);
+        }
+        {
+            QFile out(partial);
+            QCOMPARE(out.open(QIODevice::WriteOnly), true);
+            QCOMPARE(out.write("head"), qint64(4));
+            QVERIFY(source.seek(10));
+            try {
+                QInstaller::appendData(&out, &source, 100000);
+            } catch (const QInstaller::Error &error) {
+                QFAIL(qPrintable(error.message()));
+            }
+            QCOMPARE(out.pos(), qint64(100004));
+            QCOMPARE(source.pos(), qint64(100010));
+            QCOMPARE(out.flush(), true);
+        }
+
+        QFile result(whole);
+        QCOMPARE(result.open(QIODevice::ReadOnly), true);
+        QCOMPARE(result.readAll(), payload);
+        result.close();
+        result.setFileName(partial);
+        QCOMPARE(result.open(QIODevice::ReadOnly), true);
+        QCOMPARE(result.readAll(), QByteArray("head") + payload.mid(10, 100000));
+    }
+
+    void testExtractArchiveOnServer()
+    {
+        RemoteServer server;
+        QString socketName = QUuid::createUuid().toString();
+        server.init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Production);
+        server.start();
+
+        RemoteClient::instance().init(socketName, QLatin1String("SomeKey"), Protocol::Mode::Debug,
+                                      Protocol::StartAs::User);
+
+        QTemporaryDir sourceDir;
+        QVERIFY(sourceDir.isValid());
+        QStringList sources;
+        QStringList names;
+        for (int i = 0; i < 32; ++i) {
+            const QString name = QString::fromLatin1("file%1.txt").arg(i);
+            QFile source(sourceDir.path() + QLatin1Char('/') + name);
+            QCOMPARE(source.open(QIODevice::WriteOnly), true);
+            source.write(QByteArray(16 * 1024, char('a' + i % 26)));
+            sources.append(source.fileName());
+            names.append(name);
+        }
+        const QString archive = sourceDir.path() + QLatin1String("/archive.7z");
+        Lib7z::initSevenZ();
+        Lib7z::createArchive(archive, sources, Lib7z::QTmpFile::No);
+
+        // progress and file names reach the client
+        {
+            QTemporaryDir target;
+            QVERIFY(target.isValid());
+
+            RecordingExtractCallback callback;
+            RemoteFileEngine engine;
+            engine.setFileName(archive);
+            QVERIFY(engine.isConnectedToServer());
+            QVERIFY(engine.supportsDeferredCalls());
+
+            QString error;
+            QVERIFY2(engine.extractArchive(target.path(), &callback, &error), qPrintable(error));
+            QCOMPARE(error, QString());
+
+            QStringList currentFiles = callback.currentFiles;
+            currentFiles.sort();
+            QStringList expected = names;
+            expected.sort();
+            QCOMPARE(currentFiles, expected);
+            QCOMPARE(callback.preparedFiles, QStringList());
+            QVERIFY(callback.completedCount > 0);
+            QVERIFY(callback.total > 0);
+            QVERIFY(callback.completed > 0);
+            QVERIFY(callback.completed <= callback.total);
+            foreach (const QString &name, names)
+                QVERIFY(QFileInfo(target.path() + QLatin1Char('/') + name).exists());
+        }
+
+        // existing files are announced with PrepareForFile, the client's answer decides
+        {
+            QTemporaryDir target;
+            QVERIFY(target.isValid());
+            const QString existing = target.path() + QLatin1Char('/') + names.at(3);
+            {
+                QFile file(existing);
+                QCOMPARE(file.open(QIODevice::WriteOnly), true);
+                file.write("old");
+            }
+
+            RecordingExtractCallback callback;
+            RemoteFileEngine engine;
+            engine.setFileName(archive);
+
+            QString error;
+            QVERIFY2(engine.extractArchive(target.path(), &callback, &error), qPrintable(error));
+            QCOMPARE(callback.preparedFiles, QStringList() << names.at(3));
+            QCOMPARE(QFileInfo(existing).size(), qint64(16 * 1024));
+
+            callback.prepareAnswer = false;
+            callback.preparedFiles.clear();
+            QCOMPARE(engine.extractArchive(target.path(), &callback, &error), false);
+            QVERIFY(!error.isEmpty());
+            QCOMPARE(callback.preparedFiles.size(), 1);
+        }
+
+        // cancel from the progress callback, every file waits for an answer so the
+        // extraction cannot finish before the server sees the cancel request
+        {
+            QTemporaryDir target;
+            QVERIFY(target.isValid());
+            foreach (const QString &name, names) {
+                QFile file(target.path() + QLatin1Char('/') + name);
+                QCOMPARE(file.open(QIODevice::WriteOnly), true);
+                file.write("old");
+            }
+
+            RecordingExtractCallback callback;
+            callback.cancel = true;
+            RemoteFileEngine engine;
+            engine.setFileName(archive);
+
+            QString error;
+            QCOMPARE(engine.extractArchive(target.path(), &callback, &error), false);
+            QVERIFY(!error.isEmpty());
+            QVERIFY(callback.completedCount > 0);
+            QVERIFY(callback.preparedFiles.size() < names.size());
+        }
     }
 
     void cleanupTestCase()
@@ -0,0 +1,234 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include "httpstandin.h"
+#include "syntheticrepository.h"
+
+#include <binarycontent.h>
+#include <component.h>
+#include <downloadarchivesjob.h>
+#include <errors.h>
+#include <init.h>
+#include <packagemanagercore.h>
+#include <repository.h>
+#include <settings.h>
+
+#include <QDir>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace QInstaller;
+
+static const int scComponentCount = 6;
+static const int scLatency = 100;
+
+class tst_DownloadArchivesJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_DownloadArchivesJob()
+        : m_server(0)
+    {}
+
+private:
+    PackageManagerCore *createCore()
+    {
+        PackageManagerCore *core = new PackageManagerCore(BinaryContent::MagicInstallerMarker,
+            QList<OperationBlob>());
+        core->setValue(scTargetDir, m_targetDir.path());
+        core->setTestChecksum(true);
+        core->settings().setDefaultRepositories(QSet<Repository>()
+            << Repository(m_server->url(), true));
+        return core;
+    }
+
+    // Collects the archives of all components the same way the installer does.
+    QList<QPair<QString, QString> > archivesToDownload(PackageManagerCore *core)
+    {
+        QList<QPair<QString, QString> > archives;
+        foreach (Component *component,
+                core->components(PackageManagerCore::ComponentType::Root)) {
+            foreach (const QString &archive, component->downloadableArchives()) {
+                archives.append(qMakePair(QString::fromLatin1("installer://%1/%2")
+                    .arg(component->name(), archive), QString::fromLatin1("%1/%2/%3")
+                    .arg(component->repositoryUrl().toString(), component->name(), archive)));
+            }
+        }
+        return archives;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QInstaller::init();
+
+        QVERIFY(m_packagesDir.isValid());
+        QVERIFY(m_repositoryDir.isValid());
+        QVERIFY(m_targetDir.isValid());
+
+        try {
+            Benchmarks::writePackages(m_packagesDir.path(),
+                Benchmarks::RepositoryShape(scComponentCount, 0, 2, 64 * 1024));
+            Benchmarks::generateRepository(m_packagesDir.path(), m_repositoryDir.path());
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+
+        m_server = new HttpStandIn(m_repositoryDir.path(), this);
+        m_server->setLatency(scLatency);
+        QVERIFY(m_server->listen());
+    }
+
+    void testConcurrencyCap_data()
+    {
+        QTest::addColumn<int>("maxConcurrentDownloads");
+        QTest::newRow("one at a time") << 1;
+        QTest::newRow("three at a time") << 3;
+    }
+
+    void testConcurrencyCap()
+    {
+        QFETCH(int, maxConcurrentDownloads);
+
+        QScopedPointer<PackageManagerCore> core(createCore());
+        QVERIFY2(core->fetchRemotePackagesTree(), qPrintable(core->error()));
+        const QList<QPair<QString, QString> > archives = archivesToDownload(core.data());
+        QCOMPARE(archives.count(), scComponentCount);
+
+        DownloadArchivesJob job(core.data());
+        job.setAutoDelete(false);
+        job.setMaxConcurrentDownloads(maxConcurrentDownloads);
+        job.setArchivesToDownload(archives);
+        QSignalSpy downloaded(&job, &DownloadArchivesJob::archivesDownloaded);
+
+        m_server->resetMaxConcurrentRequests();
+        job.start();
+        job.waitForFinished();
+
+        QVERIFY2(job.error() == Job::NoError, qPrintable(job.errorString()));
+        QCOMPARE(job.numberOfDownloads(), scComponentCount);
+        QCOMPARE(downloaded.count(), scComponentCount);
+
+        // every transfer fetches its hash and its archive one after the other, so there are never
+        // more requests in flight than transfers
+        QVERIFY(m_server->maxConcurrentRequests() <= maxConcurrentDownloads);
+        if (maxConcurrentDownloads > 1)
+            QVERIFY(m_server->maxConcurrentRequests() > 1);
+    }
+
+    void testErrorStopsTransfers()
+    {
+        QScopedPointer<PackageManagerCore> core(createCore());
+        QVERIFY2(core->fetchRemotePackagesTree(), qPrintable(core->error()));
+        const QList<QPair<QString, QString> > archives = archivesToDownload(core.data());
+        QCOMPARE(archives.count(), scComponentCount);
+
+        // the hash of the first archive can still be fetched, the archive itself is missing
+        const QString failing = Benchmarks::componentName(0);
+        QDir componentDir(m_repositoryDir.path() + QLatin1Char('/') + failing);
+        foreach (const QString &archive, componentDir.entryList(QStringList()
+                << QLatin1String("*.7z"), QDir::Files)) {
+            QVERIFY(componentDir.remove(archive));
+        }
+
+        DownloadArchivesJob job(core.data());
+        job.setAutoDelete(false);
+        job.setMaxConcurrentDownloads(2);
+        job.setArchivesToDownload(archives);
+        QSignalSpy downloaded(&job, &DownloadArchivesJob::archivesDownloaded);
+
+        // without a QApplication the message box answers with no button, which cancels the job
+        job.start();
+        job.waitForFinished();
+
+        QVERIFY(job.error() != Job::NoError);
+        QVERIFY(!job.errorString().isEmpty());
+        QVERIFY(job.numberOfDownloads() < scComponentCount);
+        foreach (const QList<QVariant> &arguments, downloaded)
+            QVERIFY(arguments.value(0).toString() != failing);
+
+        // the other transfers got aborted and no new ones are started
+        const int requestCount = m_server->requestCount();
+        QTest::qWait(3 * scLatency);
+        QCOMPARE(m_server->requestCount(), requestCount);
+    }
+
+    void testCancelFinishesJob_data()
+    {
+        QTest::addColumn<bool>("running");
+        QTest::newRow("no transfers") << false;
+        QTest::newRow("running transfers") << true;
+    }
+
+    void testCancelFinishesJob()
+    {
+        QFETCH(bool, running);
+
+        QScopedPointer<PackageManagerCore> core(createCore());
+        QVERIFY2(core->fetchRemotePackagesTree(), qPrintable(core->error()));
+
+        DownloadArchivesJob job(core.data());
+        job.setAutoDelete(false);
+        job.setMaxConcurrentDownloads(2);
+        job.setArchivesToDownload(archivesToDownload(core.data()));
+        QSignalSpy finished(&job, &Job::finished);
+
+        const int requestCount = m_server->requestCount();
+        job.start();
+        if (running)
+            QTRY_VERIFY(m_server->requestCount() > requestCount);
+        job.cancel();
+
+        QVERIFY(job.isFinished());
+        QCOMPARE(job.error(), int(Job::Canceled));
+
+        // neither the queued start nor the aborted transfers finish the job a second time
+        QTest::qWait(3 * scLatency);
+        QCOMPARE(finished.count(), 1);
+        QCOMPARE(job.error(), int(Job::Canceled));
+        QCOMPARE(job.numberOfDownloads(), 0);
+    }
+
+    void cleanupTestCase()
+    {
+        if (m_server)
+            m_server->close();
+    }
+
+private:
+    QTemporaryDir m_packagesDir;
+    QTemporaryDir m_repositoryDir;
+    QTemporaryDir m_targetDir;
+    HttpStandIn *m_server;
+};
+
+QTEST_MAIN(tst_DownloadArchivesJob)
+
+#include "tst_downloadarchivesjob.moc"
@@ -28,9 +28,15 @@
 
 #include "init.h"
 #include "extractarchiveoperation.h"
+#include "fileremover.h"
+#include "fileutils.h"
+#include "lib7z_create.h"
+#include "lib7z_extract.h"
 
 #include <QDir>
+#include <QDirIterator>
 #include <QObject>
+#include <QTemporaryDir>
 #include <QTest>
 
 using namespace KDUpdater;
@@ -40,6 +46,39 @@ class tst_extractarchiveoperationtest : public QObject
 {
     Q_OBJECT
 
+private:
+    // Maps the paths below directory to their content, directories map to a null byte array.
+    QMap<QString, QByteArray> snapshot(const QString &directory)
+    {
+        QMap<QString, QByteArray> result;
+        const QDir root(directory);
+        QDirIterator it(directory, QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot,
+            QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            const QString path = it.next();
+            QByteArray content;
+            if (!it.fileInfo().isDir()) {
+                QFile file(path);
+                if (file.open(QIODevice::ReadOnly))
+                    content = file.readAll();
+                content.prepend('f'); // keeps empty files apart from directories
+            }
+            result.insert(root.relativeFilePath(path), content);
+        }
+        return result;
+    }
+
+    void extract(const QString &archivePath, const QString &targetDir, int threadCount)
+    {
+        QFile archive(archivePath);
+        QVERIFY(archive.open(QIODevice::ReadOnly));
+        try {
+            Lib7z::extractArchive(&archive, targetDir, 0, threadCount);
+        } catch (const Lib7z::SevenZipException &e) {
+            QFAIL(qPrintable(e.message()));
+        }
+    }
+
 private slots:
     void initTestCase()
     {
@@ -70,6 +109,114 @@ private slots:
         QVERIFY(op.undoOperation());
     }
 
+    void testExtractOperationFileManifest()
+    {
+        ExtractArchiveOperation op(0);
+        op.setArguments(QStringList() << ":///data/valid.7z" << QDir::tempPath());
+        QVERIFY(op.performOperation());
+
+        const QStringList files = op.value("files").toStringList();
+        QVERIFY(files.contains(QDir::tempPath() + QString("/valid")));
+
+        ExtractArchiveOperation restored(0);
+        QVERIFY(restored.fromXml(op.toXml()));
+        QCOMPARE(restored.value("files").toStringList(), files);
+        QCOMPARE(restored.arguments(), op.arguments());
+
+        QVERIFY(restored.undoOperation());
+        QVERIFY(!QFile::exists(QDir::tempPath() + QString("/valid")));
+    }
+
+    void testRemoveEntriesAndDirectory()
+    {
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        const QString root = tempDir.path() + QString("/tree");
+
+        QStringList entries;
+        for (int i = 0; i < 8; ++i) {
+            const QString dir = root + QString("/dir%1/sub").arg(i);
+            QVERIFY(QDir().mkpath(dir));
+            for (int j = 0; j < 600; ++j) { // more than fits into one batch
+                QFile file(dir + QString("/file%1").arg(j));
+                QVERIFY(file.open(QIODevice::WriteOnly));
+                entries.prepend(file.fileName());
+            }
+            entries.append(dir);
+        }
+        QFile foreign(root + QString("/dir0/sub/foreign"));
+        QVERIFY(foreign.open(QIODevice::WriteOnly));
+        foreign.close();
+
+        FileRemover remover;
+        QCOMPARE(remover.removeEntries(entries), QStringList());
+        QVERIFY(!QFile::exists(root + QString("/dir1/sub")));
+        QVERIFY(!QFile::exists(root + QString("/dir0/sub/file0")));
+        QVERIFY(foreign.exists()); // not in the list, keeps its directory alive
+
+        QInstaller::removeDirectory(root);
+        QVERIFY(!QFile::exists(root));
+    }
+
+    void testParallelExtractMatchesSerial_data()
+    {
+        QTest::addColumn<quint64>("solidBlockSize");
+        QTest::newRow("multiple solid blocks") << quint64(64 * 1024);
+        QTest::newRow("one solid block") << quint64(0);
+    }
+
+    void testParallelExtractMatchesSerial()
+    {
+        QFETCH(quint64, solidBlockSize);
+
+        QTemporaryDir tempDir;
+        QVERIFY(tempDir.isValid());
+        const QString source = tempDir.path() + QString("/source");
+        for (int i = 0; i < 6; ++i) {
+            const QString dir = source + QString("/dir%1/sub").arg(i);
+            QVERIFY(QDir().mkpath(dir));
+            for (int j = 0; j < 8; ++j) {
+                QFile file(dir + QString("/file%1").arg(j));
+                QVERIFY(file.open(QIODevice::WriteOnly));
+                QByteArray content;
+                for (int k = 0; content.size() < (i * 8 + j) * 1024; ++k)
+                    content.append(QByteArray::number(k * (i + 1) * (j + 3)));
+                file.write(content);
+            }
+        }
+        QVERIFY(QDir().mkpath(source + QString("/empty/dir")));
+        QFile empty(source + QString("/dir0/empty"));
+        QVERIFY(empty.open(QIODevice::WriteOnly));
+        empty.close();
+
+        const QString archive = tempDir.path() + QString("/archive.7z");
+        try {
+            Lib7z::createArchive(archive, QStringList() << source, Lib7z::QTmpFile::No,
+                Lib7z::Compression::Normal, 0, solidBlockSize);
+        } catch (const Lib7z::SevenZipException &e) {
+            QFAIL(qPrintable(e.message()));
+        }
+
+        const QString serial = tempDir.path() + QString("/serial");
+        const QString parallel = tempDir.path() + QString("/parallel");
+        extract(archive, serial, 1);
+        extract(archive, parallel, 4);
+
+        const QMap<QString, QByteArray> expected = snapshot(serial);
+        QVERIFY(expected.contains(QString("source/dir5/sub/file7")));
+        QVERIFY(expected.contains(QString("source/empty/dir")));
+        QCOMPARE(snapshot(parallel), expected);
+
+        // the operation extracts with all cores
+        const QString operation = tempDir.path() + QString("/operation");
+        ExtractArchiveOperation op(0);
+        op.setArguments(QStringList() << archive << operation);
+        QVERIFY2(op.performOperation(), qPrintable(op.errorString()));
+        QCOMPARE(snapshot(operation), expected);
+        QVERIFY(op.undoOperation());
+        QVERIFY(!QFile::exists(operation + QString("/source/dir5/sub/file7")));
+    }
+
     void testExtractOperationInvalidFile()
     {
         ExtractArchiveOperation op(0);
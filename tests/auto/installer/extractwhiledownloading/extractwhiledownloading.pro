@@ -0,0 +1,10 @@
+include(../../qttest.pri)
+include(../../../shared/shared.pri)
+
+QT -= gui
+QT += concurrent network qml xml
+
+SOURCES += tst_extractwhiledownloading.cpp
+
+RESOURCES += \
+    settings.qrc
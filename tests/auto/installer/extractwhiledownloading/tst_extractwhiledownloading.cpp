@@ -0,0 +1,217 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include "httpstandin.h"
+#include "packagemanagercoretestaccess.h"
+#include "syntheticrepository.h"
+
+#include <binarycontent.h>
+#include <component.h>
+#include <constants.h>
+#include <errors.h>
+#include <init.h>
+#include <packagemanagercore.h>
+#include <progresscoordinator.h>
+#include <repository.h>
+#include <settings.h>
+
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace QInstaller;
+
+static const int scComponentCount = 6;
+
+/*
+    Runs an installation, an update and the installation of additional components in the
+    maintenance tool with ExtractWhileDownloading enabled in config.xml, and checks that each of
+    them starts installing components before the last archive was requested from the repository.
+    The functions depend on each other and need to run in the declared order.
+*/
+class tst_ExtractWhileDownloading : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_ExtractWhileDownloading()
+        : m_server(0)
+        , m_core(0)
+        , m_requestsBeforeInstall(-1)
+    {}
+
+private:
+    void generateRepository()
+    {
+        try {
+            Benchmarks::generateRepository(m_packagesDir.path(), m_repositoryDir.path());
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+    }
+
+    void writePackage(int index, const QString &version)
+    {
+        try {
+            Benchmarks::writePackage(m_packagesDir.path(), index, version, m_shape);
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+    }
+
+    // Runs the installation in the current mode of the core and checks that the first component
+    // got installed while archives were still downloaded.
+    void runAndVerifyPipelined(bool (PackageManagerCore::*run)())
+    {
+        QVERIFY2(m_core->calculateComponentsToInstall(),
+            qPrintable(m_core->componentsToInstallError()));
+        QVERIFY(!m_core->orderedComponentsToInstall().isEmpty());
+
+        m_requestsBeforeInstall = -1;
+        const int requestsBefore = m_server->requestCount();
+        const QMetaObject::Connection connection = connect(ProgressCoordinator::instance(),
+            &ProgressCoordinator::detailTextChanged, this, [this](const QString &text) {
+                if (m_requestsBeforeInstall < 0
+                        && text.contains(QLatin1String("Installing component"))) {
+                    m_requestsBeforeInstall = m_server->requestCount();
+                }
+        });
+
+        (m_core->*run)();
+        disconnect(connection);
+        ProgressCoordinator::instance()->reset();
+
+        QCOMPARE(m_core->status(), int(PackageManagerCore::Success));
+        QVERIFY(m_requestsBeforeInstall >= 0);
+        QVERIFY2(m_requestsBeforeInstall < m_server->requestCount(), "Waited for all downloads.");
+        QVERIFY(m_requestsBeforeInstall > requestsBefore);
+    }
+
+    void verifyInstalled(int index)
+    {
+        const QString name = Benchmarks::componentName(index);
+        const QString relativePath = QString::fromLatin1("%1/dir0/file0.bin").arg(name);
+        QFile source(QString::fromLatin1("%1/%2/data/%3").arg(m_packagesDir.path(), name,
+            relativePath));
+        QFile installed(m_targetDir.path() + QLatin1Char('/') + relativePath);
+        QVERIFY(source.open(QIODevice::ReadOnly));
+        QVERIFY2(installed.open(QIODevice::ReadOnly), qPrintable(installed.fileName()));
+        QCOMPARE(installed.readAll(), source.readAll());
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QInstaller::init();
+
+        QVERIFY(m_packagesDir.isValid());
+        QVERIFY(m_repositoryDir.isValid());
+        QVERIFY(m_targetDir.isValid());
+
+        m_shape = Benchmarks::RepositoryShape(scComponentCount, 0, 2, 64 * 1024);
+        for (int i = 0; i < scComponentCount; ++i)
+            writePackage(i, QLatin1String("1.0.0"));
+        generateRepository();
+
+        // one download at a time, so the downloads of all components take a while
+        m_server = new HttpStandIn(m_repositoryDir.path(), this);
+        m_server->setLatency(50);
+        QVERIFY(m_server->listen());
+    }
+
+    void install()
+    {
+        m_core = new PackageManagerCore(BinaryContent::MagicInstallerMarker,
+            QList<OperationBlob>());
+        QVERIFY(m_core->settings().extractWhileDownloading());
+        m_core->autoAcceptMessageBoxes();
+        PackageManagerCoreTestAccess::disableWriteMaintenanceTool(m_core);
+        m_core->setValue(scTargetDir, m_targetDir.path());
+        m_core->settings().setDefaultRepositories(QSet<Repository>()
+            << Repository(m_server->url(), true));
+        QVERIFY2(m_core->fetchRemotePackagesTree(), qPrintable(m_core->error()));
+
+        runAndVerifyPipelined(&PackageManagerCore::runInstaller);
+        for (int i = 0; i < scComponentCount; ++i)
+            verifyInstalled(i);
+    }
+
+    void update()
+    {
+        QVERIFY(m_core);
+        for (int i = 0; i < scComponentCount; ++i)
+            writePackage(i, QLatin1String("2.0.0"));
+        generateRepository();
+
+        m_core->setUpdater();
+        QVERIFY2(m_core->fetchRemotePackagesTree(), qPrintable(m_core->error()));
+        runAndVerifyPipelined(&PackageManagerCore::runPackageUpdater);
+        for (int i = 0; i < scComponentCount; ++i)
+            verifyInstalled(i);
+    }
+
+    void addComponents()
+    {
+        QVERIFY(m_core);
+        for (int i = scComponentCount; i < 2 * scComponentCount; ++i)
+            writePackage(i, QLatin1String("1.0.0"));
+        generateRepository();
+
+        m_core->setPackageManager();
+        QVERIFY2(m_core->fetchRemotePackagesTree(), qPrintable(m_core->error()));
+        for (int i = scComponentCount; i < 2 * scComponentCount; ++i) {
+            Component *component = m_core->componentByName(Benchmarks::componentName(i));
+            QVERIFY(component);
+            component->setCheckState(Qt::Checked);
+        }
+
+        runAndVerifyPipelined(&PackageManagerCore::runPackageUpdater);
+        for (int i = 0; i < 2 * scComponentCount; ++i)
+            verifyInstalled(i);
+    }
+
+    void cleanupTestCase()
+    {
+        if (m_server)
+            m_server->close();
+        delete m_core;
+        m_core = 0;
+    }
+
+private:
+    QTemporaryDir m_packagesDir;
+    QTemporaryDir m_repositoryDir;
+    QTemporaryDir m_targetDir;
+    Benchmarks::RepositoryShape m_shape;
+    HttpStandIn *m_server;
+    PackageManagerCore *m_core;
+    int m_requestsBeforeInstall;
+};
+
+QTEST_MAIN(tst_ExtractWhileDownloading)
+
+#include "tst_extractwhiledownloading.moc"
@@ -0,0 +1,133 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include <fileio.h>
+
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace QInstaller;
+
+class tst_FileIO : public QObject
+{
+    Q_OBJECT
+
+private:
+    static QByteArray testData(int size)
+    {
+        QByteArray data(size, Qt::Uninitialized);
+        for (int i = 0; i < size; ++i)
+            data[i] = char((i * 7 + i / 251) & 0xff);
+        return data;
+    }
+
+    static bool writeFile(const QString &fileName, const QByteArray &data)
+    {
+        QFile file(fileName);
+        return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+    }
+
+    static QByteArray readFile(const QString &fileName)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return QByteArray();
+        return file.readAll();
+    }
+
+private slots:
+    void init()
+    {
+        QVERIFY(m_dir.isValid());
+        m_inputFileName = m_dir.path() + QLatin1String("/input.bin");
+        m_outputFileName = m_dir.path() + QLatin1String("/output.bin");
+        QFile::remove(m_inputFileName);
+        QFile::remove(m_outputFileName);
+    }
+
+    void appendDataAtOffsets()
+    {
+        const QByteArray data = testData(256 * 1024);
+        const QByteArray prefix = testData(333);
+        QVERIFY(writeFile(m_inputFileName, data));
+
+        QFile in(m_inputFileName);
+        openForRead(&in);
+        QVERIFY(in.seek(1000));
+
+        QFile out(m_outputFileName);
+        openForWrite(&out);
+        QCOMPARE(out.write(prefix), qint64(prefix.size()));
+
+        // neither device starts at 0, so the whole file can't be shared and the kernel copies
+        // the range between the current positions, if it supports that at all
+        appendData(&out, &in, 100000);
+        QCOMPARE(in.pos(), qint64(1000 + 100000));
+        QCOMPARE(out.pos(), qint64(prefix.size() + 100000));
+
+        // the positions are usable for further copies and for buffered reads and writes
+        appendData(&out, &in, 5000);
+        QCOMPARE(in.read(10), data.mid(106000, 10));
+        QCOMPARE(out.write(prefix), qint64(prefix.size()));
+        out.close();
+
+        QCOMPARE(readFile(m_outputFileName), prefix + data.mid(1000, 105000) + prefix);
+    }
+
+    void appendDataToAppendOnlyFile()
+    {
+        const QByteArray data = testData(70000);
+        const QByteArray prefix = testData(17);
+        QVERIFY(writeFile(m_inputFileName, data));
+        QVERIFY(writeFile(m_outputFileName, prefix));
+
+        QFile in(m_inputFileName);
+        openForRead(&in);
+        QVERIFY(in.seek(3));
+
+        // the kernel can't copy to a file opened for appending, blockingCopy() copies the
+        // remainder, which is all of it here
+        QFile out(m_outputFileName);
+        openForAppend(&out);
+        appendData(&out, &in, data.size() - 3);
+        QVERIFY(in.atEnd());
+        out.close();
+
+        QCOMPARE(readFile(m_outputFileName), prefix + data.mid(3));
+    }
+
+private:
+    QTemporaryDir m_dir;
+    QString m_inputFileName;
+    QString m_outputFileName;
+};
+
+QTEST_MAIN(tst_FileIO)
+
+#include "tst_fileio.moc"
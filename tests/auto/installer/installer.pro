@@ -19,7 +19,17 @@ SUBDIRS += \
     settingsoperation \
     task \
     clientserver \
-    factory
+    factory \
+    updatesinfo \
+    localpackagehub \
+    tracer \
+    verbosewriter \
+    fileio \
+    repositorygen \
+    downloadarchivesjob \
+    extractwhiledownloading \
+    metadatajob \
+    binaryformatenginehandler
 
 win32 {
     SUBDIRS += registerfiletypeoperation
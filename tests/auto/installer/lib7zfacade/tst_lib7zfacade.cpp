@@ -32,6 +32,7 @@
 #include <lib7z_list.h>
 
 #include <QDir>
+#include <QFileInfo>
 #include <QObject>
 #include <QTemporaryFile>
 #include <QTest>
@@ -138,6 +139,90 @@ private slots:
 
     }
 
+    void testChangedArchiveIsReopened()
+    {
+        try {
+            const QString path1 = tempSourceFile("Source File 1.");
+            const QString path2 = tempSourceFile("Source File 2.");
+            const QString target = QDir::tempPath() + "/changed.7z";
+
+            QFile::remove(target);
+            Lib7z::createArchive(target, QStringList() << path1, Lib7z::QTmpFile::No);
+            QVERIFY(Lib7z::isSupportedArchive(target)); // keeps the parsed archive around
+
+            QVERIFY(QFile::remove(target));
+            Lib7z::createArchive(target, QStringList() << path1 << path2, Lib7z::QTmpFile::No);
+            QFile file(target);
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            QCOMPARE(Lib7z::listArchive(&file).count(), 2);
+        } catch (const Lib7z::SevenZipException& e) {
+            QFAIL(e.message().toUtf8());
+        } catch (...) {
+            QFAIL("Unexpected error during list archive.");
+        }
+    }
+
+    void testReplacedArchiveIsReopened()
+    {
+        try {
+            const QString path1 = tempSourceFile("Source File 1.");
+            const QString path2 = tempSourceFile("Source File 2.");
+            const QString target = QDir::tempPath() + "/replaced.7z";
+            const QString replacement = QDir::tempPath() + "/replacement.7z";
+
+            QFile::remove(target);
+            QFile::remove(replacement);
+            Lib7z::createArchive(target, QStringList() << path1, Lib7z::QTmpFile::No);
+            Lib7z::createArchive(replacement, QStringList() << path2, Lib7z::QTmpFile::No);
+            QVERIFY(Lib7z::isSupportedArchive(target)); // keeps the parsed archive around
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+            // same size and modification time, only the file identity tells them apart
+            QFile replacementFile(replacement);
+            QVERIFY(replacementFile.open(QIODevice::ReadWrite));
+            QVERIFY(replacementFile.setFileTime(QFileInfo(target).lastModified(),
+                QFileDevice::FileModificationTime));
+            replacementFile.close();
+#endif
+            QVERIFY(QFile::remove(target));
+            QVERIFY(QFile::rename(replacement, target));
+
+            QFile file(target);
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            const QVector<Lib7z::File> files = Lib7z::listArchive(&file);
+            QCOMPARE(files.count(), 1);
+            QCOMPARE(files.first().path, QFileInfo(path2).fileName());
+        } catch (const Lib7z::SevenZipException& e) {
+            QFAIL(e.message().toUtf8());
+        } catch (...) {
+            QFAIL("Unexpected error during list archive.");
+        }
+    }
+
+    void testClearArchiveCache()
+    {
+#ifdef Q_OS_LINUX
+        try {
+            const QString target = QDir::tempPath() + "/cleared.7z";
+            QFile::remove(target);
+            Lib7z::createArchive(target, QStringList() << tempSourceFile("Source File 1."),
+                Lib7z::QTmpFile::No);
+            QVERIFY(Lib7z::isSupportedArchive(target)); // keeps the parsed archive around
+            QCOMPARE(openCount(target), 1);
+
+            Lib7z::clearArchiveCache();
+            QCOMPARE(openCount(target), 0);
+            QVERIFY(QFile::remove(target));
+        } catch (const Lib7z::SevenZipException& e) {
+            QFAIL(e.message().toUtf8());
+        } catch (...) {
+            QFAIL("Unexpected error during list archive.");
+        }
+#else
+        QSKIP("Open files are only inspected on Linux.");
+#endif
+    }
+
     void testExtractArchive()
     {
         QFile source(":///data/valid.7z");
@@ -154,6 +239,19 @@ private slots:
     }
 
 private:
+    // Returns how often this process has \a path open.
+    int openCount(const QString &path)
+    {
+        int count = 0;
+        const QString canonicalPath = QFileInfo(path).canonicalFilePath();
+        QDir fds(QLatin1String("/proc/self/fd"));
+        foreach (const QFileInfo &fd, fds.entryInfoList(QDir::System | QDir::NoDotAndDotDot)) {
+            if (fd.symLinkTarget() == canonicalPath)
+                ++count;
+        }
+        return count;
+    }
+
     QString tempSourceFile(const QByteArray &data, const QString &templateName = QString())
     {
         QTemporaryFile source;
@@ -0,0 +1,132 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include <localpackagehub.h>
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace KDUpdater;
+
+class tst_LocalPackageHub : public QObject
+{
+    Q_OBJECT
+
+private:
+    void addPackage(LocalPackageHub *hub, const QString &name, const QString &version)
+    {
+        hub->addPackage(name, version, name + QLatin1String(" title"), QString(),
+            QStringList(), QStringList(), false, false, 1024, QString(), true);
+    }
+
+private slots:
+    void testJournalReplay()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/components.xml");
+
+        {
+            LocalPackageHub hub;
+            hub.setFileName(fileName);
+            hub.setApplicationName(QLatin1String("Test"));
+            addPackage(&hub, QLatin1String("A"), QLatin1String("1.0"));
+            hub.writeToDisk();
+            QVERIFY(QFile::exists(fileName));
+            QVERIFY(!QFile::exists(hub.journalFileName()));
+
+            addPackage(&hub, QLatin1String("B"), QLatin1String("1.0"));
+            hub.writeJournal();
+            addPackage(&hub, QLatin1String("C"), QLatin1String("2.0"));
+            QVERIFY(hub.removePackage(QLatin1String("A")));
+            hub.writeJournal();
+            QVERIFY(QFile::exists(hub.journalFileName()));
+
+            // simulate a crash, the destructor would compact the journal
+            QFile::copy(fileName, fileName + QLatin1String(".crashed"));
+            QFile::copy(hub.journalFileName(), hub.journalFileName() + QLatin1String(".crashed"));
+        }
+        QVERIFY(QFile::remove(fileName));
+        QVERIFY(QFile::rename(fileName + QLatin1String(".crashed"), fileName));
+        QVERIFY(QFile::rename(fileName + QLatin1String(".journal.crashed"),
+            fileName + QLatin1String(".journal")));
+
+        // append a truncated record as left by a crash while writing
+        {
+            QFile journal(fileName + QLatin1String(".journal"));
+            QVERIFY(journal.open(QIODevice::WriteOnly | QIODevice::Append));
+            journal.write("\x00\x00\x01\x00\x00", 5);
+        }
+
+        LocalPackageHub hub;
+        hub.setFileName(fileName);
+        QCOMPARE(hub.error(), LocalPackageHub::NoError);
+        QCOMPARE(hub.applicationName(), QLatin1String("Test"));
+        QCOMPARE(hub.packageNames(), QStringList() << QLatin1String("B") << QLatin1String("C"));
+        QCOMPARE(hub.packageInfo(QLatin1String("C")).version, QLatin1String("2.0"));
+        QCOMPARE(hub.packageInfo(QLatin1String("C")).uncompressedSize, quint64(1024));
+        QCOMPARE(hub.packageInfo(QLatin1String("C")).checkable, true);
+
+        // the journal got compacted into the snapshot
+        QVERIFY(!QFile::exists(hub.journalFileName()));
+        LocalPackageHub reread;
+        reread.setFileName(fileName);
+        QCOMPARE(reread.packageNames(), hub.packageNames());
+    }
+
+    void testJournalWithoutSnapshot()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/components.xml");
+
+        {
+            LocalPackageHub hub;
+            hub.setFileName(fileName);
+            hub.clearPackageInfos();
+            addPackage(&hub, QLatin1String("A"), QLatin1String("1.0"));
+            hub.writeJournal();
+            QVERIFY(!QFile::exists(fileName));
+            QVERIFY(QFile::copy(hub.journalFileName(), fileName + QLatin1String(".saved")));
+        }
+        QVERIFY(QFile::rename(fileName + QLatin1String(".saved"), fileName
+            + QLatin1String(".journal")));
+        QVERIFY(QFile::remove(fileName));
+
+        LocalPackageHub hub;
+        hub.setFileName(fileName);
+        QCOMPARE(hub.error(), LocalPackageHub::NoError);
+        QCOMPARE(hub.packageNames(), QStringList() << QLatin1String("A"));
+        QVERIFY(QFile::exists(fileName));
+    }
+};
+
+QTEST_MAIN(tst_LocalPackageHub)
+
+#include "tst_localpackagehub.moc"
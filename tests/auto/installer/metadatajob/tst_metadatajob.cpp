@@ -0,0 +1,193 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include "httpstandin.h"
+#include "syntheticrepository.h"
+
+#include <binarycontent.h>
+#include <component.h>
+#include <constants.h>
+#include <downloadcache.h>
+#include <errors.h>
+#include <init.h>
+#include <packagemanagercore.h>
+#include <repository.h>
+#include <settings.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace QInstaller;
+
+static const int scComponentCount = 4;
+
+/*
+    Fetches the meta information of a repository served by the HTTP stand-in several times, with
+    the download cache keeping the last Updates.xml and its entity tag. The functions depend on
+    each other and need to run in the declared order.
+*/
+class tst_MetadataJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_MetadataJob()
+        : m_server(0)
+    {}
+
+private:
+    void generateRepository()
+    {
+        try {
+            Benchmarks::generateRepository(m_packagesDir.path(), m_repositoryDir.path());
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+    }
+
+    // Fetches the repository with a new core and sets requests to the number of requests it took.
+    void fetch(const QString &expectedVersion, int *requests)
+    {
+        *requests = -1;
+        const int requestsBefore = m_server->requestCount();
+
+        PackageManagerCore core(BinaryContent::MagicInstallerMarker, QList<OperationBlob>());
+        core.setValue(scTargetDir, m_targetDir.path());
+        core.settings().setDefaultRepositories(QSet<Repository>()
+            << Repository(m_server->url(), true));
+        QVERIFY2(core.fetchRemotePackagesTree(), qPrintable(core.error()));
+
+        QCOMPARE(core.components(PackageManagerCore::ComponentType::Root).count(),
+            scComponentCount);
+        const Component *changed = core.componentByName(Benchmarks::componentName(0));
+        QVERIFY(changed);
+        QCOMPARE(changed->value(scVersion), expectedVersion);
+
+        *requests = m_server->requestCount() - requestsBefore;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QInstaller::init();
+
+        QVERIFY(m_packagesDir.isValid());
+        QVERIFY(m_repositoryDir.isValid());
+        QVERIFY(m_targetDir.isValid());
+        QVERIFY(m_cacheDir.isValid());
+
+        try {
+            Benchmarks::writePackages(m_packagesDir.path(),
+                Benchmarks::RepositoryShape(scComponentCount, 0, 1, 1024));
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+        generateRepository();
+
+        DownloadCache::instance()->setPath(m_cacheDir.path());
+        QVERIFY(DownloadCache::instance()->isEnabled());
+
+        m_server = new HttpStandIn(m_repositoryDir.path(), this);
+        QVERIFY(m_server->listen());
+    }
+
+    void firstFetch()
+    {
+        int requests = 0;
+        fetch(QLatin1String("1.0.0"), &requests);
+        QVERIFY(requests > 1); // Updates.xml and the meta information of the packages
+        QCOMPARE(m_server->notModifiedCount(), 0);
+    }
+
+    void notModifiedReusesCache()
+    {
+        // only Updates.xml is revalidated, the cached meta information is used as is
+        int requests = 0;
+        fetch(QLatin1String("1.0.0"), &requests);
+        QCOMPARE(requests, 1);
+        QCOMPARE(m_server->notModifiedCount(), 1);
+    }
+
+    void changedEntityTagFetchesAgain()
+    {
+        try {
+            Benchmarks::writePackage(m_packagesDir.path(), 0, QLatin1String("2.0.0"),
+                Benchmarks::RepositoryShape(scComponentCount, 0, 1, 1024));
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+        generateRepository();
+
+        int requests = 0;
+        fetch(QLatin1String("2.0.0"), &requests);
+        QVERIFY(requests > 1);
+        QCOMPARE(m_server->notModifiedCount(), 1);
+
+        // the new index replaced the cached one
+        fetch(QLatin1String("2.0.0"), &requests);
+        QCOMPARE(requests, 1);
+        QCOMPARE(m_server->notModifiedCount(), 2);
+    }
+
+    void cacheIsReplacedAsAWhole()
+    {
+        // the staging copy got renamed into place and the replaced copy removed
+        QDir metadataDir(m_cacheDir.path() + QLatin1String("/metadata"));
+        const QStringList entries = metadataDir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot);
+        QCOMPARE(entries.count(), 1);
+        QVERIFY(QFileInfo(metadataDir.absoluteFilePath(entries.first())
+            + QLatin1String("/Updates.xml")).isFile());
+
+        // a removed copy is fetched and published again
+        QVERIFY(QDir(metadataDir.absoluteFilePath(entries.first())).removeRecursively());
+        int requests = 0;
+        fetch(QLatin1String("2.0.0"), &requests);
+        QVERIFY(requests > 1);
+        QCOMPARE(metadataDir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot), entries);
+    }
+
+    void cleanupTestCase()
+    {
+        if (m_server)
+            m_server->close();
+        DownloadCache::instance()->setPath(QString());
+    }
+
+private:
+    QTemporaryDir m_packagesDir;
+    QTemporaryDir m_repositoryDir;
+    QTemporaryDir m_targetDir;
+    QTemporaryDir m_cacheDir;
+    HttpStandIn *m_server;
+};
+
+QTEST_MAIN(tst_MetadataJob)
+
+#include "tst_metadatajob.moc"
@@ -2,6 +2,10 @@ include(../../qttest.pri)
 
 QT += qml
 
+# reaches internals of the core through the shared test access class
+INCLUDEPATH += $$IFW_SOURCE_TREE/tests/shared
+HEADERS += $$IFW_SOURCE_TREE/tests/shared/packagemanagercoretestaccess.h
+
 SOURCES += tst_packagemanagercore.cpp
 
 RESOURCES += \
@@ -26,14 +26,20 @@
 **
 **************************************************************************/
 
+#include "packagemanagercoretestaccess.h"
+
 #include <binarycontent.h>
 #include <component.h>
 #include <errors.h>
 #include <fileutils.h>
+#include <lib7z_create.h>
+#include <lib7z_facade.h>
 #include <packagemanagercore.h>
 #include <progresscoordinator.h>
 
 #include <QDir>
+#include <QMessageBox>
+#include <QTemporaryDir>
 #include <QTemporaryFile>
 #include <QTest>
 
@@ -77,11 +83,66 @@ public:
 
 };
 
+class OperationsComponent : public NamedComponent
+{
+public:
+    OperationsComponent(PackageManagerCore *core, const QString &name)
+        : NamedComponent(core, name)
+        , m_created(false)
+    {
+        setCheckState(Qt::Checked);
+    }
+
+    void appendOperation(const QString &operation, const QStringList &arguments)
+    {
+        m_operations.append(qMakePair(operation, arguments));
+    }
+
+    void beginInstallation()
+    {
+    }
+
+    void createOperations()
+    {
+        if (m_created)
+            return;
+        m_created = true;
+        for (int i = 0; i < m_operations.count(); ++i)
+            addOperation(m_operations.at(i).first, m_operations.at(i).second);
+    }
+
+private:
+    bool m_created;
+    QList<QPair<QString, QStringList> > m_operations;
+};
+
 class tst_PackageManagerCore : public QObject
 {
     Q_OBJECT
 
 private:
+    QString createArchive(const QString &directory, const QString &fileName,
+        const QByteArray &content)
+    {
+        QTemporaryDir source;
+        QFile file(source.path() + QLatin1Char('/') + fileName);
+        if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size())
+            return QString();
+        file.close();
+
+        const QString archive = directory + QLatin1Char('/') + fileName + QLatin1String(".7z");
+        Lib7z::createArchive(archive, QStringList(file.fileName()), Lib7z::QTmpFile::No);
+        return archive;
+    }
+
+    QByteArray readFile(const QString &fileName)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly))
+            return QByteArray();
+        return file.readAll();
+    }
+
     void setIgnoreMessage(const QString &testDirectory)
     {
         const QString message = "\t- arguments: %1";
@@ -100,6 +161,11 @@ private:
     }
 
 private slots:
+    void initTestCase()
+    {
+        Lib7z::initSevenZ();
+    }
+
     void testRollBackInstallationKeepTarget()
     {
 
@@ -152,6 +218,207 @@ private slots:
         ProgressCoordinator::instance()->reset();
     }
 
+    void testConcurrentExtractKeepsWriteOrder()
+    {
+        QTemporaryDir archives;
+        QTemporaryDir target;
+        QVERIFY(archives.isValid());
+        QVERIFY(target.isValid());
+
+        const QString copySource = archives.path() + QLatin1String("/copied.txt");
+        QFile copied(copySource);
+        QVERIFY(copied.open(QIODevice::WriteOnly));
+        copied.write("copied");
+        copied.close();
+
+        PackageManagerCore core(QInstaller::BinaryContent::MagicInstallerMarker,
+            QList<QInstaller::OperationBlob>());
+        core.autoRejectMessageBoxes();
+        // the test binary carries no installer payload
+        PackageManagerCoreTestAccess::disableWriteMaintenanceTool(&core);
+        core.setValue(QLatin1String("TargetDir"), target.path());
+
+        // a writes shared.txt with a copy after its extraction, b extracts shared.txt later on,
+        // so b's archive has to win like in a serial installation; c touches nothing of them
+        OperationsComponent *first = new OperationsComponent(&core, QLatin1String("a.first"));
+        first->appendOperation(QLatin1String("Extract"), QStringList() << createArchive(
+            archives.path(), QLatin1String("first.txt"), "first") << target.path());
+        first->appendOperation(QLatin1String("Copy"), QStringList() << copySource
+            << target.path() + QLatin1String("/shared.txt"));
+        core.appendRootComponent(first);
+
+        OperationsComponent *second = new OperationsComponent(&core, QLatin1String("b.second"));
+        second->appendOperation(QLatin1String("Extract"), QStringList() << createArchive(
+            archives.path(), QLatin1String("shared.txt"), "second") << target.path());
+        core.appendRootComponent(second);
+
+        OperationsComponent *third = new OperationsComponent(&core, QLatin1String("c.third"));
+        third->appendOperation(QLatin1String("Extract"), QStringList() << createArchive(
+            archives.path(), QLatin1String("third.txt"), "third") << target.path());
+        core.appendRootComponent(third);
+
+        QVERIFY(core.calculateComponentsToInstall());
+        core.runInstaller();
+
+        QCOMPARE(core.status(), int(PackageManagerCore::Success));
+        QCOMPARE(readFile(target.path() + QLatin1String("/first.txt")), QByteArray("first"));
+        QCOMPARE(readFile(target.path() + QLatin1String("/shared.txt")), QByteArray("second"));
+        QCOMPARE(readFile(target.path() + QLatin1String("/third.txt")), QByteArray("third"));
+        ProgressCoordinator::instance()->reset();
+    }
+
+    void testRollBackScheduledExtractOperations()
+    {
+        QTemporaryDir archives;
+        QTemporaryDir target;
+        QVERIFY(archives.isValid());
+        QVERIFY(target.isValid());
+
+        PackageManagerCore core(QInstaller::BinaryContent::MagicInstallerMarker,
+            QList<QInstaller::OperationBlob>());
+        core.autoRejectMessageBoxes();
+        core.setMessageBoxAutomaticAnswer(QLatin1String("installationErrorWithRetry"),
+            QMessageBox::Cancel);
+        core.setValue(QLatin1String("TargetDir"), target.path());
+        core.setValue(QLatin1String("RemoveTargetDir"), QLatin1String("false"));
+        // only the failing copy is to roll back
+        PackageManagerCoreTestAccess::disableWriteMaintenanceTool(&core);
+
+        OperationsComponent *first = new OperationsComponent(&core, QLatin1String("a.first"));
+        first->appendOperation(QLatin1String("Extract"), QStringList() << createArchive(
+            archives.path(), QLatin1String("first.txt"), "first") << target.path());
+        core.appendRootComponent(first);
+
+        // fails after the extraction of the following component might have been started
+        OperationsComponent *failing = new OperationsComponent(&core, QLatin1String("b.failing"));
+        failing->appendOperation(QLatin1String("Copy"), QStringList()
+            << archives.path() + QLatin1String("/missing.txt")
+            << target.path() + QLatin1String("/missing.txt"));
+        core.appendRootComponent(failing);
+
+        OperationsComponent *third = new OperationsComponent(&core, QLatin1String("c.third"));
+        third->appendOperation(QLatin1String("Extract"), QStringList() << createArchive(
+            archives.path(), QLatin1String("third.txt"), "third") << target.path());
+        core.appendRootComponent(third);
+
+        QVERIFY(core.calculateComponentsToInstall());
+        core.runInstaller();
+
+        QVERIFY(core.status() != PackageManagerCore::Success);
+        QVERIFY(QDir(target.path()).exists());
+        QVERIFY(!QFileInfo::exists(target.path() + QLatin1String("/first.txt")));
+        QVERIFY(!QFileInfo::exists(target.path() + QLatin1String("/third.txt")));
+        ProgressCoordinator::instance()->reset();
+    }
+
+    void testParseNameAndVersion_data()
+    {
+        QTest::addColumn<QString>("requirement");
+        QTest::addColumn<QString>("name");
+        QTest::addColumn<QString>("version");
+
+        QTest::newRow("name") << "org.example.tool" << "org.example.tool" << "";
+        QTest::newRow("version") << "org.example.tool-1.0" << "org.example.tool" << "1.0";
+        QTest::newRow("operator") << "org.example.tool->=1.0-beta" << "org.example.tool"
+            << ">=1.0-beta";
+        QTest::newRow("first dash") << "org.qt-project.sdk-<2" << "org.qt" << "project.sdk-<2";
+        QTest::newRow("digit after name") << "foo-2bar" << "foo" << "2bar";
+        QTest::newRow("trailing dash") << "org.example.tool-" << "org.example.tool" << "";
+    }
+
+    void testParseNameAndVersion()
+    {
+        QFETCH(QString, requirement);
+        QFETCH(QString, name);
+        QFETCH(QString, version);
+
+        QString parsedName;
+        QString parsedVersion;
+        PackageManagerCore::parseNameAndVersion(requirement, &parsedName, &parsedVersion);
+        QCOMPARE(parsedName, name);
+        QCOMPARE(parsedVersion, version);
+    }
+
+    void testVersionMatches_data()
+    {
+        QTest::addColumn<QString>("version");
+        QTest::addColumn<QString>("requirement");
+        QTest::addColumn<bool>("matches");
+
+        QTest::newRow("equal") << "1.0.1" << "1.0.1" << true;
+        QTest::newRow("not equal") << "1.0.2" << "1.0.1" << false;
+        QTest::newRow("explicit equal") << "1.0.1" << "=1.0.1" << true;
+        QTest::newRow("greater") << "1.0.2" << ">1.0.1" << true;
+        QTest::newRow("not greater") << "1.0.1" << ">1.0.1" << false;
+        QTest::newRow("greater or equal") << "1.0.1" << ">=1.0.1" << true;
+        QTest::newRow("less") << "1.0.0" << "<1.0.1" << true;
+        QTest::newRow("not less") << "1.1" << "<1.0.1" << false;
+        QTest::newRow("less or equal") << "1.0.1" << "<=1.0.1" << true;
+    }
+
+    void testVersionMatches()
+    {
+        QFETCH(QString, version);
+        QFETCH(QString, requirement);
+        QFETCH(bool, matches);
+
+        QCOMPARE(PackageManagerCore::versionMatches(version, requirement), matches);
+    }
+
+    void testComponentRegistry()
+    {
+        PackageManagerCore core;
+        core.setPackageManager();
+
+        Component *root = new NamedComponent(&core, QLatin1String("root"), QLatin1String("2.0.0"));
+        Component *child = new NamedComponent(&core, QLatin1String("root.child"));
+        root->appendComponent(child);
+        core.appendRootComponent(root);
+
+        Component *any = new NamedComponent(&core, QLatin1String("any"));
+        any->setValue(scDependencies, QLatin1String("root, root.child"));
+        core.appendRootComponent(any);
+        Component *newer = new NamedComponent(&core, QLatin1String("newer"));
+        newer->setValue(scDependencies, QLatin1String("root->=2.0.0"));
+        core.appendRootComponent(newer);
+        Component *older = new NamedComponent(&core, QLatin1String("older"));
+        older->setValue(scDependencies, QLatin1String("root-<2.0.0"));
+        core.appendRootComponent(older);
+        Component *automatic = new NamedComponent(&core, QLatin1String("automatic"));
+        automatic->setValue(scAutoDependOn, QLatin1String("root"));
+        core.appendRootComponent(automatic);
+
+        QCOMPARE(core.componentByName(QLatin1String("root.child")), child);
+        QCOMPARE(core.componentByName(QLatin1String("root->1.0")), root);
+        QVERIFY(!core.componentByName(QLatin1String("root-<2.0.0")));
+        QVERIFY(!core.componentByName(QLatin1String("missing")));
+
+        // automatic dependencies and unsatisfied version requirements are no dependees
+        QCOMPARE(core.dependees(root).toSet(), QSet<Component *>() << any << newer);
+        QCOMPARE(core.dependees(child), QList<Component *>() << any);
+
+        // the registry follows renames, changed dependencies and new components
+        child->setValue(scName, QLatin1String("root.renamed"));
+        QVERIFY(!core.componentByName(QLatin1String("root.child")));
+        QCOMPARE(core.componentByName(QLatin1String("root.renamed")), child);
+        QVERIFY(core.dependees(child).isEmpty());
+
+        older->setValue(scDependencies, QLatin1String("root.renamed-1.0.0"));
+        QCOMPARE(core.dependees(root).toSet(), QSet<Component *>() << any << newer);
+        QCOMPARE(core.dependees(child), QList<Component *>() << older);
+
+        Component *grandChild = new NamedComponent(&core, QLatin1String("root.renamed.child"));
+        grandChild->addDependency(QLatin1String("root-2.0.0"));
+        child->appendComponent(grandChild);
+        QCOMPARE(core.componentByName(QLatin1String("root.renamed.child")), grandChild);
+        QCOMPARE(core.dependees(root).toSet(), QSet<Component *>() << any << newer << grandChild);
+
+        child->removeComponent(grandChild);
+        QVERIFY(!core.componentByName(QLatin1String("root.renamed.child")));
+        QCOMPARE(core.dependees(root).toSet(), QSet<Component *>() << any << newer);
+        delete grandChild;
+    }
+
     void testComponentSetterGetter()
     {
         {
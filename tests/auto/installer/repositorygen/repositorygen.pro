@@ -0,0 +1,8 @@
+include(../../qttest.pri)
+
+QT -= gui
+
+INCLUDEPATH += $$IFW_SOURCE_TREE/tools/common
+HEADERS += $$IFW_SOURCE_TREE/tools/common/repositorygen.h
+SOURCES += tst_repositorygen.cpp \
+    $$IFW_SOURCE_TREE/tools/common/repositorygen.cpp
@@ -0,0 +1,363 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include "repositorygen.h"
+
+#include <errors.h>
+#include <fileio.h>
+#include <fileutils.h>
+#include <init.h>
+#include <lib7z_facade.h>
+#include <lib7z_list.h>
+#include <utils.h>
+
+#include <QDateTime>
+#include <QDirIterator>
+#include <QDomDocument>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QTest>
+
+#define QUOTE_(x) #x
+#define QUOTE(x) QUOTE_(x)
+
+using namespace QInstallerTools;
+
+class tst_RepositoryGen : public QObject
+{
+    Q_OBJECT
+
+private:
+    void writeFile(const QString &fileName, const QByteArray &data)
+    {
+        QFile file(fileName);
+        QInstaller::openForWrite(&file);
+        QInstaller::blockingWrite(&file, data);
+    }
+
+    void writePackage(const QString &name, const QString &version, const QByteArray &content)
+    {
+        const QString packageDir = m_packagesDir + QLatin1Char('/') + name;
+        QInstaller::removeDirectory(packageDir);
+        QInstaller::mkpath(packageDir + QLatin1String("/meta"));
+        QInstaller::mkpath(packageDir + QLatin1String("/data"));
+
+        writeFile(packageDir + QLatin1String("/meta/package.xml"), QString::fromLatin1(
+            "<?xml version=\"1.0\"?>\n"
+            "<Package>\n"
+            "    <DisplayName>%1</DisplayName>\n"
+            "    <Description>%1</Description>\n"
+            "    <Version>%2</Version>\n"
+            "    <ReleaseDate>2020-01-01</ReleaseDate>\n"
+            "</Package>\n").arg(name, version).toUtf8());
+        writeFile(packageDir + QLatin1String("/data/") + name + QLatin1String(".txt"), content);
+    }
+
+    // Runs the same steps as repogen --update -p <packagesDir> <repositoryDir>.
+    void generateRepository(int jobs, bool uniteMetadata = false,
+        FingerprintMode fingerprintMode = NoFingerprints)
+    {
+        QStringList filteredPackages;
+        PackageInfoVector packages = createListOfPackages(QStringList(m_packagesDir),
+            &filteredPackages, Exclude);
+        const QHash<QString, QString> pathToVersionMapping = buildPathToVersionMapping(packages);
+
+        QTemporaryDir tmp;
+        QVERIFY(tmp.isValid());
+        copyComponentData(QStringList(m_packagesDir), m_repositoryDir, &packages, 0, jobs,
+            fingerprintMode);
+        copyMetaData(tmp.path(), m_repositoryDir, packages, QLatin1String("{AnyApplication}"),
+            QLatin1String(QUOTE(IFW_REPOSITORY_FORMAT_VERSION)));
+        compressMetaDirectories(tmp.path(), tmp.path(), pathToVersionMapping, uniteMetadata,
+            m_repositoryDir, jobs);
+
+        QDirIterator it(m_repositoryDir, QStringList() << QLatin1String("Updates*.xml")
+            << QLatin1String("*_meta.7z"), QDir::Files | QDir::CaseSensitive);
+        while (it.hasNext()) {
+            it.next();
+            QFile::remove(it.fileInfo().absoluteFilePath());
+        }
+        QInstaller::moveDirectoryContents(tmp.path(), m_repositoryDir);
+    }
+
+    QDomDocument updatesXml()
+    {
+        QDomDocument doc;
+        QFile file(m_repositoryDir + QLatin1String("/Updates.xml"));
+        if (file.open(QIODevice::ReadOnly))
+            doc.setContent(&file);
+        return doc;
+    }
+
+    QDomElement packageUpdate(const QDomDocument &doc, const QString &name)
+    {
+        const QDomNodeList elements = doc.elementsByTagName(QLatin1String("PackageUpdate"));
+        for (int i = 0; i < elements.count(); ++i) {
+            const QDomElement element = elements.at(i).toElement();
+            if (element.firstChildElement(QLatin1String("Name")).text() == name)
+                return element;
+        }
+        return QDomElement();
+    }
+
+    QString componentName(int index) const
+    {
+        return QString::fromLatin1("com.example.component%1").arg(index);
+    }
+
+    // Checks that the united archive and the meta.7z archive of each package in \a names match
+    // their checksums in Updates.xml.
+    void verifyChecksums(const QStringList &names)
+    {
+        const QDomDocument doc = updatesXml();
+        const QDomElement root = doc.documentElement();
+        const QString unitedName = root.firstChildElement(QLatin1String("MetadataName")).text();
+        QVERIFY(!unitedName.isEmpty());
+
+        QFile united(m_repositoryDir + QLatin1Char('/') + unitedName);
+        QVERIFY2(united.open(QIODevice::ReadOnly), qPrintable(united.fileName()));
+        QCOMPARE(root.firstChildElement(QLatin1String("MetadataSHA1")).text(), QString::fromLatin1(
+            QInstaller::calculateHash(&united, QCryptographicHash::Sha1).toHex()));
+        united.seek(0);
+        const QVector<Lib7z::File> unitedFiles = Lib7z::listArchive(&united);
+
+        foreach (const QString &name, names) {
+            const QDomElement element = packageUpdate(doc, name);
+            QVERIFY2(!element.isNull(), qPrintable(name));
+            const QString version = element.firstChildElement(QLatin1String("Version")).text();
+
+            QFile archive(QString::fromLatin1("%1/%2/%3meta.7z").arg(m_repositoryDir, name,
+                version));
+            QVERIFY2(archive.open(QIODevice::ReadOnly), qPrintable(archive.fileName()));
+            QCOMPARE(element.firstChildElement(QLatin1String("SHA1")).text(), QString::fromLatin1(
+                QInstaller::calculateHash(&archive, QCryptographicHash::Sha1).toHex()));
+
+            bool found = false;
+            foreach (const Lib7z::File &file, unitedFiles)
+                found = found || file.path.startsWith(name);
+            QVERIFY2(found, qPrintable(name));
+        }
+    }
+
+    struct RepositoryFile
+    {
+        QByteArray content;
+        QDateTime lastModified;
+    };
+
+    // Returns the data archives and checksum files of the package \a name in the repository.
+    QHash<QString, RepositoryFile> repositoryFiles(const QString &name)
+    {
+        QHash<QString, RepositoryFile> files;
+        const QDir dir(m_repositoryDir + QLatin1Char('/') + name);
+        foreach (const QFileInfo &fi, dir.entryInfoList(QStringList() << QLatin1String("*.7z")
+                << QLatin1String("*.sha1"), QDir::Files)) {
+            if (fi.fileName().endsWith(QLatin1String("meta.7z")))
+                continue; // the meta data archive is always recreated
+            QFile file(fi.absoluteFilePath());
+            QInstaller::openForRead(&file);
+            RepositoryFile entry = { file.readAll(), fi.lastModified() };
+            files.insert(fi.fileName(), entry);
+        }
+        return files;
+    }
+
+    // Checks that every data archive of the package \a name matches its .sha1 file.
+    void verifyArchiveHashes(const QString &name)
+    {
+        const QHash<QString, RepositoryFile> files = repositoryFiles(name);
+        QVERIFY2(!files.isEmpty(), qPrintable(name));
+        foreach (const QString &fileName, files.keys()) {
+            if (fileName.endsWith(QLatin1String(".sha1")))
+                continue;
+            const QByteArray sha1 = QCryptographicHash::hash(files.value(fileName).content,
+                QCryptographicHash::Sha1);
+            QCOMPARE(files.value(fileName + QLatin1String(".sha1")).content, sha1.toHex());
+        }
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QInstaller::init();
+    }
+
+    void init()
+    {
+        QVERIFY(m_packages.isValid());
+        QVERIFY(m_repository.isValid());
+        m_packagesDir = m_packages.path();
+        m_repositoryDir = m_repository.path();
+    }
+
+    void cleanup()
+    {
+        QInstaller::removeDirectory(m_packagesDir);
+        QInstaller::removeDirectory(m_repositoryDir);
+        QInstaller::mkpath(m_packagesDir);
+        QInstaller::mkpath(m_repositoryDir);
+    }
+
+    void compressSameVersionInParallel()
+    {
+        const int count = 8;
+        for (int i = 0; i < count; ++i)
+            writePackage(componentName(i), QLatin1String("1.0.0"), componentName(i).toLatin1());
+
+        try {
+            generateRepository(4);
+        } catch (const QInstaller::Error &e) {
+            QFAIL(qPrintable(e.message()));
+        }
+
+        const QDomDocument doc = updatesXml();
+        for (int i = 0; i < count; ++i) {
+            const QString name = componentName(i);
+            QFile archive(m_repositoryDir + QLatin1Char('/') + name + QLatin1String("/1.0.0meta.7z"));
+            QVERIFY2(archive.open(QIODevice::ReadOnly), qPrintable(archive.fileName()));
+
+            // the archive holds the meta data of its own package, and Updates.xml its checksum
+            foreach (const Lib7z::File &file, Lib7z::listArchive(&archive))
+                QVERIFY2(file.path.startsWith(name), qPrintable(file.path));
+            archive.seek(0);
+            const QByteArray sha1 = QInstaller::calculateHash(&archive, QCryptographicHash::Sha1);
+            QCOMPARE(packageUpdate(doc, name).firstChildElement(QLatin1String("SHA1")).text(),
+                QString::fromLatin1(sha1.toHex()));
+        }
+
+        // no temporary archives are left behind
+        QCOMPARE(QDir(m_repositoryDir).entryList(QStringList(QLatin1String("*.7z")), QDir::Files),
+            QStringList());
+    }
+
+    void uniteMetadata()
+    {
+        writePackage(componentName(0), QLatin1String("1.0.0"), "first");
+        writePackage(componentName(1), QLatin1String("1.0.0"), "second");
+
+        try {
+            generateRepository(2, true);
+        } catch (const QInstaller::Error &e) {
+            QFAIL(qPrintable(e.message()));
+        }
+        verifyChecksums(QStringList() << componentName(0) << componentName(1));
+
+        // drop a checksum, as written by older versions, and only regenerate the other package
+        QDomDocument doc = updatesXml();
+        QDomElement first = packageUpdate(doc, componentName(0));
+        first.removeChild(first.firstChildElement(QLatin1String("SHA1")));
+        writeFile(m_repositoryDir + QLatin1String("/Updates.xml"), doc.toByteArray());
+
+        QInstaller::removeDirectory(m_packagesDir + QLatin1Char('/') + componentName(0));
+        writePackage(componentName(1), QLatin1String("2.0.0"), "changed");
+        try {
+            generateRepository(2, true);
+        } catch (const QInstaller::Error &e) {
+            QFAIL(qPrintable(e.message()));
+        }
+        verifyChecksums(QStringList() << componentName(0) << componentName(1));
+    }
+
+    void updateTwice_data()
+    {
+        QTest::addColumn<int>("fingerprintMode");
+        QTest::newRow("file attributes") << int(FileAttributeFingerprints);
+        QTest::newRow("file content") << int(FileContentFingerprints);
+    }
+
+    void updateTwice()
+    {
+        QFETCH(int, fingerprintMode);
+        const FingerprintMode mode = FingerprintMode(fingerprintMode);
+        const QString unchanged = componentName(0);
+        const QString changedData = componentName(1);
+        const QString changedVersion = componentName(2);
+
+        writePackage(unchanged, QLatin1String("1.0.0"), "unchanged");
+        writePackage(changedData, QLatin1String("1.0.0"), "data");
+        writePackage(changedVersion, QLatin1String("1.0.0"), "version");
+        try {
+            generateRepository(2, false, mode);
+        } catch (const QInstaller::Error &e) {
+            QFAIL(qPrintable(e.message()));
+        }
+        QVERIFY(QFileInfo(m_repositoryDir + QLatin1String("/Fingerprints.xml")).isFile());
+
+        const QHash<QString, RepositoryFile> unchangedBefore = repositoryFiles(unchanged);
+        const QHash<QString, RepositoryFile> changedDataBefore = repositoryFiles(changedData);
+        QCOMPARE(unchangedBefore.count(), 2); // the archive and its .sha1 file
+        QCOMPARE(changedDataBefore.count(), 2);
+
+        // rewrite the data of one package and raise the version of another
+        writePackage(changedData, QLatin1String("1.0.0"), "changed data");
+        writePackage(changedVersion, QLatin1String("2.0.0"), "version");
+        try {
+            generateRepository(2, false, mode);
+        } catch (const QInstaller::Error &e) {
+            QFAIL(qPrintable(e.message()));
+        }
+
+        // the unchanged package keeps its archive and checksum, not just their content
+        const QHash<QString, RepositoryFile> unchangedAfter = repositoryFiles(unchanged);
+        QCOMPARE(unchangedAfter.keys().toSet(), unchangedBefore.keys().toSet());
+        foreach (const QString &fileName, unchangedBefore.keys()) {
+            const RepositoryFile before = unchangedBefore.value(fileName);
+            const RepositoryFile after = unchangedAfter.value(fileName);
+            QCOMPARE(after.content, before.content);
+            QCOMPARE(after.lastModified, before.lastModified);
+        }
+
+        // the changed packages are compressed again
+        const QHash<QString, RepositoryFile> changedDataAfter = repositoryFiles(changedData);
+        QCOMPARE(changedDataAfter.keys().toSet(), changedDataBefore.keys().toSet());
+        foreach (const QString &fileName, changedDataBefore.keys()) {
+            QVERIFY2(changedDataAfter.value(fileName).content
+                != changedDataBefore.value(fileName).content, qPrintable(fileName));
+        }
+
+        QCOMPARE(repositoryFiles(changedVersion).keys().toSet(), QSet<QString>()
+            << QLatin1String("2.0.0content.7z") << QLatin1String("2.0.0content.7z.sha1"));
+
+        const QDomDocument doc = updatesXml();
+        QCOMPARE(packageUpdate(doc, changedVersion).firstChildElement(QLatin1String("Version"))
+            .text(), QLatin1String("2.0.0"));
+        foreach (const QString &name, QStringList() << unchanged << changedData << changedVersion)
+            verifyArchiveHashes(name);
+    }
+
+private:
+    QTemporaryDir m_packages;
+    QTemporaryDir m_repository;
+    QString m_packagesDir;
+    QString m_repositoryDir;
+};
+
+QTEST_MAIN(tst_RepositoryGen)
+
+#include "tst_repositorygen.moc"
@@ -92,6 +92,9 @@ void tst_Settings::loadTutorialConfig()
     QCOMPARE(settings.controlScript(), QString());
 
     QCOMPARE(settings.supportsModify(), true);
+    QCOMPARE(settings.maxConcurrentDownloads(), 1);
+    QCOMPARE(settings.extractWhileDownloading(), false);
+    QCOMPARE(settings.serverSideExtraction(), false);
 }
 
 void tst_Settings::loadFullConfig()
@@ -138,6 +138,23 @@ private slots:
         qDebug("Found cycle: %s", graph.hasCycle() ? "true" : "false");
         qDebug("(%s) has a indirect dependency on (%s).", qPrintable(cycle.second.data()),
             qPrintable(cycle.first.data()));
+
+        QVERIFY(graph.hasCycle());
+        QCOMPARE(graph.cycleNodes(), QList<Data>() << a << b << c << d << e << a);
+    }
+
+    void sortGraphLongChain()
+    {
+        // deep enough to overflow the stack with a recursive depth-first search
+        Graph<int> graph;
+        for (int i = 0; i < 200000; ++i)
+            graph.addEdge(i, i + 1);
+
+        const QList<int> resolved = graph.sort();
+        QVERIFY(!graph.hasCycle());
+        QCOMPARE(resolved.count(), 200001);
+        QCOMPARE(resolved.first(), 200000);
+        QCOMPARE(resolved.last(), 0);
     }
 
     void resolveInstaller_data()
@@ -27,12 +27,15 @@
 **************************************************************************/
 
 #include <copyfiletask.h>
+#include <downloadcache.h>
 #include <downloadfiletask.h>
 #include <fileio.h>
 
+#include <QCryptographicHash>
 #include <QFutureWatcher>
 #include <QSignalSpy>
 #include <QTest>
+#include <QTemporaryDir>
 #include <QTemporaryFile>
 
 using namespace QInstaller;
@@ -111,6 +114,111 @@ private slots:
             QCOMPARE(result.checkSum().toHex(), QByteArray("85304f87b8d90554a63c6f6d1e9cc974fbef8d32"));
         }
     }
+
+    void downloadFileFromCache()
+    {
+        const QByteArray checksum("85304f87b8d90554a63c6f6d1e9cc974fbef8d32");
+
+        QTemporaryDir cacheDir;
+        QVERIFY(cacheDir.isValid());
+        DownloadCache::instance()->setPath(cacheDir.path());
+
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        QInstaller::blockingWrite(&file, QByteArray(scLargeSize, '1'));
+        file.close();
+
+        FileTaskItem item(QLatin1String("file:///") + file.fileName());
+        item.insert(TaskRole::Checksum, checksum);
+
+        DownloadFileTask fileTask(item);
+        QFuture<FileTaskResult> future = QtConcurrent::run(&DownloadFileTask::doTask, &fileTask);
+        future.waitForFinished();
+        QVERIFY(QFile::remove(future.result().target()));
+
+        // the source is gone, the second download needs to be served from the cache
+        file.remove();
+        future = QtConcurrent::run(&DownloadFileTask::doTask, &fileTask);
+        future.waitForFinished();
+
+        FileTaskResult result = future.result();
+        QCOMPARE(future.resultCount(), 1);
+        QCOMPARE(QFile(result.target()).size(), scLargeSize);
+        QCOMPARE(result.checkSum().toHex(), checksum);
+
+        // files larger than the whole cache are not kept, and don't push out the cached ones
+        QTemporaryDir smallCacheDir;
+        DownloadCache::instance()->setPath(smallCacheDir.path());
+        DownloadCache::instance()->setMaxSize(scLargeSize - 1);
+        const QByteArray first = storeInCache(QByteArray(1024, 'a'));
+        const QByteArray second = storeInCache(QByteArray(1024, 'b'));
+        QVERIFY(!DownloadCache::instance()->store(checksum, result.target()));
+        QVERIFY(isCached(first));
+        QVERIFY(isCached(second));
+        QVERIFY(!isCached(checksum));
+
+        QFile::remove(result.target());
+        DownloadCache::instance()->setPath(QString());
+        DownloadCache::instance()->setMaxSize(Q_INT64_C(2) * 1024 * 1024 * 1024);
+    }
+
+    void evictLeastRecentlyUsed()
+    {
+        QTemporaryDir cacheDir;
+        QVERIFY(cacheDir.isValid());
+        DownloadCache::instance()->setPath(cacheDir.path());
+        DownloadCache::instance()->setMaxSize(2 * 1024 + 512);
+
+        const QByteArray first = storeInCache(QByteArray(1024, 'a'));
+        QTest::qWait(10);
+        const QByteArray second = storeInCache(QByteArray(1024, 'b'));
+        QTest::qWait(10);
+        QVERIFY(isCached(first)); // makes the second file the least recently used one
+        QTest::qWait(10);
+        const QByteArray third = storeInCache(QByteArray(1024, 'c'));
+
+        QVERIFY(isCached(first));
+        QVERIFY(!isCached(second));
+        QVERIFY(isCached(third));
+
+        // the use times survive reloading the index
+        DownloadCache::instance()->setPath(QString());
+        DownloadCache::instance()->setPath(cacheDir.path());
+        QTest::qWait(10);
+        QVERIFY(isCached(third));
+        QTest::qWait(10);
+        const QByteArray fourth = storeInCache(QByteArray(1024, 'd'));
+        QVERIFY(!isCached(first));
+        QVERIFY(isCached(third));
+        QVERIFY(isCached(fourth));
+
+        DownloadCache::instance()->setPath(QString());
+        DownloadCache::instance()->setMaxSize(Q_INT64_C(2) * 1024 * 1024 * 1024);
+    }
+
+private:
+    QByteArray storeInCache(const QByteArray &data)
+    {
+        QTemporaryFile file;
+        if (!file.open())
+            return QByteArray();
+        QInstaller::blockingWrite(&file, data);
+        file.close();
+
+        const QByteArray sha1 = QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+        if (!DownloadCache::instance()->store(sha1, file.fileName()))
+            return QByteArray();
+        return sha1;
+    }
+
+    bool isCached(const QByteArray &sha1)
+    {
+        QTemporaryFile file;
+        if (!file.open())
+            return false;
+        file.close();
+        return DownloadCache::instance()->retrieve(sha1, file.fileName());
+    }
 };
 
 QTEST_MAIN(tst_Task)
@@ -0,0 +1,6 @@
+include(../../qttest.pri)
+
+QT -= gui
+QT += concurrent
+
+SOURCES += tst_tracer.cpp
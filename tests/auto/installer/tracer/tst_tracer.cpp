@@ -0,0 +1,114 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include <tracer.h>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QtConcurrentRun>
+
+using namespace QInstaller;
+
+class tst_Tracer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void disabled()
+    {
+        QVERIFY(!Tracer::isEnabled());
+        QCOMPARE(Tracer::now(), qint64(-1));
+
+        TraceSpan span("test", "Disabled");
+        QVERIFY(!span.isActive());
+    }
+
+    void writeTrace()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/trace.json");
+
+        Tracer::instance()->start(fileName);
+        QVERIFY(Tracer::isEnabled());
+        {
+            TraceSpan outer("test", "Outer", QLatin1String("main thread"));
+            QVERIFY(outer.isActive());
+            TraceSpan inner("test", "Inner");
+        }
+        QtConcurrent::run([]() { TraceSpan span("test", "Worker"); }).waitForFinished();
+
+        const qint64 start = Tracer::now();
+        QVERIFY(start >= 0);
+        Tracer::instance()->addEvent("test", "Async", start, QLatin1String("detail"));
+
+        QVERIFY(Tracer::instance()->stop());
+        QVERIFY(!Tracer::isEnabled());
+
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        const QJsonArray events = QJsonDocument::fromJson(file.readAll()).object()
+            .value(QLatin1String("traceEvents")).toArray();
+
+        QHash<QString, QJsonObject> spans;
+        QSet<int> threads;
+        foreach (const QJsonValue &value, events) {
+            const QJsonObject event = value.toObject();
+            if (event.value(QLatin1String("ph")).toString() == QLatin1String("X")) {
+                spans.insert(event.value(QLatin1String("name")).toString(), event);
+                threads.insert(event.value(QLatin1String("tid")).toInt());
+            }
+        }
+        QCOMPARE(spans.count(), 4);
+        QCOMPARE(threads.count(), 2);
+
+        const QJsonObject outer = spans.value(QLatin1String("Outer"));
+        const QJsonObject inner = spans.value(QLatin1String("Inner"));
+        QCOMPARE(outer.value(QLatin1String("cat")).toString(), QLatin1String("test"));
+        QCOMPARE(outer.value(QLatin1String("args")).toObject().value(QLatin1String("detail"))
+            .toString(), QLatin1String("main thread"));
+        QVERIFY(outer.value(QLatin1String("ts")).toDouble() <= inner.value(QLatin1String("ts")).toDouble());
+        QVERIFY(outer.value(QLatin1String("dur")).toDouble() >= inner.value(QLatin1String("dur")).toDouble());
+        QCOMPARE(outer.value(QLatin1String("tid")), inner.value(QLatin1String("tid")));
+        QVERIFY(spans.value(QLatin1String("Worker")).value(QLatin1String("tid"))
+            != outer.value(QLatin1String("tid")));
+
+        // nothing is recorded once stopped
+        TraceSpan span("test", "Stopped");
+        QVERIFY(!span.isActive());
+    }
+};
+
+QTEST_MAIN(tst_Tracer)
+
+#include "tst_tracer.moc"
@@ -0,0 +1,203 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+#include "updatesinfo_p.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace KDUpdater;
+
+class tst_UpdatesInfo : public QObject
+{
+    Q_OBJECT
+
+private:
+    void writeFile(const QString &fileName, const QByteArray &content)
+    {
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        QCOMPARE(file.write(content), qint64(content.size()));
+    }
+
+private slots:
+    void init()
+    {
+        UpdatesInfo::clearCache();
+    }
+
+    void testParse()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/Updates.xml");
+        writeFile(fileName,
+            "<Updates>\n"
+            "    <ApplicationName>{AnyApplication}</ApplicationName>\n"
+            "    <ApplicationVersion>1.0.0</ApplicationVersion>\n"
+            "    <Checksum>true</Checksum>\n"
+            "    <MetadataName>united_meta.7z</MetadataName>\n"
+            "    <PackageUpdate>\n"
+            "        <Name>A</Name>\n"
+            "        <DisplayName>Component A</DisplayName>\n"
+            "        <Version inheritVersionFrom=\"B\">1.0.0</Version>\n"
+            "        <ReleaseDate>2017-01-01</ReleaseDate>\n"
+            "        <UpdateFile CompressedSize=\"12\" UncompressedSize=\"34\"/>\n"
+            "        <Licenses>\n"
+            "            <License name=\"License\" file=\"license.txt\"/>\n"
+            "        </Licenses>\n"
+            "        <SHA1>abcdef</SHA1>\n"
+            "    </PackageUpdate>\n"
+            "    <PackageUpdate>\n"
+            "        <Name>B</Name>\n"
+            "        <Version>1.0.0</Version>\n"
+            "        <ReleaseDate>2017-01-01</ReleaseDate>\n"
+            "    </PackageUpdate>\n"
+            "    <RepositoryUpdate>\n"
+            "        <Repository action=\"add\" url=\"http://example.com\" displayname=\"Example\"/>\n"
+            "    </RepositoryUpdate>\n"
+            "</Updates>\n");
+
+        UpdatesInfo info;
+        info.setFileName(fileName);
+        QVERIFY2(info.isValid(), qPrintable(info.errorString()));
+        QCOMPARE(info.applicationName(), QString::fromLatin1("{AnyApplication}"));
+        QCOMPARE(info.applicationVersion(), QString::fromLatin1("1.0.0"));
+        QCOMPARE(info.value(QLatin1String("Checksum")), QString::fromLatin1("true"));
+        QCOMPARE(info.value(QLatin1String("MetadataName")), QString::fromLatin1("united_meta.7z"));
+        QVERIFY(info.value(QLatin1String("MetadataSHA1")).isNull());
+
+        QCOMPARE(info.updateInfoCount(), 2);
+        const QHash<QString, QVariant> a = info.updateInfo(0).data;
+        QCOMPARE(a.value(QLatin1String("Name")).toString(), QString::fromLatin1("A"));
+        QCOMPARE(a.value(QLatin1String("DisplayName")).toString(), QString::fromLatin1("Component A"));
+        QCOMPARE(a.value(QLatin1String("inheritVersionFrom")).toString(), QString::fromLatin1("B"));
+        QCOMPARE(a.value(QLatin1String("CompressedSize")).toString(), QString::fromLatin1("12"));
+        QCOMPARE(a.value(QLatin1String("UncompressedSize")).toString(), QString::fromLatin1("34"));
+        QCOMPARE(a.value(QLatin1String("SHA1")).toString(), QString::fromLatin1("abcdef"));
+        QCOMPARE(a.value(QLatin1String("Licenses")).toHash().value(QLatin1String("License"))
+            .toString(), QString::fromLatin1("license.txt"));
+
+        const QList<RepositoryUpdateInfo> updates = info.repositoryUpdates();
+        QCOMPARE(updates.count(), 1);
+        QCOMPARE(updates.first().attributes.value(QLatin1String("action")), QString::fromLatin1("add"));
+        QCOMPARE(updates.first().attributes.value(QLatin1String("url")),
+            QString::fromLatin1("http://example.com"));
+        QCOMPARE(updates.first().lineNumber, qint64(23));
+    }
+
+    void testErrors()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        UpdatesInfo info;
+        info.setFileName(dir.path() + QLatin1String("/missing.xml"));
+        QCOMPARE(info.error(), UpdatesInfo::CouldNotReadUpdateInfoFileError);
+
+        const QString invalidXml = dir.path() + QLatin1String("/invalid.xml");
+        writeFile(invalidXml, "<Updates><ApplicationName>A</ApplicationVersion></Updates>");
+        info.setFileName(invalidXml);
+        QCOMPARE(info.error(), UpdatesInfo::InvalidXmlError);
+
+        const QString invalidContent = dir.path() + QLatin1String("/content.xml");
+        writeFile(invalidContent, "<Updates><ApplicationName>A</ApplicationName>"
+            "<ApplicationVersion>1</ApplicationVersion><PackageUpdate><Name>A</Name>"
+            "</PackageUpdate></Updates>");
+        info.setFileName(invalidContent);
+        QCOMPARE(info.error(), UpdatesInfo::InvalidContentError);
+    }
+
+    void testSharedParse()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/Updates.xml");
+        writeFile(fileName, "<Updates><ApplicationName>A</ApplicationName>"
+            "<ApplicationVersion>1</ApplicationVersion></Updates>");
+
+        UpdatesInfo first;
+        first.setFileName(fileName);
+        QVERIFY(first.isValid());
+
+        // a second reader of the unchanged file shares the result
+        UpdatesInfo second;
+        second.setFileName(fileName);
+        QCOMPARE(second.applicationName(), QString::fromLatin1("A"));
+        QCOMPARE(second.updatesInfo().count(), 0);
+
+        // a changed file is read again
+        writeFile(fileName, "<Updates><ApplicationName>Other application</ApplicationName>"
+            "<ApplicationVersion>2</ApplicationVersion></Updates>");
+        UpdatesInfo third;
+        third.setFileName(fileName);
+        QCOMPARE(third.applicationName(), QString::fromLatin1("Other application"));
+        QCOMPARE(first.applicationName(), QString::fromLatin1("A"));
+    }
+
+    void testRemoveFromCache()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/Updates.xml");
+        writeFile(fileName, "<Updates><ApplicationName>A</ApplicationName>"
+            "<ApplicationVersion>1</ApplicationVersion></Updates>");
+
+        UpdatesInfo first;
+        first.setFileName(fileName);
+        QVERIFY(first.isValid());
+
+        // same size and modification time, only dropping the parsed result tells them apart
+        const QDateTime lastModified = QFileInfo(fileName).lastModified();
+        writeFile(fileName, "<Updates><ApplicationName>B</ApplicationName>"
+            "<ApplicationVersion>2</ApplicationVersion></Updates>");
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        if (QFileInfo(fileName).lastModified() != lastModified) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+            QVERIFY(file.setFileTime(lastModified, QFileDevice::FileModificationTime));
+#else
+            QSKIP("Cannot restore the modification time.");
+#endif
+        }
+        file.close();
+
+        UpdatesInfo::removeFromCache(fileName);
+        UpdatesInfo second;
+        second.setFileName(fileName);
+        QCOMPARE(second.applicationName(), QString::fromLatin1("B"));
+        QCOMPARE(first.applicationName(), QString::fromLatin1("A"));
+    }
+};
+
+QTEST_MAIN(tst_UpdatesInfo)
+
+#include "tst_updatesinfo.moc"
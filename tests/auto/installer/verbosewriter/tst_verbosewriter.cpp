@@ -0,0 +1,286 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include <lib7z_facade.h>
+#include <protocol.h>
+#include <remoteclient.h>
+#include <utils.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QUuid>
+
+using namespace QInstaller;
+
+class FailingOutput : public VerboseWriterOutput
+{
+public:
+    bool write(const QString &, QIODevice::OpenMode, const QByteArray &)
+    {
+        return false;
+    }
+};
+
+class tst_VerboseWriter : public QObject
+{
+    Q_OBJECT
+
+private:
+    QByteArray readFile(const QString &fileName)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+            return QByteArray();
+        return file.readAll();
+    }
+
+private slots:
+    void initTestCase()
+    {
+        Lib7z::initSevenZ();
+    }
+
+    void noFileName()
+    {
+        VerboseWriter writer;
+        writer.appendLine(QLatin1String("line"));
+
+        PlainVerboseWriterOutput output;
+        QVERIFY(writer.flush(&output));
+    }
+
+    void missingTargetDirectory()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/missing/log.txt");
+
+        VerboseWriter writer;
+        writer.appendLine(QLatin1String("line"));
+        writer.setFileName(fileName);
+
+        PlainVerboseWriterOutput output;
+        QVERIFY(writer.flush(&output));
+        QVERIFY(!QFile::exists(fileName));
+    }
+
+    void writeLog()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/log.txt");
+
+        VerboseWriter writer;
+        writer.appendLine(QLatin1String("first"));
+        writer.appendLine(QLatin1String("second"));
+        writer.setFileName(fileName);
+        writer.appendLine(QLatin1String("third"));
+
+        PlainVerboseWriterOutput output;
+        QVERIFY(writer.flush(&output));
+        writer.appendLine(QLatin1String("dropped"));
+        QVERIFY(writer.flush(&output));
+
+        const QList<QByteArray> lines = readFile(fileName).split('\n');
+        QCOMPARE(lines.count(), 5);
+        QVERIFY(lines.at(0).startsWith("************************************* Invoked: "));
+        QCOMPARE(lines.at(1), QByteArray("first"));
+        QCOMPARE(lines.at(2), QByteArray("second"));
+        QCOMPARE(lines.at(3), QByteArray("third"));
+        QVERIFY(lines.at(4).isEmpty());
+    }
+
+    void streamLog()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/log.txt");
+
+        VerboseWriter writer;
+        writer.appendLine(QLatin1String("before"));
+        writer.setFileName(fileName);
+        writer.appendLine(QLatin1String("after"));
+
+        // the lines reach the file without flush()
+        QTRY_VERIFY(readFile(fileName).endsWith("before\nafter\n"));
+
+        FailingOutput output;
+        QVERIFY(writer.flush(&output));
+    }
+
+    void retryFlush()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/log.txt");
+
+        QVERIFY(QDir(dir.path()).mkdir(QLatin1String("log.txt"))); // can't be opened as a file
+
+        VerboseWriter writer;
+        writer.appendLine(QLatin1String("line"));
+        writer.setFileName(fileName);
+
+        FailingOutput failing;
+        QVERIFY(!writer.flush(&failing));
+        QVERIFY(QDir(dir.path()).rmdir(QLatin1String("log.txt")));
+
+        PlainVerboseWriterOutput output;
+        QVERIFY(writer.flush(&output));
+        QVERIFY(readFile(fileName).endsWith("line\n"));
+    }
+
+    void rotateLog()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/log.txt");
+        const QString line(100, QLatin1Char('x'));
+
+        VerboseWriter writer;
+        writer.setMaxFileSize(1024);
+        writer.setRotatedFileCount(2);
+        writer.setFileName(fileName);
+        for (int i = 0; i < 100; ++i)
+            writer.appendLine(line);
+
+        PlainVerboseWriterOutput output;
+        QVERIFY(writer.flush(&output));
+
+        QVERIFY(QFile::exists(fileName));
+        QVERIFY(QFile::exists(fileName + QLatin1String(".1")));
+        QVERIFY(QFile::exists(fileName + QLatin1String(".2")));
+        QVERIFY(!QFile::exists(fileName + QLatin1String(".3")));
+        QVERIFY(QFileInfo(fileName).size() <= 1024 + line.size() + 1);
+    }
+
+    void compressRotatedLogs()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/log.txt");
+        const QString line(100, QLatin1Char('x'));
+
+        VerboseWriter writer;
+        writer.setMaxFileSize(1024);
+        writer.setRotatedFileCount(2);
+        writer.setCompressRotatedFiles(true);
+        writer.setFileName(fileName);
+        for (int i = 0; i < 100; ++i)
+            writer.appendLine(line);
+
+        PlainVerboseWriterOutput output;
+        QVERIFY(writer.flush(&output));
+
+        QVERIFY(QFile::exists(fileName));
+        QVERIFY(QFile::exists(fileName + QLatin1String(".1.7z")));
+        QVERIFY(QFile::exists(fileName + QLatin1String(".2.7z")));
+        QVERIFY(!QFile::exists(fileName + QLatin1String(".1")));
+        QVERIFY(!QFile::exists(fileName + QLatin1String(".2")));
+        QVERIFY(!QFile::exists(fileName + QLatin1String(".3.7z")));
+    }
+
+    void keepLinesWhileElevated()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/log.txt");
+
+        // the file would be opened through the elevated server, which goes away with the rights
+        RemoteClient::instance().init(QUuid::createUuid().toString(), QLatin1String("SomeKey"),
+            Protocol::Mode::Debug, Protocol::StartAs::User);
+        RemoteClient::instance().setActive(true);
+        QVERIFY(RemoteClient::instance().isActive());
+
+        VerboseWriter writer;
+        writer.appendLine(QLatin1String("before"));
+        writer.setFileName(fileName);
+        writer.appendLine(QLatin1String("after"));
+        RemoteClient::instance().setActive(false);
+
+        // nothing was streamed, so the output has to write all lines
+        FailingOutput failing;
+        QVERIFY(!writer.flush(&failing));
+        QVERIFY(!QFile::exists(fileName));
+
+        PlainVerboseWriterOutput output;
+        QVERIFY(writer.flush(&output));
+        const QList<QByteArray> lines = readFile(fileName).split('\n');
+        QCOMPARE(lines.count(), 4);
+        QVERIFY(lines.at(0).startsWith("************************************* Invoked: "));
+        QCOMPARE(lines.at(1), QByteArray("before"));
+        QCOMPARE(lines.at(2), QByteArray("after"));
+    }
+
+    void releaseFile()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        const QString fileName = dir.path() + QLatin1String("/log.txt");
+        const QString existingFileName = dir.path() + QLatin1String("/existing.txt");
+        QFile existing(existingFileName);
+        QVERIFY(existing.open(QIODevice::WriteOnly | QIODevice::Text));
+        existing.write("previous run\n");
+        existing.close();
+
+        VerboseWriter writer;
+        writer.appendLine(QLatin1String("first"));
+        writer.setFileName(fileName);
+        writer.appendLine(QLatin1String("second"));
+        QTRY_VERIFY(readFile(fileName).endsWith("first\nsecond\n"));
+
+        // the file is removed again since it did not exist before
+        writer.releaseFile();
+        QVERIFY(!QFile::exists(fileName));
+
+        writer.appendLine(QLatin1String("third"));
+        writer.setFileName(existingFileName);
+        QTRY_VERIFY(readFile(existingFileName).endsWith("first\nsecond\nthird\n"));
+
+        // the file is cut back to what it contained before
+        writer.releaseFile();
+        QCOMPARE(readFile(existingFileName), QByteArray("previous run\n"));
+
+        // the lines are kept for the next log file
+        writer.setFileName(fileName);
+        PlainVerboseWriterOutput output;
+        QVERIFY(writer.flush(&output));
+        const QList<QByteArray> lines = readFile(fileName).split('\n');
+        QCOMPARE(lines.count(), 5);
+        QVERIFY(lines.at(0).startsWith("************************************* Invoked: "));
+        QCOMPARE(lines.at(1), QByteArray("first"));
+        QCOMPARE(lines.at(2), QByteArray("second"));
+        QCOMPARE(lines.at(3), QByteArray("third"));
+    }
+};
+
+QTEST_MAIN(tst_VerboseWriter)
+
+#include "tst_verbosewriter.moc"
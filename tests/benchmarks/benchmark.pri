@@ -0,0 +1,16 @@
+include(../auto/qttest.pri)
+include(../shared/shared.pri)
+
+# benchmarks are run on demand, not as part of make check
+CONFIG -= testcase
+CONFIG += benchmark
+
+# JSON results of the benchmark harness
+QT += concurrent qml
+INCLUDEPATH += $$PWD/shared
+
+HEADERS += \
+    $$PWD/shared/benchmarkmain.h
+
+SOURCES += \
+    $$PWD/shared/benchmarkmain.cpp
@@ -0,0 +1,199 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include "benchmarkmain.h"
+
+#include <binarycontent.h>
+#include <binaryformat.h>
+#include <errors.h>
+#include <fileio.h>
+#include <updateoperation.h>
+
+#include <QTemporaryFile>
+#include <QTest>
+
+using namespace QInstaller;
+
+class TestOperation : public KDUpdater::UpdateOperation
+{
+public:
+    TestOperation(const QString &name)
+        : KDUpdater::UpdateOperation(0)
+    { setName(name); }
+
+    virtual void backup() {}
+    virtual bool performOperation() { return true; }
+    virtual bool undoOperation() { return true; }
+    virtual bool testOperation() { return true; }
+    virtual KDUpdater::UpdateOperation *clone() const { return 0; }
+};
+
+/*
+    Returns \a count operations that look like the ones an installation of archives leaves behind,
+    each remembering the files it extracted.
+*/
+static QList<OperationBlob> createOperations(int count)
+{
+    QList<OperationBlob> operations;
+    for (int i = 0; i < count; ++i) {
+        const QString component = QString::fromLatin1("component%1").arg(i / 10);
+        TestOperation op(QLatin1String("Extract"));
+        op.setArguments(QStringList() << QString::fromLatin1("installer://%1/1.0.0.7z").arg(component)
+            << QLatin1String("@TargetDir@"));
+        QStringList files;
+        for (int j = 0; j < 20; ++j)
+            files.append(QString::fromLatin1("/opt/target/%1/dir%2/file%3.bin").arg(component).arg(j % 4).arg(j));
+        op.setValue(QLatin1String("files"), files);
+        op.setValue(QLatin1String("component"), component);
+        operations.append(OperationBlob(op.name(), component, op.toXml().toString().toUtf8()));
+    }
+    return operations;
+}
+
+/*
+    Writes the data block of a maintenance tool into \a out, the same way the maintenance tool
+    writes its .dat file: the resource segment copied from \a resource, followed by the operations
+    and the trailer.
+*/
+static void writeDataBlock(QFileDevice *out, QFile *resource, const QList<OperationBlob> &operations)
+{
+    const qint64 dataBlockStart = out->pos();
+
+    resource->seek(0);
+    const Range<qint64> resourceSegment = Range<qint64>::fromStartAndLength(out->pos(), resource->size());
+    QInstaller::appendData(out, resource, resource->size());
+
+    const qint64 operationsStart = out->pos();
+    BinaryContent::writeOperations(out, operations);
+    const qint64 operationsEnd = out->pos();
+
+    QInstaller::appendInt64(out, 0); // no component indexes
+    const qint64 compIndexStart = out->pos();
+    QInstaller::appendInt64(out, 0);
+    QInstaller::appendInt64(out, 0);
+    const qint64 compIndexEnd = out->pos();
+
+    QInstaller::appendInt64Range(out, Range<qint64>::fromStartAndEnd(compIndexStart, compIndexEnd)
+        .moved(-dataBlockStart));
+    QInstaller::appendInt64Range(out, resourceSegment.moved(-dataBlockStart));
+    QInstaller::appendInt64Range(out, Range<qint64>::fromStartAndEnd(operationsStart, operationsEnd)
+        .moved(-dataBlockStart));
+    QInstaller::appendInt64(out, 1); // resource segments count
+    QInstaller::appendInt64(out, out->pos() + 3 * sizeof(qint64) - dataBlockStart);
+    QInstaller::appendInt64(out, BinaryContent::MagicUninstallerMarker);
+    QInstaller::appendInt64(out, BinaryContent::MagicCookieDat);
+}
+
+class tst_BinaryContent : public QObject
+{
+    Q_OBJECT
+
+private:
+    void addRows()
+    {
+        QTest::addColumn<int>("operationCount");
+        QTest::addColumn<qint64>("resourceSize");
+
+        QTest::newRow("100 operations, 1 MiB resource") << 100 << 1048576LL;
+        QTest::newRow("1000 operations, 1 MiB resource") << 1000 << 1048576LL;
+        QTest::newRow("10000 operations, 1 MiB resource") << 10000 << 1048576LL;
+        QTest::newRow("1000 operations, 64 MiB resource") << 1000 << 67108864LL;
+    }
+
+    static void createResource(QTemporaryFile *resource, qint64 size)
+    {
+        QInstaller::openForWrite(resource);
+        const QByteArray chunk(1048576, 'r');
+        for (qint64 written = 0; written < size; written += chunk.size())
+            QInstaller::blockingWrite(resource, chunk.constData(), qMin<qint64>(chunk.size(), size - written));
+        resource->close();
+        QInstaller::openForRead(resource);
+    }
+
+private slots:
+    void writeDataFile_data()
+    {
+        addRows();
+    }
+
+    void writeDataFile()
+    {
+        QFETCH(int, operationCount);
+        QFETCH(qint64, resourceSize);
+
+        const QList<OperationBlob> operations = createOperations(operationCount);
+        QTemporaryFile resource;
+        createResource(&resource, resourceSize);
+
+        try {
+            QBENCHMARK {
+                QTemporaryFile data;
+                QInstaller::openForWrite(&data);
+                writeDataBlock(&data, &resource, operations);
+                QVERIFY(data.flush());
+            }
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+    }
+
+    void readDataFile_data()
+    {
+        addRows();
+    }
+
+    void readDataFile()
+    {
+        QFETCH(int, operationCount);
+        QFETCH(qint64, resourceSize);
+
+        QTemporaryFile resource;
+        createResource(&resource, resourceSize);
+
+        QTemporaryFile data;
+        try {
+            QInstaller::openForWrite(&data);
+            writeDataBlock(&data, &resource, createOperations(operationCount));
+            data.close();
+            QInstaller::openForRead(&data);
+
+            QBENCHMARK {
+                const BinaryLayout layout = BinaryContent::binaryLayout(&data, BinaryContent::MagicCookieDat);
+                QVERIFY(data.seek(layout.operationsSegment.start()));
+                QCOMPARE(BinaryContent::readOperations(&data).count(), operationCount);
+            }
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+    }
+};
+
+IFW_BENCHMARK_MAIN(tst_BinaryContent)
+
+#include "tst_binarycontent.moc"
@@ -0,0 +1,8 @@
+include(../../benchmark.pri)
+
+QT -= gui
+
+SOURCES += tst_installation.cpp
+
+RESOURCES += \
+    settings.qrc
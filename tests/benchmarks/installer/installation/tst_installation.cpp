@@ -0,0 +1,219 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include "benchmarkmain.h"
+#include "httpstandin.h"
+#include "packagemanagercoretestaccess.h"
+#include "syntheticrepository.h"
+
+#include <binarycontent.h>
+#include <constants.h>
+#include <errors.h>
+#include <init.h>
+#include <packagemanagercore.h>
+#include <progresscoordinator.h>
+#include <qinstallerglobal.h>
+#include <repository.h>
+#include <settings.h>
+
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QTest>
+
+using namespace QInstaller;
+
+/*
+    Measures the stages of an installation end to end against a synthetic repository served over
+    HTTP: generating the repository, fetching its metadata, installing all components, updating
+    some of them and uninstalling everything again. The stages run through the same entry points
+    as the installer and the maintenance tool, without writing the maintenance tool itself. The
+    functions depend on each other and need to run in the declared order.
+
+    The shape of the repository and the network are set through the environment:
+    IFW_BENCHMARK_COMPONENTS, IFW_BENCHMARK_FANOUT, IFW_BENCHMARK_FILES, IFW_BENCHMARK_ARCHIVE_SIZE
+    (KiB), IFW_BENCHMARK_LATENCY (ms per request), IFW_BENCHMARK_BANDWIDTH (KiB/s, 0 is unlimited)
+    and IFW_BENCHMARK_UPDATED (percentage of components changed for the update).
+*/
+class tst_Installation : public QObject
+{
+    Q_OBJECT
+
+public:
+    tst_Installation()
+        : m_server(0)
+        , m_core(0)
+    {}
+
+private:
+    PackageManagerCore *createCore()
+    {
+        PackageManagerCore *core = new PackageManagerCore(BinaryContent::MagicInstallerMarker,
+            QList<OperationBlob>());
+        core->autoAcceptMessageBoxes();
+        core->setValue(scTargetDir, m_targetDir.path());
+        core->settings().setDefaultRepositories(QSet<Repository>()
+            << Repository(m_server->url(), true));
+        return core;
+    }
+
+private slots:
+    void initTestCase()
+    {
+        QInstaller::init();
+
+        QVERIFY(m_packagesDir.isValid());
+        QVERIFY(m_repositoryDir.isValid());
+        QVERIFY(m_targetDir.isValid());
+
+        m_shape = Benchmarks::RepositoryShape::fromEnvironment();
+        try {
+            Benchmarks::writePackages(m_packagesDir.path(), m_shape);
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+
+        m_server = new HttpStandIn(m_repositoryDir.path(), this);
+        m_server->setLatency(qEnvironmentVariableIntValue("IFW_BENCHMARK_LATENCY"));
+        m_server->setBandwidth(qint64(qEnvironmentVariableIntValue("IFW_BENCHMARK_BANDWIDTH")) * 1024);
+        QVERIFY(m_server->listen());
+    }
+
+    void generateRepository()
+    {
+        try {
+            QBENCHMARK_ONCE {
+                Benchmarks::generateRepository(m_packagesDir.path(), m_repositoryDir.path());
+            }
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+        QVERIFY(QFileInfo(m_repositoryDir.path() + QLatin1String("/Updates.xml")).exists());
+    }
+
+    void fetchMetadata()
+    {
+        int componentCount = 0;
+        QBENCHMARK {
+            QScopedPointer<PackageManagerCore> core(createCore());
+            QVERIFY2(core->fetchRemotePackagesTree(), qPrintable(core->error()));
+            componentCount = core->components(PackageManagerCore::ComponentType::Root).count();
+        }
+        QCOMPARE(componentCount, m_shape.componentCount);
+    }
+
+    void install()
+    {
+        // the core lives on as the maintenance tool for the update and the uninstallation
+        m_core = createCore();
+        PackageManagerCoreTestAccess::disableWriteMaintenanceTool(m_core);
+        QVERIFY2(m_core->fetchRemotePackagesTree(), qPrintable(m_core->error()));
+        QVERIFY2(m_core->calculateComponentsToInstall(),
+            qPrintable(m_core->componentsToInstallError()));
+        QCOMPARE(m_core->orderedComponentsToInstall().count(), m_shape.componentCount);
+
+        QBENCHMARK_ONCE {
+            m_core->runInstaller();
+        }
+        QCOMPARE(m_core->status(), int(PackageManagerCore::Success));
+        ProgressCoordinator::instance()->reset();
+    }
+
+    void updateRepository()
+    {
+        // change every n-th component, the rest of the repository is reused by the update
+        const int percent = qBound(0, qEnvironmentVariableIsSet("IFW_BENCHMARK_UPDATED")
+            ? qEnvironmentVariableIntValue("IFW_BENCHMARK_UPDATED") : 50, 100);
+        const int changed = (m_shape.componentCount * percent) / 100;
+        try {
+            for (int i = 0; i < changed; ++i) {
+                const int index = (i * m_shape.componentCount) / qMax(1, changed);
+                Benchmarks::writePackage(m_packagesDir.path(), index, QLatin1String("2.0.0"), m_shape);
+                m_changedComponents.insert(Benchmarks::componentName(index));
+            }
+
+            QBENCHMARK_ONCE {
+                Benchmarks::generateRepository(m_packagesDir.path(), m_repositoryDir.path());
+            }
+        } catch (const QInstaller::Error &error) {
+            QFAIL(qPrintable(error.message()));
+        }
+    }
+
+    void update()
+    {
+        QVERIFY(m_core);
+        m_core->setUpdater();
+        QBENCHMARK_ONCE {
+            // only the changed components have an update, which replaces their installed files
+            QVERIFY2(m_core->fetchRemotePackagesTree(), qPrintable(m_core->error()));
+            QVERIFY2(m_core->calculateComponentsToInstall(),
+                qPrintable(m_core->componentsToInstallError()));
+            QCOMPARE(m_core->orderedComponentsToInstall().count(), m_changedComponents.count());
+            m_core->runPackageUpdater();
+        }
+        QCOMPARE(m_core->status(), int(PackageManagerCore::Success));
+        ProgressCoordinator::instance()->reset();
+    }
+
+    void uninstall()
+    {
+        QVERIFY(m_core);
+        m_core->setUninstaller();
+        QBENCHMARK_ONCE {
+            m_core->runUninstaller();
+        }
+        QCOMPARE(m_core->status(), int(PackageManagerCore::Success));
+        ProgressCoordinator::instance()->reset();
+    }
+
+    void cleanupTestCase()
+    {
+        if (m_server) {
+            qDebug("HTTP stand-in served %d requests, %lld bytes.", m_server->requestCount(),
+                m_server->bytesSent());
+            m_server->close();
+        }
+        delete m_core;
+        m_core = 0;
+    }
+
+private:
+    QTemporaryDir m_packagesDir;
+    QTemporaryDir m_repositoryDir;
+    QTemporaryDir m_targetDir;
+    Benchmarks::RepositoryShape m_shape;
+    HttpStandIn *m_server;
+
+    PackageManagerCore *m_core;
+    QSet<QString> m_changedComponents;
+};
+
+IFW_BENCHMARK_MAIN(tst_Installation)
+
+#include "tst_installation.moc"
@@ -0,0 +1,101 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include "benchmarkmain.h"
+#include "syntheticrepository.h"
+
+#include <component.h>
+#include <constants.h>
+#include <installercalculator.h>
+#include <packagemanagercore.h>
+
+#include <QTest>
+
+using namespace QInstaller;
+
+class tst_InstallerCalculator : public QObject
+{
+    Q_OBJECT
+
+private:
+    static PackageManagerCore *createCore(int componentCount, int fanOut)
+    {
+        PackageManagerCore *core = new PackageManagerCore();
+        for (int i = 0; i < componentCount; ++i) {
+            Component *component = new Component(core);
+            component->setValue(scName, Benchmarks::componentName(i));
+            component->setValue(scVersion, QLatin1String("1.0.0"));
+            foreach (const QString &dependency, Benchmarks::componentDependencies(i, fanOut))
+                component->addDependency(dependency);
+            core->appendRootComponent(component);
+        }
+        return core;
+    }
+
+private slots:
+    void appendComponentsToInstall_data()
+    {
+        QTest::addColumn<int>("componentCount");
+        QTest::addColumn<int>("fanOut");
+
+        QTest::newRow("100 components, fan-out 1") << 100 << 1;
+        QTest::newRow("100 components, fan-out 8") << 100 << 8;
+        QTest::newRow("1000 components, fan-out 1") << 1000 << 1;
+        QTest::newRow("1000 components, fan-out 3") << 1000 << 3;
+        QTest::newRow("1000 components, fan-out 8") << 1000 << 8;
+        QTest::newRow("5000 components, fan-out 3") << 5000 << 3;
+
+        const Benchmarks::RepositoryShape shape = Benchmarks::RepositoryShape::fromEnvironment();
+        QTest::newRow("environment") << shape.componentCount << shape.dependencyFanOut;
+    }
+
+    void appendComponentsToInstall()
+    {
+        QFETCH(int, componentCount);
+        QFETCH(int, fanOut);
+
+        QScopedPointer<PackageManagerCore> core(createCore(componentCount, fanOut));
+        const QList<Component *> all =
+            core->components(PackageManagerCore::ComponentType::AllNoReplacements);
+
+        // select the last tenth, they pull in most of the graph through their dependencies
+        QList<Component *> selected;
+        for (int i = componentCount - qMax(1, componentCount / 10); i < componentCount; ++i)
+            selected.append(all.at(i));
+
+        QBENCHMARK {
+            InstallerCalculator calc(all);
+            QVERIFY2(calc.appendComponentsToInstall(selected), qPrintable(calc.componentsToInstallError()));
+        }
+    }
+};
+
+IFW_BENCHMARK_MAIN(tst_InstallerCalculator)
+
+#include "tst_installercalculator.moc"
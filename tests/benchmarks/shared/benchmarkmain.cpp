@@ -0,0 +1,138 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include "benchmarkmain.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcessEnvironment>
+#include <QTemporaryFile>
+#include <QTest>
+#include <QXmlStreamReader>
+
+#define QUOTE_(x) #x
+#define QUOTE(x) QUOTE_(x)
+
+/*
+    Reads the benchmark results of the QTest XML log \a fileName into a JSON array and sets
+    \a testCase to the name of the test case.
+*/
+static QJsonArray readResults(const QString &fileName, QString *testCase)
+{
+    QJsonArray results;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return results;
+
+    QString function;
+    QXmlStreamReader reader(&file);
+    while (!reader.atEnd()) {
+        if (reader.readNext() != QXmlStreamReader::StartElement)
+            continue;
+
+        const QXmlStreamAttributes attributes = reader.attributes();
+        if (reader.name() == QLatin1String("TestCase")) {
+            *testCase = attributes.value(QLatin1String("name")).toString();
+        } else if (reader.name() == QLatin1String("TestFunction")) {
+            function = attributes.value(QLatin1String("name")).toString();
+        } else if (reader.name() == QLatin1String("BenchmarkResult")) {
+            QJsonObject result;
+            result.insert(QLatin1String("function"), function);
+            result.insert(QLatin1String("tag"), attributes.value(QLatin1String("tag")).toString());
+            result.insert(QLatin1String("metric"), attributes.value(QLatin1String("metric")).toString());
+            result.insert(QLatin1String("value"), attributes.value(QLatin1String("value")).toDouble());
+            result.insert(QLatin1String("iterations"),
+                attributes.value(QLatin1String("iterations")).toInt());
+            results.append(result);
+        }
+    }
+    return results;
+}
+
+/*!
+    Runs the tests of \a testObject with \a arguments. If -json <file> is passed or the environment
+    variable IFW_BENCHMARK_JSON names a file, the benchmark results are additionally written to
+    that file, together with the IFW_BENCHMARK_* settings they were measured with.
+*/
+int Benchmarks::exec(QObject *testObject, const QStringList &arguments)
+{
+    QStringList args = arguments;
+    QString jsonFile = QString::fromLocal8Bit(qgetenv("IFW_BENCHMARK_JSON"));
+    const int index = args.indexOf(QLatin1String("-json"));
+    if (index > 0 && index + 1 < args.count()) {
+        jsonFile = args.at(index + 1);
+        args.removeAt(index + 1);
+        args.removeAt(index);
+    }
+    if (jsonFile.isEmpty())
+        return QTest::qExec(testObject, args);
+
+    // let QTest log in its XML format next to the usual output, the results are taken from there
+    QTemporaryFile xmlLog;
+    if (!xmlLog.open()) {
+        qWarning("Cannot create the temporary benchmark log: %s", qPrintable(xmlLog.errorString()));
+        return 1;
+    }
+    xmlLog.close();
+    if (!args.contains(QLatin1String("-o")))
+        args << QLatin1String("-o") << QLatin1String("-,txt");
+    args << QLatin1String("-o") << xmlLog.fileName() + QLatin1String(",xml");
+
+    const int failures = QTest::qExec(testObject, args);
+
+    QString testCase;
+    const QJsonArray results = readResults(xmlLog.fileName(), &testCase);
+
+    QJsonObject environment;
+    const QProcessEnvironment processEnvironment = QProcessEnvironment::systemEnvironment();
+    foreach (const QString &key, processEnvironment.keys()) {
+        if (key.startsWith(QLatin1String("IFW_BENCHMARK_")) && key != QLatin1String("IFW_BENCHMARK_JSON"))
+            environment.insert(key, processEnvironment.value(key));
+    }
+
+    QJsonObject root;
+    root.insert(QLatin1String("testCase"), testCase);
+    root.insert(QLatin1String("ifwVersion"), QLatin1String(QUOTE(IFW_VERSION_STR)));
+    root.insert(QLatin1String("qtVersion"), QLatin1String(qVersion()));
+    root.insert(QLatin1String("timestamp"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    root.insert(QLatin1String("failures"), failures);
+    root.insert(QLatin1String("environment"), environment);
+    root.insert(QLatin1String("results"), results);
+
+    QFile file(jsonFile);
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(root).toJson()) < 0) {
+        qWarning("Cannot write benchmark results to \"%s\": %s", qPrintable(jsonFile),
+            qPrintable(file.errorString()));
+        return failures ? failures : 1;
+    }
+    return failures;
+}
@@ -0,0 +1,313 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include "httpstandin.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QPointer>
+#include <QTimer>
+
+#include <QHostAddress>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+static const qint64 scChunkSize = 256 * 1024;
+static const int scThrottleInterval = 10;
+
+/*
+    Serves the requests arriving on one socket, in the order they arrive. Requests are answered one
+    after the other, so pipelined requests keep working.
+*/
+class Connection : public QObject
+{
+public:
+    Connection(qintptr socketDescriptor, HttpStandIn *standIn, QObject *parent)
+        : QObject(parent)
+        , m_standIn(standIn)
+        , m_socket(new QTcpSocket(this))
+        , m_busy(false)
+        , m_closeWhenDone(false)
+        , m_bytesThisSecond(0)
+    {
+        m_socket->setSocketDescriptor(socketDescriptor);
+        connect(m_socket, &QTcpSocket::readyRead, this, &Connection::processRequests);
+        connect(m_socket, &QTcpSocket::bytesWritten, this, &Connection::sendBody);
+        connect(m_socket, &QTcpSocket::disconnected, this, &QObject::deleteLater);
+    }
+
+    ~Connection()
+    {
+        if (m_busy)
+            m_standIn->removeRequest(); // dropped by the client
+    }
+
+private:
+    void processRequests()
+    {
+        if (m_busy)
+            return;
+
+        const int end = m_socket->peek(m_socket->bytesAvailable()).indexOf("\r\n\r\n");
+        if (end < 0)
+            return;
+
+        const QList<QByteArray> lines = m_socket->read(end + 4).trimmed().split('\n');
+        const QList<QByteArray> requestLine = lines.value(0).trimmed().split(' ');
+        const QByteArray method = requestLine.value(0);
+        const QByteArray version = requestLine.value(2);
+
+        m_closeWhenDone = (version != "HTTP/1.1");
+        QByteArray ifNoneMatch;
+        for (int i = 1; i < lines.count(); ++i) {
+            const QByteArray line = lines.at(i).trimmed().toLower();
+            if (line.startsWith("connection:"))
+                m_closeWhenDone = line.contains("close");
+            else if (line.startsWith("if-none-match:"))
+                ifNoneMatch = line.mid(14).trimmed();
+        }
+
+        m_busy = true;
+        m_standIn->addRequest();
+
+        QByteArray path = requestLine.value(1);
+        path = path.left(path.indexOf('?') < 0 ? path.size() : path.indexOf('?'));
+        const QString relativePath = QDir::cleanPath(QUrl::fromPercentEncoding(path));
+        const QString root = QDir::cleanPath(m_standIn->rootPath()) + QLatin1Char('/');
+        const QString filePath = QDir::cleanPath(root + relativePath);
+
+        const bool valid = (method == "GET" || method == "HEAD") && filePath.startsWith(root)
+            && QFileInfo(filePath).isFile();
+
+        QByteArray header;
+        if (valid) {
+            m_file.setFileName(filePath);
+            if (m_file.open(QIODevice::ReadOnly)) {
+                const QByteArray etag = entityTag(&m_file);
+                if (!ifNoneMatch.isEmpty() && ifNoneMatch == etag) {
+                    header = "HTTP/1.1 304 Not Modified\r\nETag: " + etag + "\r\n";
+                    m_standIn->addNotModified();
+                    m_file.close();
+                } else {
+                    header = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+                        "Content-Length: " + QByteArray::number(m_file.size()) + "\r\n"
+                        "ETag: " + etag + "\r\n";
+                    if (method == "HEAD")
+                        m_file.close();
+                }
+            }
+        }
+        if (header.isEmpty())
+            header = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n";
+        if (m_closeWhenDone)
+            header += "Connection: close\r\n";
+        header += "\r\n";
+
+        const QPointer<Connection> self(this);
+        QTimer::singleShot(m_standIn->latency(), this, [self, header]() {
+            if (!self)
+                return;
+            self->m_socket->write(header);
+            self->m_throttle.start();
+            self->m_bytesThisSecond = 0;
+            self->sendBody();
+        });
+    }
+
+    // Returns a strong entity tag derived from the content of file, and rewinds it.
+    static QByteArray entityTag(QFile *file)
+    {
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        hash.addData(file);
+        file->seek(0);
+        return '"' + hash.result().toHex() + '"';
+    }
+
+    void sendBody()
+    {
+        if (!m_busy || !m_throttle.isValid())
+            return;
+
+        if (!m_file.isOpen()) {
+            finishRequest();
+            return;
+        }
+
+        // keep only a little data queued in the socket, so the throttling below is effective
+        if (m_socket->bytesToWrite() > scChunkSize)
+            return;
+
+        qint64 budget = scChunkSize;
+        const qint64 bandwidth = m_standIn->bandwidth();
+        if (bandwidth > 0) {
+            budget = (bandwidth * m_throttle.elapsed()) / 1000 - m_bytesThisSecond;
+            if (budget <= 0) {
+                QTimer::singleShot(scThrottleInterval, this, &Connection::sendBody);
+                return;
+            }
+            budget = qMin(budget, scChunkSize);
+        }
+
+        const QByteArray data = m_file.read(budget);
+        if (!data.isEmpty()) {
+            m_socket->write(data);
+            m_bytesThisSecond += data.size();
+            m_standIn->addBytesSent(data.size());
+        }
+
+        if (m_file.atEnd() || data.isEmpty()) {
+            m_file.close();
+            finishRequest();
+        } else if (bandwidth > 0) {
+            QTimer::singleShot(scThrottleInterval, this, &Connection::sendBody);
+        }
+    }
+
+    void finishRequest()
+    {
+        m_busy = false;
+        m_standIn->removeRequest();
+        m_throttle.invalidate();
+        if (m_closeWhenDone) {
+            m_socket->disconnectFromHost();
+            return;
+        }
+        if (m_socket->bytesAvailable() > 0)
+            QTimer::singleShot(0, this, &Connection::processRequests);
+    }
+
+private:
+    HttpStandIn *const m_standIn;
+    QTcpSocket *const m_socket;
+    QFile m_file;
+    QElapsedTimer m_throttle;
+    bool m_busy;
+    bool m_closeWhenDone;
+    qint64 m_bytesThisSecond;
+};
+
+class Server : public QTcpServer
+{
+public:
+    explicit Server(HttpStandIn *standIn)
+        : m_standIn(standIn)
+    {}
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override
+    {
+        new Connection(socketDescriptor, m_standIn, this);
+    }
+
+private:
+    HttpStandIn *const m_standIn;
+};
+
+
+// -- HttpStandIn
+
+HttpStandIn::HttpStandIn(const QString &rootPath, QObject *parent)
+    : QThread(parent)
+    , m_rootPath(QFileInfo(rootPath).absoluteFilePath())
+    , m_port(0)
+    , m_latency(0)
+    , m_bandwidth(0)
+    , m_requestCount(0)
+    , m_activeRequests(0)
+    , m_maxActiveRequests(0)
+    , m_notModifiedCount(0)
+    , m_bytesSent(0)
+{
+}
+
+HttpStandIn::~HttpStandIn()
+{
+    close();
+}
+
+/*!
+    Starts the server thread and waits until the server listens on a local port. Returns \c false
+    if the server could not listen.
+*/
+bool HttpStandIn::listen()
+{
+    if (isRunning())
+        return m_port != 0;
+
+    start();
+    m_ready.acquire();
+    return m_port != 0;
+}
+
+/*!
+    Stops the server and waits for the server thread to finish. Open connections are dropped.
+*/
+void HttpStandIn::close()
+{
+    if (!isRunning())
+        return;
+    quit();
+    wait();
+}
+
+/*!
+    Counts a request that arrived. The request is in progress until removeRequest() is called,
+    the highest number of requests in progress at the same time is kept for
+    maxConcurrentRequests().
+*/
+void HttpStandIn::addRequest()
+{
+    m_requestCount.ref();
+    const int active = m_activeRequests.fetchAndAddRelaxed(1) + 1;
+    int max = m_maxActiveRequests.load();
+    while (active > max && !m_maxActiveRequests.testAndSetRelaxed(max, active))
+        max = m_maxActiveRequests.load();
+}
+
+/*!
+    Returns the URL of the root directory, without a trailing slash.
+*/
+QUrl HttpStandIn::url() const
+{
+    return QUrl(QString::fromLatin1("http://127.0.0.1:%1").arg(m_port));
+}
+
+void HttpStandIn::run()
+{
+    Server server(this);
+    m_port = server.listen(QHostAddress::LocalHost) ? server.serverPort() : 0;
+    m_ready.release();
+    if (m_port == 0)
+        return;
+
+    exec();
+}
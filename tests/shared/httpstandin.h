@@ -0,0 +1,93 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#ifndef HTTPSTANDIN_H
+#define HTTPSTANDIN_H
+
+#include <QAtomicInteger>
+#include <QSemaphore>
+#include <QString>
+#include <QThread>
+#include <QUrl>
+
+/*
+    A minimal HTTP/1.1 server that serves the files below a root directory, standing in for the
+    web server of a repository. It runs on its own thread, so it keeps serving while the code under
+    test blocks the main thread. Every response can be delayed by a latency and the transfer of the
+    file data can be limited to a bandwidth. Responses carry an entity tag of the file content, and
+    matching conditional requests are answered with 304 Not Modified.
+*/
+class HttpStandIn : public QThread
+{
+public:
+    explicit HttpStandIn(const QString &rootPath, QObject *parent = 0);
+    ~HttpStandIn();
+
+    QString rootPath() const { return m_rootPath; }
+
+    int latency() const { return m_latency.load(); }
+    void setLatency(int msecs) { m_latency.store(msecs); }
+
+    qint64 bandwidth() const { return m_bandwidth.load(); }
+    void setBandwidth(qint64 bytesPerSecond) { m_bandwidth.store(bytesPerSecond); }
+
+    bool listen();
+    void close();
+    QUrl url() const;
+
+    int requestCount() const { return m_requestCount.load(); }
+    qint64 bytesSent() const { return m_bytesSent.load(); }
+
+    int notModifiedCount() const { return m_notModifiedCount.load(); }
+    int maxConcurrentRequests() const { return m_maxActiveRequests.load(); }
+    void resetMaxConcurrentRequests() { m_maxActiveRequests.store(m_activeRequests.load()); }
+
+    void addRequest();
+    void removeRequest() { m_activeRequests.deref(); }
+    void addNotModified() { m_notModifiedCount.ref(); }
+    void addBytesSent(qint64 bytes) { m_bytesSent.fetchAndAddRelaxed(bytes); }
+
+protected:
+    void run();
+
+private:
+    const QString m_rootPath;
+    QSemaphore m_ready;
+    quint16 m_port;
+
+    QAtomicInteger<int> m_latency;
+    QAtomicInteger<qint64> m_bandwidth;
+    QAtomicInteger<int> m_requestCount;
+    QAtomicInteger<int> m_activeRequests;
+    QAtomicInteger<int> m_maxActiveRequests;
+    QAtomicInteger<int> m_notModifiedCount;
+    QAtomicInteger<qint64> m_bytesSent;
+};
+
+#endif // HTTPSTANDIN_H
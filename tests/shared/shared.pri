@@ -0,0 +1,15 @@
+# helpers shared by the auto tests and the benchmarks: synthetic repositories, the HTTP
+# stand-in server and access to internals of the package manager core
+QT += network xml
+INCLUDEPATH += $$PWD $$IFW_SOURCE_TREE/tools/common
+
+HEADERS += \
+    $$PWD/httpstandin.h \
+    $$PWD/packagemanagercoretestaccess.h \
+    $$PWD/syntheticrepository.h \
+    $$IFW_SOURCE_TREE/tools/common/repositorygen.h
+
+SOURCES += \
+    $$PWD/httpstandin.cpp \
+    $$PWD/syntheticrepository.cpp \
+    $$IFW_SOURCE_TREE/tools/common/repositorygen.cpp
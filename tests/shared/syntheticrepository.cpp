@@ -0,0 +1,194 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#include "syntheticrepository.h"
+
+#include <errors.h>
+#include <fileutils.h>
+#include <repositorygen.h>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+
+#define QUOTE_(x) #x
+#define QUOTE(x) QUOTE_(x)
+
+static int environmentValue(const char *name, int defaultValue)
+{
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return (ok && value >= 0) ? value : defaultValue;
+}
+
+/*!
+    Returns the repository shape with the defaults overridden by the IFW_BENCHMARK_* environment
+    variables.
+*/
+Benchmarks::RepositoryShape Benchmarks::RepositoryShape::fromEnvironment()
+{
+    RepositoryShape shape;
+    shape.componentCount = qMax(1, environmentValue("IFW_BENCHMARK_COMPONENTS", shape.componentCount));
+    shape.dependencyFanOut = environmentValue("IFW_BENCHMARK_FANOUT", shape.dependencyFanOut);
+    shape.fileCount = qMax(1, environmentValue("IFW_BENCHMARK_FILES", shape.fileCount));
+    shape.archiveSize = qint64(environmentValue("IFW_BENCHMARK_ARCHIVE_SIZE",
+        int(shape.archiveSize / 1024))) * 1024;
+    return shape;
+}
+
+/*!
+    Returns the name of the component at \a index. Names contain neither dots nor dashes, so all
+    components are root components and valid package directory names.
+*/
+QString Benchmarks::componentName(int index)
+{
+    return QString::fromLatin1("component%1").arg(index, 4, 10, QLatin1Char('0'));
+}
+
+/*!
+    Returns up to \a fanOut dependencies of the component at \a index. Components only depend on
+    components with a lower index, so the dependencies always form a directed acyclic graph. The
+    result is the same for every run.
+*/
+QStringList Benchmarks::componentDependencies(int index, int fanOut)
+{
+    QStringList dependencies;
+    for (int i = 0; i < qMin(index, fanOut); ++i) {
+        const QString dependency = componentName((index * 31 + i * 17) % index);
+        if (!dependencies.contains(dependency))
+            dependencies.append(dependency);
+    }
+    return dependencies;
+}
+
+static void writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        throw QInstaller::Error(QString::fromLatin1("Cannot write file \"%1\": %2")
+            .arg(QDir::toNativeSeparators(fileName), file.errorString()));
+    }
+}
+
+/*
+    Returns \a size bytes of pseudo random data, so the archives do not compress to nothing. The
+    data only depends on \a seed.
+*/
+static QByteArray payload(qint64 size, quint32 seed)
+{
+    QByteArray data(int(size), Qt::Uninitialized);
+    quint32 state = seed ? seed : 0x9e3779b9;
+    for (int i = 0; i < data.size(); ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        data[i] = char(state);
+    }
+    return data;
+}
+
+/*!
+    Writes the package directory of the component at \a index with \a version into
+    \a packagesDir, replacing an existing one. The data of the package changes with the version.
+*/
+void Benchmarks::writePackage(const QString &packagesDir, int index, const QString &version,
+    const RepositoryShape &shape)
+{
+    const QString name = componentName(index);
+    const QString packageDir = packagesDir + QLatin1Char('/') + name;
+    QInstaller::removeDirectory(packageDir);
+    QInstaller::mkpath(packageDir + QLatin1String("/meta"));
+
+    const QString packageXml = QString::fromLatin1("<?xml version=\"1.0\"?>\n"
+        "<Package>\n"
+        "    <DisplayName>%1</DisplayName>\n"
+        "    <Description>Synthetic benchmark component %1</Description>\n"
+        "    <Version>%2</Version>\n"
+        "    <ReleaseDate>2020-01-01</ReleaseDate>\n"
+        "    <Default>true</Default>\n"
+        "    <Dependencies>%3</Dependencies>\n"
+        "</Package>\n").arg(name, version,
+            componentDependencies(index, shape.dependencyFanOut).join(QLatin1Char(',')));
+    writeFile(packageDir + QLatin1String("/meta/package.xml"), packageXml.toUtf8());
+
+    // spread the files over a few directories, like a real installation would
+    const qint64 fileSize = shape.archiveSize / shape.fileCount;
+    const quint32 seed = qHash(name) ^ qHash(version);
+    for (int i = 0; i < shape.fileCount; ++i) {
+        const QString dir = QString::fromLatin1("%1/data/%2/dir%3").arg(packageDir, name).arg(i % 4);
+        QInstaller::mkpath(dir);
+        writeFile(QString::fromLatin1("%1/file%2.bin").arg(dir).arg(i), payload(fileSize, seed + i));
+    }
+}
+
+/*!
+    Writes the package directories of all components described by \a shape with version 1.0.0
+    into \a packagesDir.
+*/
+void Benchmarks::writePackages(const QString &packagesDir, const RepositoryShape &shape)
+{
+    for (int i = 0; i < shape.componentCount; ++i)
+        writePackage(packagesDir, i, QLatin1String("1.0.0"), shape);
+}
+
+/*!
+    Generates or updates the repository \a repositoryDir from the packages in \a packagesDir, the
+    same way as running \c{repogen --update -p <packagesDir> <repositoryDir>} does. Throws
+    QInstaller::Error on failure.
+*/
+void Benchmarks::generateRepository(const QString &packagesDir, const QString &repositoryDir)
+{
+    QStringList filteredPackages;
+    QInstallerTools::PackageInfoVector packages = QInstallerTools::createListOfPackages(
+        QStringList(packagesDir), &filteredPackages, QInstallerTools::Exclude);
+    const QHash<QString, QString> pathToVersionMapping =
+        QInstallerTools::buildPathToVersionMapping(packages);
+
+    QTemporaryDir tmp;
+    if (!tmp.isValid())
+        throw QInstaller::Error(QLatin1String("Cannot create temporary directory."));
+
+    const int jobs = qMax(1, QThread::idealThreadCount());
+    QInstallerTools::copyComponentData(QStringList(packagesDir), repositoryDir, &packages, 0, jobs,
+        QInstallerTools::FileAttributeFingerprints);
+    QInstallerTools::copyMetaData(tmp.path(), repositoryDir, packages, QLatin1String("{AnyApplication}"),
+        QLatin1String(QUOTE(IFW_REPOSITORY_FORMAT_VERSION)));
+    QInstallerTools::compressMetaDirectories(tmp.path(), tmp.path(), pathToVersionMapping, false,
+        repositoryDir, jobs);
+
+    QDirIterator it(repositoryDir, QStringList() << QLatin1String("Updates*.xml")
+        << QLatin1String("*_meta.7z"), QDir::Files | QDir::CaseSensitive);
+    while (it.hasNext()) {
+        it.next();
+        QFile::remove(it.fileInfo().absoluteFilePath());
+    }
+    QInstaller::moveDirectoryContents(tmp.path(), repositoryDir);
+}
@@ -0,0 +1,71 @@
+/**************************************************************************
+**
+** Copyright (C) 2017 The Qt Company Ltd.
+** Contact: https://www.qt.io/licensing/
+**
+** This file is part of the Qt Installer Framework.
+**
+** $QT_BEGIN_LICENSE:GPL-EXCEPT$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see https://www.qt.io/terms-conditions. For further
+** information use the contact form at https://www.qt.io/contact-us.
+**
+** GNU General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU
+** General Public License version 3 as published by the Free Software
+** Foundation with exceptions as appearing in the file LICENSE.GPL3-EXCEPT
+** included in the packaging of this file. Please review the following
+** information to ensure the GNU General Public License requirements will
+** be met: https://www.gnu.org/licenses/gpl-3.0.html.
+**
+** $QT_END_LICENSE$
+**
+**************************************************************************/
+
+
+#ifndef SYNTHETICREPOSITORY_H
+#define SYNTHETICREPOSITORY_H
+
+#include <QString>
+#include <QStringList>
+
+namespace Benchmarks {
+
+/*
+    Describes the repository the benchmarks run against. The defaults can be overridden through
+    the environment variables IFW_BENCHMARK_COMPONENTS, IFW_BENCHMARK_FANOUT, IFW_BENCHMARK_FILES
+    and IFW_BENCHMARK_ARCHIVE_SIZE (in KiB).
+*/
+struct RepositoryShape
+{
+    RepositoryShape(int components = 100, int fanOut = 3, int files = 10, qint64 size = 256 * 1024)
+        : componentCount(components)
+        , dependencyFanOut(fanOut)
+        , fileCount(files)
+        , archiveSize(size)
+    {}
+
+    static RepositoryShape fromEnvironment();
+
+    int componentCount;
+    int dependencyFanOut;
+    int fileCount;      // number of files per component
+    qint64 archiveSize; // uncompressed size of the data per component, in bytes
+};
+
+QString componentName(int index);
+QStringList componentDependencies(int index, int fanOut);
+
+void writePackage(const QString &packagesDir, int index, const QString &version,
+    const RepositoryShape &shape);
+void writePackages(const QString &packagesDir, const RepositoryShape &shape);
+
+void generateRepository(const QString &packagesDir, const QString &repositoryDir);
+
+} // namespace Benchmarks
+
+#endif // SYNTHETICREPOSITORY_H
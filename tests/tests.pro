@@ -2,5 +2,6 @@ TEMPLATE = subdirs
 
 SUBDIRS = \
         auto \
+        benchmarks \
         downloadspeed \
         environmentvariable
@@ -150,8 +150,16 @@ int main(int argc, char *argv[])
                 "Defaults to 5 (Normal compression)."
             ), QLatin1String("5"), QLatin1String("5"));
 
+        const QCommandLineOption solidBlockSize = QCommandLineOption(QStringList()
+            << QLatin1String("s") << QLatin1String("solid-block-size"),
+            QCoreApplication::translate("archivegen",
+                "Limit the size of solid blocks to the given amount of MB, so the archive can be "
+                "extracted by several threads. Defaults to the 7z default block size."
+            ), QLatin1String("MB"));
+
         parser.addOption(verbose);
         parser.addOption(compression);
+        parser.addOption(solidBlockSize);
         parser.addPositionalArgument(QLatin1String("archive"),
             QCoreApplication::translate("archivegen", "Compressed archive to create."));
         parser.addPositionalArgument(QLatin1String("sources"),
@@ -183,13 +191,23 @@ int main(int argc, char *argv[])
                 "Unknown compression level \"%1\". See 'archivgen --help'.").arg(value));
         }
 
+        quint64 blockSize = 0;
+        if (parser.isSet(solidBlockSize)) {
+            blockSize = parser.value(solidBlockSize).toULongLong(&ok) * 1024 * 1024;
+            if (!ok || blockSize == 0) {
+                throw QInstaller::Error(QCoreApplication::translate("archivegen",
+                    "Invalid solid block size \"%1\". See 'archivgen --help'.")
+                    .arg(parser.value(solidBlockSize)));
+            }
+        }
+
         Lib7z::initSevenZ();
         Lib7z::createArchive(args[0], args.mid(1), Lib7z::QTmpFile::No, Lib7z::Compression(value),
             [&] () -> Lib7z::UpdateCallback * {
                 if (parser.isSet(verbose))
                     return new VerbosePrinterCallback;
                 return new FailOnErrorCallback;
-            } ()
+            } (), blockSize
         );
         return EXIT_SUCCESS;
     } catch (const QInstaller::Error &e) {
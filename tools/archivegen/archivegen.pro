@@ -5,7 +5,7 @@ INCLUDEPATH += . .. ../common
 include(../../installerfw.pri)
 
 QT -= gui
-QT += qml xml
+QT += concurrent qml xml
 
 LIBS += -l7z
 CONFIG += console
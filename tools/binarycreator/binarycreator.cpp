@@ -607,6 +607,8 @@ int main(int argc, char **argv)
     QInstallerTools::FilterType ftype = QInstallerTools::Exclude;
     bool compileResource = false;
     QString signingIdentity;
+    quint64 solidBlockSize = 0;
+    int jobs = 1;
 
     const QStringList args = app.arguments().mid(1);
     for (QStringList::const_iterator it = args.begin(); it != args.end(); ++it) {
@@ -699,6 +701,20 @@ int main(int argc, char **argv)
             if (it == args.end() || it->startsWith(QLatin1String("-")))
                 return printErrorAndUsageAndExit(QString::fromLatin1("Error: Resource files to include are missing."));
             resources = it->split(QLatin1Char(','));
+        } else if (*it == QLatin1String("--solid-block-size")) {
+            ++it;
+            bool ok = false;
+            if (it != args.end())
+                solidBlockSize = it->toULongLong(&ok) * 1024 * 1024;
+            if (!ok || solidBlockSize == 0)
+                return printErrorAndUsageAndExit(QString::fromLatin1("Error: Solid block size parameter missing or invalid."));
+        } else if (*it == QLatin1String("-j") || *it == QLatin1String("--jobs")) {
+            ++it;
+            bool ok = false;
+            if (it != args.end())
+                jobs = it->toInt(&ok);
+            if (!ok || jobs < 1)
+                return printErrorAndUsageAndExit(QString::fromLatin1("Error: Jobs parameter missing or invalid."));
         } else if (*it == QLatin1String("--ignore-translations")
             || *it == QLatin1String("--ignore-invalid-packages")) {
                 continue;
@@ -783,7 +799,8 @@ int main(int argc, char **argv)
             // 2.2; copy the packages data and setup the packages vector with the files we copied,
             //    must happen before copying meta data because files will be compressed if
             //    needed and meta data generation relies on this
-            QInstallerTools::copyComponentData(packagesDirectories, tmpRepoDir, &preparedPackages);
+            QInstallerTools::copyComponentData(packagesDirectories, tmpRepoDir, &preparedPackages,
+                solidBlockSize, jobs);
             // 2.3; add to common vector
             packages.append(preparedPackages);
         }
@@ -43,8 +43,13 @@
 
 #include <updater.h>
 
+#include <QtCore/QDateTime>
 #include <QtCore/QDirIterator>
 #include <QtCore/QRegExp>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QThreadPool>
+
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <QtXml/QDomDocument>
 
@@ -67,6 +72,10 @@ void QInstallerTools::printRepositoryGenOptions()
     std::cout << "  --ignore-translations     Do not use any translation" << std::endl;
     std::cout << "  --ignore-invalid-packages Ignore all invalid packages instead of aborting." << std::endl;
     std::cout << "  --ignore-invalid-repositories Ignore all invalid repositories instead of aborting." << std::endl;
+    std::cout << "  --solid-block-size MB     Limit the solid blocks of the compressed component data to the" << std::endl;
+    std::cout << "                            given size, so archives can be extracted by several threads." << std::endl;
+    std::cout << "  -j|--jobs N               Compress up to N packages at the same time. Defaults" << std::endl;
+    std::cout << "                            to 1." << std::endl;
 }
 
 QString QInstallerTools::makePathAbsolute(const QString &path)
@@ -652,8 +661,102 @@ static void writeSHA1ToNodeWithName(QDomDocument &doc, QDomNodeList &list, const
     }
 }
 
+/*
+    Packs the meta directories \a packageDirs of \a repoDir together with the meta data of all
+    other components listed in \a doc into one archive, and references it from the root element.
+    The meta data of components not generated in this run is taken from their existing
+    meta.7z archives in \a existingRepoDir, whose SHA-1 is written to their entries as well, so
+    every component keeps a checksum next to the one of the united archive.
+*/
+static void createUnitedMetadata(QDomDocument &doc, const QString &repoDir,
+    const QStringList &packageDirs, const QString &existingRepoDir)
+{
+    QTemporaryDir existing;
+    QStringList sources;
+    foreach (const QString &packageDir, packageDirs)
+        sources.append(QDir(repoDir).absoluteFilePath(packageDir));
+
+    QDomNodeList elements = doc.elementsByTagName(QLatin1String("PackageUpdate"));
+    for (int i = 0; i < elements.count(); ++i) {
+        const QString name = elements.at(i).firstChildElement(scName).text();
+        if (packageDirs.contains(name))
+            continue; // gets its checksum when its meta.7z is created
+
+        const QString version = elements.at(i).firstChildElement(scVersion).text();
+        QFile archive(QString::fromLatin1("%1/%2/%3meta.7z").arg(existingRepoDir, name, version));
+        if (!archive.open(QIODevice::ReadOnly)) {
+            throw QInstaller::Error(QString::fromLatin1("Cannot open meta data archive \"%1\": %2")
+                .arg(QDir::toNativeSeparators(archive.fileName()), archive.errorString()));
+        }
+        Lib7z::extractArchive(&archive, existing.path());
+        sources.append(existing.path() + QLatin1Char('/') + name);
+
+        archive.seek(0);
+        writeSHA1ToNodeWithName(doc, elements, QInstaller::calculateHash(&archive,
+            QCryptographicHash::Sha1), name);
+    }
+
+    const QString tmpTarget = repoDir + QLatin1String("/united_meta.7z");
+    Lib7z::createArchive(tmpTarget, sources, Lib7z::QTmpFile::No);
+
+    QFile tmp(tmpTarget);
+    QInstaller::openForRead(&tmp);
+    const QByteArray sha1Sum = QInstaller::calculateHash(&tmp, QCryptographicHash::Sha1).toHex();
+    tmp.close();
+
+    // name the archive after its content, so no cache can ever hand out an outdated one
+    const QString fileName = QString::fromLatin1(sha1Sum) + QLatin1String("_meta.7z");
+    if (!tmp.rename(repoDir + QLatin1Char('/') + fileName)) {
+        throw QInstaller::Error(QString::fromLatin1("Cannot move file \"%1\" to \"%2\".").arg(
+            QDir::toNativeSeparators(tmpTarget), QDir::toNativeSeparators(fileName)));
+    }
+
+    QDomElement root = doc.documentElement();
+    root.appendChild(doc.createElement(QLatin1String("MetadataName")))
+        .appendChild(doc.createTextNode(fileName));
+    root.appendChild(doc.createElement(QLatin1String("MetadataSHA1")))
+        .appendChild(doc.createTextNode(QString::fromLatin1(sha1Sum)));
+}
+
+/*!
+    Compresses the meta data directory \a absPath into an archive named after \a versionPrefix and
+    moves it into the directory. The SHA-1 of the archive is stored in \a sha1Sum. Returns an
+    empty string on success, otherwise the error message.
+*/
+static QString compressMetaDirectory(const QString &absPath, const QString &repoDir,
+    const QString &versionPrefix, QByteArray *sha1Sum)
+{
+    try {
+        const QString fn = QLatin1String(versionPrefix.toLatin1() + "meta.7z");
+        // the archive must not end up in the directory it is created from, name it after the
+        // package so that concurrent jobs for packages of the same version don't collide
+        const QString tmpTarget = repoDir + QLatin1Char('/') + QFileInfo(absPath).fileName()
+            + QLatin1Char('_') + fn;
+        Lib7z::createArchive(tmpTarget, QStringList() << absPath, Lib7z::QTmpFile::No);
+
+        // remove the files that got compressed
+        QInstaller::removeFiles(absPath, true);
+
+        QFile tmp(tmpTarget);
+        QInstaller::openForRead(&tmp);
+        *sha1Sum = QInstaller::calculateHash(&tmp, QCryptographicHash::Sha1);
+        const QString finalTarget = absPath + QLatin1String("/") + fn;
+        if (!tmp.rename(finalTarget)) {
+            throw QInstaller::Error(QString::fromLatin1("Cannot move file \"%1\" to \"%2\".").arg(
+                                        QDir::toNativeSeparators(tmpTarget), QDir::toNativeSeparators(finalTarget)));
+        }
+    } catch (const QInstaller::Error &e) {
+        return e.message();
+    } catch (...) {
+        return QString::fromLatin1("Unknown exception caught while compressing \"%1\".")
+            .arg(QDir::toNativeSeparators(absPath));
+    }
+    return QString();
+}
+
 void QInstallerTools::compressMetaDirectories(const QString &repoDir, const QString &baseDir,
-    const QHash<QString, QString> &versionMapping)
+    const QHash<QString, QString> &versionMapping, bool uniteMetadata, const QString &existingRepoDir,
+    int jobs)
 {
     QDomDocument doc;
     QDomElement root;
@@ -666,57 +769,254 @@ void QInstallerTools::compressMetaDirectories(const QString &repoDir, const QStr
     }
     existingUpdatesXml.close();
 
+    // drop the reference to a previously united archive, it gets recreated if requested
+    if (!root.isNull()) {
+        foreach (const QString &tag, QStringList() << QLatin1String("MetadataName")
+                << QLatin1String("MetadataSHA1")) {
+            const QDomElement element = root.firstChildElement(tag);
+            if (!element.isNull())
+                root.removeChild(element);
+        }
+    }
+
     QDir dir(repoDir);
     const QStringList sub = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-    QDomNodeList elements =  doc.elementsByTagName(QLatin1String("PackageUpdate"));
+    if (uniteMetadata && !root.isNull())
+        createUnitedMetadata(doc, repoDir, sub, existingRepoDir);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, jobs));
+
+    QStringList paths;
+    QList<QFuture<QString> > futures;
+    QVector<QByteArray> sha1Sums(sub.count());
     foreach (const QString &i, sub) {
-        QDir sd(dir);
-        sd.cd(i);
         const QString path = QString(i).remove(baseDir);
-        const QString versionPrefix = versionMapping[path];
         if (path.isNull())
             continue;
-        const QString absPath = sd.absolutePath();
-        const QString fn = QLatin1String(versionPrefix.toLatin1() + "meta.7z");
-        const QString tmpTarget = repoDir + QLatin1String("/") +fn;
-        Lib7z::createArchive(tmpTarget, QStringList() << absPath, Lib7z::QTmpFile::No);
-
-        // remove the files that got compressed
-        QInstaller::removeFiles(absPath, true);
+        futures.append(QtConcurrent::run(&pool, compressMetaDirectory, QDir(dir.filePath(i))
+            .absolutePath(), repoDir, versionMapping.value(path), &sha1Sums[paths.count()]));
+        paths.append(path);
+    }
 
-        QFile tmp(tmpTarget);
-        tmp.open(QFile::ReadOnly);
-        const QByteArray sha1Sum = QInstaller::calculateHash(&tmp, QCryptographicHash::Sha1);
-        writeSHA1ToNodeWithName(doc, elements, sha1Sum, path);
-        const QString finalTarget = absPath + QLatin1String("/") + fn;
-        if (!tmp.rename(finalTarget)) {
-            throw QInstaller::Error(QString::fromLatin1("Cannot move file \"%1\" to \"%2\".").arg(
-                                        QDir::toNativeSeparators(tmpTarget), QDir::toNativeSeparators(finalTarget)));
+    QString errorString;
+    QDomNodeList elements =  doc.elementsByTagName(QLatin1String("PackageUpdate"));
+    for (int i = 0; i < futures.count(); ++i) {
+        const QString result = futures.at(i).result();
+        if (!result.isEmpty()) {
+            if (errorString.isEmpty())
+                errorString = result;
+            continue;
         }
+        writeSHA1ToNodeWithName(doc, elements, sha1Sums.at(i), paths.at(i));
     }
+    if (!errorString.isEmpty())
+        throw QInstaller::Error(errorString);
 
     QInstaller::openForWrite(&existingUpdatesXml);
     QInstaller::blockingWrite(&existingUpdatesXml, doc.toByteArray());
     existingUpdatesXml.close();
 }
 
-void QInstallerTools::copyComponentData(const QStringList &packageDirs, const QString &repoDir,
-    PackageInfoVector *const infos)
+/*!
+    Copies \a source to \a target and returns the SHA-1 of the data, computed while it is copied.
+*/
+static QByteArray copyWithHash(const QString &source, const QString &target)
 {
-    for (int i = 0; i < infos->count(); ++i) {
-        const PackageInfo info = infos->at(i);
-        const QString name = info.name;
-        qDebug() << "Copying component data for" << name;
+    QFile in(source);
+    QFile out(target);
+    QInstaller::openForRead(&in);
+    QInstaller::openForWrite(&out);
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QByteArray buffer(1024 * 1024, '\0');
+    forever {
+        const qint64 numRead = in.read(buffer.data(), buffer.size());
+        if (numRead < 0) {
+            throw QInstaller::Error(QString::fromLatin1("Cannot read file \"%1\": %2")
+                .arg(QDir::toNativeSeparators(source), in.errorString()));
+        }
+        if (numRead == 0)
+            break;
+        hash.addData(buffer.constData(), numRead);
+        QInstaller::blockingWrite(&out, buffer.constData(), numRead);
+    }
+    out.setPermissions(in.permissions());
+    return hash.result();
+}
+
+static const QLatin1String scFingerprintsFile("Fingerprints.xml");
 
+struct PackageFingerprint
+{
+    QByteArray hash;
+    QStringList files;
+};
+
+struct CopyDataContext
+{
+    quint64 solidBlockSize;
+    FingerprintMode fingerprintMode;
+    QAtomicInt failed;
+};
+
+/*!
+    Returns the fingerprint of the package data described by \a info in \a packageDirs. It covers
+    the version and \a solidBlockSize, because both end up in the repository files, and the path,
+    type, size, permissions and modification time of every file in the data directories. If
+    \a mode is \c FileContentFingerprints, the content of the files is hashed as well.
+*/
+static QByteArray packageFingerprint(const QStringList &packageDirs, const PackageInfo &info,
+    quint64 solidBlockSize, FingerprintMode mode)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(info.version.toUtf8());
+    hash.addData(QByteArray::number(solidBlockSize));
+
+    for (int i = 0; i < packageDirs.count(); ++i) {
+        const QDir dataDir(QString::fromLatin1("%1/%2/data").arg(packageDirs.at(i), info.name));
+        if (!dataDir.exists())
+            continue;
+
+        QStringList entries;
+        QDirIterator it(dataDir.absolutePath(), QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden
+            | QDir::System, QDirIterator::Subdirectories);
+        while (it.hasNext())
+            entries.append(dataDir.relativeFilePath(it.next()));
+        entries.sort(); // the iteration order depends on the file system
+
+        hash.addData(QByteArray::number(i));
+        foreach (const QString &entry, entries) {
+            const QFileInfo fi(dataDir.absoluteFilePath(entry));
+            QByteArray line = entry.toUtf8();
+            if (fi.isSymLink())
+                line += "\tl\t" + fi.symLinkTarget().toUtf8();
+            else if (fi.isDir())
+                line += "\td";
+            else
+                line += "\tf\t" + QByteArray::number(fi.size());
+            line += '\t' + QByteArray::number(int(fi.permissions()));
+            line += '\t' + QByteArray::number(fi.lastModified().toMSecsSinceEpoch());
+            if (mode == FileContentFingerprints && fi.isFile() && !fi.isSymLink())
+                line += '\t' + QInstaller::calculateHash(fi.absoluteFilePath(), QCryptographicHash::Sha1);
+            hash.addData(line + '\n');
+        }
+    }
+    return hash.result().toHex();
+}
+
+/*!
+    Reads the package fingerprints stored in the repository directory \a repoDir.
+*/
+static QHash<QString, PackageFingerprint> readFingerprints(const QString &repoDir)
+{
+    QHash<QString, PackageFingerprint> fingerprints;
+
+    QFile file(QString::fromLatin1("%1/%2").arg(repoDir, scFingerprintsFile));
+    QDomDocument doc;
+    if (!file.open(QIODevice::ReadOnly) || !doc.setContent(&file))
+        return fingerprints;
+
+    const QDomNodeList packages = doc.documentElement().elementsByTagName(QLatin1String("Package"));
+    for (int i = 0; i < packages.count(); ++i) {
+        const QDomElement package = packages.at(i).toElement();
+        PackageFingerprint fingerprint;
+        fingerprint.hash = package.attribute(QLatin1String("Hash")).toLatin1();
+        const QDomNodeList files = package.elementsByTagName(QLatin1String("File"));
+        for (int j = 0; j < files.count(); ++j)
+            fingerprint.files.append(files.at(j).toElement().text());
+        fingerprints.insert(package.attribute(QLatin1String("Name")), fingerprint);
+    }
+    return fingerprints;
+}
+
+/*!
+    Writes \a fingerprints to the repository directory \a repoDir. Packages without a fingerprint
+    hash are left out.
+*/
+static void writeFingerprints(const QString &repoDir, const QHash<QString, PackageFingerprint> &fingerprints)
+{
+    QDomDocument doc;
+    QDomElement root = doc.createElement(QLatin1String("Fingerprints"));
+    doc.appendChild(root);
+
+    QStringList names = fingerprints.keys();
+    names.sort();
+    foreach (const QString &name, names) {
+        const PackageFingerprint &fingerprint = fingerprints[name];
+        if (fingerprint.hash.isEmpty())
+            continue;
+        QDomElement package = doc.createElement(QLatin1String("Package"));
+        package.setAttribute(QLatin1String("Name"), name);
+        package.setAttribute(QLatin1String("Hash"), QString::fromLatin1(fingerprint.hash));
+        foreach (const QString &fileName, fingerprint.files) {
+            package.appendChild(doc.createElement(QLatin1String("File")))
+                .appendChild(doc.createTextNode(fileName));
+        }
+        root.appendChild(package);
+    }
+
+    QInstaller::mkpath(repoDir);
+    QFile file(QString::fromLatin1("%1/%2").arg(repoDir, scFingerprintsFile));
+    QInstaller::openForWrite(&file);
+    QInstaller::blockingWrite(&file, doc.toByteArray());
+}
+
+/*!
+    Compresses the data directories of the package described by \a info into the repository
+    directory \a repoDir, or copies the files it already lists, and stores the resulting files
+    in \a info. If the package data still matches \a fingerprint, the files already in the
+    repository are reused instead. Otherwise \a fingerprint is updated once the new files are
+    in place. Returns an empty string on success, otherwise the error message.
+*/
+static QString copyPackageData(const QStringList &packageDirs, const QString &repoDir,
+    PackageInfo *info, PackageFingerprint *fingerprint, CopyDataContext *context)
+{
+    if (context->failed.load())
+        return QString(); // another package failed already, the result gets discarded anyway
+
+    try {
+        const QString name = info->name;
         const QString namedRepoDir = QString::fromLatin1("%1/%2").arg(repoDir, name);
+
+        QByteArray hash;
+        if (info->copiedFiles.isEmpty() && context->fingerprintMode != NoFingerprints) {
+            hash = packageFingerprint(packageDirs, *info, context->solidBlockSize,
+                context->fingerprintMode);
+            bool unchanged = (hash == fingerprint->hash);
+            foreach (const QString &fileName, fingerprint->files)
+                unchanged = unchanged && QFileInfo(namedRepoDir, fileName).isFile();
+            if (unchanged) {
+                qDebug() << "Reusing unchanged component data for" << name;
+                // drop everything else, such as the previous meta data archive
+                const QDir dir(namedRepoDir);
+                foreach (const QString &entry, dir.entryList(QDir::Files | QDir::Hidden | QDir::System)) {
+                    QFile file(dir.absoluteFilePath(entry));
+                    if (!fingerprint->files.contains(entry) && !file.remove()) {
+                        throw QInstaller::Error(QString::fromLatin1("Cannot remove file \"%1\": %2")
+                            .arg(QDir::toNativeSeparators(file.fileName()), file.errorString()));
+                    }
+                }
+                foreach (const QString &fileName, fingerprint->files)
+                    info->copiedFiles.append(QString::fromLatin1("%1/%2").arg(namedRepoDir, fileName));
+                return QString();
+            }
+        }
+        fingerprint->hash.clear();
+        fingerprint->files.clear();
+
+        qDebug() << "Copying component data for" << name;
+        if (QFileInfo(namedRepoDir).exists())
+            QInstaller::removeDirectory(namedRepoDir);
         if (!QDir().mkpath(namedRepoDir)) {
             throw QInstaller::Error(QString::fromLatin1("Cannot create repository directory for component \"%1\".")
                 .arg(name));
         }
 
-        if (info.copiedFiles.isEmpty()) {
+        if (info->copiedFiles.isEmpty()) {
             QStringList compressedFiles;
             QStringList filesToCompress;
+            QHash<QString, QByteArray> hashes;
             foreach (const QString &packageDir, packageDirs) {
                 const QDir dataDir(QString::fromLatin1("%1/%2/data").arg(packageDir, name));
                 foreach (const QString &entry, dataDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Files)) {
@@ -724,22 +1024,18 @@ void QInstallerTools::copyComponentData(const QStringList &packageDirs, const QS
                     if (fileInfo.isFile() && !fileInfo.isSymLink()) {
                         const QString absoluteEntryFilePath = dataDir.absoluteFilePath(entry);
                         if (Lib7z::isSupportedArchive(absoluteEntryFilePath)) {
-                            QFile tmp(absoluteEntryFilePath);
-                            QString target = QString::fromLatin1("%1/%3%2").arg(namedRepoDir, entry, info.version);
-                            qDebug() << "Copying archive from" << tmp.fileName() << "to" << target;
-                            if (!tmp.copy(target)) {
-                                throw QInstaller::Error(QString::fromLatin1("Cannot copy file \"%1\" to \"%2\": %3")
-                                    .arg(QDir::toNativeSeparators(tmp.fileName()), QDir::toNativeSeparators(target), tmp.errorString()));
-                            }
+                            QString target = QString::fromLatin1("%1/%3%2").arg(namedRepoDir, entry, info->version);
+                            qDebug() << "Copying archive from" << absoluteEntryFilePath << "to" << target;
+                            hashes.insert(target, copyWithHash(absoluteEntryFilePath, target));
                             compressedFiles.append(target);
                         } else {
                             filesToCompress.append(absoluteEntryFilePath);
                         }
                     } else if (fileInfo.isDir()) {
                         qDebug() << "Compressing data directory" << entry;
-                        QString target = QString::fromLatin1("%1/%3%2.7z").arg(namedRepoDir, entry, info.version);
+                        QString target = QString::fromLatin1("%1/%3%2.7z").arg(namedRepoDir, entry, info->version);
                         Lib7z::createArchive(target, QStringList() << dataDir.absoluteFilePath(entry),
-                            Lib7z::QTmpFile::No);
+                            Lib7z::QTmpFile::No, Lib7z::Compression::Normal, 0, solidBlockSize);
                         compressedFiles.append(target);
                     } else if (fileInfo.isSymLink()) {
                         filesToCompress.append(dataDir.absoluteFilePath(entry));
@@ -750,13 +1046,14 @@ void QInstallerTools::copyComponentData(const QStringList &packageDirs, const QS
             if (!filesToCompress.isEmpty()) {
                 qDebug() << "Compressing files found in data directory:" << filesToCompress;
                 QString target = QString::fromLatin1("%1/%3%2").arg(namedRepoDir, QLatin1String("content.7z"),
-                    info.version);
-                Lib7z::createArchive(target, filesToCompress, Lib7z::QTmpFile::No);
+                    info->version);
+                Lib7z::createArchive(target, filesToCompress, Lib7z::QTmpFile::No,
+                    Lib7z::Compression::Normal, 0, solidBlockSize);
                 compressedFiles.append(target);
             }
 
             foreach (const QString &target, compressedFiles) {
-                (*infos)[i].copiedFiles.append(target);
+                info->copiedFiles.append(target);
 
                 QFile archiveFile(target);
                 QFile archiveHashFile(archiveFile.fileName() + QLatin1String(".sha1"));
@@ -765,15 +1062,21 @@ void QInstallerTools::copyComponentData(const QStringList &packageDirs, const QS
                 qDebug() << "Creating hash of archive" << archiveFile.fileName();
 
                 try {
-                    QInstaller::openForRead(&archiveFile);
-                    const QByteArray hashOfArchiveData = QInstaller::calculateHash(&archiveFile,
-                        QCryptographicHash::Sha1).toHex();
-                    archiveFile.close();
+                    // 7z rewrites the start of an archive once it is complete, so created archives
+                    // are hashed afterwards, while they are still in the file system cache
+                    QByteArray hashOfArchiveData = hashes.value(target);
+                    if (hashOfArchiveData.isEmpty()) {
+                        QInstaller::openForRead(&archiveFile);
+                        hashOfArchiveData = QInstaller::calculateHash(&archiveFile,
+                            QCryptographicHash::Sha1);
+                        archiveFile.close();
+                    }
+                    hashOfArchiveData = hashOfArchiveData.toHex();
 
                     QInstaller::openForWrite(&archiveHashFile);
                     archiveHashFile.write(hashOfArchiveData);
                     qDebug() << "Generated sha1 hash:" << hashOfArchiveData;
-                    (*infos)[i].copiedFiles.append(archiveHashFile.fileName());
+                    info->copiedFiles.append(archiveHashFile.fileName());
                     archiveHashFile.close();
                 } catch (const QInstaller::Error &/*e*/) {
                     archiveFile.close();
@@ -782,7 +1085,7 @@ void QInstallerTools::copyComponentData(const QStringList &packageDirs, const QS
                 }
             }
         } else {
-            foreach (const QString &file, (*infos)[i].copiedFiles) {
+            foreach (const QString &file, info->copiedFiles) {
                 QFileInfo fromInfo(file);
                 QFile from(file);
                 QString target = QString::fromLatin1("%1/%2").arg(namedRepoDir, fromInfo.fileName());
@@ -793,5 +1096,60 @@ void QInstallerTools::copyComponentData(const QStringList &packageDirs, const QS
                 }
             }
         }
+
+        if (!hash.isEmpty()) {
+            fingerprint->hash = hash;
+            foreach (const QString &file, info->copiedFiles)
+                fingerprint->files.append(QFileInfo(file).fileName());
+        }
+    } catch (const QInstaller::Error &e) {
+        context->failed.store(1);
+        return e.message();
+    } catch (...) {
+        context->failed.store(1);
+        return QString::fromLatin1("Unknown exception caught while copying component data for "
+            "\"%1\".").arg(info->name);
     }
+    return QString();
+}
+
+void QInstallerTools::copyComponentData(const QStringList &packageDirs, const QString &repoDir,
+    PackageInfoVector *const infos, quint64 solidBlockSize, int jobs, FingerprintMode fingerprintMode)
+{
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, jobs));
+
+    CopyDataContext context;
+    context.solidBlockSize = solidBlockSize;
+    context.fingerprintMode = fingerprintMode;
+
+    QHash<QString, PackageFingerprint> fingerprints;
+    if (fingerprintMode != NoFingerprints)
+        fingerprints = readFingerprints(repoDir);
+
+    PackageInfo *const packages = infos->data();
+    QVector<PackageFingerprint> packageFingerprints(infos->count());
+    QList<QFuture<QString> > futures;
+    for (int i = 0; i < infos->count(); ++i) {
+        packageFingerprints[i] = fingerprints.value(packages[i].name);
+        futures.append(QtConcurrent::run(&pool, copyPackageData, packageDirs, repoDir,
+            packages + i, &packageFingerprints[i], &context));
+    }
+
+    QString errorString;
+    foreach (const QFuture<QString> &future, futures) {
+        const QString result = future.result(); // blocks until the package is done
+        if (errorString.isEmpty())
+            errorString = result;
+    }
+
+    // written even on errors, so packages that did complete are not compressed again next time
+    if (fingerprintMode != NoFingerprints) {
+        for (int i = 0; i < infos->count(); ++i)
+            fingerprints.insert(packages[i].name, packageFingerprints.at(i));
+        writeFingerprints(repoDir, fingerprints);
+    }
+
+    if (!errorString.isEmpty())
+        throw QInstaller::Error(errorString);
 }
@@ -54,6 +54,12 @@ enum FilterType {
     Exclude
 };
 
+enum FingerprintMode {
+    NoFingerprints,
+    FileAttributeFingerprints,
+    FileContentFingerprints
+};
+
 void printRepositoryGenOptions();
 QString makePathAbsolute(const QString &path);
 void copyWithException(const QString &source, const QString &target, const QString &kind = QString());
@@ -67,11 +73,13 @@ PackageInfoVector createListOfRepositoryPackages(const QStringList &repositoryDi
 QHash<QString, QString> buildPathToVersionMapping(const PackageInfoVector &info);
 
 void compressMetaDirectories(const QString &repoDir, const QString &baseDir,
-    const QHash<QString, QString> &versionMapping);
+    const QHash<QString, QString> &versionMapping, bool uniteMetadata = false,
+    const QString &existingRepoDir = QString(), int jobs = 1);
 
 void copyMetaData(const QString &outDir, const QString &dataDir, const PackageInfoVector &packages,
     const QString &appName, const QString& appVersion);
-void copyComponentData(const QStringList &packageDir, const QString &repoDir, PackageInfoVector *const infos);
+void copyComponentData(const QStringList &packageDir, const QString &repoDir, PackageInfoVector *const infos,
+    quint64 solidBlockSize = 0, int jobs = 1, FingerprintMode fingerprintMode = NoFingerprints);
 
 
 } // namespace QInstallerTools
@@ -66,6 +66,13 @@ static void printUsage()
     std::cout << "                            --include or --exclude) in the repository with all new components"
         << std::endl;
 
+    std::cout << "  --unite-metadata          Additionally pack the meta data of all components into" << std::endl;
+    std::cout << "                            one archive that installers fetch with a single download" << std::endl;
+
+    std::cout << "  --fingerprint-content     Compare the content of the package data files, not only" << std::endl;
+    std::cout << "                            their sizes and modification times, when checking" << std::endl;
+    std::cout << "                            whether a package can be reused on update" << std::endl;
+
     std::cout << "  -v|--verbose              Verbose output" << std::endl;
 
     std::cout << std::endl;
@@ -99,6 +106,10 @@ int main(int argc, char** argv)
         QInstallerTools::FilterType filterType = QInstallerTools::Exclude;
         bool remove = false;
         bool updateExistingRepositoryWithNewComponents = false;
+        quint64 solidBlockSize = 0;
+        int jobs = 1;
+        bool uniteMetadata = false;
+        QInstallerTools::FingerprintMode fingerprintMode = QInstallerTools::FileAttributeFingerprints;
 
         //TODO: use a for loop without removing values from args like it is in binarycreator.cpp
         //for (QStringList::const_iterator it = args.begin(); it != args.end(); ++it) {
@@ -170,6 +181,32 @@ int main(int argc, char** argv)
                 }
                 repositoryDirectories.append(args.first());
                 args.removeFirst();
+            } else if (args.first() == QLatin1String("--solid-block-size")) {
+                args.removeFirst();
+                bool ok = false;
+                if (!args.isEmpty())
+                    solidBlockSize = args.first().toULongLong(&ok) * 1024 * 1024;
+                if (!ok || solidBlockSize == 0) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Solid block size parameter missing or invalid"));
+                }
+                args.removeFirst();
+            } else if (args.first() == QLatin1String("--jobs") || args.first() == QLatin1String("-j")) {
+                args.removeFirst();
+                bool ok = false;
+                if (!args.isEmpty())
+                    jobs = args.first().toInt(&ok);
+                if (!ok || jobs < 1) {
+                    return printErrorAndUsageAndExit(QCoreApplication::translate("QInstaller",
+                        "Error: Jobs parameter missing or invalid"));
+                }
+                args.removeFirst();
+            } else if (args.first() == QLatin1String("--unite-metadata")) {
+                args.removeFirst();
+                uniteMetadata = true;
+            } else if (args.first() == QLatin1String("--fingerprint-content")) {
+                args.removeFirst();
+                fingerprintMode = QInstallerTools::FileContentFingerprints;
             } else if (args.first() == QLatin1String("--ignore-translations")
                 || args.first() == QLatin1String("--ignore-invalid-packages")) {
                     args.removeFirst();
@@ -263,24 +300,21 @@ int main(int argc, char** argv)
 
         QHash<QString, QString> pathToVersionMapping = QInstallerTools::buildPathToVersionMapping(packages);
 
-        foreach (const QInstallerTools::PackageInfo &package, packages) {
-            const QFileInfo fi(repositoryDir, package.name);
-            if (fi.exists())
-                removeDirectory(fi.absoluteFilePath());
-        }
-
         QTemporaryDir tmp;
         tmp.setAutoRemove(false);
         tmpMetaDir = tmp.path();
         QStringList directories;
         directories.append(packagesDirectories);
         directories.append(repositoryDirectories);
-        QInstallerTools::copyComponentData(directories, repositoryDir, &packages);
+        QInstallerTools::copyComponentData(directories, repositoryDir, &packages, solidBlockSize, jobs,
+            fingerprintMode);
         QInstallerTools::copyMetaData(tmpMetaDir, repositoryDir, packages, QLatin1String("{AnyApplication}"),
             QLatin1String(QUOTE(IFW_REPOSITORY_FORMAT_VERSION)));
-        QInstallerTools::compressMetaDirectories(tmpMetaDir, tmpMetaDir, pathToVersionMapping);
+        QInstallerTools::compressMetaDirectories(tmpMetaDir, tmpMetaDir, pathToVersionMapping,
+            uniteMetadata, repositoryDir, jobs);
 
-        QDirIterator it(repositoryDir, QStringList(QLatin1String("Updates*.xml")), QDir::Files | QDir::CaseSensitive);
+        QDirIterator it(repositoryDir, QStringList() << QLatin1String("Updates*.xml")
+            << QLatin1String("*_meta.7z"), QDir::Files | QDir::CaseSensitive);
         while (it.hasNext()) {
             it.next();
             QFile::remove(it.fileInfo().absoluteFilePath());